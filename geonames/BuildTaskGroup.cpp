@@ -0,0 +1,130 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class BuildTaskGroup
+ */
+// ======================================================================
+
+#include "BuildTaskGroup.h"
+#include <boost/thread.hpp>
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <optional>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+namespace
+{
+unsigned int thread_count(unsigned int threads)
+{
+  if (threads > 0)
+    return threads;
+  return std::max(1U, boost::thread::hardware_concurrency());
+}
+}  // namespace
+
+BuildTaskGroup::BuildTaskGroup(unsigned int theThreads, LoadProfile* theProfile)
+    : itsGroup(thread_count(theThreads)), itsProfile(theProfile)
+{
+}
+
+BuildTaskGroup::~BuildTaskGroup()
+{
+  if (itsWaited)
+    return;
+
+  try
+  {
+    itsGroup.stop();
+    itsGroup.wait();
+  }
+  catch (...)
+  {
+    // Errors are irrelevant when the results are abandoned
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a new task to the group
+ */
+// ----------------------------------------------------------------------
+
+void BuildTaskGroup::add(const std::string& theName, std::function<void()> theTask)
+{
+  try
+  {
+    itsWaited = false;
+    itsGroup.add(theName,
+                 [this, theName, task = std::move(theTask)]()
+                 {
+                   try
+                   {
+                     std::optional<LoadProfile::Scope> scope;
+                     if (itsProfile != nullptr)
+                       scope.emplace(*itsProfile, theName);
+                     task();
+                   }
+                   catch (const boost::thread_interrupted&)
+                   {
+                     throw;
+                   }
+                   catch (...)
+                   {
+                     std::lock_guard<std::mutex> lock(itsMutex);
+                     if (!itsError)
+                       itsError = std::current_exception();
+                   }
+                 });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Task", theName);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Wait for all the tasks to finish
+ */
+// ----------------------------------------------------------------------
+
+void BuildTaskGroup::wait()
+{
+  try
+  {
+    try
+    {
+      itsGroup.wait();
+    }
+    catch (...)
+    {
+      itsGroup.stop();
+      itsGroup.wait();
+      itsWaited = true;
+      throw;
+    }
+
+    itsWaited = true;
+
+    std::exception_ptr error;
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      std::swap(error, itsError);
+    }
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,56 @@
+// ======================================================================
+/*!
+ * \brief Group of concurrent initialization or search tasks
+ *
+ * Runs the tasks in an Fmi::AsyncTaskGroup and remembers the first
+ * failure, which is rethrown once all the tasks have finished. Thread
+ * interruptions are passed on to the task group. Any tasks still running
+ * when the group is destroyed are stopped and waited for, so that the
+ * group can safely be abandoned when an error occurs elsewhere. If a load
+ * profile is given, every task is recorded as a phase of its own.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "LoadProfile.h"
+#include <macgyver/AsyncTaskGroup.h>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class BuildTaskGroup
+{
+ public:
+  ~BuildTaskGroup();
+  explicit BuildTaskGroup(unsigned int theThreads, LoadProfile* theProfile = nullptr);
+
+  BuildTaskGroup() = delete;
+  BuildTaskGroup(const BuildTaskGroup& other) = delete;
+  BuildTaskGroup& operator=(const BuildTaskGroup& other) = delete;
+  BuildTaskGroup(BuildTaskGroup&& other) = delete;
+  BuildTaskGroup& operator=(BuildTaskGroup&& other) = delete;
+
+  void add(const std::string& theName, std::function<void()> theTask);
+
+  // Wait for all tasks to finish and rethrow the first failure
+  void wait();
+
+ private:
+  Fmi::AsyncTaskGroup itsGroup;
+  LoadProfile* itsProfile;
+  std::mutex itsMutex;
+  std::exception_ptr itsError;
+  bool itsWaited = false;
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,164 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class CollationTable
+ */
+// ======================================================================
+
+#include "CollationTable.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <utility>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+namespace
+{
+// ASCII, Latin-1 Supplement and Latin Extended-A
+const char32_t max_codepoint = 0x180;
+
+bool is_candidate(char32_t cp)
+{
+  return (cp > 0x20 && cp < 0x7f) || (cp >= 0xa0 && cp < max_codepoint);
+}
+
+std::string to_utf8(char32_t cp)
+{
+  if (cp < 0x80)
+    return std::string(1, static_cast<char>(cp));
+
+  std::string ret;
+  ret += static_cast<char>(0xc0 | (cp >> 6));
+  ret += static_cast<char>(0x80 | (cp & 0x3f));
+  return ret;
+}
+
+std::size_t common_suffix(const std::string& a, const std::string& b)
+{
+  std::size_t n = 0;
+  while (n < a.size() && n < b.size() && a[a.size() - 1 - n] == b[b.size() - 1 - n])
+    ++n;
+  return n;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Learn the keys of the characters from the collator
+ *
+ * Characters involved in failed two character tests are dropped one at
+ * a time, the one with most failures first, until the remaining ones
+ * pass all the tests.
+ */
+// ----------------------------------------------------------------------
+
+CollationTable::CollationTable(const Transform& theTransform)
+    : itsWeights(max_codepoint), itsKnown(max_codepoint, false)
+{
+  try
+  {
+    std::vector<char32_t> chars;
+    std::vector<std::string> keys(max_codepoint);
+    for (char32_t cp = 0; cp < max_codepoint; ++cp)
+    {
+      if (!is_candidate(cp))
+        continue;
+      keys[cp] = theTransform(to_utf8(cp));
+      chars.push_back(cp);
+    }
+
+    // Common end of the keys such as a level separator
+
+    const std::string& first = keys[chars.front()];
+    std::size_t suffix = first.size();
+    for (auto cp : chars)
+      suffix = std::min(suffix, common_suffix(first, keys[cp]));
+    itsSuffix = first.substr(first.size() - suffix);
+
+    for (auto cp : chars)
+      itsWeights[cp] = keys[cp].substr(0, keys[cp].size() - suffix);
+
+    // Two character strings whose keys are not concatenations
+
+    std::vector<std::pair<char32_t, char32_t>> failures;
+    for (auto a : chars)
+      for (auto b : chars)
+      {
+        if (theTransform(to_utf8(a) + to_utf8(b)) != itsWeights[a] + itsWeights[b] + itsSuffix)
+          failures.emplace_back(a, b);
+      }
+
+    std::vector<bool> dropped(max_codepoint, false);
+    while (true)
+    {
+      std::vector<std::size_t> counts(max_codepoint, 0);
+      bool failed = false;
+      for (const auto& failure : failures)
+      {
+        if (dropped[failure.first] || dropped[failure.second])
+          continue;
+        ++counts[failure.first];
+        ++counts[failure.second];
+        failed = true;
+      }
+      if (!failed)
+        break;
+      dropped[std::max_element(counts.begin(), counts.end()) - counts.begin()] = true;
+    }
+
+    for (auto cp : chars)
+    {
+      if (dropped[cp])
+        continue;
+      itsKnown[cp] = true;
+      ++itsSize;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collation key of a name without whitespace
+ */
+// ----------------------------------------------------------------------
+
+bool CollationTable::transform(const std::string& theName, std::string& theKey) const
+{
+  theKey.clear();
+
+  for (std::size_t i = 0; i < theName.size(); ++i)
+  {
+    const auto c = static_cast<unsigned char>(theName[i]);
+
+    char32_t cp = c;
+    if (c >= 0x80)
+    {
+      // Two byte sequences up to U+017F
+      if (c < 0xc2 || c > 0xc5 || i + 1 >= theName.size())
+        return false;
+      const auto next = static_cast<unsigned char>(theName[++i]);
+      if ((next & 0xc0) != 0x80)
+        return false;
+      cp = ((c & 0x1f) << 6) | (next & 0x3f);
+    }
+
+    if (!itsKnown[cp])
+      return false;
+    theKey += itsWeights[cp];
+  }
+
+  theKey += itsSuffix;
+  return true;
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
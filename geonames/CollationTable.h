@@ -0,0 +1,55 @@
+// ======================================================================
+/*!
+ * \brief Table driven collation keys for Latin script names
+ *
+ * The primary strength collation keys of single ASCII and Latin-1 or
+ * Latin Extended-A characters are learned from the collator of the
+ * configured locale. A character is kept only if the keys of all two
+ * character strings of the kept characters are concatenations of the
+ * single character keys, which excludes contractions and compressed
+ * weights of the locale. Names consisting only of kept characters then
+ * get the same keys as from the collator without calling it, other
+ * names must be transformed by the collator.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class CollationTable
+{
+ public:
+  using Transform = std::function<std::string(const std::string&)>;
+
+  explicit CollationTable(const Transform& theTransform);
+
+  CollationTable() = delete;
+  CollationTable(const CollationTable& other) = delete;
+  CollationTable& operator=(const CollationTable& other) = delete;
+  CollationTable(CollationTable&& other) = delete;
+  CollationTable& operator=(CollationTable&& other) = delete;
+
+  // Returns false if the UTF-8 name contains characters not in the table
+  bool transform(const std::string& theName, std::string& theKey) const;
+
+  std::size_t size() const { return itsSize; }  // number of characters in the table
+
+ private:
+  std::vector<std::string> itsWeights;  // keys without the common suffix by code point
+  std::vector<bool> itsKnown;
+  std::string itsSuffix;  // common end of all keys
+  std::size_t itsSize = 0;
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -39,6 +39,17 @@ namespace Geonames
 static const std::string default_language = "fi";
 static const char* default_maxdistance = "15km";  // km
 
+// Options for the simple searches returning a single location
+Locus::QueryOptions simple_options(const std::string& theLang)
+{
+  Locus::QueryOptions opts;
+  opts.SetCountries("all");
+  opts.SetSearchVariants(true);
+  opts.SetLanguage(theLang);
+  opts.SetResultLimit(1);
+  return opts;
+}
+
 std::string parse_radius(const std::string& inputStr, double& radius)
 {
   try
@@ -260,11 +271,7 @@ void LocationOptions::add(const std::string& theTag, std::unique_ptr<Spine::Loca
 Engine::Engine(std::string theConfigFile)
     : itsStartTime(Fmi::SecondClock::local_time()),
       itsReloading(false),
-      itsNameSearchCount(0),
-      itsLonLatSearchCount(0),
-      itsIdSearchCount(0),
-      itsKeywordSearchCount(0),
-      itsSuggestCount(0),
+      itsMetrics(std::make_shared<Metrics>()),
       itsConfigFile(std::move(theConfigFile)),
       initFailed(false),
       itsIoService(),
@@ -312,9 +319,10 @@ void Engine::init()
           "Geoengine information");
     }
 
-    tmpImpl = std::make_shared<Impl>(itsConfigFile, false);
+    tmpImpl = std::make_shared<Impl>(itsConfigFile, false, itsMetrics);
     bool first_construction = true;
     tmpImpl->init(first_construction);
+    itsAsyncPool = std::make_unique<boost::asio::thread_pool>(tmpImpl->asyncThreads());
     impl.store(tmpImpl);
 
     maybeScheduleAutoReloadCheck();
@@ -338,6 +346,13 @@ void Engine::shutdown()
   {
     std::cout << "  -- Shutdown requested (geoengine)\n";
 
+    // Searches not yet started will fail with a broken promise
+    if (itsAsyncPool)
+    {
+      itsAsyncPool->stop();
+      itsAsyncPool->join();
+    }
+
     itsIoService.stop();
     if (itsIoServiceThread.joinable())
     {
@@ -490,21 +505,16 @@ Spine::LocationPtr Engine::nameSearch(const std::string& theName, const std::str
 {
   try
   {
-    // ++itsNameSearchCount;
-
     // Search the name
-    Locus::QueryOptions opts;
-    opts.SetCountries("all");
-    opts.SetSearchVariants(true);
-    opts.SetLanguage(theLang);
-    opts.SetResultLimit(1);
+    auto opts = simple_options(theLang);
 
     Spine::LocationList result = nameSearch(opts, theName);
 
     if (result.empty())
       throw Fmi::Exception(BCP, "Unknown location: " + theName);
 
-    return translateLocation(*result.front(), theLang);
+    Metrics::Timer timer(*itsMetrics, Metrics::Operation::NameSearch, Metrics::Phase::Translation);
+    return translateLocation(result.front(), theLang);
   }
   catch (...)
   {
@@ -542,32 +552,59 @@ Spine::LocationPtr Engine::featureSearch(double theLongitude,
   try
   {
     // Search the location only if there is a search distance
+    Spine::LocationList result;
     if (theMaxDistance > 0)
     {
-      Locus::QueryOptions opts;
-      opts.SetCountries("all");
-      opts.SetSearchVariants(true);
-      opts.SetLanguage(theLang);
-      opts.SetResultLimit(1);
+      auto opts = simple_options(theLang);
       if (!theFeatures.empty())
         opts.SetFeatures(theFeatures);
 
-      Spine::LocationList result = lonlatSearch(opts,
-                                                boost::numeric_cast<float>(theLongitude),
-                                                boost::numeric_cast<float>(theLatitude),
-                                                boost::numeric_cast<float>(theMaxDistance));
+      result = lonlatSearch(opts,
+                            boost::numeric_cast<float>(theLongitude),
+                            boost::numeric_cast<float>(theLatitude),
+                            boost::numeric_cast<float>(theMaxDistance));
+    }
 
-      if (!result.empty())
-      {
-        // Keep original coordinates, dem and landcover for the named location we found
-        Spine::Location newloc(*result.front());
-        newloc.longitude = theLongitude;
-        newloc.latitude = theLatitude;
-        newloc.dem = demheight(dem(), theLongitude, theLatitude, maxDemResolution());
-        newloc.covertype = covertype(landCover(), theLongitude, theLatitude);
-
-        return translateLocation(newloc, theLang);
-      }
+    return featureLocation(result,
+                           theLongitude,
+                           theLatitude,
+                           demHeight(theLongitude, theLatitude),
+                           coverType(theLongitude, theLatitude),
+                           theLang);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the result of a feature search from the found locations
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationPtr Engine::featureLocation(const Spine::LocationList& theMatches,
+                                           double theLongitude,
+                                           double theLatitude,
+                                           double theDem,
+                                           Fmi::LandCover::Type theCoverType,
+                                           const std::string& theLang) const
+{
+  try
+  {
+    if (!theMatches.empty())
+    {
+      // Keep original coordinates, dem and landcover for the named location we found
+      auto newloc = std::make_shared<Spine::Location>(*theMatches.front());
+      newloc->longitude = theLongitude;
+      newloc->latitude = theLatitude;
+      newloc->dem = theDem;
+      newloc->covertype = theCoverType;
+
+      // The copy is ours, hence translate it in place
+      impl.load()->translate(*newloc, theLang);
+      return newloc;
     }
 
     std::string name = Fmi::to_string(theLongitude) + "," + Fmi::to_string(theLatitude);
@@ -587,8 +624,8 @@ Spine::LocationPtr Engine::featureSearch(double theLongitude,
                             timezone,
                             -1,
                             -1,
-                            demheight(dem(), theLongitude, theLatitude, maxDemResolution()),
-                            covertype(landCover(), theLongitude, theLatitude)));
+                            theDem,
+                            theCoverType));
   }
   catch (...)
   {
@@ -606,22 +643,135 @@ Spine::LocationPtr Engine::idSearch(long theGeoID, const std::string& theLang) c
 {
   try
   {
-    // ++itsIdSearchCount;
-
     // Search the name
 
-    Locus::QueryOptions opts;
-    opts.SetCountries("all");
-    opts.SetSearchVariants(true);
-    opts.SetLanguage(theLang);
-    opts.SetResultLimit(1);
+    auto opts = simple_options(theLang);
 
     Spine::LocationList result = idSearch(opts, boost::numeric_cast<int>(theGeoID));
 
     if (result.empty())
       throw Fmi::Exception(BCP, "Unknown location ID: " + Fmi::to_string(theGeoID));
 
-    return translateLocation(*result.front(), theLang);
+    Metrics::Timer timer(*itsMetrics, Metrics::Operation::IdSearch, Metrics::Phase::Translation);
+    return translateLocation(result.front(), theLang);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do simple name searches
+ *
+ * Throws for the first name which is not found.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationPtr> Engine::nameSearch(const std::vector<std::string>& theNames,
+                                                   const std::string& theLang) const
+{
+  try
+  {
+    auto results = nameSearch(simple_options(theLang), theNames);
+
+    std::vector<Spine::LocationPtr> ret;
+    ret.reserve(results.size());
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+      if (results[i].empty())
+        throw Fmi::Exception(BCP, "Unknown location: " + theNames[i]);
+      ret.push_back(translateLocation(results[i].front(), theLang));
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do simple lonlat searches for the given features
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationPtr> Engine::featureSearch(
+    const std::vector<std::pair<double, double>>& theCoordinates,
+    const std::string& theLang,
+    const std::string& theFeatures,
+    double theMaxDistance) const
+{
+  try
+  {
+    // Search the locations only if there is a search distance
+    std::vector<Spine::LocationList> results(theCoordinates.size());
+    if (theMaxDistance > 0)
+    {
+      auto opts = simple_options(theLang);
+      if (!theFeatures.empty())
+        opts.SetFeatures(theFeatures);
+
+      std::vector<std::pair<float, float>> lonlats;
+      lonlats.reserve(theCoordinates.size());
+      for (const auto& lonlat : theCoordinates)
+        lonlats.emplace_back(boost::numeric_cast<float>(lonlat.first),
+                             boost::numeric_cast<float>(lonlat.second));
+
+      results = lonlatSearch(opts, lonlats, boost::numeric_cast<float>(theMaxDistance));
+    }
+
+    const auto dems = demHeights(theCoordinates);
+    const auto covertypes = coverTypes(theCoordinates);
+
+    std::vector<Spine::LocationPtr> ret;
+    ret.reserve(results.size());
+    for (std::size_t i = 0; i < results.size(); ++i)
+      ret.push_back(featureLocation(results[i],
+                                    theCoordinates[i].first,
+                                    theCoordinates[i].second,
+                                    dems[i],
+                                    covertypes[i],
+                                    theLang));
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do simple ID searches
+ *
+ * Throws for the first ID which is not found.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationPtr> Engine::idSearch(const std::vector<long>& theGeoIDs,
+                                                 const std::string& theLang) const
+{
+  try
+  {
+    std::vector<int> ids;
+    ids.reserve(theGeoIDs.size());
+    for (auto geoid : theGeoIDs)
+      ids.push_back(boost::numeric_cast<int>(geoid));
+
+    auto results = idSearch(simple_options(theLang), ids);
+
+    std::vector<Spine::LocationPtr> ret;
+    ret.reserve(results.size());
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+      if (results[i].empty())
+        throw Fmi::Exception(BCP, "Unknown location ID: " + Fmi::to_string(theGeoIDs[i]));
+      ret.push_back(translateLocation(results[i].front(), theLang));
+    }
+    return ret;
   }
   catch (...)
   {
@@ -640,7 +790,7 @@ Spine::LocationList Engine::nameSearch(const Locus::QueryOptions& theOptions,
 {
   try
   {
-    ++itsNameSearchCount;
+    Metrics::Call call(*itsMetrics, Metrics::Operation::NameSearch);
     auto mycopy = impl.load();
     return mycopy->name_search(theOptions, theName);
   }
@@ -684,7 +834,7 @@ Spine::LocationList Engine::lonlatSearch(const Locus::QueryOptions& theOptions,
 {
   try
   {
-    ++itsLonLatSearchCount;
+    Metrics::Call call(*itsMetrics, Metrics::Operation::LonLatSearch);
     auto mycopy = impl.load();
     return mycopy->lonlat_search(theOptions, theLongitude, theLatitude, theRadius);
   }
@@ -704,7 +854,7 @@ Spine::LocationList Engine::idSearch(const Locus::QueryOptions& theOptions, int
 {
   try
   {
-    ++itsIdSearchCount;
+    Metrics::Call call(*itsMetrics, Metrics::Operation::IdSearch);
     auto mycopy = impl.load();
     return mycopy->id_search(theOptions, theId);
   }
@@ -714,6 +864,71 @@ Spine::LocationList Engine::idSearch(const Locus::QueryOptions& theOptions, int
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do name searches
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationList> Engine::nameSearch(const Locus::QueryOptions& theOptions,
+                                                    const std::vector<std::string>& theNames) const
+{
+  try
+  {
+    Metrics::Call call(*itsMetrics, Metrics::Operation::NameSearch, theNames.size());
+    auto mycopy = impl.load();
+    return mycopy->name_search(theOptions, theNames);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do coordinate searches
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationList> Engine::lonlatSearch(
+    const Locus::QueryOptions& theOptions,
+    const std::vector<std::pair<float, float>>& theCoordinates,
+    float theRadius) const
+{
+  try
+  {
+    Metrics::Call call(*itsMetrics, Metrics::Operation::LonLatSearch, theCoordinates.size());
+    auto mycopy = impl.load();
+    return mycopy->lonlat_search(theOptions, theCoordinates, theRadius);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do id searches
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationList> Engine::idSearch(const Locus::QueryOptions& theOptions,
+                                                  const std::vector<int>& theIds) const
+{
+  try
+  {
+    Metrics::Call call(*itsMetrics, Metrics::Operation::IdSearch, theIds.size());
+    auto mycopy = impl.load();
+    return mycopy->id_search(theOptions, theIds);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Do a keyword search
@@ -725,7 +940,7 @@ Spine::LocationList Engine::keywordSearch(const Locus::QueryOptions& theOptions,
 {
   try
   {
-    ++itsKeywordSearchCount;
+    Metrics::Call call(*itsMetrics, Metrics::Operation::KeywordSearch);
     auto mycopy = impl.load();
     return mycopy->keyword_search(theOptions, theKeyword);
   }
@@ -735,6 +950,143 @@ Spine::LocationList Engine::keywordSearch(const Locus::QueryOptions& theOptions,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run a search in the asynchronous search thread pool
+ */
+// ----------------------------------------------------------------------
+
+std::future<Spine::LocationList> Engine::runAsync(
+    std::shared_ptr<Metrics::Call> theCall, std::function<Spine::LocationList()> theSearch) const
+{
+  try
+  {
+    if (!itsAsyncPool)
+      throw Fmi::Exception(BCP, "Geonames engine has not been initialized");
+
+    // The call is measured until the search has finished
+    auto task = std::make_shared<std::packaged_task<Spine::LocationList()>>(
+        [call = std::move(theCall), search = std::move(theSearch)]()
+        {
+          try
+          {
+            return search();
+          }
+          catch (...)
+          {
+            call->fail();
+            throw;
+          }
+        });
+    auto ret = task->get_future();
+    boost::asio::post(*itsAsyncPool, [task]() { (*task)(); });
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return a ready future for a result found without the database
+ */
+// ----------------------------------------------------------------------
+
+std::future<Spine::LocationList> ready_future(Spine::LocationList theResult)
+{
+  std::promise<Spine::LocationList> promise;
+  promise.set_value(std::move(theResult));
+  return promise.get_future();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do a name search asynchronously
+ */
+// ----------------------------------------------------------------------
+
+std::future<Spine::LocationList> Engine::nameSearchAsync(const Locus::QueryOptions& theOptions,
+                                                         const std::string& theName) const
+{
+  try
+  {
+    auto call = std::make_shared<Metrics::Call>(*itsMetrics, Metrics::Operation::NameSearch);
+    auto mycopy = impl.load();
+
+    auto result = mycopy->find_name_search(theOptions, theName);
+    if (result)
+      return ready_future(std::move(*result));
+
+    return runAsync(call,
+                    [mycopy, theOptions, theName]()
+                    { return mycopy->name_search(theOptions, theName); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do a coordinate search asynchronously
+ */
+// ----------------------------------------------------------------------
+
+std::future<Spine::LocationList> Engine::lonlatSearchAsync(const Locus::QueryOptions& theOptions,
+                                                           float theLongitude,
+                                                           float theLatitude,
+                                                           float theRadius) const
+{
+  try
+  {
+    auto call = std::make_shared<Metrics::Call>(*itsMetrics, Metrics::Operation::LonLatSearch);
+    auto mycopy = impl.load();
+
+    auto result = mycopy->find_lonlat_search(theOptions, theLongitude, theLatitude, theRadius);
+    if (result)
+      return ready_future(std::move(*result));
+
+    return runAsync(
+        call,
+        [mycopy, theOptions, theLongitude, theLatitude, theRadius]()
+        { return mycopy->lonlat_search(theOptions, theLongitude, theLatitude, theRadius); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do an id search asynchronously
+ */
+// ----------------------------------------------------------------------
+
+std::future<Spine::LocationList> Engine::idSearchAsync(const Locus::QueryOptions& theOptions,
+                                                       int theId) const
+{
+  try
+  {
+    auto call = std::make_shared<Metrics::Call>(*itsMetrics, Metrics::Operation::IdSearch);
+    auto mycopy = impl.load();
+
+    auto result = mycopy->find_id_search(theOptions, theId);
+    if (result)
+      return ready_future(std::move(*result));
+
+    return runAsync(call,
+                    [mycopy, theOptions, theId]() { return mycopy->id_search(theOptions, theId); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Do a search for wkt object
@@ -745,6 +1097,8 @@ Spine::LocationPtr Engine::wktSearch(const std::string& theWktString,
                                      const std::string& theLanguage,
                                      double theRadius /* = 0.0*/) const
 {
+  Metrics::Call call(*itsMetrics, Metrics::Operation::WktSearch);
+
   std::unique_ptr<OGRGeometry> geom;
   geom.reset(Fmi::OGR::createFromWkt(theWktString, 4326));
 
@@ -770,6 +1124,25 @@ Spine::LocationPtr Engine::wktSearch(const std::string& theWktString,
   return lonlatSearch(lon, lat, theLanguage);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get a parsed wkt geometry
+ */
+// ----------------------------------------------------------------------
+
+WktShapePtr Engine::wktShape(const std::string& theWkt, double theRadius) const
+{
+  try
+  {
+    auto mycopy = impl.load();
+    return mycopy->wkt_shape(theWkt, theRadius);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Get wkt geometries
@@ -811,7 +1184,7 @@ Spine::LocationList Engine::suggest(
   {
     Spine::LocationList ret;
 
-    ++itsSuggestCount;
+    Metrics::Call call(*itsMetrics, Metrics::Operation::Suggest);
 
     auto mycopy = impl.load();
     return mycopy->suggest(
@@ -841,7 +1214,7 @@ Spine::LocationList Engine::suggestDuplicates(
   {
     Spine::LocationList ret;
 
-    ++itsSuggestCount;
+    Metrics::Call call(*itsMetrics, Metrics::Operation::Suggest);
 
     auto mycopy = impl.load();
     return mycopy->suggest(
@@ -871,7 +1244,7 @@ std::vector<Spine::LocationList> Engine::suggest(
   {
     Spine::LocationList ret;
 
-    ++itsSuggestCount;
+    Metrics::Call call(*itsMetrics, Metrics::Operation::Suggest);
 
     bool duplicates = false;
 
@@ -902,16 +1275,10 @@ Spine::LocationPtr Engine::keywordSearch(double theLongitude,
 {
   try
   {
-    ++itsLonLatSearchCount;
-
-    auto mycopy = impl.load();
+    Metrics::Call call(*itsMetrics, Metrics::Operation::LonLatSearch);
 
-    // We need suggest to be ready
-
-    while (!mycopy->isSuggestReady())
-    {
-      boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
-    }
+    // The keyword trees are built first
+    auto mycopy = readyImpl(ReadyPhase::Locations);
 
     // return null if keyword is wrong
 
@@ -919,20 +1286,60 @@ Spine::LocationPtr Engine::keywordSearch(double theLongitude,
     if (it == mycopy->itsGeoTrees.end())
       return {};
 
-    // this is unfortunate - we must allocate new Location just to
-    // get NearTree comparisons working
-
-    Spine::LocationPtr dummy(new Spine::Location(theLongitude, theLatitude));
-
     // result will be here, if there is one
 
-    std::optional<Spine::LocationPtr> ptr = it->second->nearest(dummy, theRadius);
+    Spine::LocationPtr ptr = it->second->nearest(theLongitude, theLatitude, theRadius);
     if (!ptr)
       return {};
 
-    Spine::LocationPtr newptr(new Spine::Location(**ptr));
-    mycopy->translate(newptr, theLang);
-    return newptr;
+    Metrics::Timer timer(
+        *itsMetrics, Metrics::Operation::LonLatSearch, Metrics::Phase::Translation);
+    mycopy->translate(ptr, theLang);
+    return ptr;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the keyword locations within the given radius, nearest first
+ *
+ * A zero maximum result count means all locations within the radius are returned.
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::keywordRadiusSearch(double theLongitude,
+                                                double theLatitude,
+                                                double theRadius,
+                                                const std::string& theLang,
+                                                const std::string& theKeyword,
+                                                unsigned int theMaxResults) const
+{
+  try
+  {
+    Metrics::Call call(*itsMetrics, Metrics::Operation::LonLatSearch);
+
+    // The keyword trees are built first
+    auto mycopy = readyImpl(ReadyPhase::Locations);
+
+    // return empty list if keyword is wrong
+
+    const auto it = mycopy->itsGeoTrees.find(theKeyword);
+    if (it == mycopy->itsGeoTrees.end())
+      return {};
+
+    auto matches =
+        (theMaxResults > 0 ? it->second->nearest(theLongitude, theLatitude, theMaxResults, theRadius)
+                           : it->second->within(theLongitude, theLatitude, theRadius));
+
+    Spine::LocationList ret(matches.begin(), matches.end());
+    Metrics::Timer timer(
+        *itsMetrics, Metrics::Operation::LonLatSearch, Metrics::Phase::Translation);
+    mycopy->translate(ret, theLang);
+    return ret;
   }
   catch (...)
   {
@@ -947,6 +1354,8 @@ LocationOptions Engine::parseLocations(const std::vector<int>& fmisids,
 {
   try
   {
+    Metrics::Call call(*itsMetrics, Metrics::Operation::ParseLocations);
+
     LocationOptions options;
 
     Locus::QueryOptions opts;
@@ -957,27 +1366,27 @@ LocationOptions Engine::parseLocations(const std::vector<int>& fmisids,
     opts.SetLanguage(language);
     opts.SetResultLimit(1);
 
-    opts.SetNameType("fmisid");
-    for (const auto& id : fmisids)
+    const auto add_stations = [this, &options, &opts](const std::vector<int>& ids)
     {
-      Spine::LocationList ll = nameSearch(opts, Fmi::to_string(id));
-      if (!ll.empty())
-        options.add(Fmi::to_string(id), ll.front());
-    }
+      std::vector<std::string> names;
+      names.reserve(ids.size());
+      for (const auto& id : ids)
+        names.push_back(Fmi::to_string(id));
+
+      auto results = nameSearch(opts, names);
+      for (std::size_t i = 0; i < results.size(); ++i)
+      {
+        if (!results[i].empty())
+          options.add(names[i], results[i].front());
+      }
+    };
+
+    opts.SetNameType("fmisid");
+    add_stations(fmisids);
     opts.SetNameType("lpnn");
-    for (const auto& id : lpnns)
-    {
-      Spine::LocationList ll = nameSearch(opts, Fmi::to_string(id));
-      if (!ll.empty())
-        options.add(Fmi::to_string(id), ll.front());
-    }
+    add_stations(lpnns);
     opts.SetNameType("wmo");
-    for (const auto& id : wmos)
-    {
-      Spine::LocationList ll = nameSearch(opts, Fmi::to_string(id));
-      if (!ll.empty())
-        options.add(Fmi::to_string(id), ll.front());
-    }
+    add_stations(wmos);
 
     return options;
   }
@@ -1001,17 +1410,17 @@ void Engine::parse_place(LocationOptions& theOptions,
   if (searchName.empty())
     return;
 
+  std::vector<std::string> names;
+  std::vector<double> radiuses;
+
   for (const std::string& city : searchName)
   {
     double radius = 0.0;
-    std::string city_string = parse_radius(city, radius);
-    Spine::LocationPtr loc = this->nameSearch(city_string, theLanguage);  // throws for empty result
-    std::unique_ptr<Spine::Location> loc2(new Spine::Location(*loc));
-    // in order to make difference between e.g. Helsinki, Helsinki:50
-    loc2->radius = radius;
-    loc2->type = Spine::Location::Place;
-    theOptions.add(city_string, loc2);
+    names.push_back(parse_radius(city, radius));
+    radiuses.push_back(radius);
   }
+
+  add_places(theOptions, names, radiuses, theLanguage);
 }
 
 void Engine::parse_places(LocationOptions& theOptions,
@@ -1022,6 +1431,9 @@ void Engine::parse_places(LocationOptions& theOptions,
   if (searchName.empty())
     return;
 
+  std::vector<std::string> names;
+  std::vector<double> radiuses;
+
   for (const std::string& places : searchName)
   {
     std::list<std::string> parts;
@@ -1030,16 +1442,30 @@ void Engine::parse_places(LocationOptions& theOptions,
     for (const std::string& city : parts)
     {
       double radius = 0.0;
-      std::string city_string = parse_radius(city, radius);
-      Spine::LocationPtr loc =
-          this->nameSearch(city_string, theLanguage);  // throws for empty result
-      // in order to make difference between e.g. Helsinki, Helsinki:50
-      std::unique_ptr<Spine::Location> loc2(new Spine::Location(*loc));
-      loc2->radius = radius;
-      loc2->type = Spine::Location::Place;
-      theOptions.add(city_string, loc2);
+      names.push_back(parse_radius(city, radius));
+      radiuses.push_back(radius);
     }
   }
+
+  add_places(theOptions, names, radiuses, theLanguage);
+}
+
+// Search the places with a single batch
+void Engine::add_places(LocationOptions& theOptions,
+                        const std::vector<std::string>& theNames,
+                        const std::vector<double>& theRadiuses,
+                        const std::string& theLanguage) const
+{
+  auto locs = nameSearch(theNames, theLanguage);  // throws for empty results
+
+  for (std::size_t i = 0; i < locs.size(); ++i)
+  {
+    // in order to make difference between e.g. Helsinki, Helsinki:50
+    std::unique_ptr<Spine::Location> loc2(new Spine::Location(*locs[i]));
+    loc2->radius = theRadiuses[i];
+    loc2->type = Spine::Location::Place;
+    theOptions.add(theNames[i], loc2);
+  }
 }
 
 void Engine::parse_lonlat(LocationOptions& theOptions,
@@ -1052,6 +1478,10 @@ void Engine::parse_lonlat(LocationOptions& theOptions,
   if (searchName.empty())
     return;
 
+  std::vector<std::string> tags;
+  std::vector<std::pair<double, double>> coordinates;
+  std::vector<double> radiuses;
+
   for (const std::string& coords : searchName)
   {
     std::vector<std::string> parts;
@@ -1066,15 +1496,14 @@ void Engine::parse_lonlat(LocationOptions& theOptions,
       std::string latstr = parse_radius(parts[j + 1], radius);
       double lon = Fmi::stod(parts[j]);
       double lat = Fmi::stod(latstr);
-      std::string tag = parts[j] + ',' + parts[j + 1];
-      Spine::LocationPtr loc =
-          this->featureSearch(lon, lat, theLanguage, theFeatures, theMaxDistance);
-      std::unique_ptr<Spine::Location> loc2(new Spine::Location(*loc));
-      loc2->radius = radius;
-      loc2->type = Spine::Location::CoordinatePoint;
-      theOptions.add(tag, loc2);
+      tags.push_back(parts[j] + ',' + parts[j + 1]);
+      coordinates.emplace_back(lon, lat);
+      radiuses.push_back(radius);
     }
   }
+
+  add_coordinates(
+      theOptions, tags, coordinates, radiuses, theLanguage, theFeatures, theMaxDistance);
 }
 
 void Engine::parse_lonlats(LocationOptions& theOptions,
@@ -1087,6 +1516,10 @@ void Engine::parse_lonlats(LocationOptions& theOptions,
   if (searchName.empty())
     return;
 
+  std::vector<std::string> tags;
+  std::vector<std::pair<double, double>> coordinates;
+  std::vector<double> radiuses;
+
   for (const std::string& coords : searchName)
   {
     std::vector<std::string> parts;
@@ -1100,15 +1533,14 @@ void Engine::parse_lonlats(LocationOptions& theOptions,
       std::string latstr = parse_radius(parts[j + 1], radius);
       double lon = Fmi::stod(parts[j]);
       double lat = Fmi::stod(latstr);
-      std::string tag = parts[j] + ',' + parts[j + 1];
-      Spine::LocationPtr loc =
-          this->featureSearch(lon, lat, theLanguage, theFeatures, theMaxDistance);
-      std::unique_ptr<Spine::Location> loc2(new Spine::Location(*loc));
-      loc2->type = Spine::Location::CoordinatePoint;
-      loc2->radius = radius;
-      theOptions.add(tag, loc2);
+      tags.push_back(parts[j] + ',' + parts[j + 1]);
+      coordinates.emplace_back(lon, lat);
+      radiuses.push_back(radius);
     }
   }
+
+  add_coordinates(
+      theOptions, tags, coordinates, radiuses, theLanguage, theFeatures, theMaxDistance);
 }
 
 void Engine::parse_latlon(LocationOptions& theOptions,
@@ -1121,6 +1553,10 @@ void Engine::parse_latlon(LocationOptions& theOptions,
   if (searchName.empty())
     return;
 
+  std::vector<std::string> tags;
+  std::vector<std::pair<double, double>> coordinates;
+  std::vector<double> radiuses;
+
   for (const std::string& coords : searchName)
   {
     std::vector<std::string> parts;
@@ -1136,15 +1572,14 @@ void Engine::parse_latlon(LocationOptions& theOptions,
       double lon = Fmi::stod(parts[j]);
       double lat = Fmi::stod(latstr);
       std::swap(lon, lat);
-      std::string tag = parts[j] + ',' + parts[j + 1];
-      Spine::LocationPtr loc =
-          this->featureSearch(lon, lat, theLanguage, theFeatures, theMaxDistance);
-      std::unique_ptr<Spine::Location> loc2(new Spine::Location(*loc));
-      loc2->type = Spine::Location::CoordinatePoint;
-      loc2->radius = radius;
-      theOptions.add(tag, loc2);
+      tags.push_back(parts[j] + ',' + parts[j + 1]);
+      coordinates.emplace_back(lon, lat);
+      radiuses.push_back(radius);
     }
   }
+
+  add_coordinates(
+      theOptions, tags, coordinates, radiuses, theLanguage, theFeatures, theMaxDistance);
 }
 
 void Engine::parse_latlons(LocationOptions& theOptions,
@@ -1157,6 +1592,10 @@ void Engine::parse_latlons(LocationOptions& theOptions,
   if (searchName.empty())
     return;
 
+  std::vector<std::string> tags;
+  std::vector<std::pair<double, double>> coordinates;
+  std::vector<double> radiuses;
+
   for (const std::string& coords : searchName)
   {
     std::vector<std::string> parts;
@@ -1171,15 +1610,34 @@ void Engine::parse_latlons(LocationOptions& theOptions,
       double lon = Fmi::stod(parts[j]);
       double lat = Fmi::stod(latstr);
       std::swap(lon, lat);
-      std::string tag = parts[j] + ',' + parts[j + 1];
-      Spine::LocationPtr loc =
-          this->featureSearch(lon, lat, theLanguage, theFeatures, theMaxDistance);
-      std::unique_ptr<Spine::Location> loc2(new Spine::Location(*loc));
-      loc2->type = Spine::Location::CoordinatePoint;
-      loc2->radius = radius;
-      theOptions.add(tag, loc2);
+      tags.push_back(parts[j] + ',' + parts[j + 1]);
+      coordinates.emplace_back(lon, lat);
+      radiuses.push_back(radius);
     }
   }
+
+  add_coordinates(
+      theOptions, tags, coordinates, radiuses, theLanguage, theFeatures, theMaxDistance);
+}
+
+// Search the coordinates with a single batch
+void Engine::add_coordinates(LocationOptions& theOptions,
+                             const std::vector<std::string>& theTags,
+                             const std::vector<std::pair<double, double>>& theCoordinates,
+                             const std::vector<double>& theRadiuses,
+                             const std::string& theLanguage,
+                             const std::string& theFeatures,
+                             double theMaxDistance) const
+{
+  auto locs = featureSearch(theCoordinates, theLanguage, theFeatures, theMaxDistance);
+
+  for (std::size_t i = 0; i < locs.size(); ++i)
+  {
+    std::unique_ptr<Spine::Location> loc2(new Spine::Location(*locs[i]));
+    loc2->type = Spine::Location::CoordinatePoint;
+    loc2->radius = theRadiuses[i];
+    theOptions.add(theTags[i], loc2);
+  }
 }
 
 void Engine::parse_geoid(LocationOptions& theOptions,
@@ -1190,17 +1648,21 @@ void Engine::parse_geoid(LocationOptions& theOptions,
   if (searchName.empty())
     return;
 
+  std::vector<std::string> tags;
+  std::vector<long> numbers;
+
   for (const std::string& geoids : searchName)
   {
     std::list<std::string> parts;
     boost::algorithm::split(parts, geoids, boost::algorithm::is_any_of(","));
     for (const std::string& geoid : parts)
     {
-      long number = Fmi::stol(geoid);
-      Spine::LocationPtr loc = this->idSearch(number, theLanguage);
-      theOptions.add(geoid, loc);
+      numbers.push_back(Fmi::stol(geoid));
+      tags.push_back(geoid);
     }
   }
+
+  add_geoids(theOptions, tags, numbers, theLanguage);
 }
 
 void Engine::parse_geoids(LocationOptions& theOptions,
@@ -1211,17 +1673,32 @@ void Engine::parse_geoids(LocationOptions& theOptions,
   if (searchName.empty())
     return;
 
+  std::vector<std::string> tags;
+  std::vector<long> numbers;
+
   for (const std::string& geoids : searchName)
   {
     std::list<std::string> parts;
     boost::algorithm::split(parts, geoids, boost::algorithm::is_any_of(","));
     for (const std::string& geoid : parts)
     {
-      long number = Fmi::stol(geoid);
-      Spine::LocationPtr loc = this->idSearch(number, theLanguage);
-      theOptions.add(geoid, loc);
+      numbers.push_back(Fmi::stol(geoid));
+      tags.push_back(geoid);
     }
   }
+
+  add_geoids(theOptions, tags, numbers, theLanguage);
+}
+
+// Search the geoids with a single batch
+void Engine::add_geoids(LocationOptions& theOptions,
+                        const std::vector<std::string>& theTags,
+                        const std::vector<long>& theGeoIDs,
+                        const std::string& theLanguage) const
+{
+  auto locs = idSearch(theGeoIDs, theLanguage);  // throws for unknown IDs
+  for (std::size_t i = 0; i < locs.size(); ++i)
+    theOptions.add(theTags[i], locs[i]);
 }
 
 void Engine::parse_keyword(LocationOptions& theOptions,
@@ -1300,6 +1777,8 @@ LocationOptions Engine::parseLocations(const Spine::HTTP::Request& theReq) const
 {
   try
   {
+    Metrics::Call call(*itsMetrics, Metrics::Operation::ParseLocations);
+
     // Language selection (default -> config -> querystring order)
 
     std::string language = default_language;
@@ -1437,6 +1916,61 @@ bool Engine::isSuggestReady() const
   return mycopy->isSuggestReady();
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return a future which becomes ready with the autocomplete data
+ *
+ * The future fails if the engine is shut down before the data is ready.
+ */
+// ----------------------------------------------------------------------
+
+std::shared_future<void> Engine::suggestReady() const
+{
+  auto mycopy = impl.load();
+  return mycopy->suggestReady();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a phase of the initialization has been completed
+ *
+ * Searches needing only the locations can be answered long before all the
+ * autocomplete trees have been built.
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::isReady(ReadyPhase thePhase) const
+{
+  auto mycopy = impl.load();
+  return mycopy->isReady(thePhase);
+}
+
+std::shared_future<void> Engine::ready(ReadyPhase thePhase) const
+{
+  auto mycopy = impl.load();
+  return mycopy->ready(thePhase);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Wait for a phase of the autocomplete data and return the data
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<Engine::Impl> Engine::readyImpl(ReadyPhase thePhase) const
+{
+  try
+  {
+    auto mycopy = impl.load();
+    mycopy->ready(thePhase).get();  // throws on shutdown
+    return mycopy;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Priority sort a location list
@@ -1481,9 +2015,9 @@ std::pair<bool, std::string> Engine::reload()
     output << m1 << std::endl;
     std::cout << m1 << std::endl;
 
-    auto p = std::make_shared<Impl>(itsConfigFile, true);  // reload=true
+    auto p = std::make_shared<Impl>(itsConfigFile, true, itsMetrics);  // reload=true
     bool first_construction = false;
-    p->init(first_construction);
+    p->init(first_construction, impl.load());  // previous data for incremental reloads
 
     if (!p->itsReloadOK)
     {
@@ -1497,6 +2031,9 @@ std::pair<bool, std::string> Engine::reload()
       return {false, output.str()};
     }
 
+    // Avoid a burst of database queries with an empty cache after the swap
+    p->warmup(impl.load());
+
     impl.store(p);
 
     const Fmi::DateTime end = Fmi::MicrosecClock::local_time();
@@ -1583,6 +2120,15 @@ StatusReturnType Engine::metadataStatus() const
 
     auto mycopy = impl.load();
 
+    const auto calls = [this](Metrics::Operation op)
+    { return static_cast<long>(itsMetrics->summary(op).calls); };
+
+    const long nameSearches = calls(Metrics::Operation::NameSearch);
+    const long lonlatSearches = calls(Metrics::Operation::LonLatSearch);
+    const long idSearches = calls(Metrics::Operation::IdSearch);
+    const long keywordSearches = calls(Metrics::Operation::KeywordSearch);
+    const long suggests = calls(Metrics::Operation::Suggest);
+
     std::stringstream ss;
 
     ss << itsStartTime;
@@ -1603,34 +2149,34 @@ StatusReturnType Engine::metadataStatus() const
     cacheTable->set(column, row, Fmi::to_string(mycopy->itsNameSearchCache.maxSize()));
     ++column;
 
-    cacheTable->set(column, row, printrate(itsNameSearchCount, secs));
+    cacheTable->set(column, row, printrate(nameSearches, secs));
     ++column;
 
-    cacheTable->set(column, row, Fmi::to_string(itsNameSearchCount));
+    cacheTable->set(column, row, Fmi::to_string(nameSearches));
     ++column;
 
-    cacheTable->set(column, row, printrate(itsLonLatSearchCount, secs));
+    cacheTable->set(column, row, printrate(lonlatSearches, secs));
     ++column;
 
-    cacheTable->set(column, row, Fmi::to_string(itsLonLatSearchCount));
+    cacheTable->set(column, row, Fmi::to_string(lonlatSearches));
     ++column;
 
-    cacheTable->set(column, row, printrate(itsIdSearchCount, secs));
+    cacheTable->set(column, row, printrate(idSearches, secs));
     ++column;
 
-    cacheTable->set(column, row, Fmi::to_string(itsIdSearchCount));
+    cacheTable->set(column, row, Fmi::to_string(idSearches));
     ++column;
 
-    cacheTable->set(column, row, printrate(itsKeywordSearchCount, secs));
+    cacheTable->set(column, row, printrate(keywordSearches, secs));
     ++column;
 
-    cacheTable->set(column, row, Fmi::to_string(itsKeywordSearchCount));
+    cacheTable->set(column, row, Fmi::to_string(keywordSearches));
     ++column;
 
-    cacheTable->set(column, row, printrate(itsSuggestCount, secs));
+    cacheTable->set(column, row, printrate(suggests, secs));
     ++column;
 
-    cacheTable->set(column, row, Fmi::to_string(itsSuggestCount));
+    cacheTable->set(column, row, Fmi::to_string(suggests));
     ++column;
 
     cacheHeaders.push_back("StartTime");
@@ -1657,6 +2203,70 @@ StatusReturnType Engine::metadataStatus() const
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return call counts and latencies of the searches
+ *
+ * One row per operation and measured phase, the total is always listed.
+ * Latencies are in microseconds.
+ */
+// ----------------------------------------------------------------------
+
+StatusReturnType Engine::metricsStatus() const
+{
+  try
+  {
+    std::unique_ptr<Spine::Table> metricsTable(new Spine::Table());
+    Spine::TableFormatter::Names metricsHeaders{"Operation",
+                                                "Phase",
+                                                "Count",
+                                                "Failures",
+                                                "CacheHits",
+                                                "CacheMisses",
+                                                "Mean",
+                                                "P50",
+                                                "P99",
+                                                "P999",
+                                                "Max"};
+
+    unsigned int row = 0;
+    for (std::size_t op = 0; op < Metrics::operations; op++)
+    {
+      const auto operation = static_cast<Metrics::Operation>(op);
+      const auto summary = itsMetrics->summary(operation);
+
+      for (std::size_t phase = 0; phase < Metrics::phases; phase++)
+      {
+        const auto& latency = summary.latencies[phase];
+        const bool total = (static_cast<Metrics::Phase>(phase) == Metrics::Phase::Total);
+        if (!total && latency.count == 0)
+          continue;
+
+        unsigned int column = 0;
+        metricsTable->set(column++, row, Metrics::name(operation));
+        metricsTable->set(column++, row, Metrics::name(static_cast<Metrics::Phase>(phase)));
+        metricsTable->set(column++, row, Fmi::to_string(total ? summary.calls : latency.count));
+        metricsTable->set(column++, row, total ? Fmi::to_string(summary.failures) : "");
+        metricsTable->set(column++, row, total ? Fmi::to_string(summary.cache_hits) : "");
+        metricsTable->set(column++, row, total ? Fmi::to_string(summary.cache_misses) : "");
+        metricsTable->set(column++, row, Fmi::to_string(latency.mean));
+        metricsTable->set(column++, row, Fmi::to_string(latency.p50));
+        metricsTable->set(column++, row, Fmi::to_string(latency.p99));
+        metricsTable->set(column++, row, Fmi::to_string(latency.p999));
+        metricsTable->set(column++, row, Fmi::to_string(latency.max));
+        ++row;
+      }
+    }
+
+    metricsTable->setNames(metricsHeaders);
+    return metricsTable;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 StatusReturnType Engine::cacheStatus() const
 {
   try
@@ -1673,6 +2283,38 @@ StatusReturnType Engine::cacheStatus() const
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the timing and memory use of loading the current data
+ */
+// ----------------------------------------------------------------------
+
+StatusReturnType Engine::loadStatus() const
+{
+  try
+  {
+    auto mycopy = impl.load();
+    return mycopy->load_status();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+StatusReturnType Engine::poolStatus() const
+{
+  try
+  {
+    auto mycopy = impl.load();
+    return mycopy->pool_status();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Return error message from the reload operation
@@ -1696,6 +2338,20 @@ Fmi::LandCover::Type Engine::coverType(double theLongitude, double theLatitude)
   return covertype(landCover(), theLongitude, theLatitude);
 }
 
+// DEM heights
+std::vector<double> Engine::demHeights(
+    const std::vector<std::pair<double, double>>& theCoordinates) const
+{
+  return impl.load()->elevations(theCoordinates);
+}
+
+// Cover types
+std::vector<Fmi::LandCover::Type> Engine::coverTypes(
+    const std::vector<std::pair<double, double>>& theCoordinates) const
+{
+  return impl.load()->coverTypes(theCoordinates);
+}
+
 Fmi::Cache::CacheStatistics Engine::getCacheStats() const
 {
   auto mycopy = impl.load();
@@ -1703,13 +2359,13 @@ Fmi::Cache::CacheStatistics Engine::getCacheStats() const
   return mycopy->getCacheStats();
 }
 
-Spine::LocationPtr Engine::translateLocation(const Spine::Location& theLocation,
+Spine::LocationPtr Engine::translateLocation(Spine::LocationPtr theLocation,
                                              const std::string& theLang) const
 {
-  Spine::LocationPtr newptr(new Spine::Location(theLocation));
+  // Copies the location only if the translation changes it
   auto mycopy = impl.load();
-  mycopy->translate(newptr, theLang);
-  return newptr;
+  mycopy->translate(theLocation, theLang);
+  return theLocation;
 }
 
 void Engine::requestReload(SmartMet::Spine::HTTP::Response& theResponse)
@@ -1759,6 +2415,18 @@ try
   {
     return cacheStatus();
   }
+  else if (dataType == "metrics")
+  {
+    return metricsStatus();
+  }
+  else if (dataType == "load")
+  {
+    return loadStatus();
+  }
+  else if (dataType == "pool")
+  {
+    return poolStatus();
+  }
   else
   {
     throw Fmi::Exception(BCP, "Unknown type '" + dataType + "'");
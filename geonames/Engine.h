@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include "Metrics.h"
 #include "WktGeometry.h"
 #include <boost/asio.hpp>
 #include <boost/utility.hpp>
@@ -23,6 +24,7 @@
 #include <spine/Thread.h>
 #include <atomic>
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 
@@ -70,14 +72,11 @@ class Engine : public Spine::SmartMetEngine
   Fmi::DateTime itsStartTime;
   Fmi::DateTime itsLastReload;
   std::atomic<bool> itsReloading;
-  mutable std::atomic<long> itsNameSearchCount;  // TODO: These should be made into std::atomics
-  mutable std::atomic<long> itsLonLatSearchCount;
-  mutable std::atomic<long> itsIdSearchCount;
-  mutable std::atomic<long> itsKeywordSearchCount;
-  mutable std::atomic<long> itsSuggestCount;
+  std::shared_ptr<Metrics> itsMetrics;  // shared with the implementations, survives reloads
   std::string itsConfigFile;
   std::string itsErrorMessage;
   std::atomic_bool initFailed;
+  std::unique_ptr<boost::asio::thread_pool> itsAsyncPool;  // runs the asynchronous searches
 
  public:
   explicit Engine(std::string theConfigFile);
@@ -110,6 +109,20 @@ class Engine : public Spine::SmartMetEngine
 
   Spine::LocationPtr idSearch(long theGeoID, const std::string& theLang) const;
 
+  // Batched versions of the above, the results are in the order of the inputs
+
+  std::vector<Spine::LocationPtr> nameSearch(const std::vector<std::string>& theNames,
+                                             const std::string& theLang) const;
+
+  std::vector<Spine::LocationPtr> featureSearch(
+      const std::vector<std::pair<double, double>>& theCoordinates,
+      const std::string& theLang,
+      const std::string& theFeatures,
+      double theMaxDistance = Locus::Query::default_radius) const;
+
+  std::vector<Spine::LocationPtr> idSearch(const std::vector<long>& theGeoIDs,
+                                           const std::string& theLang) const;
+
   // Find locations with options
 
   Spine::LocationList nameSearch(const Locus::QueryOptions& theOptions,
@@ -127,6 +140,19 @@ class Engine : public Spine::SmartMetEngine
 
   Spine::LocationList idSearch(const Locus::QueryOptions& theOptions, int theId) const;
 
+  // Batched searches with options, the results are in the order of the inputs
+
+  std::vector<Spine::LocationList> nameSearch(const Locus::QueryOptions& theOptions,
+                                              const std::vector<std::string>& theNames) const;
+
+  std::vector<Spine::LocationList> lonlatSearch(
+      const Locus::QueryOptions& theOptions,
+      const std::vector<std::pair<float, float>>& theCoordinates,
+      float theRadius = Locus::Query::default_radius) const;
+
+  std::vector<Spine::LocationList> idSearch(const Locus::QueryOptions& theOptions,
+                                            const std::vector<int>& theIds) const;
+
   Spine::LocationPtr keywordSearch(double theLongitude,
                                    double theLatitude,
                                    double theRadius = -1,
@@ -136,6 +162,30 @@ class Engine : public Spine::SmartMetEngine
   Spine::LocationList keywordSearch(const Locus::QueryOptions& theOptions,
                                     const std::string& theKeyword) const;
 
+  // Asynchronous searches. Results available without database access are
+  // returned immediately, the rest are searched in a separate thread pool.
+
+  std::future<Spine::LocationList> nameSearchAsync(const Locus::QueryOptions& theOptions,
+                                                   const std::string& theName) const;
+
+  std::future<Spine::LocationList> lonlatSearchAsync(
+      const Locus::QueryOptions& theOptions,
+      float theLongitude,
+      float theLatitude,
+      float theRadius = Locus::Query::default_radius) const;
+
+  std::future<Spine::LocationList> idSearchAsync(const Locus::QueryOptions& theOptions,
+                                                 int theId) const;
+
+  // Keyword locations within the radius (km), nearest first. Zero max results = no limit
+  Spine::LocationList keywordRadiusSearch(
+      double theLongitude,
+      double theLatitude,
+      double theRadius,
+      const std::string& theLang = "fi",
+      const std::string& theKeyword = FMINAMES_DEFAULT_KEYWORD,
+      unsigned int theMaxResults = 0) const;
+
   Spine::LocationPtr wktSearch(const std::string& theWktString,
                                const std::string& theLanguage,
                                double theRadius = 0.0) const;
@@ -178,6 +228,9 @@ class Engine : public Spine::SmartMetEngine
   // Parse location-related HTTP options
   LocationOptions parseLocations(const Spine::HTTP::Request& theReq) const;
 
+  // Parsed and expanded WKT geometry, cached since the same geometries are requested often
+  WktShapePtr wktShape(const std::string& theWkt, double theRadius) const;
+
   // Get WKT geometries
   WktGeometries getWktGeometries(const LocationOptions& loptions,
                                  const std::string& language) const;
@@ -192,6 +245,9 @@ class Engine : public Spine::SmartMetEngine
 
   StatusReturnType cacheStatus() const;
   StatusReturnType metadataStatus() const;
+  StatusReturnType metricsStatus() const;
+  StatusReturnType loadStatus() const;
+  StatusReturnType poolStatus() const;
 
   void sort(Spine::LocationList& theLocations) const;
 
@@ -207,8 +263,28 @@ class Engine : public Spine::SmartMetEngine
   // Cover type
   Fmi::LandCover::Type coverType(double theLongitude, double theLatitude) const;
 
+  // DEM heights and cover types for many coordinates, in the order of the coordinates.
+  // Coordinates which are not finite get NaN and NoData.
+  std::vector<double> demHeights(
+      const std::vector<std::pair<double, double>>& theCoordinates) const;
+  std::vector<Fmi::LandCover::Type> coverTypes(
+      const std::vector<std::pair<double, double>>& theCoordinates) const;
+
+  // Phases of initializing the loaded data, each phase includes the previous ones
+  enum class ReadyPhase
+  {
+    Locations,  // id, station, nearest and keyword searches use the loaded data
+    Suggest,    // autocomplete of keyword "all" without language specific names
+    Complete    // all autocomplete data
+  };
+
   // Has autocomplete data been initialized?
   bool isSuggestReady() const;
+  bool isReady(ReadyPhase thePhase) const;
+
+  // Becomes ready once autocomplete data has been initialized, throws on shutdown
+  std::shared_future<void> suggestReady() const;
+  std::shared_future<void> ready(ReadyPhase thePhase) const;
 
   void assign_priorities(Spine::LocationList& locs) const;
 
@@ -218,10 +294,35 @@ class Engine : public Spine::SmartMetEngine
 
  private:
   unsigned int maxDemResolution() const;
+  std::shared_ptr<Impl> readyImpl(ReadyPhase thePhase = ReadyPhase::Complete) const;
+  std::future<Spine::LocationList> runAsync(std::shared_ptr<Metrics::Call> theCall,
+                                            std::function<Spine::LocationList()> theSearch) const;
   void cache_cleaner();
   Fmi::Cache::CacheStatistics getCacheStats() const override;
-  Spine::LocationPtr translateLocation(const Spine::Location& theLocation,
+  Spine::LocationPtr translateLocation(Spine::LocationPtr theLocation,
                                        const std::string& theLang) const;
+  Spine::LocationPtr featureLocation(const Spine::LocationList& theMatches,
+                                     double theLongitude,
+                                     double theLatitude,
+                                     double theDem,
+                                     Fmi::LandCover::Type theCoverType,
+                                     const std::string& theLang) const;
+
+  void add_places(LocationOptions& theOptions,
+                  const std::vector<std::string>& theNames,
+                  const std::vector<double>& theRadiuses,
+                  const std::string& theLanguage) const;
+  void add_coordinates(LocationOptions& theOptions,
+                       const std::vector<std::string>& theTags,
+                       const std::vector<std::pair<double, double>>& theCoordinates,
+                       const std::vector<double>& theRadiuses,
+                       const std::string& theLanguage,
+                       const std::string& theFeatures,
+                       double theMaxDistance) const;
+  void add_geoids(LocationOptions& theOptions,
+                  const std::vector<std::string>& theTags,
+                  const std::vector<long>& theGeoIDs,
+                  const std::string& theLanguage) const;
 
   void parse_place(LocationOptions& theOptions,
                    const Spine::HTTP::Request& theRequest,
@@ -0,0 +1,287 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class GeoIndex
+ */
+// ======================================================================
+
+#include "GeoIndex.h"
+#include <macgyver/Exception.h>
+#include <macgyver/Geometry.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+namespace
+{
+// Mean earth radius in km. The chord limits are inflated slightly so that small
+// differences to the radius used by Fmi::Geometry::GeoDistance do not matter,
+// the exact limit is applied to the final candidates.
+
+const double earth_radius = 6371.0;
+const double chord_tolerance = 1.001;
+
+double deg2rad(double value)
+{
+  return value * M_PI / 180.0;
+}
+
+std::array<double, 3> unit_vector(double theLongitude, double theLatitude)
+{
+  const double lon = deg2rad(theLongitude);
+  const double lat = deg2rad(theLatitude);
+  return {std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat)};
+}
+
+// Squared chord length limit for the given search radius in km
+double chord_limit(double theRadius)
+{
+  if (theRadius < 0)
+    return std::numeric_limits<double>::infinity();
+
+  double angle = std::min(theRadius / earth_radius, M_PI);
+  double chord = 2 * std::sin(angle / 2) * chord_tolerance;
+  return chord * chord;
+}
+
+// Great circle distance in km
+double distance(const Spine::Location& loc, double theLongitude, double theLatitude)
+{
+  return Fmi::Geometry::GeoDistance(loc.longitude, loc.latitude, theLongitude, theLatitude) /
+         1000.0;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the index
+ */
+// ----------------------------------------------------------------------
+
+GeoIndex::GeoIndex(const std::vector<Spine::LocationPtr>& theLocations)
+    : itsLocations(theLocations)
+{
+  try
+  {
+    if (itsLocations.size() > std::numeric_limits<std::uint32_t>::max())
+      throw Fmi::Exception(BCP, "Too many locations for a spatial index");
+
+    itsNodes.reserve(itsLocations.size());
+
+    for (std::size_t i = 0; i < itsLocations.size(); i++)
+    {
+      const auto& loc = *itsLocations[i];
+      itsNodes.push_back(
+          Node{unit_vector(loc.longitude, loc.latitude), static_cast<std::uint32_t>(i)});
+    }
+
+    build(0, itsNodes.size(), 0);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+GeoIndex::GeoIndex(const Spine::LocationList& theLocations)
+    : GeoIndex(std::vector<Spine::LocationPtr>(theLocations.begin(), theLocations.end()))
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Recursively arrange a range of nodes into a balanced k-d tree
+ *
+ * The median of the range is the node itself, the halves are the subtrees.
+ */
+// ----------------------------------------------------------------------
+
+void GeoIndex::build(std::size_t lo, std::size_t hi, unsigned int depth)
+{
+  if (hi - lo < 2)
+    return;
+
+  const unsigned int axis = depth % 3;
+  const std::size_t mid = lo + (hi - lo) / 2;
+
+  std::nth_element(itsNodes.begin() + lo,
+                   itsNodes.begin() + mid,
+                   itsNodes.begin() + hi,
+                   [axis](const Node& a, const Node& b)
+                   { return a.p[axis] < b.p[axis]; });
+
+  build(lo, mid, depth + 1);
+  build(mid + 1, hi, depth + 1);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collect the nearest candidates into a max-heap
+ *
+ * theCount = 0 means all candidates within the limit are collected.
+ */
+// ----------------------------------------------------------------------
+
+void GeoIndex::search(const Node& theQuery,
+                      std::size_t lo,
+                      std::size_t hi,
+                      unsigned int depth,
+                      std::size_t theCount,
+                      double theLimit,
+                      const Predicate& thePredicate,
+                      std::vector<Candidate>& theHeap) const
+{
+  if (lo >= hi)
+    return;
+
+  const std::size_t mid = lo + (hi - lo) / 2;
+  const Node& node = itsNodes[mid];
+
+  const bool full = (theCount > 0 && theHeap.size() >= theCount);
+  const double limit = (full ? theHeap.front().chord2 : theLimit);
+
+  const double dx = node.p[0] - theQuery.p[0];
+  const double dy = node.p[1] - theQuery.p[1];
+  const double dz = node.p[2] - theQuery.p[2];
+  const double chord2 = dx * dx + dy * dy + dz * dz;
+
+  if (chord2 <= limit && (!thePredicate || thePredicate(itsLocations[node.index])))
+  {
+    if (full)
+    {
+      std::pop_heap(theHeap.begin(), theHeap.end());
+      theHeap.back() = Candidate{chord2, node.index};
+    }
+    else
+      theHeap.push_back(Candidate{chord2, node.index});
+    std::push_heap(theHeap.begin(), theHeap.end());
+  }
+
+  const unsigned int axis = depth % 3;
+  const double diff = theQuery.p[axis] - node.p[axis];
+
+  const bool left_first = (diff < 0);
+
+  if (left_first)
+    search(theQuery, lo, mid, depth + 1, theCount, theLimit, thePredicate, theHeap);
+  else
+    search(theQuery, mid + 1, hi, depth + 1, theCount, theLimit, thePredicate, theHeap);
+
+  // The limit may have shrunk during the first search
+
+  const bool still_full = (theCount > 0 && theHeap.size() >= theCount);
+  const double new_limit = (still_full ? theHeap.front().chord2 : theLimit);
+
+  if (diff * diff <= new_limit)
+  {
+    if (left_first)
+      search(theQuery, mid + 1, hi, depth + 1, theCount, theLimit, thePredicate, theHeap);
+    else
+      search(theQuery, lo, mid, depth + 1, theCount, theLimit, thePredicate, theHeap);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Search and apply the exact radius to the final candidates
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationPtr> GeoIndex::select(double theLongitude,
+                                                 double theLatitude,
+                                                 std::size_t theCount,
+                                                 double theRadius,
+                                                 const Predicate& thePredicate) const
+{
+  try
+  {
+    std::vector<Spine::LocationPtr> ret;
+    if (itsNodes.empty())
+      return ret;
+
+    const Node query{unit_vector(theLongitude, theLatitude), 0};
+
+    std::vector<Candidate> heap;
+    if (theCount > 0)
+      heap.reserve(theCount);
+
+    search(query, 0, itsNodes.size(), 0, theCount, chord_limit(theRadius), thePredicate, heap);
+
+    std::sort_heap(heap.begin(), heap.end());
+
+    ret.reserve(heap.size());
+    for (const auto& candidate : heap)
+    {
+      const auto& loc = itsLocations[candidate.index];
+      if (theRadius < 0 || distance(*loc, theLongitude, theLatitude) <= theRadius)
+        ret.push_back(loc);
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the nearest location
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationPtr GeoIndex::nearest(double theLongitude,
+                                     double theLatitude,
+                                     double theRadius,
+                                     const Predicate& thePredicate) const
+{
+  auto ret = select(theLongitude, theLatitude, 1, theRadius, thePredicate);
+  if (ret.empty())
+    return {};
+  return ret.front();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the N nearest locations
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationPtr> GeoIndex::nearest(double theLongitude,
+                                                  double theLatitude,
+                                                  std::size_t theCount,
+                                                  double theRadius,
+                                                  const Predicate& thePredicate) const
+{
+  if (theCount == 0)
+    return {};
+  return select(theLongitude, theLatitude, theCount, theRadius, thePredicate);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find all locations within the given radius
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationPtr> GeoIndex::within(double theLongitude,
+                                                 double theLatitude,
+                                                 double theRadius,
+                                                 const Predicate& thePredicate) const
+{
+  if (theRadius < 0)
+    return {};
+  return select(theLongitude, theLatitude, 0, theRadius, thePredicate);
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
+
+// ======================================================================
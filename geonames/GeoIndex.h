@@ -0,0 +1,111 @@
+// ======================================================================
+/*!
+ * \brief Spatial index for nearest location searches
+ *
+ * Locations are stored as unit vectors in a flat implicit k-d tree.
+ * Since the chord length between two points on the unit sphere grows
+ * monotonically with the great circle distance, all pruning is done with
+ * cheap squared 3D distances. Great circle distances are calculated only
+ * for the final candidates to apply the exact search radius.
+ *
+ * All distances are in kilometers, a negative radius means no limit.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <spine/Location.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class GeoIndex
+{
+ public:
+  using Predicate = std::function<bool(const Spine::LocationPtr&)>;
+
+  explicit GeoIndex(const std::vector<Spine::LocationPtr>& theLocations);
+  explicit GeoIndex(const Spine::LocationList& theLocations);
+
+  GeoIndex() = delete;
+  GeoIndex(const GeoIndex& other) = delete;
+  GeoIndex& operator=(const GeoIndex& other) = delete;
+  GeoIndex(GeoIndex&& other) = delete;
+  GeoIndex& operator=(GeoIndex&& other) = delete;
+
+  // Nearest location, nullptr if there is none
+  Spine::LocationPtr nearest(double theLongitude,
+                             double theLatitude,
+                             double theRadius = -1,
+                             const Predicate& thePredicate = Predicate()) const;
+
+  // Nearest locations sorted by distance
+  std::vector<Spine::LocationPtr> nearest(double theLongitude,
+                                          double theLatitude,
+                                          std::size_t theCount,
+                                          double theRadius = -1,
+                                          const Predicate& thePredicate = Predicate()) const;
+
+  // All locations within the radius sorted by distance
+  std::vector<Spine::LocationPtr> within(double theLongitude,
+                                         double theLatitude,
+                                         double theRadius,
+                                         const Predicate& thePredicate = Predicate()) const;
+
+  std::size_t size() const { return itsNodes.size(); }
+  bool empty() const { return itsNodes.empty(); }
+
+  // Approximate size in bytes excluding the shared locations
+  std::size_t memory() const
+  {
+    return itsLocations.capacity() * sizeof(Spine::LocationPtr) +
+           itsNodes.capacity() * sizeof(Node);
+  }
+
+ private:
+  struct Node
+  {
+    std::array<double, 3> p;  // unit vector
+    std::uint32_t index;      // index to itsLocations
+  };
+
+  struct Candidate
+  {
+    double chord2;  // squared chord distance
+    std::uint32_t index;
+    bool operator<(const Candidate& other) const { return chord2 < other.chord2; }
+  };
+
+  void build(std::size_t lo, std::size_t hi, unsigned int depth);
+
+  void search(const Node& theQuery,
+              std::size_t lo,
+              std::size_t hi,
+              unsigned int depth,
+              std::size_t theCount,
+              double theLimit,
+              const Predicate& thePredicate,
+              std::vector<Candidate>& theHeap) const;
+
+  std::vector<Spine::LocationPtr> select(double theLongitude,
+                                         double theLatitude,
+                                         std::size_t theCount,
+                                         double theRadius,
+                                         const Predicate& thePredicate) const;
+
+  std::vector<Spine::LocationPtr> itsLocations;
+  std::vector<Node> itsNodes;
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
+
+// ======================================================================
@@ -6,7 +6,9 @@
 
 #include "Impl.h"
 #include "Engine.h"
+#include "Snapshot.h"
 #include <boost/algorithm/string/erase.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/bind/bind.hpp>
 #include <boost/locale.hpp>
@@ -21,13 +23,20 @@
 #include <spine/Exceptions.h>
 #include <spine/Location.h>
 #include <sys/types.h>
+#include <algorithm>
 #include <cassert>
 #include <cerrno>  // iconv uses errno
 #include <cmath>
 #include <csignal>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <numeric>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <unordered_set>
 
 // We want to allow empty databases in order to be able to build it one part a time while testing
 // the engine too
@@ -119,47 +128,231 @@ void filter_features(SmartMet::Spine::LocationList &locs,
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Keep only the desired page of suggest results
+ * \brief Throw for disallowed name searches
  */
 // ----------------------------------------------------------------------
 
-void keep_wanted_page(SmartMet::Spine::LocationList &locs,
-                      unsigned int maxresults,
-                      unsigned int page)
+void check_forbidden_name_search(const std::string &name,
+                                 const std::vector<boost::regex> &forbidden_rules)
 {
-  if (maxresults == 0)
-    return;
+  for (const auto &rule : forbidden_rules)
+  {
+    if (boost::regex_match(name, rule))
+      throw Fmi::Exception(BCP, "Forbidden name search")
+          .addParameter("Name", name)
+          .disableLogging();
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the country filter of the query accepts the country
+ *
+ * An empty filter or "all" accepts all countries.
+ */
+// ----------------------------------------------------------------------
 
-  // Erase the pages before the desired one
-  unsigned int first = page * maxresults;
-  auto pos1 = locs.begin();
-  auto pos2 = pos1;
-  std::advance(pos2, first);
-  locs.erase(pos1, pos2);
+bool accepts_country(const Locus::QueryOptions &options, const std::string &iso2)
+{
+  const auto &countries = options.GetCountries();
+  if (countries.empty())
+    return true;
 
-  // Erase the remaining elements after the size of 'maxelements'.
-  pos1 = locs.begin();
-  auto npos2 = std::min(locs.size(), static_cast<std::size_t>(maxresults));
-  std::advance(pos1, npos2);
-  locs.erase(pos1, locs.end());
+  for (const auto &country : countries)
+  {
+    if (boost::algorithm::iequals(country, "all") || boost::algorithm::iequals(country, iso2))
+      return true;
+  }
+  return false;
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Throw for disallowed name searches
+ * \brief Test whether the feature filter of the query accepts the feature
+ *
+ * An empty filter accepts all features.
  */
 // ----------------------------------------------------------------------
 
-void check_forbidden_name_search(const std::string &name,
-                                 const std::vector<boost::regex> &forbidden_rules)
+bool accepts_feature(const Locus::QueryOptions &options, const std::string &feature)
 {
-  for (const auto &rule : forbidden_rules)
+  const auto &features = options.GetFeatures();
+  if (features.empty())
+    return true;
+
+  for (const auto &f : features)
   {
-    if (boost::regex_match(name, rule))
-      throw Fmi::Exception(BCP, "Forbidden name search")
-          .addParameter("Name", name)
-          .disableLogging();
+    if (f == feature)
+      return true;
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Sample a raster at the given coordinates
+ *
+ * The coordinates are visited in order of one degree cells so that nearby
+ * points read the same raster tiles consecutively, and repeated coordinates
+ * are sampled only once. Coordinates which are not finite get the missing
+ * value without sampling, they could not be ordered. Only large inputs are
+ * split over several threads.
+ */
+// ----------------------------------------------------------------------
+
+const std::size_t raster_chunk_size = 4096;
+const std::size_t raster_parallel_size = 4 * raster_chunk_size;
+
+template <typename T, typename Sample>
+std::vector<T> sample_raster(const std::vector<std::pair<double, double>> &lonlats,
+                             unsigned int threads,
+                             T missing,
+                             Sample sample)
+{
+  std::vector<T> ret(lonlats.size(), missing);
+
+  std::vector<std::size_t> order;
+  order.reserve(lonlats.size());
+  for (std::size_t i = 0; i < lonlats.size(); ++i)
+    if (std::isfinite(lonlats[i].first) && std::isfinite(lonlats[i].second))
+      order.push_back(i);
+
+  const auto cell = [](const std::pair<double, double> &lonlat)
+  {
+    return std::make_tuple(std::floor(lonlat.second), std::floor(lonlat.first), lonlat.second,
+                           lonlat.first);
+  };
+  std::sort(order.begin(),
+            order.end(),
+            [&](std::size_t i, std::size_t j) { return cell(lonlats[i]) < cell(lonlats[j]); });
+
+  const auto sample_range = [&](std::size_t first, std::size_t last)
+  {
+    for (std::size_t k = first; k < last; ++k)
+    {
+      const auto i = order[k];
+      if (k > first && lonlats[i] == lonlats[order[k - 1]])
+        ret[i] = ret[order[k - 1]];
+      else
+        ret[i] = sample(lonlats[i].first, lonlats[i].second);
+    }
+  };
+
+  if (order.size() < raster_parallel_size)
+  {
+    sample_range(0, order.size());
+    return ret;
+  }
+
+  SmartMet::Engine::Geonames::BuildTaskGroup tasks(threads);
+  for (std::size_t first = 0; first < order.size(); first += raster_chunk_size)
+  {
+    const auto last = std::min(first + raster_chunk_size, order.size());
+    tasks.add("raster sampling", [&sample_range, first, last]() { sample_range(first, last); });
+  }
+  tasks.wait();
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run a batch of searches
+ *
+ * Duplicate inputs are searched only once. Searches which can be answered
+ * without the database are done immediately, the rest are run concurrently
+ * using at most the given number of threads. The results are returned in
+ * the order of the inputs. If searches fail, the failure of the first
+ * failed input is rethrown as a serial loop would have done, regardless
+ * of which search happened to fail first.
+ */
+// ----------------------------------------------------------------------
+
+template <typename Input, typename Find, typename Search>
+std::vector<SmartMet::Spine::LocationList> batch_search(const std::vector<Input> &inputs,
+                                                        unsigned int threads,
+                                                        Find find,
+                                                        Search search)
+{
+  // Unique inputs in order of appearance
+
+  std::vector<Input> unique;
+  std::vector<std::size_t> positions;
+  positions.reserve(inputs.size());
+
+  std::map<Input, std::size_t> seen;
+  for (const auto &input : inputs)
+  {
+    auto pos = seen.emplace(input, unique.size());
+    if (pos.second)
+      unique.push_back(input);
+    positions.push_back(pos.first->second);
+  }
+
+  // Answer what we can immediately and collect the rest. The unique inputs
+  // are in order of appearance, hence the first failed one is also the
+  // first failed input.
+
+  std::vector<SmartMet::Spine::LocationList> results(unique.size());
+  std::vector<std::exception_ptr> errors(unique.size());
+  std::vector<std::size_t> missing;
+
+  for (std::size_t i = 0; i < unique.size(); ++i)
+  {
+    try
+    {
+      auto result = find(unique[i]);
+      if (result)
+        results[i] = std::move(*result);
+      else
+        missing.push_back(i);
+    }
+    catch (...)
+    {
+      errors[i] = std::current_exception();
+    }
+  }
+
+  const auto run = [&results, &errors, &unique, &search](std::size_t i)
+  {
+    try
+    {
+      results[i] = search(unique[i]);
+    }
+    catch (...)
+    {
+      errors[i] = std::current_exception();
+    }
+  };
+
+  if (missing.size() == 1 || threads <= 1)
+  {
+    // Stop at the first failure like a serial loop would
+    for (auto i : missing)
+    {
+      const auto failed = [](const std::exception_ptr &e) { return static_cast<bool>(e); };
+      if (std::any_of(errors.begin(), errors.begin() + i, failed))
+        break;
+      run(i);
+    }
   }
+  else if (!missing.empty())
+  {
+    SmartMet::Engine::Geonames::BuildTaskGroup tasks(
+        std::min(threads, static_cast<unsigned int>(missing.size())));
+    for (auto i : missing)
+      tasks.add("batch search", [&run, i]() { run(i); });
+    tasks.wait();
+  }
+
+  for (const auto &error : errors)
+    if (error)
+      std::rethrow_exception(error);
+
+  std::vector<SmartMet::Spine::LocationList> ret;
+  ret.reserve(inputs.size());
+  for (auto pos : positions)
+    ret.push_back(results[pos]);
+  return ret;
 }
 
 }  // namespace
@@ -184,13 +377,32 @@ std::string Engine::Impl::iconvName(const std::string &name) const
   assert(utf8_to_latin1);
   return utf8_to_latin1->convert(name);
 }
-// ---------------------------------------------------------------------
+
+// ----------------------------------------------------------------------
 /*!
- * \brief Impl destructor
+ * \brief Destructor waits for the trees of lazy languages being built
  */
 // ----------------------------------------------------------------------
 
-Engine::Impl::~Impl() = default;
+Engine::Impl::~Impl()
+{
+  try
+  {
+    std::vector<std::future<void>> builds;
+    {
+      std::lock_guard<std::mutex> lock(itsLazyMutex);
+      for (auto &lang_lazy : itsLazyLanguages)
+        if (lang_lazy.second.build.valid())
+          builds.push_back(std::move(lang_lazy.second.build));
+    }
+    for (auto &build : builds)
+      build.wait();
+  }
+  catch (...)
+  {
+    // Destructors must not throw
+  }
+}
 
 // ----------------------------------------------------------------------
 /*!
@@ -210,9 +422,10 @@ Engine::Impl::~Impl() = default;
  */
 // ----------------------------------------------------------------------
 
-Engine::Impl::Impl(std::string configfile, bool reloading)
+Engine::Impl::Impl(std::string configfile, bool reloading, std::shared_ptr<Metrics> metrics)
     : itsReloading(reloading),
       itsConfigFile(std::move(configfile)),
+      itsMetrics(std::move(metrics)),
       startTime(Fmi::SecondClock::universal_time())
 {
   try
@@ -223,16 +436,42 @@ Engine::Impl::Impl(std::string configfile, bool reloading)
 
     try
     {
-      // Cache settings
-      unsigned int cacheMaxSize = 1000;
+      // Cache settings, the sizes are measured in bytes
+      unsigned int cacheMaxSize = 10000000;
       itsConfig.lookupValue("cache.max_size", cacheMaxSize);
       itsNameSearchCache.resize(cacheMaxSize);
 
-      // Suggest cache settings
-      unsigned int suggestCacheSize = 666;
+      unsigned int lonlatCacheMaxSize = 2000000;
+      itsConfig.lookupValue("cache.lonlat_max_size", lonlatCacheMaxSize);
+      itsLonLatSearchCache.resize(lonlatCacheMaxSize);
+
+      unsigned int idCacheMaxSize = 2000000;
+      itsConfig.lookupValue("cache.id_max_size", idCacheMaxSize);
+      itsIdSearchCache.resize(idCacheMaxSize);
+
+      unsigned int keywordCacheMaxSize = 10000000;
+      itsConfig.lookupValue("cache.keyword_max_size", keywordCacheMaxSize);
+      itsKeywordSearchCache.resize(keywordCacheMaxSize);
+
+      unsigned int wktCacheMaxSize = 1000;
+      itsConfig.lookupValue("cache.wkt_max_size", wktCacheMaxSize);
+      itsWktCache.resize(wktCacheMaxSize);
+
+      itsConfig.lookupValue("cache.lonlat_resolution", itsLonLatResolution);
+      if (itsLonLatResolution < 0)
+        throw Fmi::Exception(BCP, "cache.lonlat_resolution cannot be negative");
+
+      // Suggest cache settings, the size is measured in candidates
+      unsigned int suggestCacheSize = 200000;
       itsConfig.lookupValue("cache.suggest_max_size", suggestCacheSize);
-      if (suggestCacheSize != 666)
-        std::cerr << "Warning: cache.suggest_max_size is deprecated" << std::endl;
+      itsSuggestCache.resize(suggestCacheSize);
+      itsConfig.lookupValue("cache.suggest_prefix_reuse", itsSuggestPrefixReuse);
+
+      // Name search cache warmup settings
+      unsigned int warmupSize = 1000;
+      itsConfig.lookupValue("cache.warmup_size", warmupSize);
+      itsQueryLog.resize(warmupSize);
+      itsConfig.lookupValue("cache.warmup_file", itsWarmupFile);
 
       // Establish collator
 
@@ -240,6 +479,19 @@ Engine::Impl::Impl(std::string configfile, bool reloading)
       itsLocale = itsLocaleGenerator(locale);
       itsCollator = &std::use_facet<Collator>(itsLocale);
 
+      // Optional table driven collation of Latin names
+
+      itsConfig.lookupValue("fast_collation", itsFastCollation);
+
+      if (itsFastCollation)
+      {
+        itsCollationTable = std::make_unique<CollationTable>(
+            [this](const std::string &name) { return collate(name); });
+        if (itsVerbose)
+          std::cout << "Fast collation of " << itsCollationTable->size() << " characters"
+                    << std::endl;
+      }
+
       // Optional second encoding for autocomplete, usually ASCII
 
       itsConfig.lookupValue("ascii_autocomplete", itsAsciiAutocomplete);
@@ -261,19 +513,36 @@ Engine::Impl::Impl(std::string configfile, bool reloading)
 
       setup_fallback_encodings();
 
-      // FIXME: should we have limits in configuration instead of hardcoded here?
       if (!itsDatabaseDisabled)
       {
-        query_worker_pool.reset(new Fmi::WorkerPool<Locus::Query>(
-            [this]() -> std::shared_ptr<Locus::Query> {
+        query_pool = std::make_unique<QueryPool>(
+            "primary",
+            [this]() -> std::shared_ptr<Locus::Query>
+            {
               return std::make_shared<Locus::Query>(
                   itsHost, itsUser, itsPass, itsDatabase, itsPort);
             },
-            30,
-            100,
-            5));
-
-        std::shared_ptr<Locus::Query> lq = query_worker_pool->reserve();
+            itsPoolOptions);
+
+        // The replica is only an alternative to the primary database, hence
+        // its connections are opened on first use
+        auto replica_options = itsPoolOptions;
+        replica_options.lazy = true;
+
+        if (!itsReplicaHost.empty())
+          replica_pool = std::make_unique<QueryPool>(
+              "replica",
+              [this]() -> std::shared_ptr<Locus::Query>
+              {
+                return std::make_shared<Locus::Query>(itsReplicaHost,
+                                                      itsReplicaUser,
+                                                      itsReplicaPass,
+                                                      itsReplicaDatabase,
+                                                      itsReplicaPort);
+              },
+              replica_options);
+
+        std::shared_ptr<Locus::Query> lq = query_pool->reserve();
         lq->load_iso639_table();
       }
     }
@@ -374,6 +643,64 @@ Fmi::LandCover::Type Engine::Impl::coverType(double lon, double lat) const
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the heights at the given coordinates
+ */
+// ----------------------------------------------------------------------
+
+std::vector<double> Engine::Impl::elevations(
+    const std::vector<std::pair<double, double>> &lonlats) const
+{
+  return elevations(lonlats, itsMaxDemResolution);
+}
+
+std::vector<double> Engine::Impl::elevations(const std::vector<std::pair<double, double>> &lonlats,
+                                             unsigned int maxdemresolution) const
+{
+  try
+  {
+    if (!itsDEM)
+      return std::vector<double>(lonlats.size(), std::numeric_limits<double>::quiet_NaN());
+
+    return sample_raster<double>(lonlats,
+                                 itsBuildThreads,
+                                 std::numeric_limits<double>::quiet_NaN(),
+                                 [this, maxdemresolution](double lon, double lat)
+                                 { return itsDEM->elevation(lon, lat, maxdemresolution); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the land cover types at the given coordinates
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Fmi::LandCover::Type> Engine::Impl::coverTypes(
+    const std::vector<std::pair<double, double>> &lonlats) const
+{
+  try
+  {
+    if (!itsLandCover)
+      return std::vector<Fmi::LandCover::Type>(lonlats.size(), Fmi::LandCover::NoData);
+
+    return sample_raster<Fmi::LandCover::Type>(
+        lonlats,
+        itsBuildThreads,
+        Fmi::LandCover::NoData,
+        [this](double lon, double lat) { return itsLandCover->coverType(lon, lat); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Preprocess a UTF-8 name with possible bad characters
@@ -518,7 +845,30 @@ std::string Engine::Impl::to_treeword(const std::string &name) const
         name.begin(), name.end(), std::back_inserter(tmp), [](char c) { return std::isspace(c); });
     if (tmp.empty())
       return {};
-    tmp = itsCollator->transform(boost::locale::collator_base::primary, tmp);
+
+    std::string key;
+    if (itsCollationTable && itsCollationTable->transform(tmp, key))
+      return key;
+
+    return collate(tmp);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Primary strength collation key from the collator
+ */
+// ----------------------------------------------------------------------
+
+std::string Engine::Impl::collate(const std::string &name) const
+{
+  try
+  {
+    auto tmp = itsCollator->transform(boost::locale::collator_base::primary, name);
 
     // The standard library std::string provided in RHEL6 cannot handle
     // std::string comparisons if there are 0-bytes in the std::strings. The collator
@@ -535,6 +885,45 @@ std::string Engine::Impl::to_treeword(const std::string &name) const
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the precomputed collation key for a name
+ *
+ * The keys are generated while building the search trees, hence lookups
+ * are done only once suggest is ready. Returns nullptr if the name is unknown.
+ */
+// ----------------------------------------------------------------------
+
+const std::string *Engine::Impl::find_collation_key(const std::string &name) const
+{
+  if (!isSuggestReady())
+    return nullptr;
+
+  auto pos = itsCollationKeys.find(name);
+  if (pos == itsCollationKeys.end())
+    return nullptr;
+  return &pos->second;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store the collation key of a name unless already known
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::add_collation_key(const std::string &name)
+{
+  try
+  {
+    if (itsCollationKeys.find(name) == itsCollationKeys.end())
+      itsCollationKeys.emplace(name, to_treeword(name));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*
  * \brief Transform search location to normal form
@@ -668,6 +1057,16 @@ void Engine::Impl::initSuggest(bool threaded)
 {
   try
   {
+    // Trees which depend only on the locations are built while the
+    // remaining tables are still being read
+
+    LoadProfile::Scope phase(itsLoadProfile, "initSuggest");
+
+    BuildTaskGroup builds(itsBuildThreads, &itsLoadProfile);
+
+    // Database hash value for writing a new snapshot
+    std::optional<std::size_t> snapshot_hash;
+
     try
     {
       itsConfig.lookupValue("maxdemresolution", itsMaxDemResolution);
@@ -676,48 +1075,40 @@ void Engine::Impl::initSuggest(bool threaded)
         std::cerr << "Warning: Geonames database is disabled" << std::endl;
       else
       {
-        Fmi::Database::PostgreSQLConnectionOptions opt;
-        opt.host = itsHost;
-        opt.port = Fmi::stoul(itsPort);
-        opt.database = itsDatabase;
-        opt.username = itsUser;
-        opt.password = itsPass;
-        opt.encoding = "UTF8";
         Fmi::Database::PostgreSQLConnection conn;
-        conn.open(opt);
-
-        if (!conn.isConnected())
-          throw Fmi::Exception(BCP, "Failed to connect to fminames database");
+        {
+          LoadProfile::Scope connect(itsLoadProfile, "connect");
+          open_connection(conn);
+        }
 
-        const auto hash = read_database_hash_value(conn);
+        std::optional<std::size_t> hash;
+        {
+          LoadProfile::Scope check(itsLoadProfile, "hash check");
+          hash = read_database_hash_value(conn);
+        }
         if (hash)
           itsHashValue = *hash;
 
         Fmi::AsyncTask::interruption_point();
 
-        // These are needed in regression tests even in mock mode
-        read_countries(conn);
-        read_alternate_countries(conn);
-
-        if (!itsAutocompleteDisabled)
-        {
-          Fmi::AsyncTask::interruption_point();
-          read_municipalities(conn);
-
-          Fmi::AsyncTask::interruption_point();
-          read_geonames(conn);  // requires read_municipalities, read_countries
-
-          Fmi::AsyncTask::interruption_point();
-          build_geoid_map();  // requires read_geonames
+        if (itsIncrementalReload)
+          read_table_states(conn);
 
-          Fmi::AsyncTask::interruption_point();
-          read_alternate_geonames(conn);  // requires build_geoid_map
+        const bool from_snapshot = (hash && read_snapshot(*hash));
 
-          Fmi::AsyncTask::interruption_point();
-          read_alternate_municipalities(conn);
+        if (from_snapshot)
+          itsPrevious.reset();
+        else
+        {
+          if (itsPrevious)
+            read_tables_incremental(conn, builds);
+          else if (itsParallelLoad)
+            read_tables_parallel(conn, builds);
+          else
+            read_tables(conn, builds);
 
-          Fmi::AsyncTask::interruption_point();
-          read_keywords(conn);  // requires build_geoid_map
+          if (hash && !itsSnapshotFile.empty())
+            snapshot_hash = hash;
         }
       }
     }
@@ -751,20 +1142,31 @@ void Engine::Impl::initSuggest(bool threaded)
     // to close the connection.
 
     Fmi::AsyncTask::interruption_point();
-    build_geotrees();  // requires ?
+    build_trees(builds);  // search trees and collation keys
 
-    Fmi::AsyncTask::interruption_point();
-    build_ternarytrees();  // requires ?
+    // Release the previous data as soon as possible
+    itsPrevious.reset();
+    itsChangedGeoids.clear();
 
-    Fmi::AsyncTask::interruption_point();
-    build_lang_ternarytrees();  // requires ?
+    record_structures();
 
-    Fmi::AsyncTask::interruption_point();
-    assign_priorities(itsLocations);  // requires read_geonames
+    if (snapshot_hash)
+    {
+      try
+      {
+        write_snapshot(*snapshot_hash);
+      }
+      catch (...)
+      {
+        // The data is valid even if it could not be saved
+        Fmi::Exception exception(BCP, "Failed to write geonames snapshot", nullptr);
+        std::cerr << exception.getStackTrace() << std::endl;
+      }
+    }
 
     // Ready
     itsReloadOK = true;
-    itsSuggestReadyFlag = true;
+    set_suggest_ready();
   }
   catch (const boost::thread_interrupted &)
   {
@@ -819,18 +1221,8 @@ try
   else
   {
     const Fmi::DateTime now = Fmi::MicrosecClock::universal_time();
-    Fmi::Database::PostgreSQLConnectionOptions opt;
-    opt.host = itsHost;
-    opt.port = Fmi::stoul(itsPort);
-    opt.database = itsDatabase;
-    opt.username = itsUser;
-    opt.password = itsPass;
-    opt.encoding = "UTF8";
     Fmi::Database::PostgreSQLConnection conn;
-    conn.open(opt);
-
-    if (!conn.isConnected())
-      throw Fmi::Exception(BCP, "Failed to connect to fminames database");
+    open_connection(conn);
 
     const auto new_hash = read_database_hash_value(conn);
     const Fmi::DateTime check_done = Fmi::MicrosecClock::universal_time();
@@ -865,6 +1257,8 @@ catch (const Fmi::Exception &error)
 
 void Engine::Impl::initDEM()
 {
+  LoadProfile::Scope phase(itsLoadProfile, "initDEM");
+
   std::string demdir;
   itsConfig.lookupValue("demdir", demdir);
   if (!demdir.empty())
@@ -879,6 +1273,8 @@ void Engine::Impl::initDEM()
 
 void Engine::Impl::initLandCover()
 {
+  LoadProfile::Scope phase(itsLoadProfile, "initLandCover");
+
   std::string landcoverdir;
   itsConfig.lookupValue("landcoverdir", landcoverdir);
   if (!landcoverdir.empty())
@@ -891,10 +1287,13 @@ void Engine::Impl::initLandCover()
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::init(bool first_construction)
+void Engine::Impl::init(bool first_construction, std::shared_ptr<const Impl> previous)
 {
   try
   {
+    if (itsIncrementalReload && previous && !first_construction)
+      itsPrevious = std::move(previous);
+
     // Read DEM and GlobCover data in parallel for speed
 
     std::string landcoverdir;
@@ -914,6 +1313,10 @@ void Engine::Impl::init(bool first_construction)
     else
       tg1.add("initSuggest", [this]() { initSuggest(true); });
 
+    // Warm up a new engine from the queries saved by a previous run
+    if (first_construction && !itsWarmupFile.empty())
+      tg1.add("warmup", [this]() { warmup_from_file(); });
+
     itsConfig.lookupValue("autoreload.period", itsAutoReloadInterval);
 
     // Done apart from autocomplete. Ready to shutdown now though.
@@ -936,12 +1339,19 @@ void Engine::Impl::shutdown()
   try
   {
     std::cout << "  -- Shutdown requested (Impl)\n";
-    if (query_worker_pool)
-    {
-      query_worker_pool->cancel();
-    }
+
+    // Release anyone waiting for autocomplete to become ready
+    set_suggest_ready(
+        std::make_exception_ptr(Fmi::Exception(BCP, "Geonames engine is shutting down")));
+
+    if (query_pool)
+      query_pool->cancel();
+    if (replica_pool)
+      replica_pool->cancel();
     tg1.stop();
     tg1.wait();
+
+    write_warmup_file();
   }
   catch (...)
   {
@@ -1011,8 +1421,52 @@ void Engine::Impl::read_config()
 
       itsConfig.lookupValue("remove_underscores", itsRemoveUnderscores);
 
-      read_config_priorities();
-
+      itsConfig.lookupValue("memory_id_search", itsMemoryIdSearch);
+      itsConfig.lookupValue("memory_station_search", itsMemoryStationSearch);
+      itsConfig.lookupValue("memory_lonlat_search", itsMemoryLonLatSearch);
+      itsConfig.lookupValue("compact_suggest_index", itsCompactSuggestIndex);
+      itsConfig.lookupValue("build_threads", itsBuildThreads);
+      itsConfig.lookupValue("batch_threads", itsBatchThreads);
+      itsConfig.lookupValue("async_threads", itsAsyncThreads);
+      itsConfig.lookupValue("database.fetch_size", itsFetchSize);
+      itsConfig.lookupValue("database.parallel_load", itsParallelLoad);
+      itsConfig.lookupValue("snapshot.file", itsSnapshotFile);
+      itsConfig.lookupValue("incremental_reload", itsIncrementalReload);
+
+      if (itsConfig.exists("pretranslated_languages"))
+      {
+        const auto &languages = itsConfig.lookup("pretranslated_languages");
+        if (!languages.isArray())
+          throw Fmi::Exception(BCP,
+                               "Configured value of 'pretranslated_languages' must be an array");
+        for (int i = 0; i < languages.getLength(); ++i)
+          itsPretranslatedLanguages.push_back(to_language(languages[i].c_str()));
+      }
+
+      if (itsConfig.exists("eager_languages"))
+      {
+        const auto &languages = itsConfig.lookup("eager_languages");
+        if (!languages.isArray())
+          throw Fmi::Exception(BCP, "Configured value of 'eager_languages' must be an array");
+        itsLazyTrees = true;
+        for (int i = 0; i < languages.getLength(); ++i)
+          itsEagerLanguages.insert(to_language(languages[i].c_str()));
+      }
+      itsConfig.lookupValue("lazy_build_threads", itsLazyBuildThreads);
+      itsConfig.lookupValue("lazy_language_expiration", itsLazyLanguageExpiration);
+
+      if (itsConfig.exists("memory_lonlat_features"))
+      {
+        const auto &features = itsConfig.lookup("memory_lonlat_features");
+        if (!features.isArray())
+          throw Fmi::Exception(BCP,
+                               "Configured value of 'memory_lonlat_features' must be an array");
+        for (int i = 0; i < features.getLength(); ++i)
+          itsMemoryLonLatFeatures.emplace_back(features[i].c_str());
+      }
+
+      read_config_priorities();
+
       read_config_security();
 
       const std::string &name = boost::asio::ip::host_name();
@@ -1027,6 +1481,37 @@ void Engine::Impl::read_config()
       int port = default_port;
       itsConfig.lookupValue("database.port", port);
       itsPort = Fmi::to_string(port);
+
+      unsigned int min_connections = itsPoolOptions.min_connections;
+      unsigned int max_connections = itsPoolOptions.max_connections;
+      unsigned int wait_timeout = itsPoolOptions.wait_timeout.count();
+      unsigned int idle_timeout = itsPoolOptions.idle_timeout.count();
+      unsigned int query_timeout = 0;
+      itsConfig.lookupValue("database.pool.min_connections", min_connections);
+      itsConfig.lookupValue("database.pool.max_connections", max_connections);
+      itsConfig.lookupValue("database.pool.wait_timeout", wait_timeout);
+      itsConfig.lookupValue("database.pool.idle_timeout", idle_timeout);
+      itsConfig.lookupValue("database.query_timeout", query_timeout);
+      itsPoolOptions.min_connections = min_connections;
+      itsPoolOptions.max_connections = max_connections;
+      itsPoolOptions.wait_timeout = std::chrono::milliseconds(wait_timeout);
+      itsPoolOptions.idle_timeout = std::chrono::seconds(idle_timeout);
+      itsQueryTimeout = std::chrono::milliseconds(query_timeout);
+
+      if (itsConfig.exists("database.replica"))
+      {
+        itsReplicaHost = itsHost;
+        itsReplicaUser = itsUser;
+        itsReplicaPass = itsPass;
+        itsReplicaDatabase = itsDatabase;
+        int replica_port = port;
+        itsConfig.lookupValue("database.replica.host", itsReplicaHost);
+        itsConfig.lookupValue("database.replica.user", itsReplicaUser);
+        itsConfig.lookupValue("database.replica.pass", itsReplicaPass);
+        itsConfig.lookupValue("database.replica.database", itsReplicaDatabase);
+        itsConfig.lookupValue("database.replica.port", replica_port);
+        itsReplicaPort = Fmi::to_string(replica_port);
+      }
     }
     catch (const libconfig::SettingException &e)
     {
@@ -1133,153 +1618,218 @@ void Engine::Impl::read_config_prioritymap(const std::string &partname, Prioriti
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Read the database hash value
+ * \brief Open a connection to the geonames database
  */
 // ----------------------------------------------------------------------
 
-std::optional<std::size_t> Engine::Impl::read_database_hash_value(
-    Fmi::Database::PostgreSQLConnection &conn)
+void Engine::Impl::open_connection(Fmi::Database::PostgreSQLConnection &conn) const
 {
   try
   {
-    // Select maximum last_modified from tables which have it. Note that
-    // the maximum mya have fractional seconds, hence the rounding to seconds
+    Fmi::Database::PostgreSQLConnectionOptions opt;
+    opt.host = itsHost;
+    opt.port = Fmi::stoul(itsPort);
+    opt.database = itsDatabase;
+    opt.username = itsUser;
+    opt.password = itsPass;
+    opt.encoding = "UTF8";
+    conn.open(opt);
 
-    std::string query =
-        "SELECT EXTRACT(epoch FROM date_trunc('second',max(val))) AS max "
-        "FROM ("
-        "SELECT max(last_modified) AS val from geonames UNION "
-        "SELECT max(last_modified) AS val from keywords_has_geonames UNION "
-        "SELECT max(last_modified) AS val from alternate_geonames) x";
+    if (!conn.isConnected())
+      throw Fmi::Exception(BCP, "Failed to connect to fminames database");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-    pqxx::result res = conn.executeNonTransaction(query);
+// ----------------------------------------------------------------------
+/*!
+ * \brief The deadline of a database search starting now
+ *
+ * Searches in progress cannot be interrupted, the deadline limits how long
+ * the caller waits for a connection or for an identical search.
+ */
+// ----------------------------------------------------------------------
 
-    if (res.empty())
-    {
-      if (!itsStrict)
-        return std::nullopt;
-      throw Fmi::Exception(BCP, "FmiNames: Failed to read database hash value");
-    }
+QueryPool::Clock::time_point Engine::Impl::query_deadline() const
+{
+  if (itsQueryTimeout.count() == 0)
+    return QueryPool::Clock::time_point::max();
+  return QueryPool::Clock::now() + itsQueryTimeout;
+}
 
-    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
-    {
-      auto tmp = row["max"].as<double>();
-      return std::size_t(std::floor(tmp + 0.5));
-    }
+// ----------------------------------------------------------------------
+/*!
+ * \brief Reserve a Locus connection for a search
+ *
+ * Searches which may use the read replica get a connection to it if one
+ * has been configured, or to the primary database if the replica fails.
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<Locus::Query> Engine::Impl::reserve_query(Metrics::Operation operation,
+                                                          QueryPool::Clock::time_point deadline,
+                                                          bool replica) const
+{
+  try
+  {
+    Metrics::Timer timer(*itsMetrics, operation, Metrics::Phase::Queue);
+    if (replica && replica_pool)
+      return replica_pool->reserve(*query_pool, deadline);
+    return query_pool->reserve(deadline);
   }
   catch (...)
   {
-    if (itsStrict)
-      throw Fmi::Exception::Trace(BCP, "Operation failed!");
-    return std::nullopt;
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Read the countries table
+ * \brief Pass the rows of a query to the callback
+ *
+ * If a fetch size has been configured the rows are read through a cursor
+ * in batches of the given size, so that the full result set is never held
+ * in memory at once. Returns the number of rows read.
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::read_countries(Fmi::Database::PostgreSQLConnection &conn)
+std::size_t Engine::Impl::read_rows(
+    Fmi::Database::PostgreSQLConnection &conn,
+    const std::string &cursor,
+    const std::string &sql,
+    const std::function<void(const pqxx::result::const_iterator &)> &callback)
 {
   try
   {
-    // Note: PCLI overrides smaller political entities if there are multiple
-    // for
-    // the same iso2
-    // country
-    // code
-    std::string query(
-        "SELECT name, countries_iso2 as iso2 FROM geonames WHERE "
-        "features_code in "
-        "('PCLD','PCLF','PCLI') ORDER BY features_code ASC");
+    // The time spent in the database is profiled separately from processing the rows
+    const auto fetch_rows = [&conn](const std::string &query)
+    {
+      const auto start = LoadProfile::Clock::now();
+      pqxx::result res = conn.executeNonTransaction(query);
+      LoadProfile::database(LoadProfile::Clock::now() - start);
+      LoadProfile::rows(res.size());
+      return res;
+    };
+
+    if (itsFetchSize == 0)
+    {
+      pqxx::result res = fetch_rows(sql);
+      for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+        callback(row);
+      return res.size();
+    }
 
-    if (itsVerbose)
-      std::cout << "read_countries: " << query << std::endl;
+    // Cursors require a transaction
 
-    pqxx::result res = conn.executeNonTransaction(query);
+    conn.executeNonTransaction("BEGIN");
 
-    if (res.empty())
+    try
     {
-      if (itsStrict)
-        throw Fmi::Exception(BCP, "FmiNames: Found no PCLI/PCLF/PCLD places from geonames table");
+      const auto start = LoadProfile::Clock::now();
+      conn.executeNonTransaction("DECLARE " + cursor + " NO SCROLL CURSOR FOR " + sql);
+      LoadProfile::database(LoadProfile::Clock::now() - start);
 
-      std::cerr << "Warning: FmiNames: Found no PCLI/PCLF/PCLD places from geonames table"
-                << std::endl;
-    }
+      const std::string fetch =
+          "FETCH FORWARD " + Fmi::to_string(itsFetchSize) + " FROM " + cursor;
 
-    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+      std::size_t count = 0;
+      while (true)
+      {
+        Fmi::AsyncTask::interruption_point();
+
+        pqxx::result res = fetch_rows(fetch);
+        for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+          callback(row);
+
+        count += res.size();
+        if (res.size() < itsFetchSize)
+          break;
+      }
+
+      conn.executeNonTransaction("CLOSE " + cursor);
+      conn.executeNonTransaction("COMMIT");
+      return count;
+    }
+    catch (...)
     {
-      auto name = row["name"].as<std::string>();
-      auto iso2 = row["iso2"].as<std::string>();
-      itsCountries[iso2] = name;
+      try
+      {
+        conn.executeNonTransaction("ROLLBACK");
+      }
+      catch (...)
+      {
+        // The original error is more relevant
+      }
+      throw;
     }
-
-    if (itsVerbose)
-      std::cout << "read_countries: " << res.size() << " countries" << std::endl;
   }
   catch (...)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Cursor", cursor);
   }
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Read the alternate countries
+ * \brief Read all tables using a single connection
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::read_alternate_countries(Fmi::Database::PostgreSQLConnection &conn)
+void Engine::Impl::read_tables(Fmi::Database::PostgreSQLConnection &conn, BuildTaskGroup &builds)
 {
   try
   {
-    std::string query(
-        "SELECT language, g.name as gname,a.name as "
-        "alt_gname,a.preferred,a.priority,length(a.name) "
-        "as length FROM geonames g, alternate_geonames a WHERE "
-        "g.features_code in "
-        "('PCLI','PCLF','PCLD','TERR') AND g.id=a.geonames_id ORDER BY "
-        "geonames_id, a.priority ASC, "
-        "a.preferred DESC, length ASC, alt_gname ASC");
+    // These are needed in regression tests even in mock mode
+    read_countries(conn);
+    read_alternate_countries(conn);
 
-    if (itsVerbose)
-      std::cout << "read_alternate_countries: " << query << std::endl;
+    if (itsAutocompleteDisabled)
+      return;
 
-    pqxx::result res = conn.executeNonTransaction(query);
+    Fmi::AsyncTask::interruption_point();
+    read_municipalities(conn);
 
-    if (res.empty())
-    {
-      if (itsStrict)
-        throw Fmi::Exception(BCP, "Found no country translations");
+    read_locations(conn, builds);  // requires read_municipalities, read_countries
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-      std::cerr << "Warning: Found no country translations" << std::endl;
-    }
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read the locations and everything depending on them
+ *
+ * The trees depending only on the locations are started as soon as the
+ * locations have been read.
+ */
+// ----------------------------------------------------------------------
 
-    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
-    {
-      auto lang = row["language"].as<std::string>();
-      auto name = row["gname"].as<std::string>();
-      auto translation = row["alt_gname"].as<std::string>();
+void Engine::Impl::read_locations(Fmi::Database::PostgreSQLConnection &conn,
+                                  BuildTaskGroup &builds)
+{
+  try
+  {
+    Fmi::AsyncTask::interruption_point();
+    read_geonames(conn);  // requires read_municipalities, read_countries
 
-      auto it = itsAlternateCountries.find(name);
-      if (it == itsAlternateCountries.end())
-      {
-        it = itsAlternateCountries.insert(make_pair(name, Translations())).first;
-      }
+    Fmi::AsyncTask::interruption_point();
+    build_geoid_map();  // requires read_geonames
 
-      Fmi::ascii_tolower(lang);
+    build_location_trees(builds);  // requires build_geoid_map
 
-      auto &translations = it->second;
-      // Note: Failure to insert is OK, we prefer the sorted order of the SQL
-      // statements
-      translations.insert(std::make_pair(lang, translation));
-    }
+    Fmi::AsyncTask::interruption_point();
+    read_alternate_geonames(conn);  // requires build_geoid_map
 
-    if (itsVerbose)
+    Fmi::AsyncTask::interruption_point();
+    read_alternate_municipalities(conn);
 
-      std::cout << "read_alternate_countries: " << res.size() << " translations" << std::endl;
+    Fmi::AsyncTask::interruption_point();
+    read_keywords(conn);  // requires build_geoid_map
   }
   catch (...)
   {
@@ -1289,35 +1839,74 @@ void Engine::Impl::read_alternate_countries(Fmi::Database::PostgreSQLConnection
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Read the municipalities table
+ * \brief Read all tables using parallel connections
+ *
+ * The tables which do not depend on each other are read concurrently with
+ * separate connections. The given connection is used for the chain
+ * countries - municipalities - geonames - alternate geonames.
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::read_municipalities(Fmi::Database::PostgreSQLConnection &conn)
+void Engine::Impl::read_tables_parallel(Fmi::Database::PostgreSQLConnection &conn,
+                                        BuildTaskGroup &builds)
 {
   try
   {
-    std::string query("SELECT id, name FROM municipalities");
+    BuildTaskGroup loads(2, &itsLoadProfile);
 
-    if (itsVerbose)
-      std::cout << "read_municipalities: " << query << std::endl;
+    loads.add("alternate_countries",
+              [this]()
+              {
+                Fmi::Database::PostgreSQLConnection conn2;
+                open_connection(conn2);
+                read_alternate_countries(conn2);
+              });
 
-    pqxx::result res = conn.executeNonTransaction(query);
+    if (!itsAutocompleteDisabled)
+    {
+      loads.add("alternate_municipalities",
+                [this]()
+                {
+                  Fmi::Database::PostgreSQLConnection conn2;
+                  open_connection(conn2);
+                  read_alternate_municipalities(conn2);
+                });
+    }
 
-    // We allow this to be empty since the table contains only Finnish information
-    // if (res.empty()) throw Fmi::Exception(BCP, "FmiNames: Found nothing from municipalities
-    // table");
+    // These are needed in regression tests even in mock mode
+    read_countries(conn);
 
-    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+    if (!itsAutocompleteDisabled)
     {
-      int id = row["id"].as<int>();
-      auto name = row["name"].as<std::string>();
-      itsMunicipalities[id] = name;
+      Fmi::AsyncTask::interruption_point();
+      read_municipalities(conn);
+
+      Fmi::AsyncTask::interruption_point();
+      read_geonames(conn);  // requires read_municipalities, read_countries
+
+      Fmi::AsyncTask::interruption_point();
+      build_geoid_map();  // requires read_geonames
     }
 
-    if (itsVerbose)
-      std::cout << "read_municipalities: " << itsMunicipalities.size() << " municipalities"
-                << std::endl;
+    loads.wait();
+
+    if (itsAutocompleteDisabled)
+      return;
+
+    build_location_trees(builds);  // requires build_geoid_map
+
+    loads.add("keywords",
+              [this]()
+              {
+                Fmi::Database::PostgreSQLConnection conn2;
+                open_connection(conn2);
+                read_keywords(conn2);  // requires build_geoid_map
+              });
+
+    Fmi::AsyncTask::interruption_point();
+    read_alternate_geonames(conn);  // requires build_geoid_map
+
+    loads.wait();
   }
   catch (...)
   {
@@ -1327,334 +1916,393 @@ void Engine::Impl::read_municipalities(Fmi::Database::PostgreSQLConnection &conn
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Read the base geonames table
+ * \brief Describe the settings which affect the loaded data
+ *
+ * A snapshot written with different settings must not be used.
  */
 // ----------------------------------------------------------------------
 
-Spine::LocationPtr Engine::Impl::extract_geoname(const pqxx::result::const_iterator &row) const
+std::string Engine::Impl::snapshot_fingerprint() const
 {
-  Spine::GeoId geoid = Fmi::stoi(row["id"].as<std::string>());
-  auto name = row["name"].as<std::string>();
+  try
+  {
+    std::string fingerprint;
+    for (const char *name : {"database.where.geonames",
+                             "database.where.alternate_geonames",
+                             "demdir",
+                             "landcoverdir"})
+    {
+      std::string value;
+      itsConfig.lookupValue(name, value);
+      fingerprint.append(name).append("=").append(value).append("\n");
+    }
 
-  auto iso2 = (row["iso2"].is_null() ? "" : row["iso2"].as<std::string>());
-  auto feature = (row["feature"].is_null() ? "" : row["feature"].as<std::string>());
-  auto munip = row["munip"].as<int>();
-  auto lon = row["lon"].as<double>();
-  auto lat = row["lat"].as<double>();
-  auto tz = row["timezone"].as<std::string>();
-  auto pop = (!row["population"].is_null() ? row["population"].as<int>() : 0);
-  auto ele = (!row["elevation"].is_null() ? row["elevation"].as<double>()
-                                          : std::numeric_limits<float>::quiet_NaN());
-  double dem = (!row["dem"].is_null() ? row["dem"].as<int>() : elevation(lon, lat));
-  auto admin = (!row["admin1"].is_null() ? row["admin1"].as<std::string>() : "");
-  auto covertype = Fmi::LandCover::Type(
-      (!row["landcover"].is_null() ? row["landcover"].as<int>() : coverType(lon, lat)));
+    fingerprint.append("maxdemresolution=")
+        .append(Fmi::to_string(itsMaxDemResolution))
+        .append("\nautocomplete=")
+        .append(itsAutocompleteDisabled ? "false" : "true")
+        .append("\n");
 
-  std::string area;
-  if (munip != 0)
+    return fingerprint;
+  }
+  catch (...)
   {
-    auto it = itsMunicipalities.find(munip);
-    if (it != itsMunicipalities.end())
-      area = it->second;
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
+}
 
-  if (area.empty())
+namespace
+{
+void write_translations(SnapshotWriter &writer, const TranslationStore &store)
+{
+  writer.write(static_cast<std::uint64_t>(store.size()));
+  for (std::size_t row = 0; row < store.size(); ++row)
   {
-    auto it = itsCountries.find(iso2);
-    auto us = itsCountries.find("US");
-    if (it != itsCountries.end())
-      area = it->second;
-    if (it == us)
-      area = admin.append(", ").append(area);
-#if 0
-          else
-            std::cerr << "Failed to find country " << key << " for geoid " << geoid << std::endl;
-#endif
+    auto translations = store.translations(row);
+    writer.write(static_cast<std::int32_t>(store.id(row)));
+    writer.write(static_cast<std::uint64_t>(translations.second - translations.first));
+    for (const auto *tt = translations.first; tt != translations.second; ++tt)
+    {
+      writer.write(store.language(*tt));
+      writer.write(std::string(store.name(*tt)));
+    }
   }
-
-  std::string country;  // country will be filled in upon request
-  Spine::LocationPtr loc = std::make_shared<Spine::Location>(geoid,
-                                                             name,
-                                                             iso2,
-                                                             munip,
-                                                             area,
-                                                             feature,
-                                                             country,
-                                                             lon,
-                                                             lat,
-                                                             tz,
-                                                             pop,
-                                                             boost::numeric_cast<float>(ele),
-                                                             boost::numeric_cast<float>(dem),
-                                                             covertype);
-
-  return loc;
 }
 
-void Engine::Impl::read_geonames(Fmi::Database::PostgreSQLConnection &conn)
+void read_translations(SnapshotReader &reader, TranslationStore &store)
 {
-  try
+  const auto rows = reader.read_uint64();
+  for (std::uint64_t row = 0; row < rows; ++row)
   {
-    std::string sql =
-        "SELECT\n"
-        "  id, geonames.name AS name, countries_iso2 as iso2, features_code as feature, \n"
-        "  municipalities_id as munip, lon, lat, timezone, population, elevation, dem, landcover, "
-        "admin1\n"
-        "FROM\n"
-        "  geonames\n"
-        "INNER JOIN\n"
-        "  keywords_has_geonames\n"
-        "ON\n"
-        "  geonames.id=keywords_has_geonames.geonames_id\n";
-
-    if (itsConfig.exists("database.where.geonames"))
-    {
-      const libconfig::Setting &where_clause = itsConfig.lookup("database.where.geonames");
-      sql.append(" AND ").append(static_cast<const char *>(where_clause));
-    }
-
-    if (itsVerbose)
-      std::cout << "read_geonames: " << sql << std::endl;
-
-    pqxx::result res = conn.executeNonTransaction(sql);
-
-    if (res.empty())
-    {
-      if (itsStrict)
-        throw Fmi::Exception(BCP, "Found nothing from fminames database");
-
-      std::cerr << "Warning: Found nothing from fminames database" << std::endl;
-    }
-
-    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+    const auto id = reader.read_int32();
+    const auto count = reader.read_uint64();
+    for (std::uint64_t i = 0; i < count; ++i)
     {
-      if (row["timezone"].is_null())
-      {
-        std::cerr << "Warning: " << Fmi::stoi(row["id"].as<std::string>()) << " '"
-                  << row["name"].as<std::string>() << "' timezone is null, discarding the location"
-                  << std::endl;
-      }
-      else
-      {
-        auto loc = extract_geoname(row);
-        itsLocations.push_back(loc);
-      }
+      auto lang = reader.read_string();
+      auto name = reader.read_string();
+      store.add(id, lang, name);
     }
+  }
+  store.finalize();
+}
 
-    if (itsVerbose)
-      std::cout << "read_geonames: " << itsLocations.size() << " locations" << std::endl;
+void write_strings(SnapshotWriter &writer, const std::map<std::string, std::string> &strings)
+{
+  writer.write(static_cast<std::uint64_t>(strings.size()));
+  for (const auto &key_value : strings)
+  {
+    writer.write(key_value.first);
+    writer.write(key_value.second);
   }
-  catch (...)
+}
+
+void read_strings(SnapshotReader &reader, std::map<std::string, std::string> &strings)
+{
+  const auto count = reader.read_uint64();
+  for (std::uint64_t i = 0; i < count; ++i)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    auto key = reader.read_string();
+    strings[key] = reader.read_string();
   }
 }
 
+}  // namespace
+
 // ----------------------------------------------------------------------
 /*!
- * \brief Read the alternate_geonames table
+ * \brief Write the loaded tables into the snapshot file
+ *
+ * The trees are not stored, they are quick to rebuild in parallel
+ * compared to reading the tables from the database.
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::read_alternate_geonames(Fmi::Database::PostgreSQLConnection &conn)
+void Engine::Impl::write_snapshot(std::size_t hash) const
 {
   try
   {
-    std::string sql =
-        "SELECT a.geonames_id, a.name, a.language, a.priority, a.preferred, "
-        "length(a.name) as "
-        "length "
-        "FROM alternate_geonames a INNER JOIN keywords_has_geonames k ON "
-        "a.geonames_id=k.geonames_id";
-
-    if (itsConfig.exists("database.where.alternate_geonames"))
-    {
-      const auto &where_clause = itsConfig.lookup("database.where.alternate_geonames");
-      sql.append(" WHERE ").append(static_cast<const char *>(where_clause));
-    }
-
-    // This makes sure preferred names come first, and longest names last.
-    // Note that this leaves cases like Montreal vs Montr�al, hence we do a final
-    // name sort to guarantee a fixed order. Using ASC prefers non-accented letters.
-
-#if 0
-    // Works only in MySQL
-    sql.append(" GROUP BY a.id HAVING count(*) > 1 ORDER BY a.geonames_id, a.language, a.priority ASC, a.preferred DESC, length ASC, name ASC");
-#else
-    // PostGreSQL requires all the names to be mentioned
-    sql.append(
-        " GROUP BY "
-        "a.id,a.geonames_id,a.name,a.language,a.priority,a.preferred "
-        "HAVING count(*) > 0 "
-        "ORDER BY a.geonames_id, a.language, a.priority ASC, a.preferred DESC, "
-        "length ASC, name ASC");
-#endif
+    LoadProfile::Scope phase(itsLoadProfile, "write_snapshot");
 
     if (itsVerbose)
-      std::cout << "read_alternate_geonames: " << sql << std::endl;
+      std::cout << "write_snapshot: " << itsSnapshotFile << std::endl;
 
-    pqxx::result res = conn.executeNonTransaction(sql);
+    SnapshotWriter writer(itsSnapshotFile, hash, snapshot_fingerprint());
 
-    if (res.empty())
-    {
-      if (itsStrict)
-        throw Fmi::Exception(BCP, "Found nothing from alternate_geonames database");
+    write_strings(writer, itsCountries);
 
-      std::cerr << "Warning: Found nothing from alternate_geonames database" << std::endl;
+    writer.write(static_cast<std::uint64_t>(itsAlternateCountries.size()));
+    for (const auto &name_translations : itsAlternateCountries)
+    {
+      writer.write(name_translations.first);
+      write_strings(writer, name_translations.second);
     }
 
-    if (itsVerbose)
-      std::cout << "read_alternate_geonames: " << res.size() << " translations" << std::endl;
-
-    // We assume sort order is geoid,language for the ifs to work
-    Spine::GeoId last_handled_geoid = 0;
-    std::string last_lang;
-    auto idinfo = itsGeoIdMap.end();
-
-    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+    writer.write(static_cast<std::uint64_t>(itsMunicipalities.size()));
+    for (const auto &id_name : itsMunicipalities)
     {
-      Spine::GeoId geoid = Fmi::stoi(row["geonames_id"].as<std::string>());
-      auto name = row["name"].as<std::string>();
-      auto lang = row["language"].as<std::string>();
-
-      Fmi::ascii_tolower(lang);
-
-      // Handle only the first translation for each place
-      if (geoid == last_handled_geoid && lang == last_lang)
-        continue;
-
-      if (geoid != last_handled_geoid)
-        idinfo = itsGeoIdMap.find(geoid);  // update only when geoid changes for speed
-
-      last_handled_geoid = geoid;
-      last_lang = lang;
-
-      // Discard translations which do not change anything to save memory and to avoid
-      // duplicates more easily
-
-      if (idinfo != itsGeoIdMap.end())
-      {
-        auto locptr = *idinfo->second;
-        if (locptr->name == name)
-          continue;
-      }
-
-      auto it = itsAlternateNames.find(geoid);
-      if (it == itsAlternateNames.end())
-        it = itsAlternateNames.insert(make_pair(geoid, Translations())).first;
+      writer.write(static_cast<std::int32_t>(id_name.first));
+      writer.write(id_name.second);
+    }
 
-      auto &translations = it->second;
+    writer.write(static_cast<std::uint64_t>(itsLocations.size()));
+    for (const Spine::LocationPtr &loc : itsLocations.locations())
+    {
+      writer.write(static_cast<std::int32_t>(loc->geoid));
+      writer.write(loc->name);
+      writer.write(loc->iso2);
+      writer.write(static_cast<std::int32_t>(loc->municipality));
+      writer.write(loc->area);
+      writer.write(loc->feature);
+      writer.write(loc->country);
+      writer.write(loc->longitude);
+      writer.write(loc->latitude);
+      writer.write(loc->timezone);
+      writer.write(static_cast<std::int32_t>(loc->population));
+      writer.write(loc->elevation);
+      writer.write(loc->dem);
+      writer.write(static_cast<std::int32_t>(loc->covertype));
+    }
 
-      // Note that it is OK if this fails - the first translation found is
-      // preferred
+    write_translations(writer, itsAlternateNames);
+    write_translations(writer, itsAlternateMunicipalities);
 
-      translations.insert(std::make_pair(lang, name));
+    writer.write(static_cast<std::uint64_t>(itsKeywords.size()));
+    for (const auto &name_locs : itsKeywords)
+    {
+      writer.write(name_locs.first);
+      writer.write(static_cast<std::uint64_t>(name_locs.second.size()));
+      for (const Spine::LocationPtr &loc : name_locs.second)
+        writer.write(static_cast<std::int32_t>(loc->geoid));
     }
 
-    if (itsVerbose)
-      std::cout << "read_alternate_geonames done" << std::endl;
+    writer.commit();
   }
   catch (...)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("File", itsSnapshotFile);
   }
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Read the alternate_municipalities table
+ * \brief Read the tables from the snapshot file
+ *
+ * Returns false if there is no valid snapshot for the database hash, in
+ * which case nothing has been modified.
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::read_alternate_municipalities(Fmi::Database::PostgreSQLConnection &conn)
+bool Engine::Impl::read_snapshot(std::size_t hash)
 {
   try
   {
-    std::string query(
-        "SELECT municipalities_id as id, name, language FROM "
-        "alternate_municipalities");
+    LoadProfile::Scope phase(itsLoadProfile, "read_snapshot");
 
-    if (itsVerbose)
-      std::cout << "read_alternate_municipalities: " << query << std::endl;
+    if (itsSnapshotFile.empty() || !std::filesystem::exists(itsSnapshotFile))
+      return false;
 
-    pqxx::result res = conn.executeNonTransaction(query);
+    SnapshotReader reader(itsSnapshotFile, hash, snapshot_fingerprint());
 
-    // Permit the table to be empty since it contains only Finnish information
-    // if (res.empty()) throw Fmi::Exception(BCP, "FmiNames: Found nothing from
-    // alternate_municipalities database");
+    Countries countries;
+    read_strings(reader, countries);
 
-    if (itsVerbose)
-      std::cout << "read_alternate_geonames: " << res.size() << " translations" << std::endl;
+    AlternateCountries alternate_countries;
+    const auto ncountries = reader.read_uint64();
+    for (std::uint64_t i = 0; i < ncountries; ++i)
+    {
+      auto name = reader.read_string();
+      read_strings(reader, alternate_countries[name]);
+    }
 
-    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+    Municipalities municipalities;
+    const auto nmunicipalities = reader.read_uint64();
+    for (std::uint64_t i = 0; i < nmunicipalities; ++i)
     {
-      int munip = row["id"].as<int>();
-      auto name = row["name"].as<std::string>();
-      auto lang = row["language"].as<std::string>();
+      const auto id = reader.read_int32();
+      municipalities[id] = reader.read_string();
+    }
+
+    LocationStore locations;
+    const auto nlocations = reader.read_uint64();
+    for (std::uint64_t i = 0; i < nlocations; ++i)
+    {
+      const Spine::GeoId geoid = reader.read_int32();
+      auto name = reader.read_string();
+      auto iso2 = reader.read_string();
+      const int munip = reader.read_int32();
+      auto area = reader.read_string();
+      auto feature = reader.read_string();
+      auto country = reader.read_string();
+      const double lon = reader.read_double();
+      const double lat = reader.read_double();
+      auto tz = reader.read_string();
+      const int pop = reader.read_int32();
+      const float ele = reader.read_float();
+      const float dem = reader.read_float();
+      const auto covertype = Fmi::LandCover::Type(reader.read_int32());
+
+      locations.add(std::make_shared<Spine::Location>(geoid,
+                                                      name,
+                                                      iso2,
+                                                      munip,
+                                                      area,
+                                                      feature,
+                                                      country,
+                                                      lon,
+                                                      lat,
+                                                      tz,
+                                                      pop,
+                                                      ele,
+                                                      dem,
+                                                      covertype));
+    }
+    locations.finalize();
 
-      auto it = itsAlternateMunicipalities.find(munip);
-      if (it == itsAlternateMunicipalities.end())
+    TranslationStore alternate_names;
+    read_translations(reader, alternate_names);
+
+    TranslationStore alternate_municipalities;
+    read_translations(reader, alternate_municipalities);
+
+    KeywordMap keywords;
+    const auto nkeywords = reader.read_uint64();
+    for (std::uint64_t i = 0; i < nkeywords; ++i)
+    {
+      auto &locs = keywords[reader.read_string()];
+      const auto count = reader.read_uint64();
+      for (std::uint64_t j = 0; j < count; ++j)
       {
-        it = itsAlternateMunicipalities.insert(make_pair(munip, Translations())).first;
+        const auto *loc = locations.find(reader.read_int32());
+        if (loc == nullptr)
+          throw Fmi::Exception(BCP, "Snapshot keyword refers to an unknown location");
+        locs.push_back(*loc);
       }
-
-      Fmi::ascii_tolower(lang);
-      it->second.insert(make_pair(lang, name));
     }
 
+    reader.finish();
+
+    itsCountries = std::move(countries);
+    itsAlternateCountries = std::move(alternate_countries);
+    itsMunicipalities = std::move(municipalities);
+    itsLocations = std::move(locations);
+    itsAlternateNames = std::move(alternate_names);
+    itsAlternateMunicipalities = std::move(alternate_municipalities);
+    itsKeywords = std::move(keywords);
+
     if (itsVerbose)
-      std::cout << "read_alternate_municipalities: " << res.size() << " translations" << std::endl;
+      std::cout << "read_snapshot: " << itsLocations.size() << " locations from "
+                << itsSnapshotFile << std::endl;
+
+    LoadProfile::rows(itsLocations.size());
+    return true;
+  }
+  catch (const boost::thread_interrupted &)
+  {
+    throw;
   }
   catch (...)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    // An unusable snapshot is not an error, the data is read from the database instead
+    Fmi::Exception exception(BCP, "Ignoring geonames snapshot", nullptr);
+    exception.addParameter("File", itsSnapshotFile);
+    if (itsVerbose)
+      std::cerr << exception.getStackTrace() << std::endl;
+    else
+      std::cerr << "Warning: " << exception.what() << std::endl;
+    return false;
   }
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Build a map of geoid numbers to location pointers
- *
- * Pointers are not owner, itsLocations variable manages them
+ * \brief Read the database hash value
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::build_geoid_map()
+std::optional<std::size_t> Engine::Impl::read_database_hash_value(
+    Fmi::Database::PostgreSQLConnection &conn)
 {
   try
   {
-    if (itsVerbose)
-      std::cout << "build_geoid_map()" << std::endl;
+    // Select maximum last_modified from tables which have it. Note that
+    // the maximum mya have fractional seconds, hence the rounding to seconds
+
+    std::string query =
+        "SELECT EXTRACT(epoch FROM date_trunc('second',max(val))) AS max "
+        "FROM ("
+        "SELECT max(last_modified) AS val from geonames UNION "
+        "SELECT max(last_modified) AS val from keywords_has_geonames UNION "
+        "SELECT max(last_modified) AS val from alternate_geonames) x";
+
+    pqxx::result res = conn.executeNonTransaction(query);
+
+    if (res.empty())
+    {
+      if (!itsStrict)
+        return std::nullopt;
+      throw Fmi::Exception(BCP, "FmiNames: Failed to read database hash value");
+    }
 
-    for (Spine::LocationPtr &v : itsLocations)
-      itsGeoIdMap.emplace(GeoIdMap::value_type(v->geoid, &v));
+    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+    {
+      auto tmp = row["max"].as<double>();
+      return std::size_t(std::floor(tmp + 0.5));
+    }
   }
   catch (...)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    if (itsStrict)
+      throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    return std::nullopt;
   }
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Assign priorities
+ * \brief Read the countries table
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::assign_priorities(Spine::LocationList &locs) const
+void Engine::Impl::read_countries(Fmi::Database::PostgreSQLConnection &conn)
 {
   try
   {
+    LoadProfile::Scope phase(itsLoadProfile, "read_countries");
+
+    // Note: PCLI overrides smaller political entities if there are multiple
+    // for
+    // the same iso2
+    // country
+    // code
+    std::string query(
+        "SELECT name, countries_iso2 as iso2 FROM geonames WHERE "
+        "features_code in "
+        "('PCLD','PCLF','PCLI') ORDER BY features_code ASC");
+
     if (itsVerbose)
-      std::cout << "assign_priorities" << std::endl;
+      std::cout << "read_countries: " << query << std::endl;
 
-    for (Spine::LocationPtr &v : locs)
+    auto count = read_rows(conn,
+                           "countries_cursor",
+                           query,
+                           [this](const pqxx::result::const_iterator &row)
+                           {
+                             auto name = row["name"].as<std::string>();
+                             auto iso2 = row["iso2"].as<std::string>();
+                             itsCountries[iso2] = name;
+                           });
+
+    if (count == 0)
     {
-      int score = itsLocationPriorities.getPriority(*v);
+      if (itsStrict)
+        throw Fmi::Exception(BCP, "FmiNames: Found no PCLI/PCLF/PCLD places from geonames table");
 
-      auto &myloc = const_cast<Spine::Location &>(*v);  // NOLINT
-      myloc.priority = score;
+      std::cerr << "Warning: FmiNames: Found no PCLI/PCLF/PCLD places from geonames table"
+                << std::endl;
     }
+
+    if (itsVerbose)
+      std::cout << "read_countries: " << count << " countries" << std::endl;
   }
   catch (...)
   {
@@ -1664,59 +2312,63 @@ void Engine::Impl::assign_priorities(Spine::LocationList &locs) const
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Read keywords_has_geonames
+ * \brief Read the alternate countries
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::read_keywords(Fmi::Database::PostgreSQLConnection &conn)
+void Engine::Impl::read_alternate_countries(Fmi::Database::PostgreSQLConnection &conn)
 {
   try
   {
-    std::string query("SELECT keyword, geonames_id as id FROM keywords_has_geonames");
+    LoadProfile::Scope phase(itsLoadProfile, "read_alternate_countries");
+
+    std::string query(
+        "SELECT language, g.name as gname,a.name as "
+        "alt_gname,a.preferred,a.priority,length(a.name) "
+        "as length FROM geonames g, alternate_geonames a WHERE "
+        "g.features_code in "
+        "('PCLI','PCLF','PCLD','TERR') AND g.id=a.geonames_id ORDER BY "
+        "geonames_id, a.priority ASC, "
+        "a.preferred DESC, length ASC, alt_gname ASC");
 
     if (itsVerbose)
-      std::cout << "read_keywords: " << query << std::endl;
+      std::cout << "read_alternate_countries: " << query << std::endl;
 
-    pqxx::result res = conn.executeNonTransaction(query);
+    auto count = read_rows(
+        conn,
+        "alternate_countries_cursor",
+        query,
+        [this](const pqxx::result::const_iterator &row)
+        {
+          auto lang = row["language"].as<std::string>();
+          auto name = row["gname"].as<std::string>();
+          auto translation = row["alt_gname"].as<std::string>();
 
-    if (res.empty())
-    {
-      if (!itsStrict)
-        return;
-      throw Fmi::Exception(BCP, "GeoNames: Found nothing from keywords_has_geonames database");
-    }
+          auto it = itsAlternateCountries.find(name);
+          if (it == itsAlternateCountries.end())
+          {
+            it = itsAlternateCountries.insert(make_pair(name, Translations())).first;
+          }
 
-    int count_ok = 0;
-    int count_bad = 0;
+          Fmi::ascii_tolower(lang);
 
-    bool limited_db = itsConfig.exists("database.where");
+          auto &translations = it->second;
+          // Note: Failure to insert is OK, we prefer the sorted order of the SQL
+          // statements
+          translations.insert(std::make_pair(lang, translation));
+        });
 
-    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+    if (count == 0)
     {
-      auto key = row["keyword"].as<std::string>();
-      Spine::GeoId geoid = Fmi::stoi(row["id"].as<std::string>());
+      if (itsStrict)
+        throw Fmi::Exception(BCP, "Found no country translations");
 
-      auto it = itsGeoIdMap.find(geoid);
-      if (it != itsGeoIdMap.end())
-      {
-        itsKeywords[key].push_back(*it->second);
-        ++count_ok;
-      }
-      else
-      {
-        ++count_bad;
-        if (!limited_db)
-        {
-          std::cerr << "  warning: keyword " << key << " uses nonexistent geoid " << geoid
-                    << std::endl;
-        }
-      }
+      std::cerr << "Warning: Found no country translations" << std::endl;
     }
 
     if (itsVerbose)
-      std::cout << "read_keywords: attached " << count_ok << " keywords to locations succesfully"
-                << std::endl
-                << "read_keywords: found " << count_bad << " unknown locations" << std::endl;
+
+      std::cout << "read_alternate_countries: " << count << " translations" << std::endl;
   }
   catch (...)
   {
@@ -1726,42 +2378,38 @@ void Engine::Impl::read_keywords(Fmi::Database::PostgreSQLConnection &conn)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief build trees for finding nearest points
+ * \brief Read the municipalities table
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::build_geotrees()
+void Engine::Impl::read_municipalities(Fmi::Database::PostgreSQLConnection &conn)
 {
   try
   {
-    for (const auto &name_locs : itsKeywords)
-    {
-      const std::string &keyword = name_locs.first;
-      const Spine::LocationList &locs = name_locs.second;
-
-      if (itsVerbose)
-        std::cout << "build_geotrees:  keyword '" << keyword << "' of size " << locs.size()
-                  << std::endl;
+    LoadProfile::Scope phase(itsLoadProfile, "read_municipalities");
 
-      auto it = itsGeoTrees.find(keyword);
-      if (it == itsGeoTrees.end())
-        it = itsGeoTrees.insert(make_pair(keyword, std::make_unique<GeoTree>())).first;
+    std::string query("SELECT id, name FROM municipalities");
 
-      for (const auto &ptr : locs)
-        it->second->insert(ptr);
-    }
+    if (itsVerbose)
+      std::cout << "read_municipalities: " << query << std::endl;
+
+    // We allow this to be empty since the table contains only Finnish information
+    // if (res.empty()) throw Fmi::Exception(BCP, "FmiNames: Found nothing from municipalities
+    // table");
 
-    // global tree
+    read_rows(conn,
+              "municipalities_cursor",
+              query,
+              [this](const pqxx::result::const_iterator &row)
+              {
+                int id = row["id"].as<int>();
+                auto name = row["name"].as<std::string>();
+                itsMunicipalities[id] = name;
+              });
 
     if (itsVerbose)
-      std::cout << "build_geotrees: keyword '" << FMINAMES_DEFAULT_KEYWORD << "' of size "
-                << itsLocations.size() << std::endl;
-
-    auto it =
-        itsGeoTrees.insert(std::make_pair(FMINAMES_DEFAULT_KEYWORD, std::make_unique<GeoTree>()))
-            .first;
-    for (const auto &ptr : itsLocations)
-      it->second->insert(ptr);
+      std::cout << "read_municipalities: " << itsMunicipalities.size() << " municipalities"
+                << std::endl;
   }
   catch (...)
   {
@@ -1771,62 +2419,101 @@ void Engine::Impl::build_geotrees()
 
 // ----------------------------------------------------------------------
 /*!
- * \brief build ternary trees for finding name suggestions
+ * \brief Read the base geonames table
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::build_ternarytrees()
+Spine::LocationPtr Engine::Impl::extract_geoname(const pqxx::result::const_iterator &row) const
 {
-  try
-  {
-    // normal geonames for each keyword
-
-    for (auto &name_locs : itsKeywords)
-    {
-      const std::string &keyword = name_locs.first;
-      Spine::LocationList &locs = name_locs.second;
+  Spine::GeoId geoid = Fmi::stoi(row["id"].as<std::string>());
+  auto name = row["name"].as<std::string>();
 
-      if (itsVerbose)
-        std::cout << "build_ternarytrees: keyword '" << keyword << "' of size " << locs.size()
-                  << std::endl;
+  auto iso2 = (row["iso2"].is_null() ? "" : row["iso2"].as<std::string>());
+  auto feature = (row["feature"].is_null() ? "" : row["feature"].as<std::string>());
+  auto munip = row["munip"].as<int>();
+  auto lon = row["lon"].as<double>();
+  auto lat = row["lat"].as<double>();
+  auto tz = row["timezone"].as<std::string>();
+  auto pop = (!row["population"].is_null() ? row["population"].as<int>() : 0);
+  auto ele = (!row["elevation"].is_null() ? row["elevation"].as<double>()
+                                          : std::numeric_limits<float>::quiet_NaN());
+  double dem = (!row["dem"].is_null() ? row["dem"].as<int>() : elevation(lon, lat));
+  auto admin = (!row["admin1"].is_null() ? row["admin1"].as<std::string>() : "");
+  auto covertype = Fmi::LandCover::Type(
+      (!row["landcover"].is_null() ? row["landcover"].as<int>() : coverType(lon, lat)));
 
-      auto it = itsTernaryTrees.find(keyword);
-      if (it == itsTernaryTrees.end())
-      {
-        auto newtree = std::make_shared<TernaryTree>();
-        it = itsTernaryTrees.insert(make_pair(keyword, newtree)).first;
-      }
+  std::string area;
+  if (munip != 0)
+  {
+    auto it = itsMunicipalities.find(munip);
+    if (it != itsMunicipalities.end())
+      area = it->second;
+  }
 
-      for (Spine::LocationPtr &ptr : locs)
-      {
-        std::string specifier = ptr->area + "," + Fmi::to_string(ptr->geoid);
-        auto simple_name = preprocess_name(ptr->name);
+  if (area.empty())
+  {
+    auto it = itsCountries.find(iso2);
+    auto us = itsCountries.find("US");
+    if (it != itsCountries.end())
+      area = it->second;
+    if (it == us)
+      area = admin.append(", ").append(area);
+#if 0
+          else
+            std::cerr << "Failed to find country " << key << " for geoid " << geoid << std::endl;
+#endif
+  }
 
-        auto names = to_treewords(simple_name, specifier);
-        for (const auto &name : names)
-          it->second->insert(name, ptr);
-      }
-    }
+  std::string country;  // country will be filled in upon request
+  Spine::LocationPtr loc = std::make_shared<Spine::Location>(geoid,
+                                                             name,
+                                                             iso2,
+                                                             munip,
+                                                             area,
+                                                             feature,
+                                                             country,
+                                                             lon,
+                                                             lat,
+                                                             tz,
+                                                             pop,
+                                                             boost::numeric_cast<float>(ele),
+                                                             boost::numeric_cast<float>(dem),
+                                                             covertype);
 
-    // all geonames
+  return loc;
+}
 
-    if (itsVerbose)
-      std::cout << "build_ternarytrees: keyword '" << FMINAMES_DEFAULT_KEYWORD << "' of size "
-                << itsLocations.size() << std::endl;
+namespace
+{
+const char *geonames_columns =
+    "  id, geonames.name AS name, countries_iso2 as iso2, features_code as feature, \n"
+    "  municipalities_id as munip, lon, lat, timezone, population, elevation, dem, landcover, "
+    "admin1\n";
+}  // namespace
 
-    auto newtree = std::make_shared<TernaryTree>();
-    auto it = itsTernaryTrees.insert(std::make_pair(FMINAMES_DEFAULT_KEYWORD, newtree)).first;
+std::string Engine::Impl::geonames_sql(const std::string &columns,
+                                       const std::string &condition) const
+{
+  try
+  {
+    std::string sql = "SELECT\n" + columns +
+        "FROM\n"
+        "  geonames\n"
+        "INNER JOIN\n"
+        "  keywords_has_geonames\n"
+        "ON\n"
+        "  geonames.id=keywords_has_geonames.geonames_id\n";
 
-    for (Spine::LocationPtr &ptr : itsLocations)
+    if (itsConfig.exists("database.where.geonames"))
     {
-      std::string specifier = ptr->area + "," + Fmi::to_string(ptr->geoid);
-      auto simple_name = preprocess_name(ptr->name);
+      const libconfig::Setting &where_clause = itsConfig.lookup("database.where.geonames");
+      sql.append(" AND ").append(static_cast<const char *>(where_clause));
+    }
 
-      auto names = to_treewords(simple_name, specifier);
+    if (!condition.empty())
+      sql.append(" AND ").append(condition);
 
-      for (const auto &name : names)
-        it->second->insert(name, ptr);
-    }
+    return sql;
   }
   catch (...)
   {
@@ -1834,21 +2521,33 @@ void Engine::Impl::build_ternarytrees()
   }
 }
 
-// ----------------------------------------------------------------------
-/*!
- * \brief build language specific ternary trees for finding name suggestions
- */
-// ----------------------------------------------------------------------
-
-void Engine::Impl::build_lang_ternarytrees()
+std::size_t Engine::Impl::read_geonames_rows(Fmi::Database::PostgreSQLConnection &conn,
+                                             const std::string &sql,
+                                             LocationStore &locations)
 {
   try
   {
     if (itsVerbose)
-      std::cout << "build_lang_ternarytrees" << std::endl;
+      std::cout << "read_geonames: " << sql << std::endl;
 
-    build_lang_ternarytrees_all();
-    build_lang_ternarytrees_keywords();
+    return read_rows(
+        conn,
+        "geonames_cursor",
+        sql,
+        [this, &locations](const pqxx::result::const_iterator &row)
+        {
+          if (row["timezone"].is_null())
+          {
+            std::cerr << "Warning: " << Fmi::stoi(row["id"].as<std::string>()) << " '"
+                      << row["name"].as<std::string>()
+                      << "' timezone is null, discarding the location" << std::endl;
+          }
+          else
+          {
+            auto loc = extract_geoname(row);
+            locations.add(loc);
+          }
+        });
   }
   catch (...)
   {
@@ -1856,82 +2555,24 @@ void Engine::Impl::build_lang_ternarytrees()
   }
 }
 
-// ----------------------------------------------------------------------
-/*!
- * \brief build language specific ternary tree for keyword "all"
- *
- * for each alternate name
- *  for each translation
- *   insert translation into language specific tree
- *
- * inserts are done to keyword specific tables using keyword "all"
- */
-// ----------------------------------------------------------------------
-
-void Engine::Impl::build_lang_ternarytrees_all()
+void Engine::Impl::read_geonames(Fmi::Database::PostgreSQLConnection &conn)
 {
   try
   {
-    // traverse all alternate names
+    LoadProfile::Scope phase(itsLoadProfile, "read_geonames");
 
-    if (itsVerbose)
-      std::cout << "build_lang_ternarytrees_all: " << itsAlternateNames.size() << " names"
-                << std::endl;
+    auto count = read_geonames_rows(conn, geonames_sql(geonames_columns, ""), itsLocations);
 
-    for (const auto &gt : itsAlternateNames)
+    if (count == 0)
     {
-      int geoid = gt.first;
-      const Translations &translations = gt.second;
-
-      // find the original info
-
-      auto git = itsGeoIdMap.find(geoid);
-
-      // safety check - should not happen if all data is present
-
-      if (git == itsGeoIdMap.end())
-        continue;
-
-      const Spine::LocationPtr &loc = *git->second;
-
-      // Now process all translations for the geoid
-
-      for (const auto &tt : translations)
-      {
-        const std::string &lang = tt.first;
-        const std::string &name = tt.second;
-
-        // Find the language specific tree
-
-        auto it = itsLangTernaryTreeMap.find(lang);
-
-        // If there isn't one, create it now
-
-        if (it == itsLangTernaryTreeMap.end())
-          it =
-              itsLangTernaryTreeMap.insert(std::make_pair(lang, std::make_shared<TernaryTreeMap>()))
-                  .first;
-        // Then find keyword specific map, keyword being "all"
-
-        auto &tmap = *it->second;
-        auto tit = tmap.find("all");
-
-        if (tit == tmap.end())
-          tit =
-              tmap.insert(TernaryTreeMap::value_type("all", std::make_shared<TernaryTree>())).first;
-
-        // Insert the word "name, area" to the tree
-
-        auto &tree = *tit->second;
-
-        std::string specifier = loc->area + "," + Fmi::to_string(loc->geoid);
-        auto simple_name = preprocess_name(name);
+      if (itsStrict)
+        throw Fmi::Exception(BCP, "Found nothing from fminames database");
 
-        auto names = to_treewords(simple_name, specifier);
-        for (const auto &treename : names)
-          tree.insert(treename, *git->second);
-      }
+      std::cerr << "Warning: Found nothing from fminames database" << std::endl;
     }
+
+    if (itsVerbose)
+      std::cout << "read_geonames: " << itsLocations.size() << " locations" << std::endl;
   }
   catch (...)
   {
@@ -1941,31 +2582,50 @@ void Engine::Impl::build_lang_ternarytrees_all()
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Build language specific ternary trees for explicit keywords
- *
- * For each keyword
- *  For each geoid for keyword
- *   For each alternate translation
- *    Insert translation into language specific tree
+ * \brief Read the alternate_geonames table
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::build_lang_ternarytrees_keywords()
+std::string Engine::Impl::alternate_geonames_sql(const std::string &condition) const
 {
   try
   {
-    // Traverse all alternate names
-
-    if (itsVerbose)
-      std::cout << "build_lang_ternarytrees_keywords()" << std::endl;
+    std::string sql =
+        "SELECT a.geonames_id, a.name, a.language, a.priority, a.preferred, "
+        "length(a.name) as "
+        "length "
+        "FROM alternate_geonames a INNER JOIN keywords_has_geonames k ON "
+        "a.geonames_id=k.geonames_id";
 
-    for (auto &kloc : itsKeywords)
+    const char *conjunction = " WHERE ";
+    if (itsConfig.exists("database.where.alternate_geonames"))
     {
-      const auto &keyword = kloc.first;
-      const auto &locs = kloc.second;
-
-      build_lang_ternarytrees_one_keyword(keyword, locs);
+      const auto &where_clause = itsConfig.lookup("database.where.alternate_geonames");
+      sql.append(conjunction).append(static_cast<const char *>(where_clause));
+      conjunction = " AND ";
     }
+
+    if (!condition.empty())
+      sql.append(conjunction).append(condition);
+
+    // This makes sure preferred names come first, and longest names last.
+    // Note that this leaves cases like Montreal vs Montr�al, hence we do a final
+    // name sort to guarantee a fixed order. Using ASC prefers non-accented letters.
+
+#if 0
+    // Works only in MySQL
+    sql.append(" GROUP BY a.id HAVING count(*) > 1 ORDER BY a.geonames_id, a.language, a.priority ASC, a.preferred DESC, length ASC, name ASC");
+#else
+    // PostGreSQL requires all the names to be mentioned
+    sql.append(
+        " GROUP BY "
+        "a.id,a.geonames_id,a.name,a.language,a.priority,a.preferred "
+        "HAVING count(*) > 0 "
+        "ORDER BY a.geonames_id, a.language, a.priority ASC, a.preferred DESC, "
+        "length ASC, name ASC");
+#endif
+
+    return sql;
   }
   catch (...)
   {
@@ -1973,99 +2633,84 @@ void Engine::Impl::build_lang_ternarytrees_keywords()
   }
 }
 
-void Engine::Impl::build_lang_ternarytrees_one_keyword(const std::string &keyword,
-                                                       const Spine::LocationList &locs)
+std::size_t Engine::Impl::read_alternate_geonames_rows(Fmi::Database::PostgreSQLConnection &conn,
+                                                       const std::string &sql,
+                                                       const LocationStore &locations,
+                                                       TranslationStore &names)
 {
-  int ntranslations = 0;
-
-  for (const Spine::LocationPtr &loc : locs)
+  try
   {
-    int geoid = loc->geoid;
-
-    auto git = itsGeoIdMap.find(geoid);
-    auto ait = itsAlternateNames.find(geoid);
-
-    // safety check against missing settings
-    if (git == itsGeoIdMap.end() || ait == itsAlternateNames.end())
-      continue;
-
-    // Process all the different language translations
-
-    Spine::LocationPtr &ptr = *git->second;
-
-    for (const auto &tt : ait->second)
-    {
-      const std::string &lang = tt.first;
-      const std::string &translation = tt.second;
-
-      // Find the language specific tree
-
-      auto it = itsLangTernaryTreeMap.find(lang);
-
-      // If there isn't one, create it now
+    if (itsVerbose)
+      std::cout << "read_alternate_geonames: " << sql << std::endl;
 
-      if (it == itsLangTernaryTreeMap.end())
-        it = itsLangTernaryTreeMap.insert(std::make_pair(lang, std::make_shared<TernaryTreeMap>()))
-                 .first;
+    // We assume sort order is geoid,language for the ifs to work
+    Spine::GeoId last_handled_geoid = 0;
+    std::string last_lang;
+    const Spine::LocationPtr *idinfo = nullptr;
 
-      // Then find keyword specific map
+    return read_rows(
+        conn,
+        "alternate_geonames_cursor",
+        sql,
+        [&](const pqxx::result::const_iterator &row)
+        {
+          Spine::GeoId geoid = Fmi::stoi(row["geonames_id"].as<std::string>());
+          auto name = row["name"].as<std::string>();
+          auto lang = row["language"].as<std::string>();
 
-      auto &tmap = *it->second;
-      auto tit = tmap.find(keyword);
+          Fmi::ascii_tolower(lang);
 
-      if (tit == tmap.end())
-        tit =
-            tmap.insert(TernaryTreeMap::value_type(keyword, std::make_shared<TernaryTree>())).first;
+          // Handle only the first translation for each place
+          if (geoid == last_handled_geoid && lang == last_lang)
+            return;
 
-      // Insert the word "name, area" to the tree
+          if (geoid != last_handled_geoid)
+            idinfo = locations.find(geoid);  // update only when geoid changes for speed
 
-      ++ntranslations;
+          last_handled_geoid = geoid;
+          last_lang = lang;
 
-      TernaryTree &tree = *tit->second;
+          // Discard translations which do not change anything to save memory and to avoid
+          // duplicates more easily
 
-      // TODO(mheiskan): translate area
+          if (idinfo != nullptr && (*idinfo)->name == name)
+            return;
 
-      std::string specifier = ptr->area + "," + Fmi::to_string(ptr->geoid);
-      auto simple_name = preprocess_name(translation);
+          // Note that only the first translation found is kept, it is the preferred one
 
-      auto names = to_treewords(simple_name, specifier);
-      for (const auto &name : names)
-        tree.insert(name, loc);
-    }
+          names.add(geoid, lang, name);
+        });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
-
-  if (itsVerbose)
-    std::cout << "build_lang_ternarytrees_keywords: " << keyword << " with " << ntranslations
-              << " translations" << std::endl;
 }
 
-// ----------------------------------------------------------------------
-/*!
- * \brief Translate location name
- */
-// ----------------------------------------------------------------------
-
-void Engine::Impl::translate_name(Spine::Location &loc, const std::string &lang) const
+void Engine::Impl::read_alternate_geonames(Fmi::Database::PostgreSQLConnection &conn)
 {
   try
   {
-    // are there any translations?
+    LoadProfile::Scope phase(itsLoadProfile, "read_alternate_geonames");
 
-    auto trans = itsAlternateNames.find(loc.geoid);
-    if (trans == itsAlternateNames.end())
-      return;
+    auto count = read_alternate_geonames_rows(
+        conn, alternate_geonames_sql(""), itsLocations, itsAlternateNames);
 
-    // is there a translation?
+    if (count == 0)
+    {
+      if (itsStrict)
+        throw Fmi::Exception(BCP, "Found nothing from alternate_geonames database");
 
-    std::string lg = to_language(lang);
+      std::cerr << "Warning: Found nothing from alternate_geonames database" << std::endl;
+    }
 
-    const auto &translations = trans->second;
-    auto pos = translations.find(lg);
+    if (itsVerbose)
+      std::cout << "read_alternate_geonames: " << count << " translations" << std::endl;
 
-    if (pos == translations.end())
-      return;
+    itsAlternateNames.finalize();
 
-    loc.name = pos->second;
+    if (itsVerbose)
+      std::cout << "read_alternate_geonames done" << std::endl;
   }
   catch (...)
   {
@@ -2075,52 +2720,37 @@ void Engine::Impl::translate_name(Spine::Location &loc, const std::string &lang)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Translate location area
+ * \brief Read the modification state of the tables
+ *
+ * The state is read before the data so that modifications made while
+ * the tables are being read are included in the next incremental reload.
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::translate_area(Spine::Location &loc, const std::string &lang) const
+void Engine::Impl::read_table_states(Fmi::Database::PostgreSQLConnection &conn)
 {
   try
   {
-    std::string lg = to_language(lang);
-
-    // are there any municipality translations?
+    LoadProfile::Scope phase(itsLoadProfile, "read_table_states");
 
-    auto trans = itsAlternateMunicipalities.find(loc.municipality);
-    if (trans != itsAlternateMunicipalities.end())
-    {
-      const auto &translations = trans->second;
-      auto pos = translations.find(lg);
+    itsGeonamesModified = read_last_modified(conn, "geonames");
+    itsAlternateGeonamesModified = read_last_modified(conn, "alternate_geonames");
 
-      if (pos != translations.end())
-        loc.area = pos->second;
-    }
+    // A single aggregate over the primary key instead of counts per geoid
+    std::string sql =
+        "SELECT count(*) AS count, coalesce(max(id), 0) AS max FROM alternate_geonames";
 
-    if (!loc.area.empty())
-    {
-      // Try translating country name first, see if it is preceded by a state
-      // designator and a comma
-      auto comma = loc.area.find(", ");
-      auto country = (comma == std::string::npos) ? loc.area : loc.area.substr(comma + 2);
-      auto it = itsAlternateCountries.find(country);
+    if (itsVerbose)
+      std::cout << "read_table_states: " << sql << std::endl;
 
-      if (it != itsAlternateCountries.end())
-      {
-        const auto &translations = it->second;
+    pqxx::result res = conn.executeNonTransaction(sql);
+    if (res.empty())
+      return;
 
-        auto pos = translations.find(lg);
-        if (pos == translations.end())
-          return;
-        loc.area = (comma == std::string::npos) ? pos->second
-                                                : loc.area.substr(0, comma + 2).append(pos->second);
-      }
-    }
+    itsAlternateRows = res[0]["count"].as<std::int64_t>();
+    itsAlternateMaxId = res[0]["max"].as<std::int64_t>();
 
-    // Prevent name==area after translation just like Spine::Location constructor does on
-    // initialization
-    if (loc.name == loc.area)
-      loc.area.clear();
+    itsTableStatesRead = true;
   }
   catch (...)
   {
@@ -2130,41 +2760,65 @@ void Engine::Impl::translate_area(Spine::Location &loc, const std::string &lang)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Translate a location
+ * \brief Read the last modification time of a table
+ *
+ * The time is kept as text to avoid rounding errors in later comparisons.
+ * Returns an empty string if the table has no modification times.
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::translate(Spine::LocationPtr &loc, const std::string &lang) const
+std::string Engine::Impl::read_last_modified(Fmi::Database::PostgreSQLConnection &conn,
+                                             const std::string &table)
 {
   try
   {
-    std::unique_ptr<Spine::Location> newloc(new Spine::Location(*loc));
-
-    translate_name(*newloc, lang);
-    translate_area(*newloc, lang);
+    std::string query = "SELECT max(last_modified)::text AS max FROM " + table;
 
-    newloc->country = translate_country(newloc->iso2, lang);
-
-    loc.reset(newloc.release());
+    pqxx::result res = conn.executeNonTransaction(query);
+    for (pqxx::result::const_iterator row = res.begin(); row != res.end(); ++row)
+    {
+      if (!row["max"].is_null())
+        return row["max"].as<std::string>();
+    }
+    return {};
   }
   catch (...)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Table", table);
   }
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Translate a location list
+ * \brief Test whether the data of the previous instance can be reused
+ *
+ * The countries and municipalities must already have been read, since
+ * the areas of the locations depend on them.
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::translate(Spine::LocationList &locs, const std::string &lang) const
+bool Engine::Impl::can_reload_incrementally(const Impl &previous) const
 {
   try
   {
-    for (Spine::LocationPtr &loc : locs)
-      translate(loc, lang);
+    if (!previous.isSuggestReady() || !previous.itsTableStatesRead)
+      return false;
+
+    if (previous.itsGeonamesModified.empty() || previous.itsAlternateGeonamesModified.empty())
+      return false;
+
+    // Settings affecting the data or the trees
+
+    if (previous.snapshot_fingerprint() != snapshot_fingerprint())
+      return false;
+
+    if (previous.itsRemoveUnderscores != itsRemoveUnderscores ||
+        previous.itsAsciiAutocomplete != itsAsciiAutocomplete ||
+        previous.itsLocale.name() != itsLocale.name())
+      return false;
+
+    return (previous.itsCountries == itsCountries &&
+            previous.itsMunicipalities == itsMunicipalities);
   }
   catch (...)
   {
@@ -2174,35 +2828,58 @@ void Engine::Impl::translate(Spine::LocationList &locs, const std::string &lang)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Translate country name
+ * \brief Read all the tables reusing the unchanged data of the previous instance
+ *
+ * Only the changed locations and the translations of changed locations
+ * are read from the database. The unchanged location objects are shared
+ * with the previous instance. Falls back to a full read if the previous
+ * data is not compatible.
  */
 // ----------------------------------------------------------------------
 
-std::string Engine::Impl::translate_country(const std::string &iso2, const std::string &lang) const
+void Engine::Impl::read_tables_incremental(Fmi::Database::PostgreSQLConnection &conn,
+                                           BuildTaskGroup &builds)
 {
   try
   {
-    std::string lg = to_language(lang);
+    // These are needed in regression tests even in mock mode
+    read_countries(conn);
+    read_alternate_countries(conn);
 
-    // iso2 to official name
+    if (itsAutocompleteDisabled)
+      return;
 
-    auto country = itsCountries.find(iso2);
-    if (country == itsCountries.end())
-      return "";
+    Fmi::AsyncTask::interruption_point();
+    read_municipalities(conn);
 
-    // translation
+    if (!can_reload_incrementally(*itsPrevious))
+    {
+      if (itsVerbose)
+        std::cout << "read_tables_incremental: previous data is not compatible" << std::endl;
+      itsPrevious.reset();
+      read_locations(conn, builds);
+      return;
+    }
 
-    auto pos = itsAlternateCountries.find(country->second);
-    if (pos == itsAlternateCountries.end())
-      return country->second;
+    const Impl &previous = *itsPrevious;
 
-    const auto &translations = pos->second;
+    Fmi::AsyncTask::interruption_point();
+    read_geonames_incremental(conn, previous);
 
-    auto pos2 = translations.find(lg);
-    if (pos2 == translations.end())
-      return country->second;
+    build_location_trees(builds);  // requires read_geonames_incremental
 
-    return pos2->second;
+    Fmi::AsyncTask::interruption_point();
+    read_alternate_geonames_incremental(conn, previous);
+
+    Fmi::AsyncTask::interruption_point();
+    read_alternate_municipalities(conn);
+
+    Fmi::AsyncTask::interruption_point();
+    read_keywords(conn);
+
+    if (itsVerbose)
+      std::cout << "read_tables_incremental: " << itsChangedGeoids.size() << " changed locations"
+                << std::endl;
   }
   catch (...)
   {
@@ -2210,29 +2887,108 @@ std::string Engine::Impl::translate_country(const std::string &iso2, const std::
   }
 }
 
+namespace
+{
+// PostgreSQL array literal of geoids
+template <typename Geoids>
+std::string geoid_array(const Geoids &geoids)
+{
+  std::string ret = "{";
+  for (auto geoid : geoids)
+  {
+    if (ret.size() > 1)
+      ret += ',';
+    ret += Fmi::to_string(geoid);
+  }
+  ret += '}';
+  return ret;
+}
+}  // namespace
+
 // ----------------------------------------------------------------------
 /*!
- * \brief Priority sorter
+ * \brief Read the changed locations and reuse the rest
+ *
+ * The full list of current geoids is read to detect removed locations and
+ * locations which became visible through new keywords.
  */
 // ----------------------------------------------------------------------
 
-bool Engine::Impl::prioritySort(const Spine::LocationPtr &a, const Spine::LocationPtr &b) const
+void Engine::Impl::read_geonames_incremental(Fmi::Database::PostgreSQLConnection &conn,
+                                             const Impl &previous)
 {
   try
   {
-    // First try priority
-    if (a->priority != b->priority)
-      return (a->priority > b->priority);
+    LoadProfile::Scope phase(itsLoadProfile, "read_geonames_incremental");
+
+    LocationStore changes;
+    read_geonames_rows(
+        conn,
+        geonames_sql(geonames_columns,
+                     "geonames.last_modified >= " + conn.quote(previous.itsGeonamesModified)),
+        changes);
+    changes.finalize();
+
+    std::vector<Spine::GeoId> geoids;
+    read_rows(conn,
+              "geonames_ids_cursor",
+              geonames_sql("  DISTINCT id\n", "timezone IS NOT NULL"),
+              [&geoids](const pqxx::result::const_iterator &row)
+              { geoids.push_back(row["id"].as<int>()); });
+    std::sort(geoids.begin(), geoids.end());
+
+    std::vector<Spine::GeoId> missing;
+
+    for (auto geoid : geoids)
+    {
+      if (const auto *loc = changes.find(geoid))
+      {
+        itsLocations.add(*loc);
+        itsChangedGeoids.insert(geoid);
+      }
+      else if (const auto *oldloc = previous.itsLocations.find(geoid))
+      {
+        // The previous object is shared unless its priority changes, the
+        // object may be in use by the previous instance.
+        int score = itsLocationPriorities.getPriority(**oldloc);
+        if (score == (*oldloc)->priority)
+          itsLocations.add(*oldloc);
+        else
+        {
+          auto loc = std::make_shared<Spine::Location>(**oldloc);
+          loc->priority = score;
+          itsLocations.add(loc);
+          itsChangedGeoids.insert(geoid);
+        }
+      }
+      else
+        missing.push_back(geoid);
+    }
 
-    // Last use alphabetical sort.
+    // Old rows which became visible, for example by new keywords
 
-    std::string aname = to_treeword(a->name);
-    std::string bname = to_treeword(b->name);
+    if (!missing.empty())
+    {
+      read_geonames_rows(
+          conn,
+          geonames_sql(geonames_columns,
+                       "geonames.id = ANY(" + conn.quote(geoid_array(missing)) + "::int[])"),
+          itsLocations);
+      itsChangedGeoids.insert(missing.begin(), missing.end());
+    }
 
-    if (aname != bname)
-      return (aname < bname);
+    // Removed locations
 
-    return (a->area < b->area);
+    for (const Spine::LocationPtr &loc : previous.itsLocations.locations())
+      if (!std::binary_search(geoids.begin(), geoids.end(), loc->geoid))
+        itsChangedGeoids.insert(loc->geoid);
+
+    itsLocations.finalize();
+
+    if (itsVerbose)
+      std::cout << "read_geonames_incremental: " << changes.size() << " modified and "
+                << missing.size() << " added locations out of " << itsLocations.size()
+                << std::endl;
   }
   catch (...)
   {
@@ -2242,24 +2998,85 @@ bool Engine::Impl::prioritySort(const Spine::LocationPtr &a, const Spine::Locati
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Trivial sort to find duplicates (doesn't care about localization)
+ * \brief Read the translations of changed locations and reuse the rest
+ *
+ * Translations of a location have to be reread if the location changed
+ * or a translation was modified. Removed translations are detected from
+ * the total number of rows, in which case all translations are reread.
  */
 // ----------------------------------------------------------------------
 
-bool basicSort(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
+void Engine::Impl::read_alternate_geonames_incremental(Fmi::Database::PostgreSQLConnection &conn,
+                                                       const Impl &previous)
 {
   try
   {
-    if (a->name != b->name)
-      return (a->name < b->name);
+    LoadProfile::Scope phase(itsLoadProfile, "read_alternate_geonames_incremental");
 
-    if (a->iso2 != b->iso2)
-      return (a->iso2 < b->iso2);
+    std::set<Spine::GeoId> affected = itsChangedGeoids;
 
-    if (a->area != b->area)
-      return (a->area < b->area);
+    read_rows(conn,
+              "alternate_changes_cursor",
+              "SELECT DISTINCT geonames_id AS id FROM alternate_geonames WHERE last_modified >= " +
+                  conn.quote(previous.itsAlternateGeonamesModified),
+              [&affected](const pqxx::result::const_iterator &row)
+              { affected.insert(row["id"].as<int>()); });
 
-    return (a->priority > b->priority);
+    // Rows have been removed if there are fewer of them than before plus the
+    // added ones. The removed rows cannot be located, hence all the
+    // translations are then read.
+
+    bool removed = !itsTableStatesRead;
+    if (!removed)
+    {
+      pqxx::result res = conn.executeNonTransaction(
+          "SELECT count(*) AS count FROM alternate_geonames WHERE id > " +
+          Fmi::to_string(previous.itsAlternateMaxId));
+      const auto added = (res.empty() ? 0 : res[0]["count"].as<std::int64_t>());
+      removed = (previous.itsAlternateRows + added != itsAlternateRows);
+    }
+
+    // A full read is faster if most of the data has changed
+
+    if (removed || affected.size() > itsLocations.size() / 10)
+    {
+      if (itsVerbose)
+        std::cout << "read_alternate_geonames_incremental: "
+                  << (removed ? "translations have been removed" : "most locations changed")
+                  << ", reading all translations" << std::endl;
+      read_alternate_geonames(conn);
+      itsChangedGeoids.insert(affected.begin(), affected.end());
+      return;
+    }
+
+    const auto &names = previous.itsAlternateNames;
+    for (std::size_t row = 0; row < names.size(); ++row)
+    {
+      const int geoid = names.id(row);
+      if (affected.find(geoid) != affected.end() || itsLocations.find(geoid) == nullptr)
+        continue;
+
+      auto translations = names.translations(row);
+      for (const auto *tt = translations.first; tt != translations.second; ++tt)
+        itsAlternateNames.add(geoid, names.language(*tt), std::string(names.name(*tt)));
+    }
+
+    if (!affected.empty())
+    {
+      read_alternate_geonames_rows(
+          conn,
+          alternate_geonames_sql("a.geonames_id = ANY(" + conn.quote(geoid_array(affected)) +
+                                 "::int[])"),
+          itsLocations,
+          itsAlternateNames);
+    }
+
+    itsAlternateNames.finalize();
+    itsChangedGeoids.insert(affected.begin(), affected.end());
+
+    if (itsVerbose)
+      std::cout << "read_alternate_geonames_incremental: reread translations of "
+                << affected.size() << " locations" << std::endl;
   }
   catch (...)
   {
@@ -2269,16 +3086,98 @@ bool basicSort(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Definition of unique for Spine::LocationPtr*
+ * \brief Reuse the trees of unchanged keywords from the previous instance
+ *
+ * A keyword is unchanged if it refers to the very same location objects
+ * as before and none of their translations changed. Returns the reused
+ * keywords.
  */
 // ----------------------------------------------------------------------
 
-bool closeEnough(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
+namespace
+{
+// True if the lists contain the same location objects in any order
+bool same_locations(const Spine::LocationList &list1, const Spine::LocationList &list2)
+{
+  if (list1.size() != list2.size())
+    return false;
+
+  std::vector<const Spine::Location *> locs1;
+  std::vector<const Spine::Location *> locs2;
+  locs1.reserve(list1.size());
+  locs2.reserve(list2.size());
+  for (const auto &loc : list1)
+    locs1.push_back(loc.get());
+  for (const auto &loc : list2)
+    locs2.push_back(loc.get());
+  std::sort(locs1.begin(), locs1.end());
+  std::sort(locs2.begin(), locs2.end());
+  return (locs1 == locs2);
+}
+}  // namespace
+
+std::set<std::string> Engine::Impl::reuse_keyword_trees()
 {
   try
   {
-    // testing a->geoid == b->geoid would be redundant here
-    return (((a->name == b->name)) && (a->iso2 == b->iso2) && (a->area == b->area));
+    std::set<std::string> reused;
+    if (!itsPrevious)
+      return reused;
+
+    const Impl &previous = *itsPrevious;
+
+    for (const auto &name_locs : itsKeywords)
+    {
+      const std::string &keyword = name_locs.first;
+      if (keyword == FMINAMES_DEFAULT_KEYWORD)
+        continue;
+
+      // The order of the rows read from the database is not fixed
+      auto it = previous.itsKeywords.find(keyword);
+      if (it == previous.itsKeywords.end() || !same_locations(it->second, name_locs.second))
+        continue;
+
+      bool changed = false;
+      for (const auto &loc : name_locs.second)
+      {
+        if (itsChangedGeoids.find(loc->geoid) != itsChangedGeoids.end())
+        {
+          changed = true;
+          break;
+        }
+      }
+      if (changed)
+        continue;
+
+      itsGeoTrees[keyword] = previous.itsGeoTrees.at(keyword);
+
+      // Subsets of the compact index refer to the positions in the rebuilt index
+      if (!itsCompactSuggestIndex)
+      {
+        itsTernaryTrees[keyword] = previous.itsTernaryTrees.at(keyword);
+
+        for (const auto &lang_trees : previous.itsLangTernaryTreeMap)
+        {
+          if (!is_eager_language(lang_trees.first))
+            continue;
+          auto jt = lang_trees.second->find(keyword);
+          if (jt == lang_trees.second->end())
+            continue;
+          auto &tmap = itsLangTernaryTreeMap[lang_trees.first];
+          if (!tmap)
+            tmap = std::make_shared<TernaryTreeMap>();
+          (*tmap)[keyword] = jt->second;
+        }
+      }
+
+      reused.insert(keyword);
+    }
+
+    if (itsVerbose)
+      std::cout << "reuse_keyword_trees: reused trees of " << reused.size() << " keywords"
+                << std::endl;
+
+    return reused;
   }
   catch (...)
   {
@@ -2288,15 +3187,44 @@ bool closeEnough(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Definition of unique for Spine::LocationPtr*
+ * \brief Read the alternate_municipalities table
  */
 // ----------------------------------------------------------------------
 
-bool reallyClose(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
+void Engine::Impl::read_alternate_municipalities(Fmi::Database::PostgreSQLConnection &conn)
 {
   try
   {
-    return (a->geoid == b->geoid);
+    LoadProfile::Scope phase(itsLoadProfile, "read_alternate_municipalities");
+
+    std::string query(
+        "SELECT municipalities_id as id, name, language FROM "
+        "alternate_municipalities");
+
+    if (itsVerbose)
+      std::cout << "read_alternate_municipalities: " << query << std::endl;
+
+    // Permit the table to be empty since it contains only Finnish information
+    // if (res.empty()) throw Fmi::Exception(BCP, "FmiNames: Found nothing from
+    // alternate_municipalities database");
+
+    auto count = read_rows(conn,
+                           "alternate_municipalities_cursor",
+                           query,
+                           [this](const pqxx::result::const_iterator &row)
+                           {
+                             int munip = row["id"].as<int>();
+                             auto name = row["name"].as<std::string>();
+                             auto lang = row["language"].as<std::string>();
+
+                             Fmi::ascii_tolower(lang);
+                             itsAlternateMunicipalities.add(munip, lang, name);
+                           });
+
+    itsAlternateMunicipalities.finalize();
+
+    if (itsVerbose)
+      std::cout << "read_alternate_municipalities: " << count << " translations" << std::endl;
   }
   catch (...)
   {
@@ -2306,21 +3234,24 @@ bool reallyClose(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Priority sort a list of locations
+ * \brief Build the geoid index of the locations
+ *
+ * Sorts the locations by geoid and removes the duplicates generated by
+ * the keyword join in read_geonames.
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::sort(Spine::LocationList &theLocations) const
+void Engine::Impl::build_geoid_map()
 {
   try
   {
-    assign_priorities(theLocations);
-    theLocations.sort(basicSort);
-    theLocations.unique(closeEnough);  // needed because language specific trees create duplicates
+    LoadProfile::Scope phase(itsLoadProfile, "build_geoid_map");
 
-    // Sort based on priorities
-    theLocations.sort([this](const Spine::LocationPtr &a, const Spine::LocationPtr &b)
-                      { return prioritySort(a, b); });
+    if (itsVerbose)
+      std::cout << "build_geoid_map()" << std::endl;
+
+    itsLocations.finalize();
+    LoadProfile::rows(itsLocations.size());
   }
   catch (...)
   {
@@ -2330,145 +3261,282 @@ void Engine::Impl::sort(Spine::LocationList &theLocations) const
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Suggest translations
+ * \brief Assign priorities
  */
 // ----------------------------------------------------------------------
 
-Spine::LocationList Engine::Impl::suggest_one_keyword(const std::string &pattern,
-                                                      const std::string &lang,
-                                                      const std::string &keyword,
-                                                      const TernaryTreePtr &tree) const
+void Engine::Impl::assign_priorities(Spine::LocationList &locs) const
 {
-  Spine::LocationList result;
-
-  std::string name;
-
-  const auto try_pattern =
-      [this, &result, &name, &lang, &keyword, tree](const std::string &pattern) -> void
+  try
   {
-    // find it
-    name = to_treeword(pattern);
-
-    result = tree->findprefix(name);
-
-    // check if there are language specific translations
-
-    std::string lg = to_language(lang);
+    if (itsVerbose)
+      std::cout << "assign_priorities" << std::endl;
 
-    auto lt = itsLangTernaryTreeMap.find(lg);
-    if (lt != itsLangTernaryTreeMap.end())
+    for (Spine::LocationPtr &v : locs)
     {
-      auto tit = lt->second->find(keyword);
-      if (tit != lt->second->end())
-      {
-        std::list<Spine::LocationPtr> tmpx = tit->second->findprefix(name);
-        std::copy(tmpx.begin(), tmpx.end(), std::back_inserter(result));
-      }
-    }
-  };
+      int score = itsLocationPriorities.getPriority(*v);
 
-  if (Fmi::is_utf8(pattern))
+      auto &myloc = const_cast<Spine::Location &>(*v);  // NOLINT
+      myloc.priority = score;
+    }
+  }
+  catch (...)
   {
-    try_pattern(pattern);
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
-  else
+}
+
+void Engine::Impl::assign_priorities(LocationStore::Locations &locs) const
+{
+  try
   {
-    for (const auto &converter : fallback_converters)
+    if (itsVerbose)
+      std::cout << "assign_priorities" << std::endl;
+
+    for (Spine::LocationPtr &v : locs)
     {
-      std::string tmp;
+      int score = itsLocationPriorities.getPriority(*v);
 
-      try
-      {
-        tmp = converter->convert(pattern);
-      }
-      catch (const Fmi::Exception &e)
-      {
-        // Not interested in errors, just try the next converter.
+      // Locations shared with a previous instance already have the correct priority
+      if (v->priority == score)
         continue;
-      }
 
-      try_pattern(tmp);
-
-      if (!result.empty())
-        break;  // done if the encoding produced matches
+      auto &myloc = const_cast<Spine::Location &>(*v);  // NOLINT
+      myloc.priority = score;
     }
-  }
-
-  // Give an extra bonus for exact matches
-  add_exact_match_bonus(result, name, itsNameMatchPriority * priority_scale);
 
-  return result;
+    LoadProfile::rows(locs.size());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
 }
 
-Spine::LocationList Engine::Impl::suggest(
-    const std::string &pattern,
-    const std::function<bool(const Spine::LocationPtr &)> &predicate,
-    const std::string &lang,
-    const std::string &keyword,
-    unsigned int page,
-    unsigned int maxresults,
-    bool duplicates) const
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read keywords_has_geonames
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::read_keywords(Fmi::Database::PostgreSQLConnection &conn)
 {
-  if (!itsSuggestReadyFlag)
-    throw Fmi::Exception(BCP, "Attempt to use geonames suggest before it is ready!");
+  try
+  {
+    LoadProfile::Scope phase(itsLoadProfile, "read_keywords");
+
+    std::string query("SELECT keyword, geonames_id as id FROM keywords_has_geonames");
+
+    if (itsVerbose)
+      std::cout << "read_keywords: " << query << std::endl;
+
+    int count_ok = 0;
+    int count_bad = 0;
+
+    bool limited_db = itsConfig.exists("database.where");
+
+    auto count = read_rows(conn,
+                           "keywords_cursor",
+                           query,
+                           [&](const pqxx::result::const_iterator &row)
+                           {
+                             auto key = row["keyword"].as<std::string>();
+                             Spine::GeoId geoid = Fmi::stoi(row["id"].as<std::string>());
+
+                             const auto *loc = itsLocations.find(geoid);
+                             if (loc != nullptr)
+                             {
+                               itsKeywords[key].push_back(*loc);
+                               ++count_ok;
+                             }
+                             else
+                             {
+                               ++count_bad;
+                               if (!limited_db)
+                               {
+                                 std::cerr << "  warning: keyword " << key
+                                           << " uses nonexistent geoid " << geoid << std::endl;
+                               }
+                             }
+                           });
+
+    if (count == 0)
+    {
+      if (!itsStrict)
+        return;
+      throw Fmi::Exception(BCP, "GeoNames: Found nothing from keywords_has_geonames database");
+    }
 
+    if (itsVerbose)
+      std::cout << "read_keywords: attached " << count_ok << " keywords to locations succesfully"
+                << std::endl
+                << "read_keywords: found " << count_bad << " unknown locations" << std::endl;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start building the trees which need only the locations
+ *
+ * The location trees for keyword "all" and the priorities need only the
+ * locations, hence they can be built while the translations and keywords
+ * are still being read. The map entries are created here so that the
+ * tasks never touch the maps themselves.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::build_location_trees(BuildTaskGroup &builds)
+{
   try
   {
-    Spine::LocationList ret;
+    auto &geotree = itsGeoTrees[FMINAMES_DEFAULT_KEYWORD];
 
-    // return null if any keyword is wrong, this mimics previous behaviour
+    auto &locations = itsLocations.locations();
 
-    std::vector<std::string> keywords;
-    boost::algorithm::split(keywords, keyword, boost::algorithm::is_any_of(","));
+    builds.add("geotree all",
+               phase_task(ReadyPhase::Locations,
+                          [this, &geotree, &locations]()
+                          { build_geotree(geotree, FMINAMES_DEFAULT_KEYWORD, locations); }));
 
-    for (const auto &key : keywords)
-      if (itsTernaryTrees.find(key) == itsTernaryTrees.end())
-        return ret;
+    if (itsCompactSuggestIndex)
+    {
+      builds.add("prefix index all",
+                 phase_task(ReadyPhase::Suggest,
+                            [this, &locations]()
+                            {
+                              itsSuggestIndex.names =
+                                  build_prefix_index(FMINAMES_DEFAULT_KEYWORD, locations);
+                            }));
+    }
+    else
+    {
+      auto &tree = itsTernaryTrees[FMINAMES_DEFAULT_KEYWORD];
+      tree = std::make_shared<TernaryTree>();
+      builds.add("ternarytree all",
+                 phase_task(ReadyPhase::Suggest,
+                            [this, &tree, &locations]()
+                            { build_ternarytree(*tree, FMINAMES_DEFAULT_KEYWORD, locations); }));
+    }
+    builds.add("assign_priorities",
+               phase_task(ReadyPhase::Locations,
+                          [this, &locations]() { assign_priorities(locations); }));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-    // Process all keywords
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build all search trees for suggest and nearest point searches
+ *
+ * The trees are independent per keyword and per language, hence they are
+ * built concurrently. All the map entries are created first so that the
+ * tasks modify only their own trees. A keyword named "all" is skipped since
+ * the trees built for all locations are a superset of it. The nearest point
+ * trees and the suggest tree of all locations are published as readiness
+ * phases of their own as soon as they have been built.
+ */
+// ----------------------------------------------------------------------
 
-    for (const auto &key : keywords)
+void Engine::Impl::build_trees(BuildTaskGroup &builds)
+{
+  try
+  {
+    // The location trees may already be under construction
+    if (itsGeoTrees.find(FMINAMES_DEFAULT_KEYWORD) == itsGeoTrees.end())
+      build_location_trees(builds);
+
+    const auto reused = reuse_keyword_trees();
+
+    auto language_rows = prepare_trees(reused);
+
+    for (const auto &name_locs : itsKeywords)
     {
-      auto it = itsTernaryTrees.find(key);
-      if (it == itsTernaryTrees.end())
+      const std::string &keyword = name_locs.first;
+      const Spine::LocationList &locs = name_locs.second;
+
+      if (keyword == FMINAMES_DEFAULT_KEYWORD || reused.find(keyword) != reused.end())
         continue;
 
-      auto result = suggest_one_keyword(pattern, lang, key, it->second);
+      auto &geotree = itsGeoTrees.at(keyword);
 
-      // Append to result for all keywords (speed optimized for first keyword)
-      if (ret.empty())
-        std::swap(ret, result);
-      else
-        ret.insert(ret.end(), result.begin(), result.end());
+      builds.add("geotree " + keyword,
+                 phase_task(ReadyPhase::Locations,
+                            [this, &geotree, &keyword, &locs]()
+                            { build_geotree(geotree, keyword, locs); }));
+
+      // The compact index needs only keyword subsets once the names have been indexed
+      if (itsCompactSuggestIndex)
+        continue;
+
+      auto &tree = *itsTernaryTrees.at(keyword);
+      builds.add("ternarytree " + keyword,
+                 [this, &tree, &keyword, &locs]() { build_ternarytree(tree, keyword, locs); });
+      builds.add("lang_ternarytrees " + keyword,
+                 [this, &keyword, &locs]() { build_lang_ternarytrees_one_keyword(keyword, locs); });
     }
 
-    filter_features(ret, predicate);
+    for (const auto &lang_rows : language_rows)
+    {
+      const std::string &lang = lang_rows.first;
+      const LanguageRows &rows = lang_rows.second;
+      if (itsCompactSuggestIndex)
+      {
+        auto &index = itsLangSuggestIndexes.at(lang);
+        builds.add("lang prefix index " + lang,
+                   [this, &index, &lang, &rows]()
+                   { index.names = build_lang_prefix_index(lang, rows); });
+      }
+      else
+      {
+        auto &tree = *itsLangTernaryTreeMap.at(lang)->at(FMINAMES_DEFAULT_KEYWORD);
+        builds.add("lang_ternarytree all " + lang,
+                   [this, &tree, &lang, &rows]() { build_lang_ternarytree_all(tree, lang, rows); });
+      }
+    }
 
-    // Translate the names
+    if (itsMemoryStationSearch)
+      builds.add("station indexes",
+                 phase_task(ReadyPhase::Locations, [this]() { build_station_indexes(); }));
 
-    translate(ret, lang);
+    // The structures of the first phases are complete, only their tasks may still be running
+    seal_phase(ReadyPhase::Locations);
+    seal_phase(ReadyPhase::Suggest);
 
-    // Remove duplicates
+    builds.add("collation keys", [this]() { build_collation_keys(); });
 
-    ret.sort(basicSort);
-    if (!duplicates)
-      ret.unique(closeEnough);  // remove duplicate name,area matches
-    else
-      ret.unique(reallyClose);  // remove duplicate geoids
+    builds.wait();
 
-    // Sort based on priorities
+    // The translations copy the locations, hence they must wait for the priorities
 
-    ret.sort([this](const Spine::LocationPtr &a, const Spine::LocationPtr &b)
-             { return prioritySort(a, b); });
+    BuildTaskGroup finals(itsBuildThreads, &itsLoadProfile);
 
-    // Keep the desired part. We do this after moving exact matches to the front,
-    // otherwise for example "Spa, Belgium" is not very high on the list of
-    // matches for "Spa". Translating everything first is expensive, but the
-    // results are cached.
+    for (const auto &lang : itsPretranslatedLanguages)
+    {
+      auto &translations = itsTranslatedLocations[lang];
+      finals.add("translations " + lang,
+                 [this, &lang, &translations]() { build_translations(lang, translations); });
+    }
 
-    keep_wanted_page(ret, maxresults, page);
+    if (itsCompactSuggestIndex)
+    {
+      finals.add("keyword subsets", [this]() { build_keyword_subsets(itsSuggestIndex, ""); });
+      for (auto &lang_index : itsLangSuggestIndexes)
+      {
+        const std::string &lang = lang_index.first;
+        SuggestIndex &index = lang_index.second;
+        finals.add("keyword subsets " + lang,
+                   [this, &index, &lang]() { build_keyword_subsets(index, lang); });
+      }
+    }
 
-    return ret;
+    finals.wait();
   }
   catch (...)
   {
@@ -2478,130 +3546,2985 @@ Spine::LocationList Engine::Impl::suggest(
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Add bonus points for exact suggest matches
+ * \brief Create the map entries for all the trees to be built
+ *
+ * Returns the translations of the loaded locations grouped by language
+ * for building the language specific trees for keyword "all".
  */
 // ----------------------------------------------------------------------
 
-void Engine::Impl::add_exact_match_bonus(Spine::LocationList &locs,
-                                         const std::string &name,
-                                         int bonus) const
+Engine::Impl::LanguageRowMap Engine::Impl::prepare_trees(const std::set<std::string> &reused)
 {
-  for (auto &loc : locs)
+  try
   {
-    std::string tmpname = to_treeword(loc->name);
-    if (tmpname == name)
+    for (const auto &name_locs : itsKeywords)
+    {
+      const std::string &keyword = name_locs.first;
+      if (keyword == FMINAMES_DEFAULT_KEYWORD || reused.find(keyword) != reused.end())
+        continue;
+      itsGeoTrees[keyword];
+      if (!itsCompactSuggestIndex)
+        itsTernaryTrees[keyword] = std::make_shared<TernaryTree>();
+    }
+
+    // Translations of known locations per language for keyword "all"
+
+    LanguageRowMap language_rows;
+
+    for (std::size_t row = 0; row < itsAlternateNames.size(); ++row)
+    {
+      // safety check - should not happen if all data is present
+      if (itsLocations.find(itsAlternateNames.id(row)) == nullptr)
+        continue;
+
+      auto translations = itsAlternateNames.translations(row);
+      for (const auto *tt = translations.first; tt != translations.second; ++tt)
+        language_rows[itsAlternateNames.language(*tt)].emplace_back(row, tt);
+    }
+
+    // The trees of the other languages are built on first use
+
+    for (auto it = language_rows.begin(); it != language_rows.end();)
+    {
+      if (is_eager_language(it->first))
+        ++it;
+      else
+      {
+        itsLazyLanguages[it->first];
+        it = language_rows.erase(it);
+      }
+    }
+
+    if (itsVerbose && itsLazyTrees)
+      std::cout << "prepare_trees: " << language_rows.size() << " eager and "
+                << itsLazyLanguages.size() << " lazy languages" << std::endl;
+
+    if (itsCompactSuggestIndex)
+    {
+      for (const auto &lang_rows : language_rows)
+        itsLangSuggestIndexes[lang_rows.first];
+      return language_rows;
+    }
+
+    for (const auto &lang_rows : language_rows)
+    {
+      auto &tmap = itsLangTernaryTreeMap[lang_rows.first];
+      if (!tmap)
+        tmap = std::make_shared<TernaryTreeMap>();
+      (*tmap)[FMINAMES_DEFAULT_KEYWORD] = std::make_shared<TernaryTree>();
+    }
+
+    // Language specific trees for explicit keywords
+
+    for (const auto &name_locs : itsKeywords)
     {
-      std::unique_ptr<Spine::Location> newloc(new Spine::Location(*loc));
-      newloc->priority += bonus;
-      loc.reset(newloc.release());
+      const std::string &keyword = name_locs.first;
+      if (keyword == FMINAMES_DEFAULT_KEYWORD || reused.find(keyword) != reused.end())
+        continue;
+
+      for (const Spine::LocationPtr &loc : name_locs.second)
+      {
+        auto translations = itsAlternateNames.find(loc->geoid);
+        for (const auto *tt = translations.first; tt != translations.second; ++tt)
+        {
+          const std::string &lang = itsAlternateNames.language(*tt);
+          if (!is_eager_language(lang))
+            continue;
+          auto &tmap = itsLangTernaryTreeMap[lang];
+          if (!tmap)
+            tmap = std::make_shared<TernaryTreeMap>();
+          auto &tree = (*tmap)[keyword];
+          if (!tree)
+            tree = std::make_shared<TernaryTree>();
+        }
+      }
     }
+
+    return language_rows;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Suggest translations for several languages
+ * \brief Build the tree for finding nearest points for a keyword
  */
 // ----------------------------------------------------------------------
 
-std::vector<Spine::LocationList> Engine::Impl::suggest(
-    const std::string &pattern,
-    const std::function<bool(const Spine::LocationPtr &)> &predicate,
-    const std::vector<std::string> &languages,
-    const std::string &keyword,
-    unsigned int page,
-    unsigned int maxresults,
-    bool duplicates) const
+template <typename Locations>
+void Engine::Impl::build_geotree(GeoTreePtr &tree,
+                                 const std::string &keyword,
+                                 const Locations &locs)
 {
   try
   {
-    if (!itsSuggestReadyFlag)
-      throw Fmi::Exception(BCP, "Attempt to use geonames suggest before it is ready!");
-
-    if (languages.empty())
-      throw Fmi::Exception(BCP, "Must provide atleast one language for autocomplete");
+    if (itsVerbose)
+      std::cout << "build_geotree: keyword '" << keyword << "' of size " << locs.size()
+                << std::endl;
 
-    if (languages.size() < 2)
-      throw Fmi::Exception(BCP, "Called autocomplete for N languages with less than 2 languages");
+    tree = std::make_shared<GeoTree>(locs);
+    LoadProfile::rows(locs.size());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Keyword", keyword);
+  }
+}
 
-    // return null if keyword is wrong
+namespace
+{
+// Upper bound of the size of a ternary tree, keys sharing prefixes need fewer
+// nodes. A node holds a character, three children and a value.
+struct TreeSize
+{
+  std::size_t keys = 0;
+  std::size_t chars = 0;
 
-    std::vector<Spine::LocationList> ret;
+  void add(const std::string &key)
+  {
+    ++keys;
+    chars += key.size();
+  }
 
-    auto it = itsTernaryTrees.find(keyword);
-    if (it == itsTernaryTrees.end())
-      return ret;
+  std::size_t bytes() const { return chars * 6 * sizeof(void *); }
+};
 
-    // transform pattern to collated form and find it from the search tree
+bool is_building(const std::future<void> &build)
+{
+  return build.valid() && build.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+}  // namespace
 
-    std::string name = to_treeword(pattern);
-    auto candidates = it->second->findprefix(name);
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the ternary tree for finding name suggestions for a keyword
+ */
+// ----------------------------------------------------------------------
 
-    // check if there are language specific translations
+template <typename Locations>
+void Engine::Impl::build_ternarytree(TernaryTree &tree,
+                                     const std::string &keyword,
+                                     const Locations &locs)
+{
+  try
+  {
+    if (itsVerbose)
+      std::cout << "build_ternarytree: keyword '" << keyword << "' of size " << locs.size()
+                << std::endl;
 
-    for (const auto &lang : languages)
+    TreeSize size;
+    for (const Spine::LocationPtr &ptr : locs)
     {
-      std::string lg = to_language(lang);
+      std::string specifier = ptr->area + "," + Fmi::to_string(ptr->geoid);
+      auto simple_name = preprocess_name(ptr->name);
 
-      auto lt = itsLangTernaryTreeMap.find(lg);
-      if (lt != itsLangTernaryTreeMap.end())
+      auto names = to_treewords(simple_name, specifier);
+      for (const auto &name : names)
       {
-        auto tit = lt->second->find(keyword);
-        if (tit != lt->second->end())
-        {
-          std::list<Spine::LocationPtr> tmpx = tit->second->findprefix(name);
-          std::copy(tmpx.begin(), tmpx.end(), std::back_inserter(candidates));
-        }
+        tree.insert(name, ptr);
+        size.add(name);
       }
     }
 
-    for (auto &loc_list : ret)
-      filter_features(loc_list, predicate);
+    LoadProfile::rows(size.keys);
+    itsLoadProfile.structure("ternarytree " + keyword, size.keys, size.bytes());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Keyword", keyword);
+  }
+}
 
-    // Remove duplicates
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a language specific ternary tree for keyword "all"
+ */
+// ----------------------------------------------------------------------
 
-    candidates.sort(basicSort);
-    if (!duplicates)
-      candidates.unique(closeEnough);  // remove duplicate name,area matches
-    else
-      candidates.unique(reallyClose);  // remove duplicate geoids
+void Engine::Impl::build_lang_ternarytree_all(TernaryTree &tree,
+                                              const std::string &lang,
+                                              const LanguageRows &rows) const
+{
+  try
+  {
+    if (itsVerbose)
+      std::cout << "build_lang_ternarytree_all: language '" << lang << "' with " << rows.size()
+                << " names" << std::endl;
 
-    // Sort based on priorities. Note that the multilanguage version does not
-    // give extra scores to exact matches since the used algorithm sorts before
-    // translating the candidates. This is something that perhaps should be
-    // improved later on.
+    TreeSize size;
+    for (const auto &row_translation : rows)
+    {
+      const auto *git = itsLocations.find(itsAlternateNames.id(row_translation.first));
+      const Spine::LocationPtr &loc = *git;
 
-    candidates.sort([this](const Spine::LocationPtr &a, const Spine::LocationPtr &b)
-                    { return prioritySort(a, b); });
+      const std::string name(itsAlternateNames.name(*row_translation.second));
 
-    // Keep the desired part.
+      // Insert the word "name, area" to the tree
 
-    if (maxresults > 0)
-    {
-      // Erase the pages before the desired one
-      unsigned int first = page * maxresults;
-      auto pos1 = candidates.begin();
-      auto pos2 = pos1;
-      std::advance(pos2, first);
-      candidates.erase(pos1, pos2);
+      std::string specifier = loc->area + "," + Fmi::to_string(loc->geoid);
+      auto simple_name = preprocess_name(name);
 
-      // Erase the remaining elements after the size of 'maxelements'.
-      pos1 = candidates.begin();
-      auto npos2 = std::min(candidates.size(), static_cast<std::size_t>(maxresults));
-      std::advance(pos1, npos2);
-      candidates.erase(pos1, candidates.end());
+      auto names = to_treewords(simple_name, specifier);
+      for (const auto &treename : names)
+      {
+        tree.insert(treename, loc);
+        size.add(treename);
+      }
     }
 
-    // Build translated results
+    // Lazily built trees are not part of the load profile
+    LoadProfile::rows(size.keys);
+    if (is_eager_language(lang))
+      itsLoadProfile.structure("lang_ternarytree all " + lang, size.keys, size.bytes());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Language", lang);
+  }
+}
 
-    for (const auto &lang : languages)
-    {
-      auto tmp = candidates;
-      translate(tmp, lang);
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build language specific ternary trees for an explicit keyword
+ *
+ * For each geoid for keyword
+ *  For each alternate translation
+ *   Insert translation into language specific tree
+ *
+ * By default the trees are those of the eager languages. A lazy language
+ * gives its own trees, which are not part of the load profile.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::build_lang_ternarytrees_one_keyword(const std::string &keyword,
+                                                       const Spine::LocationList &locs,
+                                                       const LangTreeFinder &find_tree) const
+{
+  try
+  {
+    const auto tree_of = [this, &keyword, &find_tree](const std::string &lang) -> TernaryTree *
+    {
+      if (find_tree)
+        return find_tree(lang);
+      if (!is_eager_language(lang))
+        return nullptr;
+      return itsLangTernaryTreeMap.at(lang)->at(keyword).get();
+    };
+
+    int ntranslations = 0;
+    TreeSize size;
+
+    for (const Spine::LocationPtr &loc : locs)
+    {
+      auto translations = itsAlternateNames.find(loc->geoid);
+
+      // Process all the different language translations
+
+      for (const auto *tt = translations.first; tt != translations.second; ++tt)
+      {
+        // The language and keyword specific tree
+
+        TernaryTree *tree = tree_of(itsAlternateNames.language(*tt));
+        if (tree == nullptr)
+          continue;
+
+        const std::string translation(itsAlternateNames.name(*tt));
+
+        // Insert the word "name, area" to the tree
+
+        ++ntranslations;
+
+        // TODO(mheiskan): translate area
+
+        std::string specifier = loc->area + "," + Fmi::to_string(loc->geoid);
+        auto simple_name = preprocess_name(translation);
+
+        auto names = to_treewords(simple_name, specifier);
+        for (const auto &name : names)
+        {
+          tree->insert(name, loc);
+          size.add(name);
+        }
+      }
+    }
+
+    if (find_tree)
+      return;
+
+    LoadProfile::rows(size.keys);
+    itsLoadProfile.structure("lang_ternarytrees " + keyword, size.keys, size.bytes());
+
+    if (itsVerbose)
+      std::cout << "build_lang_ternarytrees_one_keyword: " << keyword << " with " << ntranslations
+                << " translations" << std::endl;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Keyword", keyword);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the compact suggest index for the names of the locations
+ *
+ * The keys are the same as in the ternary trees.
+ */
+// ----------------------------------------------------------------------
+
+template <typename Locations>
+PrefixIndexPtr Engine::Impl::build_prefix_index(const std::string &keyword,
+                                                const Locations &locs) const
+{
+  try
+  {
+    if (itsVerbose)
+      std::cout << "build_prefix_index: keyword '" << keyword << "' of size " << locs.size()
+                << std::endl;
+
+    PrefixIndex::Builder builder;
+    for (const Spine::LocationPtr &ptr : locs)
+    {
+      std::string specifier = ptr->area + "," + Fmi::to_string(ptr->geoid);
+      auto simple_name = preprocess_name(ptr->name);
+
+      auto names = to_treewords(simple_name, specifier);
+      for (const auto &name : names)
+        builder.insert(name, ptr);
+    }
+    auto index = builder.build();
+    LoadProfile::rows(index->size());
+    return index;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Keyword", keyword);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the compact suggest index for the translations of a language
+ */
+// ----------------------------------------------------------------------
+
+PrefixIndexPtr Engine::Impl::build_lang_prefix_index(const std::string &lang,
+                                                     const LanguageRows &rows) const
+{
+  try
+  {
+    if (itsVerbose)
+      std::cout << "build_lang_prefix_index: language '" << lang << "' with " << rows.size()
+                << " names" << std::endl;
+
+    PrefixIndex::Builder builder;
+    for (const auto &row_translation : rows)
+    {
+      const auto *git = itsLocations.find(itsAlternateNames.id(row_translation.first));
+      const Spine::LocationPtr &loc = *git;
+
+      const std::string name(itsAlternateNames.name(*row_translation.second));
+
+      std::string specifier = loc->area + "," + Fmi::to_string(loc->geoid);
+      auto simple_name = preprocess_name(name);
+
+      auto names = to_treewords(simple_name, specifier);
+      for (const auto &treename : names)
+        builder.insert(treename, loc);
+    }
+    auto index = builder.build();
+    LoadProfile::rows(index->size());
+    return index;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Language", lang);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the keyword subsets of a compact suggest index
+ *
+ * The keys of a keyword are the keys of its locations, hence the subset of
+ * a keyword is the same as its ternary tree would be. Language specific
+ * subsets without any translations are omitted just like the trees.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::build_keyword_subsets(SuggestIndex &index, const std::string &lang) const
+{
+  try
+  {
+    std::vector<std::string> keywords;
+    std::vector<const Spine::LocationList *> lists;
+    for (const auto &name_locs : itsKeywords)
+    {
+      if (name_locs.first == FMINAMES_DEFAULT_KEYWORD)
+        continue;
+      keywords.push_back(name_locs.first);
+      lists.push_back(&name_locs.second);
+    }
+
+    auto subsets = index.names->subsets(lists);
+
+    std::size_t entries = 0;
+    for (std::size_t i = 0; i < keywords.size(); i++)
+    {
+      if (!lang.empty() && subsets[i]->empty())
+        continue;
+      entries += subsets[i]->size();
+      index.keywords[keywords[i]] = std::move(subsets[i]);
+    }
+
+    LoadProfile::rows(entries);
+
+    if (itsVerbose)
+      std::cout << "build_keyword_subsets: language '" << (lang.empty() ? "default" : lang)
+                << "' with " << index.keywords.size() << " keywords and " << entries
+                << " entries" << std::endl;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Language", lang);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the trees of a language are built during init
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::is_eager_language(const std::string &lang) const
+{
+  return (!itsLazyTrees || itsEagerLanguages.find(lang) != itsEagerLanguages.end());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the trees or the compact index of a lazy language
+ *
+ * The trees are the same as the eager languages would have, only the
+ * translations of the language are needed for building them.
+ */
+// ----------------------------------------------------------------------
+
+Engine::Impl::LanguageTreesPtr Engine::Impl::build_lazy_language(const std::string &lang) const
+{
+  try
+  {
+    LanguageRows rows;
+    for (std::size_t row = 0; row < itsAlternateNames.size(); ++row)
+    {
+      if (itsLocations.find(itsAlternateNames.id(row)) == nullptr)
+        continue;
+
+      auto translations = itsAlternateNames.translations(row);
+      for (const auto *tt = translations.first; tt != translations.second; ++tt)
+        if (itsAlternateNames.language(*tt) == lang)
+          rows.emplace_back(row, tt);
+    }
+
+    auto ret = std::make_shared<LanguageTrees>();
+
+    if (itsCompactSuggestIndex)
+    {
+      ret->index.names = build_lang_prefix_index(lang, rows);
+      build_keyword_subsets(ret->index, lang);
+      return ret;
+    }
+
+    auto &all = ret->trees[FMINAMES_DEFAULT_KEYWORD];
+    all = std::make_shared<TernaryTree>();
+    build_lang_ternarytree_all(*all, lang, rows);
+
+    for (const auto &name_locs : itsKeywords)
+    {
+      const std::string &keyword = name_locs.first;
+      if (keyword == FMINAMES_DEFAULT_KEYWORD)
+        continue;
+
+      // A keyword gets a tree only if it has translations in the language
+      build_lang_ternarytrees_one_keyword(
+          keyword,
+          name_locs.second,
+          [&ret, &keyword, &lang](const std::string &lg) -> TernaryTree *
+          {
+            if (lg != lang)
+              return nullptr;
+            auto &tree = ret->trees[keyword];
+            if (!tree)
+              tree = std::make_shared<TernaryTree>();
+            return tree.get();
+          });
+    }
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Language", lang);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The trees of a lazy language, or nullptr if not available yet
+ *
+ * The first search of a lazy language starts building its trees in the
+ * background, and the searches are answered from the base trees until
+ * the build has finished. At most lazy_build_threads languages are built
+ * concurrently, further languages are started by later searches.
+ */
+// ----------------------------------------------------------------------
+
+Engine::Impl::LanguageTreesPtr Engine::Impl::lazy_language(const std::string &lang) const
+{
+  try
+  {
+    const auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(itsLazyMutex);
+
+    evict_lazy_languages(now);
+
+    auto it = itsLazyLanguages.find(lang);
+    if (it == itsLazyLanguages.end())
+      return {};
+
+    LazyLanguage &lazy = it->second;
+    lazy.used = now;
+    if (lazy.trees || is_building(lazy.build))
+      return lazy.trees;
+
+    std::size_t building = 0;
+    for (const auto &lang_lazy : itsLazyLanguages)
+      if (is_building(lang_lazy.second.build))
+        ++building;
+    if (building >= std::max(1U, itsLazyBuildThreads))
+      return {};
+
+    if (itsVerbose)
+      std::cout << "lazy_language: building the trees of language '" << lang << "'" << std::endl;
+
+    lazy.build = std::async(std::launch::async,
+                            [this, lang]()
+                            {
+                              LanguageTreesPtr trees;
+                              try
+                              {
+                                trees = build_lazy_language(lang);
+                              }
+                              catch (...)
+                              {
+                                // Retried by the next search of the language
+                                Fmi::Exception exception(
+                                    BCP, "Failed to build autocomplete trees", nullptr);
+                                exception.addParameter("Language", lang);
+                                std::cerr << exception.getStackTrace() << std::endl;
+                              }
+                              std::lock_guard<std::mutex> lock(itsLazyMutex);
+                              itsLazyLanguages.at(lang).trees = std::move(trees);
+                            });
+    return {};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Language", lang);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a language is lazy and its trees are not available
+ *
+ * Suggestions answered from the base trees only are not cached. The
+ * language is marked used so that it is not evicted during the search.
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::is_lazy_pending(const std::string &lang) const
+{
+  try
+  {
+    if (!itsLazyTrees)
+      return false;
+
+    std::lock_guard<std::mutex> lock(itsLazyMutex);
+    auto it = itsLazyLanguages.find(lang);
+    if (it == itsLazyLanguages.end())
+      return false;
+    it->second.used = std::chrono::steady_clock::now();
+    return !it->second.trees;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Release the trees of lazy languages which have not been used lately
+ *
+ * Called with itsLazyMutex locked. Searches still using the trees keep them
+ * alive until they finish.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::evict_lazy_languages(std::chrono::steady_clock::time_point now) const
+{
+  try
+  {
+    if (itsLazyLanguageExpiration == 0 || now < itsNextLazyEviction)
+      return;
+
+    const auto expiration = std::chrono::seconds(itsLazyLanguageExpiration);
+    itsNextLazyEviction = now + std::min<std::chrono::steady_clock::duration>(
+                                    expiration, std::chrono::seconds(60));
+
+    for (auto &lang_lazy : itsLazyLanguages)
+    {
+      LazyLanguage &lazy = lang_lazy.second;
+      if (lazy.trees && now - lazy.used > expiration)
+      {
+        lazy.trees.reset();
+        if (itsVerbose)
+          std::cout << "evict_lazy_languages: released the trees of language '"
+                    << lang_lazy.first << "'" << std::endl;
+      }
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Precompute the collation keys of all names and translations
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::build_collation_keys()
+{
+  try
+  {
+    for (const Spine::LocationPtr &ptr : itsLocations.locations())
+      add_collation_key(ptr->name);
+
+    for (std::size_t row = 0; row < itsAlternateNames.size(); ++row)
+    {
+      auto translations = itsAlternateNames.translations(row);
+      for (const auto *tt = translations.first; tt != translations.second; ++tt)
+        add_collation_key(std::string(itsAlternateNames.name(*tt)));
+    }
+
+    LoadProfile::rows(itsCollationKeys.size());
+
+    if (itsVerbose)
+      std::cout << "build_collation_keys: " << itsCollationKeys.size() << " keys" << std::endl;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Index the loaded locations by their station identifiers
+ *
+ * The identifiers are stored as translations to the pseudo languages
+ * fmisid, lpnn and wmo. The first location found for an identifier wins.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::build_station_indexes()
+{
+  try
+  {
+    for (const auto *type : {"fmisid", "lpnn", "wmo"})
+      itsStationIndexes[type];
+
+    for (std::size_t row = 0; row < itsAlternateNames.size(); ++row)
+    {
+      const auto geoid = itsAlternateNames.id(row);
+      if (itsLocations.find(geoid) == nullptr)
+        continue;
+
+      auto range = itsAlternateNames.translations(row);
+      for (const auto *entry = range.first; entry != range.second; ++entry)
+      {
+        auto it = itsStationIndexes.find(itsAlternateNames.language(*entry));
+        if (it != itsStationIndexes.end())
+          it->second.emplace(std::string(itsAlternateNames.name(*entry)), geoid);
+      }
+    }
+
+    if (itsVerbose)
+      for (const auto &type_index : itsStationIndexes)
+        std::cout << "build_station_indexes: " << type_index.second.size() << " "
+                  << type_index.first << " identifiers" << std::endl;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate the loaded locations into the given language
+ *
+ * Only the locations changed by the translation are stored, the others
+ * are returned as is by translate.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::build_translations(const std::string &lang,
+                                      TranslatedLocations &translations) const
+{
+  try
+  {
+    for (const auto &loc : itsLocations.locations())
+    {
+      if (is_translated(*loc, lang))
+        continue;
+      auto newloc = std::make_shared<Spine::Location>(*loc);
+      translate(*newloc, lang);
+      translations.emplace(loc->geoid, TranslatedLocation{loc.get(), std::move(newloc)});
+    }
+
+    LoadProfile::rows(translations.size());
+
+    if (itsVerbose)
+      std::cout << "build_translations: " << translations.size() << " " << lang
+                << " translations" << std::endl;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Record the approximate sizes of the loaded data structures
+ *
+ * The sizes of the ternary trees are recorded while building them since
+ * the trees cannot report their size. The shared locations are counted
+ * only once in the location store.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::record_structures()
+{
+  try
+  {
+    auto &profile = itsLoadProfile;
+
+    profile.structure("locations", itsLocations.size(), itsLocations.memory());
+    profile.structure("translations", itsAlternateNames.size(), itsAlternateNames.memory());
+
+    std::size_t collation_bytes = 0;
+    for (const auto &name_key : itsCollationKeys)
+      collation_bytes += name_key.first.capacity() + name_key.second.capacity() +
+                         sizeof(name_key) + 2 * sizeof(void *);
+    profile.structure("collation keys", itsCollationKeys.size(), collation_bytes);
+
+    for (const auto &keyword_tree : itsGeoTrees)
+      if (keyword_tree.second)
+        profile.structure("geotree " + keyword_tree.first,
+                          keyword_tree.second->size(),
+                          keyword_tree.second->memory());
+
+    const auto record_index = [&profile](const std::string &name, const SuggestIndex &index)
+    {
+      if (!index.names)
+        return;
+      profile.structure("prefix index " + name, index.names->size(), index.names->memory());
+
+      std::size_t entries = 0;
+      for (const auto &keyword_subset : index.keywords)
+        entries += keyword_subset.second->capacity();
+      profile.structure(
+          "keyword subsets " + name, entries, entries * sizeof(PrefixIndex::Subset::value_type));
+    };
+
+    record_index(FMINAMES_DEFAULT_KEYWORD, itsSuggestIndex);
+    for (const auto &lang_index : itsLangSuggestIndexes)
+      record_index(lang_index.first, lang_index.second);
+
+    for (const auto &lang_translations : itsTranslatedLocations)
+    {
+      std::size_t bytes = 0;
+      for (const auto &geoid_translation : lang_translations.second)
+        bytes += LocationStore::memory(*geoid_translation.second.translation) +
+                 sizeof(geoid_translation) + 2 * sizeof(void *);
+      profile.structure("translated locations " + lang_translations.first,
+                        lang_translations.second.size(),
+                        bytes);
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate location name
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::translate_name(Spine::Location &loc, const std::string &lang) const
+{
+  try
+  {
+    // is there a translation?
+
+    auto translation = itsAlternateNames.find(loc.geoid, to_language(lang));
+    if (!translation)
+      return;
+
+    loc.name = *translation;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate location area
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::translate_area(Spine::Location &loc, const std::string &lang) const
+{
+  try
+  {
+    loc.area = translated_area(loc, loc.name, to_language(lang));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the translated area of a location
+ *
+ * The name is the already translated name of the location, and the
+ * language must already be normalized.
+ */
+// ----------------------------------------------------------------------
+
+std::string Engine::Impl::translated_area(const Spine::Location &loc,
+                                          const std::string &name,
+                                          const std::string &lg) const
+{
+  try
+  {
+    std::string area = loc.area;
+
+    // are there any municipality translations?
+
+    auto translation = itsAlternateMunicipalities.find(loc.municipality, lg);
+    if (translation)
+      area = *translation;
+
+    if (!area.empty())
+    {
+      // Try translating country name first, see if it is preceded by a state
+      // designator and a comma
+      auto comma = area.find(", ");
+      auto country = (comma == std::string::npos) ? area : area.substr(comma + 2);
+      auto it = itsAlternateCountries.find(country);
+
+      if (it != itsAlternateCountries.end())
+      {
+        const auto &translations = it->second;
+
+        auto pos = translations.find(lg);
+        if (pos == translations.end())
+          return area;
+        area = (comma == std::string::npos) ? pos->second
+                                            : area.substr(0, comma + 2).append(pos->second);
+      }
+    }
+
+    // Prevent name==area after translation just like Spine::Location constructor does on
+    // initialization
+    if (name == area)
+      area.clear();
+
+    return area;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate a location
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::translate(Spine::LocationPtr &loc, const std::string &lang) const
+{
+  try
+  {
+    const std::string lg = to_language(lang);
+
+    // Use the translations made during initialization if the location was loaded by us
+
+    if (isSuggestReady())
+    {
+      auto it = itsTranslatedLocations.find(lg);
+      if (it != itsTranslatedLocations.end())
+      {
+        auto pos = it->second.find(loc->geoid);
+        if (pos != it->second.end() && pos->second.original == loc.get())
+        {
+          loc = pos->second.translation;
+          return;
+        }
+      }
+    }
+
+    // Copy only if the translation changes something
+
+    if (is_translated(*loc, lg))
+      return;
+
+    std::unique_ptr<Spine::Location> newloc(new Spine::Location(*loc));
+    translate(*newloc, lg);
+    loc.reset(newloc.release());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate a location in place
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::translate(Spine::Location &loc, const std::string &lang) const
+{
+  try
+  {
+    translate_name(loc, lang);
+    translate_area(loc, lang);
+
+    loc.country = translate_country(loc.iso2, lang);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the location is already translated
+ *
+ * That is, whether translating the location would leave it unchanged.
+ * Equivalent to comparing the location with its translated copy, but the
+ * comparisons are done in place without allocating any memory. The
+ * language must already be normalized.
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::is_translated(const Spine::Location &loc, const std::string &lg) const
+{
+  try
+  {
+    // The name, see translate_name
+
+    std::string_view name = loc.name;
+    auto name_translation = itsAlternateNames.find(loc.geoid, lg);
+    if (name_translation)
+      name = *name_translation;
+    if (name != loc.name)
+      return false;
+
+    // The area as a prefix and a translated suffix, see translated_area
+
+    const auto equals = [](std::string_view str, std::string_view prefix, std::string_view suffix)
+    {
+      return (str.size() == prefix.size() + suffix.size() &&
+              str.compare(0, prefix.size(), prefix) == 0 &&
+              str.compare(prefix.size(), std::string_view::npos, suffix) == 0);
+    };
+
+    std::string_view area = loc.area;
+    auto municipality = itsAlternateMunicipalities.find(loc.municipality, lg);
+    if (municipality)
+      area = *municipality;
+
+    std::string_view prefix = area;
+    std::string_view suffix;
+    bool clear_same_name = true;
+
+    if (!area.empty())
+    {
+      auto comma = area.find(", ");
+      auto country = (comma == std::string_view::npos) ? area : area.substr(comma + 2);
+      auto it = itsAlternateCountries.find(country);
+
+      if (it != itsAlternateCountries.end())
+      {
+        const auto &translations = it->second;
+
+        auto pos = translations.find(lg);
+        if (pos == translations.end())
+          clear_same_name = false;
+        else
+        {
+          prefix = area.substr(0, comma == std::string_view::npos ? 0 : comma + 2);
+          suffix = pos->second;
+        }
+      }
+    }
+
+    if (clear_same_name && equals(name, prefix, suffix))
+    {
+      if (!loc.area.empty())
+        return false;
+    }
+    else if (!equals(loc.area, prefix, suffix))
+      return false;
+
+    // The country, see translate_country
+
+    std::string_view country;
+    auto official = itsCountries.find(loc.iso2);
+    if (official != itsCountries.end())
+    {
+      country = official->second;
+      auto pos = itsAlternateCountries.find(official->second);
+      if (pos != itsAlternateCountries.end())
+      {
+        auto pos2 = pos->second.find(lg);
+        if (pos2 != pos->second.end())
+          country = pos2->second;
+      }
+    }
+
+    return (country == loc.country);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate a location list
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::translate(Spine::LocationList &locs, const std::string &lang) const
+{
+  try
+  {
+    for (Spine::LocationPtr &loc : locs)
+      translate(loc, lang);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate country name
+ */
+// ----------------------------------------------------------------------
+
+std::string Engine::Impl::translate_country(const std::string &iso2, const std::string &lang) const
+{
+  try
+  {
+    std::string lg = to_language(lang);
+
+    // iso2 to official name
+
+    auto country = itsCountries.find(iso2);
+    if (country == itsCountries.end())
+      return "";
+
+    // translation
+
+    auto pos = itsAlternateCountries.find(country->second);
+    if (pos == itsAlternateCountries.end())
+      return country->second;
+
+    const auto &translations = pos->second;
+
+    auto pos2 = translations.find(lg);
+    if (pos2 == translations.end())
+      return country->second;
+
+    return pos2->second;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Priority sorter
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::prioritySort(const Spine::LocationPtr &a, const Spine::LocationPtr &b) const
+{
+  try
+  {
+    // First try priority
+    if (a->priority != b->priority)
+      return (a->priority > b->priority);
+
+    // Last use alphabetical sort.
+
+    const auto *akey = find_collation_key(a->name);
+    const auto *bkey = find_collation_key(b->name);
+
+    std::string aname = (akey ? std::string() : to_treeword(a->name));
+    std::string bname = (bkey ? std::string() : to_treeword(b->name));
+
+    const std::string &acmp = (akey ? *akey : aname);
+    const std::string &bcmp = (bkey ? *bkey : bname);
+
+    if (acmp != bcmp)
+      return (acmp < bcmp);
+
+    return (a->area < b->area);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Priority sort a list of locations
+ *
+ * Equivalent to sorting with prioritySort, but the collation keys are
+ * resolved only once per location instead of once per comparison.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::priority_sort(Spine::LocationList &locs) const
+{
+  try
+  {
+    if (locs.size() < 2)
+      return;
+
+    struct SortItem
+    {
+      const std::string *key;
+      Spine::LocationPtr loc;
+    };
+
+    // Keys for names not found in the precomputed table. A list keeps the addresses stable.
+    std::list<std::string> computed_keys;
+
+    std::vector<SortItem> items;
+    items.reserve(locs.size());
+
+    for (auto &loc : locs)
+    {
+      const auto *key = find_collation_key(loc->name);
+      if (key == nullptr)
+      {
+        computed_keys.push_back(to_treeword(loc->name));
+        key = &computed_keys.back();
+      }
+      items.push_back(SortItem{key, std::move(loc)});
+    }
+
+    std::stable_sort(items.begin(),
+                     items.end(),
+                     [](const SortItem &a, const SortItem &b)
+                     {
+                       if (a.loc->priority != b.loc->priority)
+                         return (a.loc->priority > b.loc->priority);
+                       int cmp = a.key->compare(*b.key);
+                       if (cmp != 0)
+                         return (cmp < 0);
+                       return (a.loc->area < b.loc->area);
+                     });
+
+    auto it = locs.begin();
+    for (auto &item : items)
+      *it++ = std::move(item.loc);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Trivial sort to find duplicates (doesn't care about localization)
+ */
+// ----------------------------------------------------------------------
+
+bool basicSort(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
+{
+  try
+  {
+    if (a->name != b->name)
+      return (a->name < b->name);
+
+    if (a->iso2 != b->iso2)
+      return (a->iso2 < b->iso2);
+
+    if (a->area != b->area)
+      return (a->area < b->area);
+
+    return (a->priority > b->priority);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Definition of unique for Spine::LocationPtr*
+ */
+// ----------------------------------------------------------------------
+
+bool closeEnough(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
+{
+  try
+  {
+    // testing a->geoid == b->geoid would be redundant here
+    return (((a->name == b->name)) && (a->iso2 == b->iso2) && (a->area == b->area));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Definition of unique for Spine::LocationPtr*
+ */
+// ----------------------------------------------------------------------
+
+bool reallyClose(const Spine::LocationPtr &a, const Spine::LocationPtr &b)
+{
+  try
+  {
+    return (a->geoid == b->geoid);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Sort suggest matches to find duplicates, equivalent to basicSort
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::suggest_basic_sort(const SuggestMatch &a, const SuggestMatch &b)
+{
+  if (a.name != b.name)
+    return (a.name < b.name);
+  if (a.location->iso2 != b.location->iso2)
+    return (a.location->iso2 < b.location->iso2);
+  if (a.area != b.area)
+    return (a.area < b.area);
+  if (a.priority != b.priority)
+    return (a.priority > b.priority);
+  return (a.index < b.index);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Suggest matches with identical name, country and area, see closeEnough
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::suggest_close_enough(const SuggestMatch &a, const SuggestMatch &b)
+{
+  return (a.name == b.name && a.location->iso2 == b.location->iso2 && a.area == b.area);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Final order of suggest matches
+ *
+ * Equivalent to stably priority sorting the translated matches after
+ * sorting them with basicSort.
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::suggest_rank_sort(const SuggestMatch &a, const SuggestMatch &b)
+{
+  if (a.priority != b.priority)
+    return (a.priority > b.priority);
+  int cmp = a.collation_key().compare(b.collation_key());
+  if (cmp != 0)
+    return (cmp < 0);
+  if (a.area != b.area)
+    return (a.area < b.area);
+  return suggest_basic_sort(a, b);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Priority sort a list of locations
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::sort(Spine::LocationList &theLocations) const
+{
+  try
+  {
+    assign_priorities(theLocations);
+    theLocations.sort(basicSort);
+    theLocations.unique(closeEnough);  // needed because language specific trees create duplicates
+
+    // Sort based on priorities
+    priority_sort(theLocations);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Throw unless the trees of the keywords have been built
+ *
+ * Until all the data is ready only keyword "all" can be searched.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::check_suggest_ready(const std::vector<std::string> &keywords) const
+{
+  if (!isReady(ReadyPhase::Suggest))
+    throw Fmi::Exception(BCP, "Attempt to use geonames suggest before it is ready!");
+
+  if (isSuggestReady())
+    return;
+
+  for (const auto &keyword : keywords)
+    if (keyword != FMINAMES_DEFAULT_KEYWORD)
+      throw Fmi::Exception(BCP, "Attempt to use geonames suggest keywords before they are ready!")
+          .addParameter("Keyword", keyword);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a keyword can be used in suggest
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::has_suggest_keyword(const std::string &keyword) const
+{
+  if (!itsCompactSuggestIndex)
+    return (itsTernaryTrees.find(keyword) != itsTernaryTrees.end());
+
+  return (keyword == FMINAMES_DEFAULT_KEYWORD ||
+          itsSuggestIndex.keywords.find(keyword) != itsSuggestIndex.keywords.end());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find default names of a keyword starting with the given tree word
+ */
+// ----------------------------------------------------------------------
+
+std::list<Spine::LocationPtr> Engine::Impl::findprefix(const std::string &keyword,
+                                                       const std::string &name) const
+{
+  try
+  {
+    if (itsCompactSuggestIndex)
+    {
+      if (keyword == FMINAMES_DEFAULT_KEYWORD)
+        return itsSuggestIndex.names->findprefix(name);
+
+      auto it = itsSuggestIndex.keywords.find(keyword);
+      if (it == itsSuggestIndex.keywords.end())
+        return {};
+      return itsSuggestIndex.names->findprefix(name, *it->second);
+    }
+
+    auto it = itsTernaryTrees.find(keyword);
+    if (it == itsTernaryTrees.end())
+      return {};
+    return it->second->findprefix(name);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find translations of a keyword starting with the given tree word
+ */
+// ----------------------------------------------------------------------
+
+std::list<Spine::LocationPtr> Engine::Impl::findprefix(const std::string &keyword,
+                                                       const std::string &lg,
+                                                       const std::string &name) const
+{
+  try
+  {
+    // Only the base trees are searched until the language trees have been built
+    if (!isSuggestReady())
+      return {};
+
+    // Keeps the trees of a lazy language alive during the search
+    LanguageTreesPtr lazy;
+
+    if (itsCompactSuggestIndex)
+    {
+      const SuggestIndex *ptr = nullptr;
+      auto lt = itsLangSuggestIndexes.find(lg);
+      if (lt != itsLangSuggestIndexes.end())
+        ptr = &lt->second;
+      else if ((lazy = lazy_language(lg)))
+        ptr = &lazy->index;
+      else
+        return {};
+      const SuggestIndex &index = *ptr;
+
+      if (keyword == FMINAMES_DEFAULT_KEYWORD)
+        return index.names->findprefix(name);
+
+      auto it = index.keywords.find(keyword);
+      if (it == index.keywords.end())
+        return {};
+      return index.names->findprefix(name, *it->second);
+    }
+
+    const TernaryTreeMap *trees = nullptr;
+    auto lt = itsLangTernaryTreeMap.find(lg);
+    if (lt != itsLangTernaryTreeMap.end())
+      trees = lt->second.get();
+    else if ((lazy = lazy_language(lg)))
+      trees = &lazy->trees;
+    else
+      return {};
+
+    auto tit = trees->find(keyword);
+    if (tit == trees->end())
+      return {};
+    return tit->second->findprefix(name);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find names of each keyword from a compact suggest index
+ *
+ * The prefix is searched only once for all the keywords. The names of
+ * each keyword are the same as from a separate search of the keyword.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<std::list<Spine::LocationPtr>> Engine::Impl::findprefix(
+    const SuggestIndex &index,
+    const std::vector<std::string> &keywords,
+    const std::string &name) const
+{
+  try
+  {
+    static const PrefixIndex::Subset unknown_keyword;
+
+    std::vector<const PrefixIndex::Subset *> subsets;
+    for (const auto &keyword : keywords)
+    {
+      if (keyword == FMINAMES_DEFAULT_KEYWORD)
+        subsets.push_back(nullptr);
+      else
+      {
+        auto it = index.keywords.find(keyword);
+        subsets.push_back(it != index.keywords.end() ? it->second.get() : &unknown_keyword);
+      }
+    }
+
+    return index.names->findprefix(name, subsets);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the tree matches of a pattern, trying fallback encodings if needed
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::suggest_pattern(
+    const std::string &pattern,
+    std::string &name,
+    const std::function<Spine::LocationList(const std::string &name)> &find) const
+{
+  Spine::LocationList result;
+
+  const auto try_pattern = [this, &result, &name, &find](const std::string &pattern)
+  {
+    name = to_treeword(pattern);
+    result = find(name);
+  };
+
+  if (Fmi::is_utf8(pattern))
+  {
+    try_pattern(pattern);
+  }
+  else
+  {
+    for (const auto &converter : fallback_converters)
+    {
+      std::string tmp;
+
+      try
+      {
+        tmp = converter->convert(pattern);
+      }
+      catch (const Fmi::Exception &e)
+      {
+        // Not interested in errors, just try the next converter.
+        continue;
+      }
+
+      try_pattern(tmp);
+
+      if (!result.empty())
+        break;  // done if the encoding produced matches
+    }
+  }
+
+  return result;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Suggest translations
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::suggest_one_keyword(const std::string &pattern,
+                                                      const std::string &lang,
+                                                      const std::string &keyword,
+                                                      std::string &name) const
+{
+  return suggest_pattern(pattern,
+                         name,
+                         [this, &lang, &keyword](const std::string &name)
+                         {
+                           Spine::LocationList result = findprefix(keyword, name);
+
+                           // check if there are language specific translations
+
+                           auto tmpx = findprefix(keyword, to_language(lang), name);
+                           std::copy(tmpx.begin(), tmpx.end(), std::back_inserter(result));
+                           return result;
+                         });
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Suggest translations for several keywords from the compact index
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::suggest_keywords(const std::string &pattern,
+                                                   const std::string &lang,
+                                                   const std::vector<std::string> &keywords,
+                                                   std::string &name) const
+{
+  return suggest_pattern(pattern,
+                         name,
+                         [this, &lang, &keywords](const std::string &name)
+                         {
+                           auto names = findprefix(itsSuggestIndex, keywords, name);
+
+                           // Only the base index is searched until the language
+                           // indexes have been built
+                           std::vector<std::list<Spine::LocationPtr>> translations;
+                           LanguageTreesPtr lazy;
+                           if (isSuggestReady())
+                           {
+                             const std::string lg = to_language(lang);
+                             auto lt = itsLangSuggestIndexes.find(lg);
+                             if (lt != itsLangSuggestIndexes.end())
+                               translations = findprefix(lt->second, keywords, name);
+                             else if ((lazy = lazy_language(lg)))
+                               translations = findprefix(lazy->index, keywords, name);
+                           }
+
+                           // Same order as when searching each keyword separately
+                           Spine::LocationList result;
+                           for (std::size_t i = 0; i < names.size(); i++)
+                           {
+                             if (!has_suggest_keyword(keywords[i]))
+                               continue;
+                             result.splice(result.end(), names[i]);
+                             if (!translations.empty())
+                               result.splice(result.end(), translations[i]);
+                           }
+                           return result;
+                         });
+}
+
+Spine::LocationList Engine::Impl::suggest(
+    const std::string &pattern,
+    const std::function<bool(const Spine::LocationPtr &)> &predicate,
+    const std::string &lang,
+    const std::string &keyword,
+    unsigned int page,
+    unsigned int maxresults,
+    bool duplicates) const
+{
+  std::vector<std::string> keywords;
+  boost::algorithm::split(keywords, keyword, boost::algorithm::is_any_of(","));
+
+  check_suggest_ready(keywords);
+
+  try
+  {
+    Spine::LocationList ret;
+
+    // return null if any keyword is wrong, this mimics previous behaviour
+
+    for (const auto &key : keywords)
+      if (!has_suggest_keyword(key))
+        return ret;
+
+    // Patterns in other encodings are rare, they are not cached
+
+    if (!Fmi::is_utf8(pattern) || itsSuggestCache.maxSize() == 0)
+    {
+      std::string name;
+      auto matches = find_suggest_matches(pattern, lang, keywords, name);
+      return suggest_top(
+          std::move(matches), name, lang, predicate, page, maxresults, duplicates);
+    }
+
+    auto result = suggest_candidates(pattern, lang, keyword, keywords);
+
+    // Select the desired page. The candidates are already in priority order, hence
+    // only the predicate and the removal of duplicates have to be applied.
+
+    const std::size_t first = (maxresults > 0 ? std::size_t(page) * maxresults : 0);
+    std::size_t accepted = 0;
+
+    std::unordered_set<std::uint32_t> groups;
+    std::unordered_set<Spine::GeoId> geoids;
+
+    for (const auto &candidate : result->candidates)
+    {
+      if (predicate(candidate.location))
+        continue;
+
+      if (!duplicates)
+      {
+        if (!groups.insert(candidate.group).second)
+          continue;  // remove duplicate name,area matches
+      }
+      else if (!geoids.insert(candidate.location->geoid).second)
+        continue;  // remove duplicate geoids
+
+      if (accepted++ < first)
+        continue;
+
+      ret.push_back(make_suggestion(candidate, lang));
+
+      if (maxresults > 0 && ret.size() >= maxresults)
+        break;
+    }
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the tree matches for a pattern from all the keywords
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::find_suggest_matches(const std::string &pattern,
+                                                       const std::string &lang,
+                                                       const std::vector<std::string> &keywords,
+                                                       std::string &name) const
+{
+  try
+  {
+    // The compact index is searched only once for all the keywords
+    if (itsCompactSuggestIndex && keywords.size() > 1)
+      return suggest_keywords(pattern, lang, keywords, name);
+
+    Spine::LocationList matches;
+    for (const auto &keyword : keywords)
+    {
+      if (!has_suggest_keyword(keyword))
+        continue;
+
+      auto result = suggest_one_keyword(pattern, lang, keyword, name);
+
+      // Append to result for all keywords (speed optimized for first keyword)
+      if (matches.empty())
+        std::swap(matches, result);
+      else
+        matches.insert(matches.end(), result.begin(), result.end());
+    }
+    return matches;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find all the suggest candidates for an UTF-8 pattern
+ *
+ * The candidates are cached per tree word, language and keyword. Pages
+ * and suggestDuplicates are answered from the same cached candidates.
+ */
+// ----------------------------------------------------------------------
+
+Engine::Impl::SuggestResultPtr Engine::Impl::suggest_candidates(
+    const std::string &pattern,
+    const std::string &lang,
+    const std::string &keyword,
+    const std::vector<std::string> &keywords) const
+{
+  try
+  {
+    const std::string lg = to_language(lang);
+    std::string name = to_treeword(pattern);
+
+    std::size_t key = Fmi::hash_value(name);
+    Fmi::hash_combine(key, Fmi::hash_value(lg));
+    Fmi::hash_combine(key, Fmi::hash_value(keyword));
+
+    auto pos = itsSuggestCache.find(key);
+    if (pos && (*pos)->name == name && (*pos)->lang == lg && (*pos)->keyword == keyword)
+    {
+      ++itsSuggestCacheHits;
+      itsMetrics->cacheHit(Metrics::Operation::Suggest);
+      return *pos;
+    }
+    ++itsSuggestCacheMisses;
+    itsMetrics->cacheMiss(Metrics::Operation::Suggest);
+
+    // Without the language trees the matches are incomplete
+    const bool pending = (!isSuggestReady() || is_lazy_pending(lg));
+
+    std::optional<Spine::LocationList> matches;
+    if (itsSuggestPrefixReuse)
+      matches = reuse_suggest_prefix(name, lg, keyword);
+
+    if (!matches)
+      matches = find_suggest_matches(pattern, lang, keywords, name);
+
+    auto result = make_suggest_result(std::move(*matches), name, lg, keyword);
+
+    if (!pending && itsSuggestCache.insert(key, result))
+      ++itsSuggestCacheInserts;
+
+    return result;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Rank tree matches into suggest candidates
+ *
+ * The candidates are sorted as in a full suggest without a predicate.
+ * Duplicate candidates are not removed but grouped instead, so that the
+ * predicate can be applied later. Since the duplicates within a group are
+ * in the same relative order as before, keeping the first accepted
+ * candidate of each group is equivalent to removing duplicates first.
+ * The candidates are translated only when returned.
+ */
+// ----------------------------------------------------------------------
+
+Engine::Impl::SuggestResultPtr Engine::Impl::make_suggest_result(Spine::LocationList matches,
+                                                                 const std::string &name,
+                                                                 const std::string &lang,
+                                                                 const std::string &keyword) const
+{
+  try
+  {
+    auto result = std::make_shared<SuggestResult>();
+    result->name = name;
+    result->lang = lang;
+    result->keyword = keyword;
+
+    if (itsSuggestPrefixReuse)
+      result->matches = matches;
+
+    auto items = make_suggest_matches(matches, name, lang);
+
+    // Group duplicates
+
+    std::sort(items.begin(), items.end(), suggest_basic_sort);
+
+    std::vector<std::uint32_t> groups(items.size(), 0);
+    std::uint32_t group = 0;
+    for (std::size_t i = 1; i < items.size(); ++i)
+    {
+      if (!suggest_close_enough(items[i - 1], items[i]))
+        ++group;
+      groups[items[i].index] = group;
+    }
+
+    // Sort based on priorities
+
+    std::sort(items.begin(), items.end(), suggest_rank_sort);
+
+    auto &candidates = result->candidates;
+    candidates.reserve(items.size());
+    for (auto &item : items)
+      candidates.push_back(
+          SuggestCandidate{std::move(item.location), item.priority, groups[item.index]});
+
+    return result;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Select the desired page of suggestions without caching
+ *
+ * Only the best match of each duplicate group is kept and only the
+ * matches up to the end of the desired page are sorted.
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::suggest_top(
+    Spine::LocationList matches,
+    const std::string &name,
+    const std::string &lang,
+    const std::function<bool(const Spine::LocationPtr &)> &predicate,
+    unsigned int page,
+    unsigned int maxresults,
+    bool duplicates) const
+{
+  try
+  {
+    filter_features(matches, predicate);
+
+    auto items = make_suggest_matches(matches, name, to_language(lang));
+
+    // Keep the best match of each duplicate group
+
+    std::unordered_map<std::string, std::size_t> groups;
+    std::vector<std::size_t> best;
+
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+      const auto &item = items[i];
+      std::string group;
+      if (duplicates)
+        group = Fmi::to_string(item.location->geoid);
+      else
+        group = item.name + '\0' + item.location->iso2 + '\0' + item.area;
+
+      auto pos = groups.find(group);
+      if (pos == groups.end())
+      {
+        groups.emplace(std::move(group), best.size());
+        best.push_back(i);
+      }
+      else if (suggest_rank_sort(item, items[best[pos->second]]))
+        best[pos->second] = i;
+    }
+
+    const auto rank = [&items](std::size_t a, std::size_t b)
+    { return suggest_rank_sort(items[a], items[b]); };
+
+    // Sort only the matches up to the end of the desired page
+
+    std::size_t first = 0;
+    if (maxresults > 0)
+    {
+      first = std::size_t(page) * maxresults;
+      const std::size_t last = first + maxresults;
+      if (first >= best.size())
+        return {};
+      if (last < best.size())
+      {
+        std::nth_element(best.begin(), best.begin() + last, best.end(), rank);
+        best.resize(last);
+      }
+    }
+
+    std::sort(best.begin(), best.end(), rank);
+
+    Spine::LocationList ret;
+    for (std::size_t i = first; i < best.size(); ++i)
+    {
+      const auto &item = items[best[i]];
+      ret.push_back(make_suggestion(SuggestCandidate{item.location, item.priority, 0}, lang));
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collect the translated names and priorities of tree matches
+ *
+ * No locations are copied, only the fields needed for ranking are
+ * translated.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Engine::Impl::SuggestMatch> Engine::Impl::make_suggest_matches(
+    const Spine::LocationList &matches, const std::string &name, const std::string &lang) const
+{
+  try
+  {
+    const int bonus = itsNameMatchPriority * priority_scale;
+
+    std::vector<SuggestMatch> items;
+    items.reserve(matches.size());
+
+    for (const auto &loc : matches)
+    {
+      SuggestMatch item;
+      item.location = loc;
+      item.index = items.size();
+
+      // Give an extra bonus for exact matches, otherwise for example "Spa, Belgium"
+      // would not be very high on the list of matches for "Spa"
+      item.priority = loc->priority;
+      if (is_exact_suggest_match(*loc, name))
+        item.priority += bonus;
+
+      auto translation = itsAlternateNames.find(loc->geoid, lang);
+      item.name = (translation ? std::string(*translation) : loc->name);
+      item.area = translated_area(*loc, item.name, lang);
+
+      item.key = find_collation_key(item.name);
+      if (item.key == nullptr)
+        item.sortkey = to_treeword(item.name);
+
+      items.push_back(std::move(item));
+    }
+    return items;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate a suggest candidate for returning it
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationPtr Engine::Impl::make_suggestion(const SuggestCandidate &candidate,
+                                                 const std::string &lang) const
+{
+  try
+  {
+    Spine::LocationPtr loc = candidate.location;
+    translate(loc, lang);
+
+    if (loc->priority == candidate.priority)
+      return loc;
+
+    std::unique_ptr<Spine::Location> newloc(new Spine::Location(*loc));
+    newloc->priority = candidate.priority;
+    return Spine::LocationPtr(newloc.release());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the tree matches for a name from a cached shorter prefix
+ *
+ * All matches of a name are also matches of its prefixes, hence the
+ * matches can be found by filtering the matches of the longest cached
+ * prefix. Returns nothing if no prefix has been cached.
+ */
+// ----------------------------------------------------------------------
+
+std::optional<Spine::LocationList> Engine::Impl::reuse_suggest_prefix(
+    const std::string &name, const std::string &lang, const std::string &keyword) const
+{
+  try
+  {
+    if (name.size() < 2)
+      return {};
+
+    for (std::size_t n = name.size() - 1; n > 0; --n)
+    {
+      const std::string prefix = name.substr(0, n);
+
+      std::size_t key = Fmi::hash_value(prefix);
+      Fmi::hash_combine(key, Fmi::hash_value(lang));
+      Fmi::hash_combine(key, Fmi::hash_value(keyword));
+
+      auto pos = itsSuggestCache.find(key);
+      if (!pos || (*pos)->name != prefix || (*pos)->lang != lang || (*pos)->keyword != keyword)
+        continue;
+
+      Spine::LocationList matches;
+      for (const auto &loc : (*pos)->matches)
+        if (matches_suggest_prefix(loc, name, lang))
+          matches.push_back(loc);
+
+      ++itsSuggestPrefixReuses;
+      return matches;
+    }
+    return {};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the location would be found from the trees for the name
+ *
+ * The location is found either by its own name from the keyword trees, or
+ * by its translation from the language specific trees.
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::matches_suggest_prefix(const Spine::LocationPtr &loc,
+                                          const std::string &name,
+                                          const std::string &lang) const
+{
+  try
+  {
+    std::string specifier = loc->area + "," + Fmi::to_string(loc->geoid);
+
+    const auto matches = [this, &name, &specifier](const std::string &locname)
+    {
+      for (const auto &word : to_treewords(preprocess_name(locname), specifier))
+        if (boost::algorithm::starts_with(word, name))
+          return true;
+      return false;
+    };
+
+    if (matches(loc->name))
+      return true;
+
+    auto translation = itsAlternateNames.find(loc->geoid, lang);
+    return (translation && matches(std::string(*translation)));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a location name is an exact suggest match
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::is_exact_suggest_match(const Spine::Location &loc,
+                                          const std::string &name) const
+{
+  const auto *key = find_collation_key(loc.name);
+  return (key ? (*key == name) : (to_treeword(loc.name) == name));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Suggest translations for several languages
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationList> Engine::Impl::suggest(
+    const std::string &pattern,
+    const std::function<bool(const Spine::LocationPtr &)> &predicate,
+    const std::vector<std::string> &languages,
+    const std::string &keyword,
+    unsigned int page,
+    unsigned int maxresults,
+    bool duplicates) const
+{
+  try
+  {
+    check_suggest_ready({keyword});
+
+    if (languages.empty())
+      throw Fmi::Exception(BCP, "Must provide atleast one language for autocomplete");
+
+    if (languages.size() < 2)
+      throw Fmi::Exception(BCP, "Called autocomplete for N languages with less than 2 languages");
+
+    // return null if keyword is wrong
+
+    std::vector<Spine::LocationList> ret;
+
+    if (!has_suggest_keyword(keyword))
+      return ret;
+
+    // transform pattern to collated form and find it from the search tree
+
+    std::string name = to_treeword(pattern);
+    auto candidates = findprefix(keyword, name);
+
+    // check if there are language specific translations
+
+    for (const auto &lang : languages)
+    {
+      std::list<Spine::LocationPtr> tmpx = findprefix(keyword, to_language(lang), name);
+      std::copy(tmpx.begin(), tmpx.end(), std::back_inserter(candidates));
+    }
+
+    for (auto &loc_list : ret)
+      filter_features(loc_list, predicate);
+
+    // Remove duplicates
+
+    candidates.sort(basicSort);
+    if (!duplicates)
+      candidates.unique(closeEnough);  // remove duplicate name,area matches
+    else
+      candidates.unique(reallyClose);  // remove duplicate geoids
+
+    // Sort based on priorities. Note that the multilanguage version does not
+    // give extra scores to exact matches since the used algorithm sorts before
+    // translating the candidates. This is something that perhaps should be
+    // improved later on.
+
+    priority_sort(candidates);
+
+    // Keep the desired part.
+
+    if (maxresults > 0)
+    {
+      // Erase the pages before the desired one
+      unsigned int first = page * maxresults;
+      auto pos1 = candidates.begin();
+      auto pos2 = pos1;
+      std::advance(pos2, first);
+      candidates.erase(pos1, pos2);
+
+      // Erase the remaining elements after the size of 'maxelements'.
+      pos1 = candidates.begin();
+      auto npos2 = std::min(candidates.size(), static_cast<std::size_t>(maxresults));
+      std::advance(pos1, npos2);
+      candidates.erase(pos1, candidates.end());
+    }
+
+    // Build translated results
+
+    for (const auto &lang : languages)
+    {
+      auto tmp = candidates;
+      translate(tmp, lang);
       ret.push_back(tmp);
     }
 
-    return ret;
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Convert FmiNames location list to SmartMet location list
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::to_locationlist(const Locus::Query::return_type &theList) const
+{
+  try
+  {
+    std::vector<std::pair<double, double>> lonlats;
+    lonlats.reserve(theList.size());
+    for (const auto &loc : theList)
+      lonlats.emplace_back(loc.lon, loc.lat);
+
+    const auto dems = elevations(lonlats);
+    const auto covertypes = coverTypes(lonlats);
+
+    Spine::LocationList ret;
+    std::size_t i = 0;
+    for (const auto &loc : theList)
+    {
+      double dem = dems[i];
+      auto covertype = covertypes[i];
+      ++i;
+
+      // Select administrative area. In particular, if the location is the
+      // administrative area itself, select the country instead.
+
+      std::string area = loc.admin;
+      if (area == loc.name || area.empty())
+        area = loc.country;
+
+      Spine::Location newloc(loc.id,
+                             loc.name,
+                             loc.iso2,
+                             0,
+                             area,
+                             loc.feature,
+                             loc.country,
+                             loc.lon,
+                             loc.lat,
+                             loc.timezone,
+                             boost::numeric_cast<int>(loc.population),
+                             loc.elevation,
+                             dem,
+                             covertype);
+      newloc.fmisid = loc.fmisid;
+
+      ret.push_back(Spine::LocationPtr(new Spine::Location(newloc)));
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse a WKT geometry expanded by the given radius, or get it from the cache
+ */
+// ----------------------------------------------------------------------
+
+WktShapePtr Engine::Impl::wkt_shape(const std::string &theWkt, double theRadius)
+{
+  try
+  {
+    const auto key = number_key(theRadius) + '|' + theWkt;
+
+    auto pos = itsWktCache.find(key);
+    if (pos)
+      return *pos;
+
+    auto shape = std::make_shared<const WktShape>(theWkt, theRadius);
+    itsWktCache.insert(key, shape);
+    return shape;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return true if searches can be answered from the loaded data
+ */
+// ----------------------------------------------------------------------
+
+bool Engine::Impl::memory_search_ready() const
+{
+  return (isReady(ReadyPhase::Locations) && !itsAutocompleteDisabled);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a search result from a loaded location
+ *
+ * DEM and landcover are set just like to_locationlist does for database
+ * search results, and the FMISID is taken from the translations. Unlike
+ * in database results the area, municipality and priority are those of
+ * the loaded location, and the names are translated by us.
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationPtr Engine::Impl::memory_location(const Spine::LocationPtr &loc,
+                                                 const std::string &lang) const
+{
+  try
+  {
+    auto newloc = std::make_shared<Spine::Location>(*loc);
+
+    newloc->dem = boost::numeric_cast<float>(elevation(loc->longitude, loc->latitude));
+    newloc->covertype = coverType(loc->longitude, loc->latitude);
+
+    auto fmisid = itsAlternateNames.find(loc->geoid, "fmisid");
+    if (fmisid)
+    {
+      try
+      {
+        newloc->fmisid = Fmi::stoi(std::string(*fmisid));
+      }
+      catch (...)
+      {
+        // ignore invalid values just like missing ones
+      }
+    }
+
+    translate(*newloc, lang);
+
+    return newloc;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the nearest loaded locations accepted by the query options
+ *
+ * If the query does not specify any features, the configured default
+ * features are used. If there are none, all features are accepted.
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::memory_lonlat_search(const Locus::QueryOptions &theOptions,
+                                                       float theLongitude,
+                                                       float theLatitude,
+                                                       float theRadius) const
+{
+  try
+  {
+    auto it = itsGeoTrees.find(FMINAMES_DEFAULT_KEYWORD);
+    if (it == itsGeoTrees.end())
+      return {};
+
+    std::set<std::string> features;
+    for (const auto &feature : theOptions.GetFeatures())
+      features.insert(feature);
+    if (features.empty())
+      features.insert(itsMemoryLonLatFeatures.begin(), itsMemoryLonLatFeatures.end());
+
+    const auto predicate = [&features, &theOptions](const Spine::LocationPtr &loc)
+    {
+      return ((features.empty() || features.count(loc->feature) > 0) &&
+              accepts_country(theOptions, loc->iso2));
+    };
+
+    const auto limit = theOptions.GetResultLimit();
+
+    auto matches =
+        (limit > 0 ? it->second->nearest(theLongitude, theLatitude, limit, theRadius, predicate)
+                   : it->second->within(theLongitude, theLatitude, theRadius, predicate));
+
+    Spine::LocationList ret;
+    for (const auto &loc : matches)
+      ret.push_back(memory_location(loc, theOptions.GetLanguage()));
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimate the memory footprint of a cached search result
+ *
+ * The result locations are usually created from the database results and
+ * hence owned by the cache alone.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t Engine::Impl::LocationListSize::getSize(const Spine::LocationList &locs)
+{
+  std::size_t size = sizeof(Spine::LocationList);
+  for (const auto &loc : locs)
+  {
+    size += 3 * sizeof(void *) + sizeof(Spine::Location);  // list node and shared location
+    size += loc->name.capacity() + loc->iso2.capacity() + loc->area.capacity() +
+            loc->feature.capacity() + loc->country.capacity() + loc->timezone.capacity();
+  }
+  return size;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The search cache for the given kind of searches
+ */
+// ----------------------------------------------------------------------
+
+Engine::Impl::NameSearchCache &Engine::Impl::search_cache(QueryLog::Kind kind)
+{
+  switch (kind)
+  {
+    case QueryLog::Kind::LonLat:
+      return itsLonLatSearchCache;
+    case QueryLog::Kind::Id:
+      return itsIdSearchCache;
+    case QueryLog::Kind::Keyword:
+      return itsKeywordSearchCache;
+    case QueryLog::Kind::Name:
+      break;
+  }
+  return itsNameSearchCache;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move a coordinate to the coordinate search cache grid
+ */
+// ----------------------------------------------------------------------
+
+float Engine::Impl::quantize(float coordinate) const
+{
+  if (itsLonLatResolution <= 0)
+    return coordinate;
+  return static_cast<float>(std::round(coordinate / itsLonLatResolution) * itsLonLatResolution);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Answer a name search
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::name_search(const Locus::QueryOptions &theOptions,
+                                              const std::string &theName)
+{
+  if (itsDatabaseDisabled)
+    return {};
+
+  try
+  {
+    auto result = find_name_search(theOptions, theName);
+    if (result)
+      return *result;
+
+    const auto key = QueryLog::name_key(theOptions, theName);
+
+    check_forbidden_name_search(theName, itsForbiddenNamePatterns);
+
+    // Locus priority sort messes up GeoEngine priority sort, so we temporarily
+    // increase the limit to at least 100 names.
+    auto options = theOptions;
+    if (options.GetResultLimit() > 0)
+      options.SetResultLimit(std::max(theOptions.GetResultLimit(), 100U));
+
+    const auto deadline = query_deadline();
+
+    return itsNameSearchFlights.run(
+        key,
+        [&]()
+        {
+          // The result may have been cached while we were waiting for our turn
+          auto pos = itsNameSearchCache.find(key);
+          if (pos)
+            return *pos;
+
+          itsMetrics->cacheMiss(Metrics::Operation::NameSearch);
+          Metrics::Timer timer(
+              *itsMetrics, Metrics::Operation::NameSearch, Metrics::Phase::Database);
+
+          auto lq = reserve_query(Metrics::Operation::NameSearch, deadline);
+          Spine::LocationList ptrs = to_locationlist(lq->FetchByName(options, theName));
+
+          assign_priorities(ptrs);
+          priority_sort(ptrs);
+
+          // And finally keep only the desired number of matches
+          if (theOptions.GetResultLimit() > 0 && ptrs.size() > theOptions.GetResultLimit())
+            ptrs.resize(theOptions.GetResultLimit());
+
+          // Update the cache, even with empty results since searching is slow
+
+          itsNameSearchCache.insert(key, ptrs);
+
+          return ptrs;
+        },
+        deadline);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Coordinate search
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::lonlat_search(const Locus::QueryOptions &theOptions,
+                                                float theLongitude,
+                                                float theLatitude,
+                                                float theRadius)
+{
+  // Let the engine handle setting the timezone, dem and covertype
+  if (itsDatabaseDisabled)
+    return {};
+
+  try
+  {
+    auto result = find_lonlat_search(theOptions, theLongitude, theLatitude, theRadius);
+    if (result)
+      return *result;
+
+    // Search at the grid point so that the result is the same for all coordinates sharing it
+    const float lon = quantize(theLongitude);
+    const float lat = quantize(theLatitude);
+    const auto key = QueryLog::lonlat_key(theOptions, lon, lat, theRadius);
+    const auto deadline = query_deadline();
+
+    return itsNameSearchFlights.run(
+        key,
+        [&]()
+        {
+          auto pos = itsLonLatSearchCache.find(key);
+          if (pos)
+            return *pos;
+
+          itsMetrics->cacheMiss(Metrics::Operation::LonLatSearch);
+          Metrics::Timer timer(
+              *itsMetrics, Metrics::Operation::LonLatSearch, Metrics::Phase::Database);
+
+          auto lq = reserve_query(Metrics::Operation::LonLatSearch, deadline);
+
+          Spine::LocationList ptrs =
+              to_locationlist(lq->FetchByLonLat(theOptions, lon, lat, theRadius));
+
+          // Do not cache empty results
+          if (ptrs.empty())
+            return ptrs;
+
+          // Update the cache
+          itsLonLatSearchCache.insert(key, ptrs);
+          return ptrs;
+        },
+        deadline);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do a id search
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::id_search(const Locus::QueryOptions &theOptions, int theId)
+{
+  if (itsDatabaseDisabled)
+    return {};
+
+  try
+  {
+    auto result = find_id_search(theOptions, theId);
+    if (result)
+      return *result;
+
+    const auto key = QueryLog::id_key(theOptions, theId);
+    const auto deadline = query_deadline();
+
+    return itsNameSearchFlights.run(
+        key,
+        [&]()
+        {
+          auto pos = itsIdSearchCache.find(key);
+          if (pos)
+            return *pos;
+
+          itsMetrics->cacheMiss(Metrics::Operation::IdSearch);
+          Metrics::Timer timer(*itsMetrics, Metrics::Operation::IdSearch, Metrics::Phase::Database);
+
+          auto lq = reserve_query(Metrics::Operation::IdSearch, deadline, true);
+
+          Spine::LocationList ptrs = to_locationlist(lq->FetchById(theOptions, theId));
+
+          // Do not cache empty results
+          if (ptrs.empty())
+            return ptrs;
+
+          // Update the cache
+
+          itsIdSearchCache.insert(key, ptrs);
+
+          return ptrs;
+        },
+        deadline);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a cached name search result
+ */
+// ----------------------------------------------------------------------
+
+std::optional<Spine::LocationList> Engine::Impl::find_name_search(
+    const Locus::QueryOptions &theOptions, const std::string &theName)
+{
+  try
+  {
+    // Station identifiers can be found from the loaded data
+
+    if (itsMemoryStationSearch && memory_search_ready())
+    {
+      const auto start = Metrics::Clock::now();
+      auto result = find_station_search(theOptions, theName);
+      if (result)
+      {
+        itsMetrics->record(Metrics::Operation::NameSearch, Metrics::Phase::Memory, start);
+        return result;
+      }
+    }
+
+    const auto key = QueryLog::name_key(theOptions, theName);
+
+    if (!itsQueryLog.touch(key))
+      itsQueryLog.insert(key, {QueryLog::Kind::Name, theOptions, theName});
+
+    auto pos = itsNameSearchCache.find(key);
+    if (pos)
+    {
+      itsMetrics->cacheHit(Metrics::Operation::NameSearch);
+      return *pos;
+    }
+    return {};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a station by its identifier from the loaded data
+ *
+ * Returns nothing if the name type of the search is not a station
+ * identifier type, or if the station is not loaded or not accepted by the
+ * search options. The database must then be searched instead.
+ */
+// ----------------------------------------------------------------------
+
+std::optional<Spine::LocationList> Engine::Impl::find_station_search(
+    const Locus::QueryOptions &theOptions, const std::string &theName) const
+{
+  try
+  {
+    auto it = itsStationIndexes.find(theOptions.GetNameType());
+    if (it == itsStationIndexes.end())
+      return {};
+
+    auto pos = it->second.find(theName);
+    if (pos == it->second.end())
+      return {};
+
+    const auto *loc = itsLocations.find(pos->second);
+    if (loc == nullptr || !accepts_country(theOptions, (*loc)->iso2) ||
+        !accepts_feature(theOptions, (*loc)->feature))
+      return {};
+
+    return Spine::LocationList{memory_location(*loc, theOptions.GetLanguage())};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a coordinate search result from the loaded data or the cache
+ */
+// ----------------------------------------------------------------------
+
+std::optional<Spine::LocationList> Engine::Impl::find_lonlat_search(
+    const Locus::QueryOptions &theOptions, float theLongitude, float theLatitude, float theRadius)
+{
+  try
+  {
+    // Nearest place searches can be answered from the loaded data
+
+    if (itsMemoryLonLatSearch && memory_search_ready() && theRadius > 0)
+    {
+      Metrics::Timer timer(*itsMetrics, Metrics::Operation::LonLatSearch, Metrics::Phase::Memory);
+      return memory_lonlat_search(theOptions, theLongitude, theLatitude, theRadius);
+    }
+
+    const float lon = quantize(theLongitude);
+    const float lat = quantize(theLatitude);
+    const auto key = QueryLog::lonlat_key(theOptions, lon, lat, theRadius);
+
+    if (!itsQueryLog.touch(key))
+      itsQueryLog.insert(key, {QueryLog::Kind::LonLat, theOptions, "", lon, lat, theRadius});
+
+    auto pos = itsLonLatSearchCache.find(key);
+    if (pos)
+    {
+      itsMetrics->cacheHit(Metrics::Operation::LonLatSearch);
+      return *pos;
+    }
+    return {};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find an id search result from the loaded data or the cache
+ */
+// ----------------------------------------------------------------------
+
+std::optional<Spine::LocationList> Engine::Impl::find_id_search(
+    const Locus::QueryOptions &theOptions, int theId)
+{
+  try
+  {
+    // Use the loaded data if possible. Otherwise for example feature or country
+    // restrictions may require searching the database.
+
+    if (itsMemoryIdSearch && memory_search_ready())
+    {
+      const auto start = Metrics::Clock::now();
+      const auto *loc = itsLocations.find(theId);
+      if (loc != nullptr && accepts_country(theOptions, (*loc)->iso2) &&
+          accepts_feature(theOptions, (*loc)->feature))
+      {
+        Spine::LocationList ret{memory_location(*loc, theOptions.GetLanguage())};
+        itsMetrics->record(Metrics::Operation::IdSearch, Metrics::Phase::Memory, start);
+        return ret;
+      }
+    }
+
+    const auto key = QueryLog::id_key(theOptions, theId);
+
+    if (!itsQueryLog.touch(key))
+      itsQueryLog.insert(key, {QueryLog::Kind::Id, theOptions, "", 0, 0, 0, theId});
+
+    auto pos = itsIdSearchCache.find(key);
+    if (pos)
+    {
+      itsMetrics->cacheHit(Metrics::Operation::IdSearch);
+      return *pos;
+    }
+    return {};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Batched name search
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationList> Engine::Impl::name_search(
+    const Locus::QueryOptions &theOptions, const std::vector<std::string> &theNames)
+{
+  if (itsDatabaseDisabled)
+    return std::vector<Spine::LocationList>(theNames.size());
+
+  try
+  {
+    return batch_search(
+        theNames,
+        itsBatchThreads,
+        [this, &theOptions](const std::string &name) { return find_name_search(theOptions, name); },
+        [this, &theOptions](const std::string &name) { return name_search(theOptions, name); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Batched coordinate search
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationList> Engine::Impl::lonlat_search(
+    const Locus::QueryOptions &theOptions,
+    const std::vector<std::pair<float, float>> &theCoordinates,
+    float theRadius)
+{
+  if (itsDatabaseDisabled)
+    return std::vector<Spine::LocationList>(theCoordinates.size());
+
+  try
+  {
+    return batch_search(
+        theCoordinates,
+        itsBatchThreads,
+        [this, &theOptions, theRadius](const std::pair<float, float> &lonlat)
+        { return find_lonlat_search(theOptions, lonlat.first, lonlat.second, theRadius); },
+        [this, &theOptions, theRadius](const std::pair<float, float> &lonlat)
+        { return lonlat_search(theOptions, lonlat.first, lonlat.second, theRadius); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Batched id search
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Spine::LocationList> Engine::Impl::id_search(const Locus::QueryOptions &theOptions,
+                                                         const std::vector<int> &theIds)
+{
+  if (itsDatabaseDisabled)
+    return std::vector<Spine::LocationList>(theIds.size());
+
+  try
+  {
+    return batch_search(
+        theIds,
+        itsBatchThreads,
+        [this, &theOptions](int id) { return find_id_search(theOptions, id); },
+        [this, &theOptions](int id) { return id_search(theOptions, id); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do a keyword search
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList Engine::Impl::keyword_search(const Locus::QueryOptions &theOptions,
+                                                 const std::string &theKeyword)
+{
+  if (itsDatabaseDisabled)
+    return {};
+
+  try
+  {
+    const auto key = QueryLog::keyword_key(theOptions, theKeyword);
+
+    if (!itsQueryLog.touch(key))
+      itsQueryLog.insert(key, {QueryLog::Kind::Keyword, theOptions, theKeyword});
+
+    auto pos = itsKeywordSearchCache.find(key);
+    if (pos)
+    {
+      itsMetrics->cacheHit(Metrics::Operation::KeywordSearch);
+      return *pos;
+    }
+
+    const auto deadline = query_deadline();
+
+    return itsNameSearchFlights.run(
+        key,
+        [&]()
+        {
+          pos = itsKeywordSearchCache.find(key);
+          if (pos)
+            return *pos;
+
+          itsMetrics->cacheMiss(Metrics::Operation::KeywordSearch);
+          Metrics::Timer timer(
+              *itsMetrics, Metrics::Operation::KeywordSearch, Metrics::Phase::Database);
+
+          auto lq = reserve_query(Metrics::Operation::KeywordSearch, deadline, true);
+
+          Spine::LocationList ptrs = to_locationlist(lq->FetchByKeyword(theOptions, theKeyword));
+
+          // Do not cache empty results
+          if (ptrs.empty())
+            return ptrs;
+
+          // Update the cache
+          itsKeywordSearchCache.insert(key, ptrs);
+
+          return ptrs;
+        },
+        deadline);
   }
   catch (...)
   {
@@ -2611,46 +6534,44 @@ std::vector<Spine::LocationList> Engine::Impl::suggest(
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Convert FmiNames location list to SmartMet location list
+ * \brief Warm up the name search cache with the hottest queries of the previous instance
+ *
+ * If the database has not changed the cached results are still valid and
+ * are copied as such. Otherwise the queries are run against the new data.
  */
 // ----------------------------------------------------------------------
 
-Spine::LocationList Engine::Impl::to_locationlist(const Locus::Query::return_type &theList) const
+void Engine::Impl::warmup(const std::shared_ptr<Impl> &previous)
 {
   try
   {
-    Spine::LocationList ret;
-    for (const auto &loc : theList)
-    {
-      double dem = elevation(loc.lon, loc.lat);
-      auto covertype = coverType(loc.lon, loc.lat);
+    if (!previous || itsDatabaseDisabled)
+      return;
 
-      // Select administrative area. In particular, if the location is the
-      // administrative area itself, select the country instead.
+    auto entries = previous->itsQueryLog.hottest(itsQueryLog.maxSize());
+    if (entries.empty())
+      return;
 
-      std::string area = loc.admin;
-      if (area == loc.name || area.empty())
-        area = loc.country;
+    if (itsHashValue != 0 && itsHashValue == previous->itsHashValue)
+    {
+      // Least recently used first to preserve the order of the log
+      for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+      {
+        auto &cache = search_cache(it->second.kind);
+        auto pos = previous->search_cache(it->second.kind).find(it->first);
+        if (pos)
+          cache.insert(it->first, *pos);
+        itsQueryLog.insert(it->first, std::move(it->second));
+      }
+      return;
+    }
 
-      Spine::Location newloc(loc.id,
-                             loc.name,
-                             loc.iso2,
-                             0,
-                             area,
-                             loc.feature,
-                             loc.country,
-                             loc.lon,
-                             loc.lat,
-                             loc.timezone,
-                             boost::numeric_cast<int>(loc.population),
-                             loc.elevation,
-                             dem,
-                             covertype);
-      newloc.fmisid = loc.fmisid;
+    std::vector<QueryLog::Query> queries;
+    queries.reserve(entries.size());
+    for (auto &entry : entries)
+      queries.push_back(std::move(entry.second));
 
-      ret.push_back(Spine::LocationPtr(new Spine::Location(newloc)));
-    }
-    return ret;
+    warmup(queries);
   }
   catch (...)
   {
@@ -2660,49 +6581,56 @@ Spine::LocationList Engine::Impl::to_locationlist(const Locus::Query::return_typ
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Answer a name search
+ * \brief Run the given queries to fill the name search cache
+ *
+ * Individual failures are only reported, the cache is merely left colder.
  */
 // ----------------------------------------------------------------------
 
-Spine::LocationList Engine::Impl::name_search(const Locus::QueryOptions &theOptions,
-                                              const std::string &theName)
+void Engine::Impl::warmup(const std::vector<QueryLog::Query> &queries)
 {
-  if (itsDatabaseDisabled)
-    return {};
-
   try
   {
-    std::size_t key = Fmi::hash_value(theName);
-    Fmi::hash_combine(key, theOptions.HashValue());
-
-    auto pos = itsNameSearchCache.find(key);
-    if (pos)
-      return *pos;
-
-    check_forbidden_name_search(theName, itsForbiddenNamePatterns);
-
-    // Locus priority sort messes up GeoEngine priority sort, so we temporarily
-    // increase the limit to at least 100 names.
-    auto options = theOptions;
-    if (options.GetResultLimit() > 0)
-      options.SetResultLimit(std::max(theOptions.GetResultLimit(), 100U));
-
-    std::shared_ptr<Locus::Query> lq = query_worker_pool->reserve();
-    Spine::LocationList ptrs = to_locationlist(lq->FetchByName(options, theName));
-
-    assign_priorities(ptrs);
-    ptrs.sort([this](const Spine::LocationPtr &a, const Spine::LocationPtr &b)
-              { return prioritySort(a, b); });
+    if (queries.empty())
+      return;
 
-    // And finally keep only the desired number of matches
-    if (theOptions.GetResultLimit() > 0 && ptrs.size() > theOptions.GetResultLimit())
-      ptrs.resize(theOptions.GetResultLimit());
+    BuildTaskGroup group(std::min<std::size_t>(itsBatchThreads, queries.size()));
 
-    // Update the cache, even with empty results since searching is slow
+    for (const auto &query : queries)
+    {
+      group.add("warmup",
+                [this, &query]()
+                {
+                  switch (query.kind)
+                  {
+                    case QueryLog::Kind::Name:
+                      name_search(query.options, query.name);
+                      break;
+                    case QueryLog::Kind::LonLat:
+                      lonlat_search(query.options, query.longitude, query.latitude, query.radius);
+                      break;
+                    case QueryLog::Kind::Id:
+                      id_search(query.options, query.id);
+                      break;
+                    case QueryLog::Kind::Keyword:
+                      keyword_search(query.options, query.name);
+                      break;
+                  }
+                });
+    }
 
-    itsNameSearchCache.insert(key, ptrs);
+    try
+    {
+      group.wait();
+    }
+    catch (...)
+    {
+      std::cerr << Fmi::Exception::Trace(BCP, "Warning: Geonames cache warmup was incomplete")
+                << std::endl;
+    }
 
-    return ptrs;
+    if (itsVerbose)
+      std::cout << "Geonames cache warmed up with " << queries.size() << " queries" << std::endl;
   }
   catch (...)
   {
@@ -2712,42 +6640,43 @@ Spine::LocationList Engine::Impl::name_search(const Locus::QueryOptions &theOpti
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Coordinate search
+ * \brief Warm up the name search cache with the queries saved by a previous run
  */
 // ----------------------------------------------------------------------
 
-Spine::LocationList Engine::Impl::lonlat_search(const Locus::QueryOptions &theOptions,
-                                                float theLongitude,
-                                                float theLatitude,
-                                                float theRadius)
+void Engine::Impl::warmup_from_file()
 {
-  // Let the engine handle setting the timezone, dem and covertype
-  if (itsDatabaseDisabled)
-    return {};
-
   try
   {
-    std::size_t key = Fmi::hash_value(theLongitude);
-    Fmi::hash_combine(key, Fmi::hash_value(theLatitude));
-    Fmi::hash_combine(key, Fmi::hash_value(theRadius));
-    Fmi::hash_combine(key, theOptions.HashValue());
-
-    auto pos = itsNameSearchCache.find(key);
-    if (pos)
-      return *pos;
+    // Queries answered from the loaded data need not be cached
+    try
+    {
+      suggestReady().get();
+    }
+    catch (...)
+    {
+      return;  // shutting down
+    }
 
-    std::shared_ptr<Locus::Query> lq = query_worker_pool->reserve();
+    if (itsDatabaseDisabled || !std::filesystem::exists(itsWarmupFile))
+      return;
 
-    Spine::LocationList ptrs =
-        to_locationlist(lq->FetchByLonLat(theOptions, theLongitude, theLatitude, theRadius));
+    std::vector<QueryLog::Query> queries;
+    try
+    {
+      queries = QueryLog::read(itsWarmupFile);
+    }
+    catch (...)
+    {
+      std::cerr << Fmi::Exception::Trace(BCP, "Warning: Ignoring the Geonames cache warmup file")
+                << std::endl;
+      return;
+    }
 
-    // Do not cache empty results
-    if (ptrs.empty())
-      return ptrs;
+    if (queries.size() > itsQueryLog.maxSize())
+      queries.resize(itsQueryLog.maxSize());
 
-    // Update the cache
-    itsNameSearchCache.insert(key, ptrs);
-    return ptrs;
+    warmup(queries);
   }
   catch (...)
   {
@@ -2757,37 +6686,80 @@ Spine::LocationList Engine::Impl::lonlat_search(const Locus::QueryOptions &theOp
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Do a id search
+ * \brief Save the hottest queries for warming up the next run
+ *
+ * Nothing is saved unless the engine was fully initialized, so that an
+ * early shutdown does not replace a good file with an empty one.
  */
 // ----------------------------------------------------------------------
 
-Spine::LocationList Engine::Impl::id_search(const Locus::QueryOptions &theOptions, int theId)
+void Engine::Impl::write_warmup_file() const
 {
-  if (itsDatabaseDisabled)
-    return {};
-
   try
   {
-    std::size_t key = Fmi::hash_value(theId);
-    Fmi::hash_combine(key, theOptions.HashValue());
+    if (itsWarmupFile.empty() || !isSuggestReady())
+      return;
 
-    auto pos = itsNameSearchCache.find(key);
-    if (pos)
-      return *pos;
+    auto entries = itsQueryLog.hottest(itsQueryLog.maxSize());
+    if (!entries.empty())
+      QueryLog::write(itsWarmupFile, entries);
+  }
+  catch (...)
+  {
+    std::cerr << Fmi::Exception::Trace(BCP, "Warning: Failed to save Geonames cache warmup file")
+              << std::endl;
+  }
+}
 
-    std::shared_ptr<Locus::Query> lq = query_worker_pool->reserve();
+// ----------------------------------------------------------------------
+/*!
+ * \brief Report the phases of loading the data and the sizes of the results
+ *
+ * Times are in seconds since the construction of the data. Structures
+ * have no times, and phases have no approximate size but the change of
+ * the allocated heap of the process during the phase, if available.
+ */
+// ----------------------------------------------------------------------
 
-    Spine::LocationList ptrs = to_locationlist(lq->FetchById(theOptions, theId));
+std::unique_ptr<Spine::Table> Engine::Impl::load_status() const
+{
+  try
+  {
+    std::unique_ptr<Spine::Table> tablePtr(new Spine::Table);
+    Spine::TableFormatter::Names theNames{
+        "Type", "Name", "Start", "Time", "DatabaseTime", "Rows", "Bytes"};
+    tablePtr->setNames(theNames);
 
-    // Do not cache empty results
-    if (ptrs.empty())
-      return ptrs;
+    const auto seconds = [](double secs) { return Fmi::to_string("%.3f", secs); };
 
-    // Update the cache
+    unsigned int row = 0;
+    for (const auto &phase : itsLoadProfile.phases())
+    {
+      unsigned int column = 0;
+      tablePtr->set(column++, row, "phase");
+      tablePtr->set(column++, row, phase.name);
+      tablePtr->set(column++, row, seconds(phase.start));
+      tablePtr->set(column++, row, seconds(phase.seconds));
+      tablePtr->set(column++, row, seconds(phase.database));
+      tablePtr->set(column++, row, Fmi::to_string(phase.rows));
+      tablePtr->set(column++, row, phase.heap != 0 ? Fmi::to_string(phase.heap) : "");
+      ++row;
+    }
 
-    itsNameSearchCache.insert(key, ptrs);
+    for (const auto &structure : itsLoadProfile.structures())
+    {
+      unsigned int column = 0;
+      tablePtr->set(column++, row, "structure");
+      tablePtr->set(column++, row, structure.name);
+      tablePtr->set(column++, row, "");
+      tablePtr->set(column++, row, "");
+      tablePtr->set(column++, row, "");
+      tablePtr->set(column++, row, Fmi::to_string(structure.count));
+      tablePtr->set(column++, row, Fmi::to_string(structure.bytes));
+      ++row;
+    }
 
-    return ptrs;
+    return tablePtr;
   }
   catch (...)
   {
@@ -2797,40 +6769,51 @@ Spine::LocationList Engine::Impl::id_search(const Locus::QueryOptions &theOption
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Do a keyword search
+ * \brief Report the state of the database connection pools
  */
 // ----------------------------------------------------------------------
 
-Spine::LocationList Engine::Impl::keyword_search(const Locus::QueryOptions &theOptions,
-                                                 const std::string &theKeyword)
+std::unique_ptr<Spine::Table> Engine::Impl::pool_status() const
 {
-  if (itsDatabaseDisabled)
-    return {};
-
   try
   {
-    // Just in case there is a keyword equal to an actual location name
-    // we do not start the start hashing directly from the keyword
-    std::size_t key = 0x12345678;
-    Fmi::hash_combine(key, Fmi::hash_value(theKeyword));
-    Fmi::hash_combine(key, theOptions.HashValue());
-
-    auto pos = itsNameSearchCache.find(key);
-    if (pos)
-      return *pos;
-
-    std::shared_ptr<Locus::Query> lq = query_worker_pool->reserve();
-
-    Spine::LocationList ptrs = to_locationlist(lq->FetchByKeyword(theOptions, theKeyword));
+    std::unique_ptr<Spine::Table> tablePtr(new Spine::Table);
+    Spine::TableFormatter::Names theNames{"Pool",
+                                          "Connections",
+                                          "Idle",
+                                          "Waiting",
+                                          "MinConnections",
+                                          "MaxConnections",
+                                          "Reserved",
+                                          "Opened",
+                                          "Closed",
+                                          "Timeouts",
+                                          "Failures"};
+    tablePtr->setNames(theNames);
 
-    // Do not cache empty results
-    if (ptrs.empty())
-      return ptrs;
+    unsigned int row = 0;
+    for (const auto *pool : {query_pool.get(), replica_pool.get()})
+    {
+      if (pool == nullptr)
+        continue;
 
-    // Update the cache
-    itsNameSearchCache.insert(key, ptrs);
+      const auto status = pool->status();
+      unsigned int column = 0;
+      tablePtr->set(column++, row, pool->name());
+      tablePtr->set(column++, row, Fmi::to_string(status.connections));
+      tablePtr->set(column++, row, Fmi::to_string(status.idle));
+      tablePtr->set(column++, row, Fmi::to_string(status.waiting));
+      tablePtr->set(column++, row, Fmi::to_string(pool->options().min_connections));
+      tablePtr->set(column++, row, Fmi::to_string(pool->options().max_connections));
+      tablePtr->set(column++, row, Fmi::to_string(status.reserved));
+      tablePtr->set(column++, row, Fmi::to_string(status.opened));
+      tablePtr->set(column++, row, Fmi::to_string(status.closed));
+      tablePtr->set(column++, row, Fmi::to_string(status.timeouts));
+      tablePtr->set(column++, row, Fmi::to_string(status.failures));
+      ++row;
+    }
 
-    return ptrs;
+    return tablePtr;
   }
   catch (...)
   {
@@ -2848,8 +6831,6 @@ std::unique_ptr<Spine::Table> Engine::Impl::name_cache_status() const
 {
   try
   {
-    auto contentList = itsNameSearchCache.getContent();
-
     std::unique_ptr<Spine::Table> tablePtr(new Spine::Table);
     Spine::TableFormatter::Names theNames;
     theNames.push_back("Position");
@@ -2859,29 +6840,33 @@ std::unique_ptr<Spine::Table> Engine::Impl::name_cache_status() const
     theNames.push_back("Geoid");
     tablePtr->setNames(theNames);
 
-    if (contentList.empty())
-      return tablePtr;
-
     unsigned int row = 0;
-    for (const auto &ReportObject : contentList)
+    for (const auto *cache :
+         {&itsNameSearchCache, &itsLonLatSearchCache, &itsIdSearchCache, &itsKeywordSearchCache})
     {
-      const std::size_t count = ReportObject.itsHits;
-      const std::size_t key = ReportObject.itsKey;
-      const Spine::LocationPtr &loc = ReportObject.itsValue.front();
-
-      unsigned int column = 0;
-
-      tablePtr->set(column, row, Fmi::to_string(row));
-      ++column;
-      tablePtr->set(column, row, Fmi::to_string(count));
-      ++column;
-      tablePtr->set(column, row, Fmi::to_string(key));
-      ++column;
-      tablePtr->set(column, row, loc->name);
-      ++column;
-      tablePtr->set(column, row, Fmi::to_string(loc->geoid));
+      for (const auto &ReportObject : cache->getContent())
+      {
+        const std::size_t count = ReportObject.itsHits;
+        const std::string &key = ReportObject.itsKey;
+        const Spine::LocationList &locs = ReportObject.itsValue;
+
+        unsigned int column = 0;
+
+        tablePtr->set(column, row, Fmi::to_string(row));
+        ++column;
+        tablePtr->set(column, row, Fmi::to_string(count));
+        ++column;
+        tablePtr->set(column, row, key);
+        ++column;
+        if (!locs.empty())
+        {
+          tablePtr->set(column, row, locs.front()->name);
+          ++column;
+          tablePtr->set(column, row, Fmi::to_string(locs.front()->geoid));
+        }
 
-      ++row;
+        ++row;
+      }
     }
     return tablePtr;
   }
@@ -2899,7 +6884,138 @@ std::unique_ptr<Spine::Table> Engine::Impl::name_cache_status() const
 
 bool Engine::Impl::isSuggestReady() const
 {
-  return itsSuggestReadyFlag;
+  return isReady(ReadyPhase::Complete);
+}
+
+bool Engine::Impl::isReady(ReadyPhase phase) const
+{
+  return itsReadiness[static_cast<std::size_t>(phase)].flag;
+}
+
+std::shared_future<void> Engine::Impl::ready(ReadyPhase phase) const
+{
+  return itsReadiness[static_cast<std::size_t>(phase)].future;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Signal that autocomplete is ready, or that it will never be
+ *
+ * All the phases not yet published are published or failed.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::set_suggest_ready(std::exception_ptr error)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsReadyMutex);
+    for (auto &readiness : itsReadiness)
+    {
+      if (readiness.set)
+        continue;
+      readiness.set = true;
+
+      if (error)
+        readiness.promise.set_exception(error);
+      else
+      {
+        readiness.flag = true;
+        readiness.promise.set_value();
+      }
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Make a build task which counts towards publishing a phase
+ */
+// ----------------------------------------------------------------------
+
+std::function<void()> Engine::Impl::phase_task(ReadyPhase phase, std::function<void()> task)
+{
+  try
+  {
+    {
+      std::lock_guard<std::mutex> lock(itsReadyMutex);
+      ++itsReadiness[static_cast<std::size_t>(phase)].pending;
+    }
+
+    // A failed task leaves the phase unpublished, initialization fails anyway
+    return [this, phase, task = std::move(task)]()
+    {
+      task();
+      std::lock_guard<std::mutex> lock(itsReadyMutex);
+      --itsReadiness[static_cast<std::size_t>(phase)].pending;
+      publish_phases();
+    };
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Mark all the build tasks of a phase added
+ *
+ * The data structures of the phase must not be modified any more, only
+ * the tasks already added may still fill them in.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::seal_phase(ReadyPhase phase)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsReadyMutex);
+    itsReadiness[static_cast<std::size_t>(phase)].sealed = true;
+    publish_phases();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Publish the phases whose tasks have finished, in order
+ *
+ * Called with itsReadyMutex locked.
+ */
+// ----------------------------------------------------------------------
+
+void Engine::Impl::publish_phases()
+{
+  try
+  {
+    for (std::size_t i = 0; i < ready_phases; i++)
+    {
+      auto &readiness = itsReadiness[i];
+      if (readiness.set)
+        continue;
+      if (!readiness.sealed || readiness.pending > 0)
+        return;
+
+      readiness.set = true;
+      readiness.flag = true;
+      readiness.promise.set_value();
+
+      if (itsVerbose)
+        std::cout << "publish_phases: phase " << i << " is ready" << std::endl;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
 }
 
 // Convert TimedCache statistics to regular statistics
@@ -2924,6 +7040,33 @@ Fmi::Cache::CacheStatistics Engine::Impl::getCacheStats() const
   Fmi::Cache::CacheStatistics ret;
 
   ret["Geonames::name_search_cache"] = itsNameSearchCache.statistics();
+  ret["Geonames::lonlat_search_cache"] = itsLonLatSearchCache.statistics();
+  ret["Geonames::id_search_cache"] = itsIdSearchCache.statistics();
+  ret["Geonames::keyword_search_cache"] = itsKeywordSearchCache.statistics();
+  ret["Geonames::wkt_cache"] = itsWktCache.statistics();
+
+  // Hits are searches which waited for an identical search instead of querying the database
+  ret["Geonames::name_search_coalescing"] = Fmi::Cache::CacheStats(startTime,
+                                                                   0,
+                                                                   itsNameSearchFlights.inflight(),
+                                                                   itsNameSearchFlights.coalesced(),
+                                                                   itsNameSearchFlights.started(),
+                                                                   0);
+
+  // Prefix searches would distort the statistics of the suggest cache itself
+  ret["Geonames::suggest_cache"] = Fmi::Cache::CacheStats(startTime,
+                                                          itsSuggestCache.maxSize(),
+                                                          itsSuggestCache.size(),
+                                                          itsSuggestCacheHits,
+                                                          itsSuggestCacheMisses,
+                                                          itsSuggestCacheInserts);
+  ret["Geonames::suggest_prefix_reuse"] =
+      Fmi::Cache::CacheStats(startTime,
+                             itsSuggestCache.maxSize(),
+                             itsSuggestCache.size(),
+                             itsSuggestPrefixReuses,
+                             itsSuggestCacheMisses - itsSuggestPrefixReuses,
+                             0);
 
   return ret;
 }
@@ -6,8 +6,19 @@
 
 #pragma once
 
+#include "BuildTaskGroup.h"
+#include "CollationTable.h"
 #include "Engine.h"
+#include "GeoIndex.h"
 #include "LocationPriorities.h"
+#include "LoadProfile.h"
+#include "LocationStore.h"
+#include "Metrics.h"
+#include "PrefixIndex.h"
+#include "QueryLog.h"
+#include "QueryPool.h"
+#include "SingleFlight.h"
+#include "TranslationStore.h"
 #include <boost/atomic.hpp>
 #include <boost/locale.hpp>
 #include <boost/locale/collator.hpp>
@@ -17,19 +28,26 @@
 #include <macgyver/AsyncTaskGroup.h>
 #include <macgyver/Cache.h>
 #include <macgyver/CharsetConverter.h>
-#include <macgyver/Geometry.h>
-#include <macgyver/NearTree.h>
 #include <macgyver/PostgreSQLConnection.h>
 #include <macgyver/TernarySearchTree.h>
 #include <macgyver/TimedCache.h>
-#include <macgyver/WorkerPool.h>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <functional>
+#include <future>
 #include <iconv.h>
 #include <libconfig.h++>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <string>
+#include <unordered_map>
 
 namespace Fmi
 {
@@ -42,22 +60,6 @@ namespace Engine
 {
 namespace Geonames
 {
-// ----------------------------------------------------------------------
-/*!
- * \brief NearTree distance calculations for Spine::LocationPtr
- */
-// ----------------------------------------------------------------------
-
-struct LocationPtrDistance
-{
-  double operator()(const Spine::LocationPtr& loc1, const Spine::LocationPtr& loc2) const
-  {
-    return Fmi::Geometry::GeoDistance(
-               loc1->longitude, loc1->latitude, loc2->longitude, loc2->latitude) /
-           1000.0;
-  }
-};
-
 // ----------------------------------------------------------------------
 /*!
  * \brief Implementation hiding details for Locus
@@ -72,19 +74,16 @@ class Engine::Impl
   using Translations = std::map<std::string, std::string>;
 
   using Countries = std::map<std::string, std::string>;
-  using AlternateCountries = std::map<std::string, Translations>;
+  using AlternateCountries = std::map<std::string, Translations, std::less<>>;
 
-  using AlternateNames = std::map<Spine::GeoId, Translations>;
-  using AlternateMunicipalities = std::map<int, Translations>;
+  using AlternateNames = TranslationStore;           // translations per geoid
+  using AlternateMunicipalities = TranslationStore;  // translations per municipality
 
-  using GeoIdMap = std::map<Spine::GeoId, Spine::LocationPtr*>;   // map from
-                                                                  // geoid to
-                                                                  // location
   using KeywordMap = std::map<std::string, Spine::LocationList>;  // geoids belonging to
                                                                   // keywords
 
-  using GeoTree = Fmi::NearTree<Spine::LocationPtr, LocationPtrDistance>;
-  using GeoTreePtr = std::unique_ptr<GeoTree>;
+  using GeoTree = GeoIndex;
+  using GeoTreePtr = std::shared_ptr<const GeoTree>;
   using GeoTreeMap = std::map<std::string, GeoTreePtr>;  // nearest point searches
 
   // default name search trees per keyword
@@ -96,11 +95,115 @@ class Engine::Impl
   using TernaryTreeMapPtr = std::shared_ptr<TernaryTreeMap>;
   using LangTernaryTreeMap = std::map<std::string, TernaryTreeMapPtr>;
 
-  // From search hash key to result
-  using NameSearchCache = Fmi::Cache::Cache<std::size_t, Spine::LocationList>;
+  // compact alternative to the ternary trees, the names of all locations or
+  // of all translations of a language and their subsets per keyword
+  struct SuggestIndex
+  {
+    PrefixIndexPtr names;
+    std::map<std::string, PrefixIndex::SubsetPtr> keywords;  // no subset for "all"
+  };
+  using LangSuggestIndexMap = std::map<std::string, SuggestIndex>;
+
+  // The trees or the compact index of a language built on first use
+  struct LanguageTrees
+  {
+    TernaryTreeMap trees;
+    SuggestIndex index;  // used instead of the trees if itsCompactSuggestIndex
+  };
+  using LanguageTreesPtr = std::shared_ptr<const LanguageTrees>;
+
+  struct LazyLanguage
+  {
+    LanguageTreesPtr trees;  // nullptr until built or after being evicted
+    std::future<void> build;
+    std::chrono::steady_clock::time_point used;
+  };
+
+  // precomputed primary strength collation keys for names and their translations
+  using CollationKeys = std::unordered_map<std::string, std::string>;
+
+  // Locations translated during initialization, keyed by geoid. Only locations
+  // changed by the translation are stored.
+  struct TranslatedLocation
+  {
+    const Spine::Location* original;  // the loaded location which was translated
+    Spine::LocationPtr translation;
+  };
+  using TranslatedLocations = std::unordered_map<Spine::GeoId, TranslatedLocation>;
+
+  // Station identifiers (fmisid, lpnn, wmo) to geoids per identifier type
+  using StationIndex = std::unordered_map<std::string, Spine::GeoId>;
+  using StationIndexes = std::map<std::string, StationIndex>;
+
+  // Search cache sizes are measured in bytes
+  struct LocationListSize
+  {
+    static std::size_t getSize(const Spine::LocationList& locs);
+  };
+
+  // From full search key to result
+  using NameSearchCache = Fmi::Cache::Cache<std::string,
+                                            Spine::LocationList,
+                                            Fmi::Cache::LRUEviction,
+                                            std::size_t,
+                                            Fmi::Cache::InstantExpire,
+                                            LocationListSize>;
+
+  // A suggest candidate in the final sort order, translated only when returned
+  struct SuggestCandidate
+  {
+    Spine::LocationPtr location;  // untranslated location passed to the predicate
+    int priority;                 // priority including the exact match bonus
+    std::uint32_t group;          // candidates with identical name, country and area
+  };
+
+  // A tree match with the translated fields needed for ranking it
+  struct SuggestMatch
+  {
+    Spine::LocationPtr location;
+    int priority;
+    std::string name;        // translated name
+    std::string area;        // translated area
+    const std::string* key;  // precomputed collation key of the name or nullptr
+    std::string sortkey;     // computed collation key if not precomputed
+    std::size_t index;       // position in the tree matches
+
+    const std::string& collation_key() const { return (key != nullptr ? *key : sortkey); }
+  };
+
+  // All suggest candidates for a tree word, language and keyword
+  struct SuggestResult
+  {
+    std::string name;
+    std::string lang;
+    std::string keyword;
+    Spine::LocationList matches;  // raw tree matches, kept only for prefix reuse
+    std::vector<SuggestCandidate> candidates;
+  };
+
+  using SuggestResultPtr = std::shared_ptr<const SuggestResult>;
+
+  // The suggest cache size is measured in candidates
+  struct SuggestResultSize
+  {
+    static std::size_t getSize(const SuggestResultPtr& result)
+    {
+      return 1 + result->candidates.size();
+    }
+  };
+
+  // From radius and WKT to the parsed geometry
+  using WktCache = Fmi::Cache::Cache<std::string, WktShapePtr>;
+
+  using SuggestCache = Fmi::Cache::Cache<std::size_t,
+                                         SuggestResultPtr,
+                                         Fmi::Cache::LRUEviction,
+                                         std::size_t,
+                                         Fmi::Cache::InstantExpire,
+                                         SuggestResultSize>;
 
   ~Impl();
-  Impl(std::string configfile, bool reloading);
+  Impl(std::string configfile, bool reloading, std::shared_ptr<Metrics> metrics);
 
   Impl() = delete;
   Impl(const Impl& other) = delete;
@@ -108,7 +211,10 @@ class Engine::Impl
   Impl(Impl&& other) = delete;
   Impl& operator=(Impl&& other) = delete;
 
-  void init(bool first_construction);
+  void init(bool first_construction, std::shared_ptr<const Impl> previous = nullptr);
+
+  // Warm up the name search cache with the hottest queries of the previous instance
+  void warmup(const std::shared_ptr<Impl>& previous);
 
   std::size_t hash_value() const;
 
@@ -121,6 +227,13 @@ class Engine::Impl
   unsigned int maxDemResolution() const { return itsMaxDemResolution; }
   Fmi::LandCover::Type coverType(double lon, double lat) const;
 
+  // The same for many coordinates, in the order of the coordinates
+  std::vector<double> elevations(const std::vector<std::pair<double, double>>& lonlats) const;
+  std::vector<double> elevations(const std::vector<std::pair<double, double>>& lonlats,
+                                 unsigned int maxdemresolution) const;
+  std::vector<Fmi::LandCover::Type> coverTypes(
+      const std::vector<std::pair<double, double>>& lonlats) const;
+
   Spine::LocationList suggest(const std::string& pattern,
                               const std::function<bool(const Spine::LocationPtr&)>& predicate,
                               const std::string& lang,
@@ -151,10 +264,33 @@ class Engine::Impl
   Spine::LocationList keyword_search(const Locus::QueryOptions& theOptions,
                                      const std::string& theKeyword);
 
+  // Batched searches, the results are in the order of the inputs
+  std::vector<Spine::LocationList> name_search(const Locus::QueryOptions& theOptions,
+                                               const std::vector<std::string>& theNames);
+
+  std::vector<Spine::LocationList> lonlat_search(
+      const Locus::QueryOptions& theOptions,
+      const std::vector<std::pair<float, float>>& theCoordinates,
+      float theRadius);
+
+  std::vector<Spine::LocationList> id_search(const Locus::QueryOptions& theOptions,
+                                             const std::vector<int>& theIds);
+
+  // Searches answered without the database, empty if the database is needed
+  std::optional<Spine::LocationList> find_name_search(const Locus::QueryOptions& theOptions,
+                                                      const std::string& theName);
+  std::optional<Spine::LocationList> find_lonlat_search(const Locus::QueryOptions& theOptions,
+                                                        float theLongitude,
+                                                        float theLatitude,
+                                                        float theRadius);
+  std::optional<Spine::LocationList> find_id_search(const Locus::QueryOptions& theOptions,
+                                                    int theId);
+
   // Priority sort of locations
   void sort(Spine::LocationList& theLocations) const;
 
   void translate(Spine::LocationPtr& loc, const std::string& lang) const;
+  void translate(Spine::Location& loc, const std::string& lang) const;
 
   void translate(Spine::LocationList& locs, const std::string& lang) const;
 
@@ -165,15 +301,27 @@ class Engine::Impl
 
   Spine::LocationList to_locationlist(const Locus::Query::return_type& theList) const;
 
+  WktShapePtr wkt_shape(const std::string& theWkt, double theRadius);
+
   std::unique_ptr<Spine::Table> name_cache_status() const;
+  std::unique_ptr<Spine::Table> load_status() const;
+  std::unique_ptr<Spine::Table> pool_status() const;
 
   void shutdown();
 
   bool isSuggestReady() const;
+  bool isReady(ReadyPhase phase) const;
+
+  // Becomes ready when the autocomplete data has been initialized, fails on shutdown
+  std::shared_future<void> suggestReady() const { return ready(ReadyPhase::Complete); }
+  std::shared_future<void> ready(ReadyPhase phase) const;
+
+  unsigned int asyncThreads() const { return itsAsyncThreads; }
 
   Fmi::Cache::CacheStatistics getCacheStats() const;
 
   void assign_priorities(Spine::LocationList& locs) const;
+  void assign_priorities(LocationStore::Locations& locs) const;
 
   /**
    * @brief Check if geonames data has been updated since loading
@@ -212,11 +360,38 @@ class Engine::Impl
   // Convert an autocomplete name to all possible unaccented matches
   std::string to_treeword(const std::string& name) const;
   std::string to_treeword(const std::string& name, const std::string& area) const;
+  std::string collate(const std::string& name) const;
+
+  // Precomputed collation key for a name, or nullptr if not available
+  const std::string* find_collation_key(const std::string& name) const;
+  void add_collation_key(const std::string& name);
+
+  // Priority sort using precomputed collation keys
+  void priority_sort(Spine::LocationList& locs) const;
 
   void translate_name(Spine::Location& loc, const std::string& lang) const;
   void translate_area(Spine::Location& loc, const std::string& lang) const;
+  std::string translated_area(const Spine::Location& loc,
+                              const std::string& name,
+                              const std::string& lg) const;
+
+  // Answering database searches from the loaded data
+  bool memory_search_ready() const;
+  Spine::LocationPtr memory_location(const Spine::LocationPtr& loc, const std::string& lang) const;
+  Spine::LocationList memory_lonlat_search(const Locus::QueryOptions& theOptions,
+                                           float theLongitude,
+                                           float theLatitude,
+                                           float theRadius) const;
+
+  std::optional<Spine::LocationList> find_station_search(const Locus::QueryOptions& theOptions,
+                                                         const std::string& theName) const;
 
   void initSuggest(bool threaded);
+  void warmup(const std::vector<QueryLog::Query>& queries);
+  NameSearchCache& search_cache(QueryLog::Kind kind);
+  float quantize(float coordinate) const;
+  void warmup_from_file();
+  void write_warmup_file() const;
   void initDEM();
   void initLandCover();
 
@@ -228,20 +403,57 @@ class Engine::Impl
   bool itsAutocompleteDisabled = false;
   bool itsStrict = true;
   bool itsRemoveUnderscores = false;
+  bool itsMemoryIdSearch = false;
+  bool itsMemoryStationSearch = false;
+  bool itsMemoryLonLatSearch = false;
+  bool itsCompactSuggestIndex = false;
+  unsigned int itsBuildThreads = 0;   // 0 = hardware concurrency
+  unsigned int itsBatchThreads = 8;   // concurrent database searches per batch
+  unsigned int itsAsyncThreads = 10;  // threads running asynchronous searches
+  unsigned int itsFetchSize = 0;      // 0 = read each table with a single query
+  bool itsParallelLoad = false;       // read independent tables with separate connections
+  std::string itsSnapshotFile;        // empty = no snapshots
+  bool itsIncrementalReload = false;  // reuse unchanged data of the previous instance
+  std::vector<std::string> itsMemoryLonLatFeatures;  // defaults for in-memory lonlat searches
+  std::vector<std::string> itsPretranslatedLanguages;  // languages translated during init
+  bool itsLazyTrees = false;                          // build only eager languages during init
+  std::set<std::string> itsEagerLanguages;            // languages with trees built during init
+  unsigned int itsLazyBuildThreads = 2;               // concurrent builds of lazy languages
+  unsigned int itsLazyLanguageExpiration = 3600;      // seconds, 0 = never evict
   const std::string itsConfigFile;
   libconfig::Config itsConfig;
 
-  Spine::LocationList itsLocations;
+  LocationStore itsLocations;
 
   Countries itsCountries;
   AlternateCountries itsAlternateCountries;
   Municipalities itsMunicipalities;
   AlternateNames itsAlternateNames;
   AlternateMunicipalities itsAlternateMunicipalities;
-  GeoIdMap itsGeoIdMap;
   KeywordMap itsKeywords;
+  std::map<std::string, TranslatedLocations> itsTranslatedLocations;
+  StationIndexes itsStationIndexes;
+
+  // Modification state of the tables for incremental reloads
+  bool itsTableStatesRead = false;
+  std::string itsGeonamesModified;           // max(last_modified) of geonames
+  std::string itsAlternateGeonamesModified;  // max(last_modified) of alternate_geonames
+  std::int64_t itsAlternateRows = 0;         // count(*) of alternate_geonames
+  std::int64_t itsAlternateMaxId = 0;        // max(id) of alternate_geonames
+
+  // Used only during incremental reloads
+  std::shared_ptr<const Impl> itsPrevious;
+  std::set<Spine::GeoId> itsChangedGeoids;  // changed, added or removed locations
   TernaryTreeMap itsTernaryTrees;
   LangTernaryTreeMap itsLangTernaryTreeMap;
+  SuggestIndex itsSuggestIndex;  // used instead of the trees if itsCompactSuggestIndex
+  LangSuggestIndexMap itsLangSuggestIndexes;
+  CollationKeys itsCollationKeys;
+
+  // Languages not listed in eager_languages
+  mutable std::mutex itsLazyMutex;
+  mutable std::map<std::string, LazyLanguage> itsLazyLanguages;
+  mutable std::chrono::steady_clock::time_point itsNextLazyEviction;
 
   // priority info
 
@@ -251,7 +463,19 @@ class Engine::Impl
   int itsNameMatchPriority = 50;
   LocationPriorities itsLocationPriorities;
 
-  boost::atomic<bool> itsSuggestReadyFlag{false};
+  // A phase is published once its build tasks have finished and the previous phase is ready
+  struct Readiness
+  {
+    boost::atomic<bool> flag{false};
+    std::promise<void> promise;
+    std::shared_future<void> future{promise.get_future().share()};
+    bool set = false;         // promise has been satisfied
+    bool sealed = false;      // all build tasks of the phase have been added
+    std::size_t pending = 0;  // build tasks of the phase still running
+  };
+  static constexpr std::size_t ready_phases = 3;
+  std::array<Readiness, ready_phases> itsReadiness;
+  std::mutex itsReadyMutex;
 
   // security
   std::vector<boost::regex> itsForbiddenNamePatterns;
@@ -259,7 +483,27 @@ class Engine::Impl
   // caches
 
  public:
+  // Separate caches so that rarely reused results do not evict the others
   NameSearchCache itsNameSearchCache;
+  NameSearchCache itsLonLatSearchCache;
+  NameSearchCache itsIdSearchCache;
+  NameSearchCache itsKeywordSearchCache;
+  double itsLonLatResolution = 0;     // grid for coordinate search cache keys, 0 = exact
+  SingleFlight itsNameSearchFlights;  // coalesces concurrent cache misses
+  QueryLog itsQueryLog;               // queries of the hottest cache entries
+  std::string itsWarmupFile;          // empty = do not save the query log
+
+  WktCache itsWktCache;
+
+  std::shared_ptr<Metrics> itsMetrics;  // owned by the engine, shared with reloaded instances
+  mutable LoadProfile itsLoadProfile;   // phases of loading the data and the sizes of the results
+
+  mutable SuggestCache itsSuggestCache;
+  bool itsSuggestPrefixReuse = false;  // filter cached shorter prefixes instead of tree walks
+  mutable std::atomic<std::size_t> itsSuggestCacheHits{0};
+  mutable std::atomic<std::size_t> itsSuggestCacheMisses{0};
+  mutable std::atomic<std::size_t> itsSuggestCacheInserts{0};
+  mutable std::atomic<std::size_t> itsSuggestPrefixReuses{0};
 
  private:
   // locale handling for autocomplete
@@ -270,6 +514,8 @@ class Engine::Impl
 
   std::locale itsLocale;
   const Collator* itsCollator = nullptr;  // perhaps should delete in destructor?
+  bool itsFastCollation = false;
+  std::unique_ptr<CollationTable> itsCollationTable;  // keys of Latin names without ICU
 
   bool itsAsciiAutocomplete = false;
   std::unique_ptr<Fmi::CharsetConverter> utf8_to_latin1;
@@ -299,7 +545,17 @@ class Engine::Impl
   Fmi::AsyncTaskGroup tg1;
   std::shared_ptr<Fmi::AsyncTask> initSuggestTask;
 
-  std::unique_ptr<Fmi::WorkerPool<Locus::Query>> query_worker_pool;
+  QueryPool::Options itsPoolOptions;
+  std::chrono::milliseconds itsQueryTimeout{0};  // 0 = no deadline for database searches
+  std::unique_ptr<QueryPool> query_pool;
+  std::unique_ptr<QueryPool> replica_pool;  // id and keyword searches, if configured
+
+  // Optional read replica, the unset settings are the same as for the primary
+  std::string itsReplicaUser;
+  std::string itsReplicaHost;
+  std::string itsReplicaPass;
+  std::string itsReplicaDatabase;
+  std::string itsReplicaPort;
 
   void read_config();
   void read_config_priorities();
@@ -308,6 +564,33 @@ class Engine::Impl
 
   void read_config_security();
 
+  void open_connection(Fmi::Database::PostgreSQLConnection& conn) const;
+  QueryPool::Clock::time_point query_deadline() const;
+  std::shared_ptr<Locus::Query> reserve_query(Metrics::Operation operation,
+                                              QueryPool::Clock::time_point deadline,
+                                              bool replica = false) const;
+  std::size_t read_rows(Fmi::Database::PostgreSQLConnection& conn,
+                        const std::string& cursor,
+                        const std::string& sql,
+                        const std::function<void(const pqxx::result::const_iterator&)>& callback);
+  void read_tables(Fmi::Database::PostgreSQLConnection& conn, BuildTaskGroup& builds);
+  void read_tables_parallel(Fmi::Database::PostgreSQLConnection& conn, BuildTaskGroup& builds);
+  void read_locations(Fmi::Database::PostgreSQLConnection& conn, BuildTaskGroup& builds);
+
+  void read_table_states(Fmi::Database::PostgreSQLConnection& conn);
+  std::string read_last_modified(Fmi::Database::PostgreSQLConnection& conn,
+                                 const std::string& table);
+  bool can_reload_incrementally(const Impl& previous) const;
+  void read_tables_incremental(Fmi::Database::PostgreSQLConnection& conn, BuildTaskGroup& builds);
+  void read_geonames_incremental(Fmi::Database::PostgreSQLConnection& conn, const Impl& previous);
+  void read_alternate_geonames_incremental(Fmi::Database::PostgreSQLConnection& conn,
+                                           const Impl& previous);
+  std::set<std::string> reuse_keyword_trees();
+
+  std::string snapshot_fingerprint() const;
+  void write_snapshot(std::size_t hash) const;
+  bool read_snapshot(std::size_t hash);
+
   std::optional<std::size_t> read_database_hash_value(Fmi::Database::PostgreSQLConnection& conn);
 
   void read_countries(Fmi::Database::PostgreSQLConnection& conn);
@@ -316,28 +599,119 @@ class Engine::Impl
   void read_alternate_geonames(Fmi::Database::PostgreSQLConnection& conn);
   void read_alternate_municipalities(Fmi::Database::PostgreSQLConnection& conn);
   void read_geonames(Fmi::Database::PostgreSQLConnection& conn);
+  std::string geonames_sql(const std::string& columns, const std::string& condition) const;
+  std::size_t read_geonames_rows(Fmi::Database::PostgreSQLConnection& conn,
+                                 const std::string& sql,
+                                 LocationStore& locations);
+  std::string alternate_geonames_sql(const std::string& condition) const;
+  std::size_t read_alternate_geonames_rows(Fmi::Database::PostgreSQLConnection& conn,
+                                           const std::string& sql,
+                                           const LocationStore& locations,
+                                           TranslationStore& names);
 
   void build_geoid_map();
   void read_keywords(Fmi::Database::PostgreSQLConnection& conn);
 
-  void build_geotrees();
-  void build_ternarytrees();
-  void build_lang_ternarytrees();
-  void build_lang_ternarytrees_all();
-  void build_lang_ternarytrees_keywords();
+  // translations of one language as (row, entry) pairs of itsAlternateNames
+  using LanguageRows = std::vector<std::pair<std::size_t, const TranslationStore::Entry*>>;
+  using LanguageRowMap = std::map<std::string, LanguageRows>;
+
+  void build_location_trees(BuildTaskGroup& builds);
+  void build_trees(BuildTaskGroup& builds);
+  LanguageRowMap prepare_trees(const std::set<std::string>& reused);
+  template <typename Locations>
+  void build_geotree(GeoTreePtr& tree, const std::string& keyword, const Locations& locs);
+  template <typename Locations>
+  void build_ternarytree(TernaryTree& tree, const std::string& keyword, const Locations& locs);
+  void build_lang_ternarytree_all(TernaryTree& tree,
+                                  const std::string& lang,
+                                  const LanguageRows& rows) const;
+  // The tree of a language for the translations, nullptr if the language is skipped
+  using LangTreeFinder = std::function<TernaryTree*(const std::string& lang)>;
   void build_lang_ternarytrees_one_keyword(const std::string& keyword,
-                                           const Spine::LocationList& locs);
+                                           const Spine::LocationList& locs,
+                                           const LangTreeFinder& find_tree = {}) const;
+  template <typename Locations>
+  PrefixIndexPtr build_prefix_index(const std::string& keyword, const Locations& locs) const;
+  PrefixIndexPtr build_lang_prefix_index(const std::string& lang, const LanguageRows& rows) const;
+  void build_keyword_subsets(SuggestIndex& index, const std::string& lang) const;
+  bool is_eager_language(const std::string& lang) const;
+  LanguageTreesPtr build_lazy_language(const std::string& lang) const;
+  LanguageTreesPtr lazy_language(const std::string& lang) const;
+  bool is_lazy_pending(const std::string& lang) const;
+  void evict_lazy_languages(std::chrono::steady_clock::time_point now) const;
+  void build_collation_keys();
+  void build_station_indexes();
+  void record_structures();
+  void set_suggest_ready(std::exception_ptr error = nullptr);
+  std::function<void()> phase_task(ReadyPhase phase, std::function<void()> task);
+  void seal_phase(ReadyPhase phase);
+  void publish_phases();
+  void check_suggest_ready(const std::vector<std::string>& keywords) const;
+  void build_translations(const std::string& lang, TranslatedLocations& translations) const;
+  bool is_translated(const Spine::Location& loc, const std::string& lg) const;
 
   Spine::LocationPtr extract_geoname(const pqxx::result::const_iterator& row) const;
 
+  bool has_suggest_keyword(const std::string& keyword) const;
+  std::list<Spine::LocationPtr> findprefix(const std::string& keyword,
+                                           const std::string& name) const;
+  std::list<Spine::LocationPtr> findprefix(const std::string& keyword,
+                                           const std::string& lg,
+                                           const std::string& name) const;
+  std::vector<std::list<Spine::LocationPtr>> findprefix(
+      const SuggestIndex& index,
+      const std::vector<std::string>& keywords,
+      const std::string& name) const;
+  Spine::LocationList suggest_pattern(
+      const std::string& pattern,
+      std::string& name,
+      const std::function<Spine::LocationList(const std::string& name)>& find) const;
   Spine::LocationList suggest_one_keyword(const std::string& pattern,
                                           const std::string& lang,
                                           const std::string& keyword,
-                                          const TernaryTreePtr& tree) const;
-
-  void add_exact_match_bonus(SmartMet::Spine::LocationList& locs,
-                             const std::string& name,
-                             int bonus) const;
+                                          std::string& name) const;
+  Spine::LocationList suggest_keywords(const std::string& pattern,
+                                       const std::string& lang,
+                                       const std::vector<std::string>& keywords,
+                                       std::string& name) const;
+
+  Spine::LocationList find_suggest_matches(const std::string& pattern,
+                                           const std::string& lang,
+                                           const std::vector<std::string>& keywords,
+                                           std::string& name) const;
+  SuggestResultPtr suggest_candidates(const std::string& pattern,
+                                      const std::string& lang,
+                                      const std::string& keyword,
+                                      const std::vector<std::string>& keywords) const;
+  Spine::LocationList suggest_top(Spine::LocationList matches,
+                                  const std::string& name,
+                                  const std::string& lang,
+                                  const std::function<bool(const Spine::LocationPtr&)>& predicate,
+                                  unsigned int page,
+                                  unsigned int maxresults,
+                                  bool duplicates) const;
+  std::vector<SuggestMatch> make_suggest_matches(const Spine::LocationList& matches,
+                                                 const std::string& name,
+                                                 const std::string& lang) const;
+  Spine::LocationPtr make_suggestion(const SuggestCandidate& candidate,
+                                     const std::string& lang) const;
+  SuggestResultPtr make_suggest_result(Spine::LocationList matches,
+                                       const std::string& name,
+                                       const std::string& lang,
+                                       const std::string& keyword) const;
+  std::optional<Spine::LocationList> reuse_suggest_prefix(const std::string& name,
+                                                          const std::string& lang,
+                                                          const std::string& keyword) const;
+  bool matches_suggest_prefix(const Spine::LocationPtr& loc,
+                              const std::string& name,
+                              const std::string& lang) const;
+
+  bool is_exact_suggest_match(const Spine::Location& loc, const std::string& name) const;
+
+  static bool suggest_basic_sort(const SuggestMatch& a, const SuggestMatch& b);
+  static bool suggest_close_enough(const SuggestMatch& a, const SuggestMatch& b);
+  static bool suggest_rank_sort(const SuggestMatch& a, const SuggestMatch& b);
 
   /**
    *  @brief Autoreload check interval in minutes (0 = disabled)
@@ -0,0 +1,132 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class LoadProfile
+ */
+// ======================================================================
+
+#include "LoadProfile.h"
+#include <macgyver/Exception.h>
+#include <malloc.h>
+#include <utility>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+namespace
+{
+thread_local LoadProfile::Scope* current_scope = nullptr;
+
+double seconds(LoadProfile::Clock::duration theTime)
+{
+  return std::chrono::duration<double>(theTime).count();
+}
+
+}  // namespace
+
+LoadProfile::LoadProfile() : itsStart(Clock::now()) {}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start a phase in the calling thread
+ */
+// ----------------------------------------------------------------------
+
+LoadProfile::Scope::Scope(LoadProfile& theProfile, std::string theName)
+    : itsProfile(theProfile),
+      itsStart(Clock::now()),
+      itsHeap(LoadProfile::heap()),
+      itsParent(current_scope)
+{
+  itsPhase.name = std::move(theName);
+  itsPhase.start = seconds(itsStart - itsProfile.itsStart);
+  current_scope = this;
+}
+
+LoadProfile::Scope::~Scope()
+{
+  current_scope = itsParent;
+
+  try
+  {
+    itsPhase.seconds = seconds(Clock::now() - itsStart);
+    itsPhase.database = seconds(itsDatabase);
+    if (itsHeap > 0)
+      itsPhase.heap = LoadProfile::heap() - itsHeap;
+    itsProfile.finished(std::move(itsPhase));
+  }
+  catch (...)
+  {
+    // Profiling must never break loading the data
+  }
+}
+
+void LoadProfile::rows(std::size_t theRows)
+{
+  if (current_scope != nullptr)
+    current_scope->itsPhase.rows += theRows;
+}
+
+void LoadProfile::database(Clock::duration theTime)
+{
+  if (current_scope != nullptr)
+    current_scope->itsDatabase += theTime;
+}
+
+void LoadProfile::finished(Phase thePhase)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  itsPhases.push_back(std::move(thePhase));
+}
+
+void LoadProfile::structure(const std::string& theName,
+                            std::size_t theCount,
+                            std::size_t theBytes)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsStructures.push_back(Structure{theName, theCount, theBytes});
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::vector<LoadProfile::Phase> LoadProfile::phases() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsPhases;
+}
+
+std::vector<LoadProfile::Structure> LoadProfile::structures() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsStructures;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Allocated heap of the process
+ *
+ * mallinfo2 is available since glibc 2.33, the older mallinfo counters
+ * overflow at 2 GB and are hence not used.
+ */
+// ----------------------------------------------------------------------
+
+std::int64_t LoadProfile::heap()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  const auto info = mallinfo2();
+  return static_cast<std::int64_t>(info.uordblks + info.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,105 @@
+// ======================================================================
+/*!
+ * \brief Timing and memory use of the phases of loading the data
+ *
+ * A phase is measured by a Scope object, which also becomes the current
+ * phase of its thread so that common code such as the database readers
+ * can add rows and database time to it without knowing which phase is
+ * running. The heap change of a phase is measured for the whole process,
+ * hence it includes the allocations of any phases running concurrently.
+ * The sizes of the resulting data structures are recorded separately.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class LoadProfile
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Phase
+  {
+    std::string name;
+    double start = 0;     // seconds since the profile was started
+    double seconds = 0;   // wall time
+    double database = 0;  // seconds spent waiting for the database
+    std::size_t rows = 0;
+    std::int64_t heap = 0;  // change in allocated bytes, 0 if unknown
+  };
+
+  struct Structure
+  {
+    std::string name;
+    std::size_t count = 0;  // elements of the structure
+    std::size_t bytes = 0;  // approximate size
+  };
+
+  class Scope
+  {
+   public:
+    Scope(LoadProfile& theProfile, std::string theName);
+    ~Scope();
+
+    Scope() = delete;
+    Scope(const Scope& other) = delete;
+    Scope& operator=(const Scope& other) = delete;
+    Scope(Scope&& other) = delete;
+    Scope& operator=(Scope&& other) = delete;
+
+   private:
+    friend class LoadProfile;
+
+    LoadProfile& itsProfile;
+    Phase itsPhase;
+    Clock::time_point itsStart;
+    std::int64_t itsHeap;
+    Scope* itsParent;
+    Clock::duration itsDatabase{0};
+  };
+
+  LoadProfile();
+
+  LoadProfile(const LoadProfile& other) = delete;
+  LoadProfile& operator=(const LoadProfile& other) = delete;
+  LoadProfile(LoadProfile&& other) = delete;
+  LoadProfile& operator=(LoadProfile&& other) = delete;
+
+  // Add to the current phase of the calling thread, if there is one
+  static void rows(std::size_t theRows);
+  static void database(Clock::duration theTime);
+
+  void structure(const std::string& theName, std::size_t theCount, std::size_t theBytes);
+
+  // Phases in the order they finished and structures in the order they were recorded
+  std::vector<Phase> phases() const;
+  std::vector<Structure> structures() const;
+
+  // Allocated heap of the process, 0 if not available
+  static std::int64_t heap();
+
+ private:
+  void finished(Phase thePhase);
+
+  mutable std::mutex itsMutex;
+  Clock::time_point itsStart;
+  std::vector<Phase> itsPhases;
+  std::vector<Structure> itsStructures;
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -1,10 +1,52 @@
 #include "LocationPriorities.h"
 #include <macgyver/Exception.h>
+#include <algorithm>
 #include <cmath>
 
 using namespace SmartMet::Engine::Geonames;
 using namespace SmartMet::Spine;
 
+namespace
+{
+// Slots for the uppercase iso2 codes and one for anything else
+const std::size_t country_slots = 26 * 26 + 1;
+
+bool is_iso2(const std::string& iso2)
+{
+  return (iso2.size() == 2 && iso2[0] >= 'A' && iso2[0] <= 'Z' && iso2[1] >= 'A' && iso2[1] <= 'Z');
+}
+
+std::size_t country_slot(const std::string& iso2)
+{
+  if (!is_iso2(iso2))
+    return country_slots - 1;
+  return std::size_t(iso2[0] - 'A') * 26 + std::size_t(iso2[1] - 'A');
+}
+
+// Feature codes up to 7 characters are packed with their length into an integer
+const std::size_t max_feature_length = 7;
+
+std::uint64_t feature_code(const std::string& feature)
+{
+  std::uint64_t code = feature.size();
+  for (char c : feature)
+    code = (code << 8) | static_cast<unsigned char>(c);
+  return code;
+}
+
+template <typename T>
+const T* find_or_default(const std::map<std::string, T>& values, const std::string& key)
+{
+  auto it = values.find(key);
+  if (it == values.end())
+    it = values.find("default");
+  if (it == values.end())
+    return nullptr;
+  return &it->second;
+}
+
+}  // namespace
+
 LocationPriorities::LocationPriorities() = default;
 LocationPriorities::~LocationPriorities() = default;
 
@@ -12,6 +54,9 @@ int LocationPriorities::getPriority(const Location& loc) const
 {
   try
   {
+    if (itsCompiled)
+      return compiledPriority(loc);
+
     int priority = 0;
     priority += populationPriority(loc);
     priority += areaPriority(loc);
@@ -30,6 +75,7 @@ void LocationPriorities::setPopulationPriorities(const std::string& iso2, int di
   try
   {
     itsPopulationPriorities[iso2] = div;
+    compile();
   }
   catch (...)
   {
@@ -42,6 +88,7 @@ void LocationPriorities::setAreaPriorities(const std::string& area, int prty)
   try
   {
     itsAreaPriorities[area] = prty;
+    compile();
   }
   catch (...)
   {
@@ -54,6 +101,7 @@ void LocationPriorities::setCountryPriorities(const std::string& iso2, int prty)
   try
   {
     itsCountryPriorities[iso2] = prty;
+    compile();
   }
   catch (...)
   {
@@ -68,6 +116,7 @@ void LocationPriorities::setFeaturePriorities(const std::string& iso2,
   try
   {
     itsFeaturePriorities[iso2][feature] = prty;
+    compile();
   }
   catch (...)
   {
@@ -81,6 +130,124 @@ void LocationPriorities::setFeaturePriorities(const std::string& iso2,
   try
   {
     itsFeaturePriorities[iso2] = prtyMap;
+    compile();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compile the priority maps into tables
+ *
+ * The population, country and feature priorities of each iso2 code are
+ * resolved including the defaults, hence a priority needs only a few
+ * table lookups and possibly an area lookup. The maps are used as is if
+ * some configured iso2 or feature code does not fit the tables.
+ */
+// ----------------------------------------------------------------------
+
+void LocationPriorities::compile()
+{
+  try
+  {
+    itsCompiled = false;
+    itsCountryTable.clear();
+    itsFeatureCodes.clear();
+    itsFeatureTable.clear();
+
+    const auto packable_country = [](const std::string& iso2)
+    { return (iso2 == "default" || is_iso2(iso2)); };
+
+    for (const auto& iso2_value : itsPopulationPriorities)
+      if (!packable_country(iso2_value.first))
+        return;
+    for (const auto& iso2_value : itsCountryPriorities)
+      if (!packable_country(iso2_value.first))
+        return;
+    for (const auto& iso2_features : itsFeaturePriorities)
+    {
+      if (!packable_country(iso2_features.first))
+        return;
+      for (const auto& feature_value : iso2_features.second)
+      {
+        if (feature_value.first.size() > max_feature_length)
+          return;
+        if (feature_value.first != "default")
+          itsFeatureCodes.push_back(feature_code(feature_value.first));
+      }
+    }
+
+    std::sort(itsFeatureCodes.begin(), itsFeatureCodes.end());
+    itsFeatureCodes.erase(std::unique(itsFeatureCodes.begin(), itsFeatureCodes.end()),
+                          itsFeatureCodes.end());
+
+    // Feature rows, the first one for countries without their own map
+
+    const std::size_t columns = itsFeatureCodes.size() + 1;
+
+    const auto add_row = [this, columns](const std::map<std::string, int>* priomap)
+    {
+      const std::size_t row = itsFeatureTable.size() / columns;
+      itsFeatureTable.resize(itsFeatureTable.size() + columns, 0);
+      if (priomap == nullptr)
+        return row;
+
+      int* scores = &itsFeatureTable[row * columns];
+      auto def = priomap->find("default");
+      const int other = (def != priomap->end() ? def->second * priority_scale : 0);
+      for (std::size_t i = 0; i < columns; i++)
+        scores[i] = other;
+      for (const auto& feature_value : *priomap)
+      {
+        if (feature_value.first == "default")
+          continue;
+        auto pos = std::lower_bound(
+            itsFeatureCodes.begin(), itsFeatureCodes.end(), feature_code(feature_value.first));
+        scores[pos - itsFeatureCodes.begin()] = feature_value.second * priority_scale;
+      }
+      return row;
+    };
+
+    auto def = itsFeaturePriorities.find("default");
+    add_row(def != itsFeaturePriorities.end() ? &def->second : nullptr);
+
+    std::map<std::string, std::size_t> feature_rows;
+    for (const auto& iso2_features : itsFeaturePriorities)
+      if (iso2_features.first != "default")
+        feature_rows[iso2_features.first] = add_row(&iso2_features.second);
+
+    // Country entries, the last slot does not match any configured code
+
+    itsCountryTable.resize(country_slots);
+    for (std::size_t slot = 0; slot < country_slots; slot++)
+    {
+      std::string iso2;
+      if (slot + 1 < country_slots)
+      {
+        iso2 += static_cast<char>('A' + slot / 26);
+        iso2 += static_cast<char>('A' + slot % 26);
+      }
+
+      auto& entry = itsCountryTable[slot];
+
+      if (const int* divisor = find_or_default(itsPopulationPriorities, iso2))
+      {
+        entry.population = true;
+        entry.divisor = *divisor;
+      }
+
+      if (const int* score = find_or_default(itsCountryPriorities, iso2))
+        entry.country = *score * priority_scale;
+
+      auto row = feature_rows.find(iso2);
+      if (row != feature_rows.end())
+        entry.features = row->second;
+    }
+
+    itsCompiled = true;
   }
   catch (...)
   {
@@ -88,6 +255,38 @@ void LocationPriorities::setFeaturePriorities(const std::string& iso2,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get priority for a location from the compiled tables
+ */
+// ----------------------------------------------------------------------
+
+int LocationPriorities::compiledPriority(const Location& loc) const
+{
+  const auto& entry = itsCountryTable[country_slot(loc.iso2)];
+
+  int priority = entry.country;
+
+  if (entry.population)
+    priority += lround(1.0 * priority_scale * loc.population / entry.divisor);
+
+  if (!itsAreaPriorities.empty())
+    priority += areaPriority(loc);
+
+  std::size_t column = itsFeatureCodes.size();
+  if (loc.feature.size() <= max_feature_length)
+  {
+    const auto code = feature_code(loc.feature);
+    auto pos = std::lower_bound(itsFeatureCodes.begin(), itsFeatureCodes.end(), code);
+    if (pos != itsFeatureCodes.end() && *pos == code)
+      column = pos - itsFeatureCodes.begin();
+  }
+
+  priority += itsFeatureTable[entry.features * (itsFeatureCodes.size() + 1) + column];
+
+  return priority;
+}
+
 int LocationPriorities::populationPriority(const Location& loc) const
 {
   try
@@ -189,7 +388,10 @@ try
     readPriorityMap("countries", config, itsCountryPriorities);
 
     if (!config.exists("priorities.features"))
+    {
+        compile();
         return;
+    }
 
     const libconfig::Setting &tmp = config.lookup("priorities.features");
 
@@ -221,6 +423,8 @@ try
             itsFeaturePriorities[countryname][name] = value;
         }
     }
+
+    compile();
 }
 catch (const libconfig::SettingException &e)
 {
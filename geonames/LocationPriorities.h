@@ -1,7 +1,9 @@
 #pragma once
 
 #include <spine/Location.h>
+#include <cstdint>
 #include <map>
+#include <vector>
 #include <libconfig.h++>
 
 namespace SmartMet
@@ -43,6 +45,9 @@ public:
     void setFeaturePriorities(const std::string& iso2, std::map<std::string, int> prtyMap);
 
 private:
+    void compile();
+    int compiledPriority(const SmartMet::Spine::Location& loc) const;
+
     int populationPriority(const SmartMet::Spine::Location& loc) const;
     int areaPriority(const SmartMet::Spine::Location& loc) const;
     int countryPriority(const SmartMet::Spine::Location& loc) const;
@@ -57,6 +62,20 @@ private:
     std::map<std::string, int> itsAreaPriorities;
     std::map<std::string, int> itsCountryPriorities;
     std::map<std::string, std::map<std::string, int>> itsFeaturePriorities;
+
+    // The maps compiled into tables indexed by iso2 code and feature code
+    struct CountryPriorities
+    {
+        bool population = false;
+        int divisor = 0;
+        int country = 0;
+        std::size_t features = 0;  // row in itsFeatureTable
+    };
+
+    bool itsCompiled = false;
+    std::vector<CountryPriorities> itsCountryTable;
+    std::vector<std::uint64_t> itsFeatureCodes;  // sorted, column is the position
+    std::vector<int> itsFeatureTable;            // last column for other features
 };
 
 }  // namespace Geonames
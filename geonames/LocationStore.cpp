@@ -0,0 +1,110 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class LocationStore
+ */
+// ======================================================================
+
+#include "LocationStore.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a new location
+ */
+// ----------------------------------------------------------------------
+
+void LocationStore::add(const Spine::LocationPtr& loc)
+{
+  try
+  {
+    itsLocations.push_back(loc);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Sort the locations by geoid and build the lookup table
+ */
+// ----------------------------------------------------------------------
+
+void LocationStore::finalize()
+{
+  try
+  {
+    std::stable_sort(itsLocations.begin(),
+                     itsLocations.end(),
+                     [](const Spine::LocationPtr& a, const Spine::LocationPtr& b)
+                     { return a->geoid < b->geoid; });
+
+    auto last = std::unique(itsLocations.begin(),
+                            itsLocations.end(),
+                            [](const Spine::LocationPtr& a, const Spine::LocationPtr& b)
+                            { return a->geoid == b->geoid; });
+
+    itsLocations.erase(last, itsLocations.end());
+    itsLocations.shrink_to_fit();
+
+    itsGeoIds.clear();
+    itsGeoIds.reserve(itsLocations.size());
+    for (const auto& loc : itsLocations)
+      itsGeoIds.push_back(loc->geoid);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a location by geoid
+ */
+// ----------------------------------------------------------------------
+
+const Spine::LocationPtr* LocationStore::find(Spine::GeoId geoid) const
+{
+  auto pos = std::lower_bound(itsGeoIds.begin(), itsGeoIds.end(), geoid);
+  if (pos == itsGeoIds.end() || *pos != geoid)
+    return nullptr;
+  return &itsLocations[pos - itsGeoIds.begin()];
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Approximate size of the store
+ */
+// ----------------------------------------------------------------------
+
+std::size_t LocationStore::memory() const
+{
+  std::size_t size = itsLocations.capacity() * sizeof(Spine::LocationPtr) +
+                     itsGeoIds.capacity() * sizeof(Spine::GeoId);
+  for (const auto& loc : itsLocations)
+    size += memory(*loc);
+  return size;
+}
+
+std::size_t LocationStore::memory(const Spine::Location& loc)
+{
+  // The location and the control block of its shared pointer
+  return 2 * sizeof(void*) + sizeof(Spine::Location) + loc.name.capacity() +
+         loc.iso2.capacity() + loc.area.capacity() + loc.feature.capacity() +
+         loc.country.capacity() + loc.timezone.capacity();
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
+
+// ======================================================================
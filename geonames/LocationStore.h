@@ -0,0 +1,58 @@
+// ======================================================================
+/*!
+ * \brief Flat storage for all loaded locations
+ *
+ * Locations are kept in a contiguous array sorted by geoid, geoid lookups
+ * are binary searches in a parallel array of geoids. Duplicates generated
+ * by the keyword joins in the SQL queries are removed when the store is
+ * finalized, the first instance is kept.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <spine/Location.h>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class LocationStore
+{
+ public:
+  using Locations = std::vector<Spine::LocationPtr>;
+
+  // Add a location to the store. Lookups are not possible until finalize() is called.
+  void add(const Spine::LocationPtr& loc);
+
+  // Sort and remove duplicates
+  void finalize();
+
+  // Return nullptr if the geoid is unknown
+  const Spine::LocationPtr* find(Spine::GeoId geoid) const;
+
+  const Locations& locations() const { return itsLocations; }
+  Locations& locations() { return itsLocations; }
+
+  std::size_t size() const { return itsLocations.size(); }
+  bool empty() const { return itsLocations.empty(); }
+
+  // Approximate size in bytes including the locations
+  std::size_t memory() const;
+
+  // Approximate size in bytes of a shared location
+  static std::size_t memory(const Spine::Location& loc);
+
+ private:
+  Locations itsLocations;
+  std::vector<Spine::GeoId> itsGeoIds;  // sorted geoids of the locations in the same order
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
+
+// ======================================================================
@@ -0,0 +1,297 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class Metrics
+ */
+// ======================================================================
+
+#include "Metrics.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+namespace
+{
+const std::size_t shard_count = 16;
+
+// Four sub-buckets per power of two, the last bucket collects everything longer
+const unsigned int sub_bits = 2;
+const std::size_t sub_buckets = 1 << sub_bits;
+const std::size_t buckets = 128;
+
+std::size_t bucket(std::uint64_t value)
+{
+  if (value < sub_buckets)
+    return value;
+
+  unsigned int msb = 0;
+  for (auto v = value; v > 1; v >>= 1)
+    ++msb;
+
+  const std::size_t sub = (value >> (msb - sub_bits)) - sub_buckets;
+  return std::min((msb - sub_bits + 1) * sub_buckets + sub, buckets - 1);
+}
+
+// The largest value in a bucket
+std::uint64_t bucket_value(std::size_t index)
+{
+  if (index < sub_buckets)
+    return index;
+
+  const std::size_t msb = index / sub_buckets + sub_bits - 1;
+  const std::uint64_t sub = index % sub_buckets;
+  return ((sub_buckets + sub + 1) << (msb - sub_bits)) - 1;
+}
+
+std::atomic<std::size_t> next_shard{0};
+
+}  // namespace
+
+struct Metrics::Shard
+{
+  struct Series
+  {
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<std::uint64_t> max{0};
+    std::array<std::atomic<std::uint64_t>, buckets> histogram{};
+  };
+
+  struct Counters
+  {
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> failures{0};
+    std::atomic<std::uint64_t> cache_hits{0};
+    std::atomic<std::uint64_t> cache_misses{0};
+    std::array<Series, phases> series;
+  };
+
+  alignas(64) std::array<Counters, operations> counters;
+};
+
+Metrics::Metrics() : itsShards(new Shard[shard_count]) {}
+
+Metrics::~Metrics() = default;
+
+Metrics::Shard& Metrics::shard()
+{
+  thread_local const std::size_t index = next_shard++ % shard_count;
+  return itsShards[index];
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Record the latency of a phase started at the given time
+ */
+// ----------------------------------------------------------------------
+
+void Metrics::record(Operation theOperation,
+                     Phase thePhase,
+                     Clock::time_point theStart,
+                     std::size_t theCount)
+{
+  if (theCount == 0)
+    return;
+
+  using std::chrono::microseconds;
+  const auto elapsed = std::chrono::duration_cast<microseconds>(Clock::now() - theStart);
+  const auto total = static_cast<std::uint64_t>(std::max<std::int64_t>(0, elapsed.count()));
+  const auto value = total / theCount;
+
+  auto& series = shard().counters[static_cast<std::size_t>(theOperation)]
+                     .series[static_cast<std::size_t>(thePhase)];
+
+  series.count.fetch_add(theCount, std::memory_order_relaxed);
+  series.sum.fetch_add(total, std::memory_order_relaxed);
+  series.histogram[bucket(value)].fetch_add(theCount, std::memory_order_relaxed);
+
+  auto old = series.max.load(std::memory_order_relaxed);
+  while (value > old && !series.max.compare_exchange_weak(old, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+void Metrics::called(Operation theOperation, std::size_t theCount, bool theFailed)
+{
+  auto& counters = shard().counters[static_cast<std::size_t>(theOperation)];
+  counters.calls.fetch_add(theCount, std::memory_order_relaxed);
+  if (theFailed)
+    counters.failures.fetch_add(theCount, std::memory_order_relaxed);
+}
+
+void Metrics::cacheHit(Operation theOperation)
+{
+  shard().counters[static_cast<std::size_t>(theOperation)].cache_hits.fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+void Metrics::cacheMiss(Operation theOperation)
+{
+  shard().counters[static_cast<std::size_t>(theOperation)].cache_misses.fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Sum the shards of an operation
+ */
+// ----------------------------------------------------------------------
+
+Metrics::Summary Metrics::summary(Operation theOperation) const
+{
+  try
+  {
+    const auto op = static_cast<std::size_t>(theOperation);
+
+    Summary ret;
+    for (std::size_t phase = 0; phase < phases; phase++)
+    {
+      std::array<std::uint64_t, buckets> histogram{};
+      std::uint64_t sum = 0;
+      auto& latency = ret.latencies[phase];
+
+      for (std::size_t i = 0; i < shard_count; i++)
+      {
+        const auto& series = itsShards[i].counters[op].series[phase];
+        latency.count += series.count.load(std::memory_order_relaxed);
+        sum += series.sum.load(std::memory_order_relaxed);
+        latency.max = std::max(latency.max, series.max.load(std::memory_order_relaxed));
+        for (std::size_t b = 0; b < buckets; b++)
+          histogram[b] += series.histogram[b].load(std::memory_order_relaxed);
+      }
+
+      if (latency.count == 0)
+        continue;
+
+      latency.mean = sum / latency.count;
+
+      // The shards are not read atomically, hence use the total of the histogram
+      std::uint64_t total = 0;
+      for (auto n : histogram)
+        total += n;
+
+      const auto percentile = [&](double q)
+      {
+        const auto rank = static_cast<std::uint64_t>(std::ceil(q * total));
+        std::uint64_t seen = 0;
+        for (std::size_t b = 0; b < buckets; b++)
+        {
+          seen += histogram[b];
+          if (seen >= rank && seen > 0)
+            return std::min(bucket_value(b), latency.max);
+        }
+        return latency.max;
+      };
+
+      latency.p50 = percentile(0.5);
+      latency.p99 = percentile(0.99);
+      latency.p999 = percentile(0.999);
+    }
+
+    for (std::size_t i = 0; i < shard_count; i++)
+    {
+      const auto& counters = itsShards[i].counters[op];
+      ret.calls += counters.calls.load(std::memory_order_relaxed);
+      ret.failures += counters.failures.load(std::memory_order_relaxed);
+      ret.cache_hits += counters.cache_hits.load(std::memory_order_relaxed);
+      ret.cache_misses += counters.cache_misses.load(std::memory_order_relaxed);
+    }
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+const char* Metrics::name(Operation theOperation)
+{
+  switch (theOperation)
+  {
+    case Operation::NameSearch:
+      return "nameSearch";
+    case Operation::LonLatSearch:
+      return "lonlatSearch";
+    case Operation::IdSearch:
+      return "idSearch";
+    case Operation::KeywordSearch:
+      return "keywordSearch";
+    case Operation::Suggest:
+      return "suggest";
+    case Operation::ParseLocations:
+      return "parseLocations";
+    case Operation::WktSearch:
+      return "wktSearch";
+  }
+  return "unknown";
+}
+
+const char* Metrics::name(Phase thePhase)
+{
+  switch (thePhase)
+  {
+    case Phase::Total:
+      return "total";
+    case Phase::Memory:
+      return "memory";
+    case Phase::Database:
+      return "database";
+    case Phase::Translation:
+      return "translation";
+    case Phase::Queue:
+      return "queue";
+  }
+  return "unknown";
+}
+
+Metrics::Call::Call(Metrics& theMetrics, Operation theOperation, std::size_t theCount)
+    : itsMetrics(theMetrics),
+      itsOperation(theOperation),
+      itsCount(theCount),
+      itsExceptions(std::uncaught_exceptions()),
+      itsStart(Clock::now())
+{
+}
+
+Metrics::Call::~Call()
+{
+  try
+  {
+    const bool failed = (itsFailed || std::uncaught_exceptions() > itsExceptions);
+    itsMetrics.called(itsOperation, itsCount, failed);
+    itsMetrics.record(itsOperation, Phase::Total, itsStart, itsCount);
+  }
+  catch (...)
+  {
+    // Metrics must never break the searches
+  }
+}
+
+Metrics::Timer::Timer(Metrics& theMetrics, Operation theOperation, Phase thePhase)
+    : itsMetrics(theMetrics), itsOperation(theOperation), itsPhase(thePhase), itsStart(Clock::now())
+{
+}
+
+Metrics::Timer::~Timer()
+{
+  try
+  {
+    itsMetrics.record(itsOperation, itsPhase, itsStart);
+  }
+  catch (...)
+  {
+    // Metrics must never break the searches
+  }
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
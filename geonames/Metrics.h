@@ -0,0 +1,154 @@
+// ======================================================================
+/*!
+ * \brief Call counts and latency histograms of the engine entry points
+ *
+ * The counters are sharded so that threads update mostly separate cache
+ * lines. Each thread picks a shard when it first records something, and
+ * the shards are summed when the metrics are reported. Latencies are
+ * recorded in microseconds into logarithmic buckets with four linear
+ * sub-buckets per power of two, hence the reported percentiles are upper
+ * bounds within about 25% of the true values.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class Metrics
+{
+ public:
+  enum class Operation : std::size_t
+  {
+    NameSearch,
+    LonLatSearch,
+    IdSearch,
+    KeywordSearch,
+    Suggest,
+    ParseLocations,
+    WktSearch
+  };
+  static constexpr std::size_t operations = 7;
+
+  enum class Phase : std::size_t
+  {
+    Total,     // the whole call
+    Memory,    // searches answered from the loaded data
+    Database,  // database searches including waiting for a connection
+    Translation,
+    Queue  // waiting for a database connection
+  };
+  static constexpr std::size_t phases = 5;
+
+  using Clock = std::chrono::steady_clock;
+
+  // Latencies in microseconds
+  struct Latency
+  {
+    std::uint64_t count = 0;
+    std::uint64_t mean = 0;
+    std::uint64_t p50 = 0;
+    std::uint64_t p99 = 0;
+    std::uint64_t p999 = 0;
+    std::uint64_t max = 0;
+  };
+
+  struct Summary
+  {
+    std::uint64_t calls = 0;
+    std::uint64_t failures = 0;
+    std::uint64_t cache_hits = 0;
+    std::uint64_t cache_misses = 0;
+    std::array<Latency, phases> latencies;
+  };
+
+  // Records a call and its total latency. A batch counts every item as a call
+  // with the mean latency of its items, so that calls and latency samples
+  // stay comparable. A failed batch fails all its items.
+  class Call
+  {
+   public:
+    Call(Metrics& theMetrics, Operation theOperation, std::size_t theCount = 1);
+    ~Call();
+
+    Call() = delete;
+    Call(const Call& other) = delete;
+    Call& operator=(const Call& other) = delete;
+    Call(Call&& other) = delete;
+    Call& operator=(Call&& other) = delete;
+
+    // The call also fails if it is left by an exception
+    void fail() { itsFailed = true; }
+
+   private:
+    Metrics& itsMetrics;
+    Operation itsOperation;
+    std::size_t itsCount;
+    int itsExceptions;
+    bool itsFailed = false;
+    Clock::time_point itsStart;
+  };
+
+  // Records the latency of a phase of a call
+  class Timer
+  {
+   public:
+    Timer(Metrics& theMetrics, Operation theOperation, Phase thePhase);
+    ~Timer();
+
+    Timer() = delete;
+    Timer(const Timer& other) = delete;
+    Timer& operator=(const Timer& other) = delete;
+    Timer(Timer&& other) = delete;
+    Timer& operator=(Timer&& other) = delete;
+
+   private:
+    Metrics& itsMetrics;
+    Operation itsOperation;
+    Phase itsPhase;
+    Clock::time_point itsStart;
+  };
+
+  Metrics();
+  ~Metrics();
+
+  Metrics(const Metrics& other) = delete;
+  Metrics& operator=(const Metrics& other) = delete;
+  Metrics(Metrics&& other) = delete;
+  Metrics& operator=(Metrics&& other) = delete;
+
+  // Records the elapsed time divided evenly over the given number of samples
+  void record(Operation theOperation,
+              Phase thePhase,
+              Clock::time_point theStart,
+              std::size_t theCount = 1);
+  void cacheHit(Operation theOperation);
+  void cacheMiss(Operation theOperation);
+
+  Summary summary(Operation theOperation) const;
+
+  static const char* name(Operation theOperation);
+  static const char* name(Phase thePhase);
+
+ private:
+  struct Shard;
+  Shard& shard();
+
+  void called(Operation theOperation, std::size_t theCount, bool theFailed);
+
+  std::unique_ptr<Shard[]> itsShards;
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,338 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class PrefixIndex
+ */
+// ======================================================================
+
+#include "PrefixIndex.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <limits>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+namespace
+{
+// Compare the first characters of a key to a prefix as signed characters
+int compare_prefix(const char* key, std::size_t keylen, const std::string& prefix)
+{
+  const std::size_t n = std::min(keylen, prefix.size());
+  for (std::size_t i = 0; i < n; i++)
+  {
+    const auto a = static_cast<signed char>(key[i]);
+    const auto b = static_cast<signed char>(prefix[i]);
+    if (a != b)
+      return (a < b ? -1 : 1);
+  }
+  return (keylen < prefix.size() ? -1 : 0);
+}
+
+bool signed_less(const std::string& a, const std::string& b)
+{
+  const int cmp = compare_prefix(a.data(), a.size(), b);
+  return (cmp < 0 || (cmp == 0 && a.size() < b.size()));
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a key for a location
+ */
+// ----------------------------------------------------------------------
+
+void PrefixIndex::Builder::insert(const std::string& theKey, const Spine::LocationPtr& theLocation)
+{
+  try
+  {
+    auto number = static_cast<std::uint32_t>(itsValues.size());
+    auto pos = itsValueNumbers.emplace(theLocation.get(), number);
+    if (pos.second)
+      itsValues.push_back(theLocation);
+    else
+      number = pos.first->second;
+
+    itsKeys.emplace_back(theKey, number);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the index, the builder is left empty
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const PrefixIndex> PrefixIndex::Builder::build()
+{
+  try
+  {
+    // Stable sort so that the first inserted value of a key wins
+    std::stable_sort(itsKeys.begin(),
+                     itsKeys.end(),
+                     [](const auto& a, const auto& b) { return signed_less(a.first, b.first); });
+
+    auto index = std::make_shared<PrefixIndex>();
+
+    std::size_t total = 0;
+    for (const auto& key_value : itsKeys)
+      total += key_value.first.size();
+    if (total > std::numeric_limits<std::uint32_t>::max())
+      throw Fmi::Exception(BCP, "Too many names for a compact suggest index");
+
+    index->itsKeys.reserve(total);
+    index->itsKeyOffsets.reserve(itsKeys.size() + 1);
+    index->itsEntryValues.reserve(itsKeys.size());
+
+    // Only the values of the unique keys are needed
+
+    const auto unused = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> renumbered(itsValues.size(), unused);
+
+    for (std::size_t i = 0; i < itsKeys.size(); i++)
+    {
+      const auto& key = itsKeys[i].first;
+      if (i > 0 && key == itsKeys[i - 1].first)
+        continue;
+
+      auto& value = renumbered[itsKeys[i].second];
+      if (value == unused)
+      {
+        value = static_cast<std::uint32_t>(index->itsValues.size());
+        index->itsValues.push_back(itsValues[itsKeys[i].second]);
+      }
+
+      index->itsKeyOffsets.push_back(static_cast<std::uint32_t>(index->itsKeys.size()));
+      index->itsKeys += key;
+      index->itsEntryValues.push_back(value);
+    }
+    index->itsKeyOffsets.push_back(static_cast<std::uint32_t>(index->itsKeys.size()));
+
+    itsKeys.clear();
+    itsKeys.shrink_to_fit();
+    itsValues.clear();
+    itsValues.shrink_to_fit();
+    itsValueNumbers.clear();
+
+    return index;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compare an entry truncated to the prefix length to the prefix
+ */
+// ----------------------------------------------------------------------
+
+int PrefixIndex::compare(std::uint32_t theEntry, const std::string& thePrefix) const
+{
+  const auto first = itsKeyOffsets[theEntry];
+  const auto last = itsKeyOffsets[theEntry + 1];
+  const std::size_t len = std::min<std::size_t>(last - first, thePrefix.size());
+  return compare_prefix(itsKeys.data() + first, len, thePrefix);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The range of entries starting with the prefix
+ */
+// ----------------------------------------------------------------------
+
+std::pair<std::size_t, std::size_t> PrefixIndex::range(const std::string& thePrefix) const
+{
+  std::size_t lo = 0;
+  std::size_t hi = size();
+  while (lo < hi)
+  {
+    const auto mid = lo + (hi - lo) / 2;
+    if (compare(static_cast<std::uint32_t>(mid), thePrefix) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  const auto first = lo;
+  hi = size();
+  while (lo < hi)
+  {
+    const auto mid = lo + (hi - lo) / 2;
+    if (compare(static_cast<std::uint32_t>(mid), thePrefix) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return {first, lo};
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the locations of all the keys starting with the prefix
+ */
+// ----------------------------------------------------------------------
+
+PrefixIndex::Matches PrefixIndex::findprefix(const std::string& thePrefix) const
+{
+  try
+  {
+    Matches ret;
+    if (thePrefix.empty())
+      return ret;
+
+    const auto r = range(thePrefix);
+    for (auto i = r.first; i < r.second; i++)
+      ret.push_back(itsValues[itsEntryValues[i]]);
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the locations of the keys of a subset starting with the prefix
+ */
+// ----------------------------------------------------------------------
+
+PrefixIndex::Matches PrefixIndex::findprefix(const std::string& thePrefix,
+                                             const Subset& theSubset) const
+{
+  try
+  {
+    Matches ret;
+    if (thePrefix.empty())
+      return ret;
+
+    const auto r = range(thePrefix);
+    auto first = std::lower_bound(theSubset.begin(), theSubset.end(), r.first);
+    auto last = std::lower_bound(first, theSubset.end(), r.second);
+    for (auto it = first; it != last; ++it)
+      ret.push_back(itsValues[itsEntryValues[*it]]);
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the locations of the keys of each subset starting with the prefix
+ *
+ * The range of the prefix is searched only once. The matches of each
+ * subset are the same as from a separate search of the subset, a null
+ * subset matches all the keys.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<PrefixIndex::Matches> PrefixIndex::findprefix(
+    const std::string& thePrefix, const std::vector<const Subset*>& theSubsets) const
+{
+  try
+  {
+    std::vector<Matches> ret(theSubsets.size());
+    if (thePrefix.empty())
+      return ret;
+
+    const auto r = range(thePrefix);
+
+    for (std::size_t i = 0; i < theSubsets.size(); i++)
+    {
+      const auto* subset = theSubsets[i];
+      if (subset == nullptr)
+      {
+        for (auto entry = r.first; entry < r.second; entry++)
+          ret[i].push_back(itsValues[itsEntryValues[entry]]);
+      }
+      else
+      {
+        auto first = std::lower_bound(subset->begin(), subset->end(), r.first);
+        auto last = std::lower_bound(first, subset->end(), r.second);
+        for (auto it = first; it != last; ++it)
+          ret[i].push_back(itsValues[itsEntryValues[*it]]);
+      }
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build subsets for the given lists of locations
+ */
+// ----------------------------------------------------------------------
+
+std::vector<PrefixIndex::SubsetPtr> PrefixIndex::subsets(
+    const std::vector<const Spine::LocationList*>& theLists) const
+{
+  try
+  {
+    // Entries of each value
+
+    std::vector<std::uint32_t> counts(itsValues.size() + 1, 0);
+    for (auto value : itsEntryValues)
+      ++counts[value + 1];
+    for (std::size_t i = 1; i < counts.size(); i++)
+      counts[i] += counts[i - 1];
+
+    std::vector<std::uint32_t> entries(itsEntryValues.size());
+    {
+      auto next = counts;
+      for (std::size_t i = 0; i < itsEntryValues.size(); i++)
+        entries[next[itsEntryValues[i]]++] = static_cast<std::uint32_t>(i);
+    }
+
+    std::unordered_map<const Spine::Location*, std::uint32_t> values;
+    values.reserve(itsValues.size());
+    for (std::size_t i = 0; i < itsValues.size(); i++)
+      values.emplace(itsValues[i].get(), static_cast<std::uint32_t>(i));
+
+    std::vector<SubsetPtr> ret;
+    ret.reserve(theLists.size());
+
+    for (const auto* list : theLists)
+    {
+      auto subset = std::make_shared<Subset>();
+      for (const auto& loc : *list)
+      {
+        auto pos = values.find(loc.get());
+        if (pos == values.end())
+          continue;
+        subset->insert(subset->end(),
+                       entries.begin() + counts[pos->second],
+                       entries.begin() + counts[pos->second + 1]);
+      }
+      std::sort(subset->begin(), subset->end());
+      subset->erase(std::unique(subset->begin(), subset->end()), subset->end());
+      subset->shrink_to_fit();
+      ret.push_back(std::move(subset));
+    }
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
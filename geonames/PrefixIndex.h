@@ -0,0 +1,89 @@
+// ======================================================================
+/*!
+ * \brief Compact immutable index for finding names by prefix
+ *
+ * An alternative to Fmi::TernarySearchTree with the same findprefix
+ * semantics. The keys are stored sorted in a single character buffer,
+ * hence a prefix search is a binary search for a range of keys. Keys are
+ * ordered by signed characters just like in the ternary tree so that the
+ * matches are returned in the same order, and only the first value
+ * inserted for a key is kept.
+ *
+ * Subsets of the index, such as the names of the locations of a keyword,
+ * are sorted lists of entry positions instead of separate indexes.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <spine/Location.h>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class PrefixIndex
+{
+ public:
+  using Subset = std::vector<std::uint32_t>;  // sorted entry positions
+  using SubsetPtr = std::shared_ptr<const Subset>;
+
+  using Matches = std::list<Spine::LocationPtr>;
+
+  class Builder
+  {
+   public:
+    void insert(const std::string& theKey, const Spine::LocationPtr& theLocation);
+    std::shared_ptr<const PrefixIndex> build();
+
+   private:
+    std::vector<std::pair<std::string, std::uint32_t>> itsKeys;  // key and value number
+    std::vector<Spine::LocationPtr> itsValues;
+    std::unordered_map<const Spine::Location*, std::uint32_t> itsValueNumbers;
+  };
+
+  Matches findprefix(const std::string& thePrefix) const;
+  Matches findprefix(const std::string& thePrefix, const Subset& theSubset) const;
+  // Matches of each subset in turn, a null subset stands for all the keys
+  std::vector<Matches> findprefix(const std::string& thePrefix,
+                                  const std::vector<const Subset*>& theSubsets) const;
+
+  // The entries of each list of locations, empty subsets for unindexed lists
+  std::vector<SubsetPtr> subsets(const std::vector<const Spine::LocationList*>& theLists) const;
+
+  std::size_t size() const { return itsEntryValues.size(); }
+
+  // Approximate size in bytes excluding the shared locations
+  std::size_t memory() const
+  {
+    return itsKeys.capacity() + itsKeyOffsets.capacity() * sizeof(std::uint32_t) +
+           itsEntryValues.capacity() * sizeof(std::uint32_t) +
+           itsValues.capacity() * sizeof(Spine::LocationPtr);
+  }
+
+ private:
+  friend class Builder;
+
+  std::pair<std::size_t, std::size_t> range(const std::string& thePrefix) const;
+  int compare(std::uint32_t theEntry, const std::string& thePrefix) const;
+
+  std::string itsKeys;                       // sorted keys without separators
+  std::vector<std::uint32_t> itsKeyOffsets;  // entry i is [offsets[i], offsets[i+1])
+  std::vector<std::uint32_t> itsEntryValues;
+  std::vector<Spine::LocationPtr> itsValues;
+};
+
+using PrefixIndexPtr = std::shared_ptr<const PrefixIndex>;
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
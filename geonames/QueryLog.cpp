@@ -0,0 +1,322 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class QueryLog
+ */
+// ======================================================================
+
+#include "QueryLog.h"
+#include "Snapshot.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+namespace
+{
+// Increment whenever the contents of the file change
+const char* querylog_fingerprint = "querylog 1";
+
+std::string join(const std::list<std::string>& theValues)
+{
+  std::string ret;
+  for (const auto& value : theValues)
+  {
+    if (!ret.empty())
+      ret += ',';
+    ret += value;
+  }
+  return ret;
+}
+
+void write_options(SnapshotWriter& writer, const Locus::QueryOptions& options)
+{
+  writer.write(join(options.GetCountries()));
+  writer.write(join(options.GetFeatures()));
+  writer.write(options.GetLanguage());
+  writer.write(options.GetNameType());
+  writer.write(options.GetCharset());
+  writer.write(static_cast<std::uint64_t>(options.GetResultLimit()));
+  writer.write(static_cast<std::uint8_t>(options.GetSearchVariants()));
+  writer.write(static_cast<std::uint8_t>(options.GetFullCountrySearch()));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Search cache key part for the search options
+ *
+ * Only the options saved by write_options are used. A hash of all the
+ * options would not survive saving the query.
+ */
+// ----------------------------------------------------------------------
+
+std::string options_key(const Locus::QueryOptions& options)
+{
+  std::string key = options.GetLanguage();
+  key += '|';
+  key += join(options.GetCountries());
+  key += '|';
+  key += join(options.GetFeatures());
+  key += '|';
+  key += options.GetNameType();
+  key += '|';
+  key += options.GetCharset();
+  key += '|';
+  key += Fmi::to_string(options.GetResultLimit());
+  key += (options.GetSearchVariants() ? "|v" : "|-");
+  key += (options.GetFullCountrySearch() ? "f" : "-");
+  return key;
+}
+
+// Exact key part for a number
+std::string number_key(double value)
+{
+  std::uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return Fmi::to_string(bits);
+}
+
+Locus::QueryOptions read_options(SnapshotReader& reader)
+{
+  Locus::QueryOptions options;
+
+  // Setting an empty list would not restore the original empty list
+  const auto countries = reader.read_string();
+  if (!countries.empty())
+    options.SetCountries(countries);
+  const auto features = reader.read_string();
+  if (!features.empty())
+    options.SetFeatures(features);
+
+  options.SetLanguage(reader.read_string());
+  options.SetNameType(reader.read_string());
+  options.SetCharset(reader.read_string());
+  options.SetResultLimit(reader.read_uint64());
+  options.SetSearchVariants(reader.read_uint8() != 0);
+  options.SetFullCountrySearch(reader.read_uint8() != 0);
+  return options;
+}
+
+}  // namespace
+
+std::string QueryLog::name_key(const Locus::QueryOptions& theOptions, const std::string& theName)
+{
+  return "name|" + options_key(theOptions) + '|' + theName;
+}
+
+std::string QueryLog::lonlat_key(const Locus::QueryOptions& theOptions,
+                                 float theLongitude,
+                                 float theLatitude,
+                                 float theRadius)
+{
+  return "lonlat|" + options_key(theOptions) + '|' + number_key(theLongitude) + '|' +
+         number_key(theLatitude) + '|' + number_key(theRadius);
+}
+
+std::string QueryLog::id_key(const Locus::QueryOptions& theOptions, int theId)
+{
+  return "id|" + options_key(theOptions) + '|' + Fmi::to_string(theId);
+}
+
+std::string QueryLog::keyword_key(const Locus::QueryOptions& theOptions,
+                                  const std::string& theKeyword)
+{
+  return "keyword|" + options_key(theOptions) + '|' + theKeyword;
+}
+
+std::string QueryLog::key(const Query& theQuery)
+{
+  switch (theQuery.kind)
+  {
+    case Kind::LonLat:
+      return lonlat_key(
+          theQuery.options, theQuery.longitude, theQuery.latitude, theQuery.radius);
+    case Kind::Id:
+      return id_key(theQuery.options, theQuery.id);
+    case Kind::Keyword:
+      return keyword_key(theQuery.options, theQuery.name);
+    case Kind::Name:
+      break;
+  }
+  return name_key(theQuery.options, theQuery.name);
+}
+
+void QueryLog::resize(std::size_t theMaxSize)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  itsMaxSize = theMaxSize;
+  while (itsEntries.size() > itsMaxSize)
+  {
+    itsIndex.erase(itsEntries.back().first);
+    itsEntries.pop_back();
+  }
+}
+
+std::size_t QueryLog::maxSize() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsMaxSize;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move a logged query to the front
+ *
+ * Returns true also when logging is disabled, so that callers do not
+ * construct queries in vain.
+ */
+// ----------------------------------------------------------------------
+
+bool QueryLog::touch(const std::string& theKey)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  if (itsMaxSize == 0)
+    return true;
+
+  auto pos = itsIndex.find(theKey);
+  if (pos == itsIndex.end())
+    return false;
+
+  itsEntries.splice(itsEntries.begin(), itsEntries, pos->second);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Log a query as the most recently used one
+ */
+// ----------------------------------------------------------------------
+
+void QueryLog::insert(const std::string& theKey, Query theQuery)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    if (itsMaxSize == 0)
+      return;
+
+    auto pos = itsIndex.find(theKey);
+    if (pos != itsIndex.end())
+    {
+      itsEntries.splice(itsEntries.begin(), itsEntries, pos->second);
+      return;
+    }
+
+    itsEntries.emplace_front(theKey, std::move(theQuery));
+    itsIndex[theKey] = itsEntries.begin();
+
+    if (itsEntries.size() > itsMaxSize)
+    {
+      itsIndex.erase(itsEntries.back().first);
+      itsEntries.pop_back();
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::vector<QueryLog::Entry> QueryLog::hottest(std::size_t theCount) const
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    std::vector<Entry> ret;
+    ret.reserve(std::min(theCount, itsEntries.size()));
+    for (const auto& entry : itsEntries)
+    {
+      if (ret.size() >= theCount)
+        break;
+      ret.push_back(entry);
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Save the queries into a file
+ */
+// ----------------------------------------------------------------------
+
+void QueryLog::write(const std::string& theFilename, const std::vector<Entry>& theEntries)
+{
+  try
+  {
+    SnapshotWriter writer(theFilename, 0, querylog_fingerprint);
+
+    writer.write(static_cast<std::uint64_t>(theEntries.size()));
+    for (const auto& entry : theEntries)
+    {
+      const Query& query = entry.second;
+      writer.write(static_cast<std::uint8_t>(query.kind));
+      write_options(writer, query.options);
+      writer.write(query.name);
+      writer.write(query.longitude);
+      writer.write(query.latitude);
+      writer.write(query.radius);
+      writer.write(static_cast<std::int32_t>(query.id));
+    }
+
+    writer.commit();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("File", theFilename);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read the queries saved into a file, the most recently used first
+ */
+// ----------------------------------------------------------------------
+
+std::vector<QueryLog::Query> QueryLog::read(const std::string& theFilename)
+{
+  try
+  {
+    SnapshotReader reader(theFilename, 0, querylog_fingerprint);
+
+    const auto n = reader.read_uint64();
+
+    std::vector<Query> ret;
+    for (std::uint64_t i = 0; i < n; i++)
+    {
+      Query query;
+      const auto kind = reader.read_uint8();
+      if (kind > static_cast<std::uint8_t>(Kind::Keyword))
+        throw Fmi::Exception(BCP, "Invalid query type in query log");
+      query.kind = static_cast<Kind>(kind);
+      query.options = read_options(reader);
+      query.name = reader.read_string();
+      query.longitude = reader.read_float();
+      query.latitude = reader.read_float();
+      query.radius = reader.read_float();
+      query.id = reader.read_int32();
+      ret.push_back(std::move(query));
+    }
+
+    reader.finish();
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("File", theFilename);
+  }
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
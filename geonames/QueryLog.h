@@ -0,0 +1,92 @@
+// ======================================================================
+/*!
+ * \brief Log of the most recently used name search cache queries
+ *
+ * Remembers the queries needed to recreate the hottest name search cache
+ * entries in least recently used order. The log is used to warm up the
+ * cache of a reloaded engine before it replaces the old one, and it may
+ * be saved into a file so that a restarted engine can warm up too.
+ *
+ * The search cache keys are made here too. The options part of a key
+ * contains exactly the options saved into the file, hence a query read
+ * back from the file has the same key as the original query.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <locus/Query.h>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class QueryLog
+{
+ public:
+  enum class Kind
+  {
+    Name,
+    LonLat,
+    Id,
+    Keyword
+  };
+
+  struct Query
+  {
+    Kind kind = Kind::Name;
+    Locus::QueryOptions options;
+    std::string name;  // name or keyword
+    float longitude = 0;
+    float latitude = 0;
+    float radius = 0;
+    int id = 0;
+  };
+
+  using Entry = std::pair<std::string, Query>;  // cache key and query
+
+  // Search cache keys, unique also over different kinds of searches
+  static std::string key(const Query& theQuery);
+  static std::string name_key(const Locus::QueryOptions& theOptions, const std::string& theName);
+  static std::string lonlat_key(const Locus::QueryOptions& theOptions,
+                                float theLongitude,
+                                float theLatitude,
+                                float theRadius);
+  static std::string id_key(const Locus::QueryOptions& theOptions, int theId);
+  static std::string keyword_key(const Locus::QueryOptions& theOptions,
+                                 const std::string& theKeyword);
+
+  void resize(std::size_t theMaxSize);
+  std::size_t maxSize() const;
+
+  // Mark the query used, returns false if the query is not logged but should be
+  bool touch(const std::string& theKey);
+  void insert(const std::string& theKey, Query theQuery);
+
+  // At most the given number of queries, the most recently used first
+  std::vector<Entry> hottest(std::size_t theCount) const;
+
+  static void write(const std::string& theFilename, const std::vector<Entry>& theEntries);
+  static std::vector<Query> read(const std::string& theFilename);
+
+ private:
+  using Entries = std::list<Entry>;
+
+  mutable std::mutex itsMutex;
+  std::size_t itsMaxSize = 0;
+  Entries itsEntries;
+  std::unordered_map<std::string, Entries::iterator> itsIndex;
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
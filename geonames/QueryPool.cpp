@@ -0,0 +1,315 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class QueryPool
+ */
+// ======================================================================
+
+#include "QueryPool.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+using QueryPtr = std::shared_ptr<Locus::Query>;
+
+struct QueryPool::State
+{
+  struct Idle
+  {
+    QueryPtr query;
+    Clock::time_point since;
+  };
+
+  Factory factory;
+  Options options;
+
+  mutable std::mutex mutex;
+  std::condition_variable released;
+  std::deque<Idle> idle;  // the most recently released last
+  std::size_t connections = 0;
+  std::size_t waiting = 0;
+  bool cancelled = false;
+  std::uint64_t reserved = 0;
+  std::uint64_t opened = 0;
+  std::uint64_t closed = 0;
+  std::uint64_t timeouts = 0;
+  std::uint64_t failures = 0;
+
+  // Remove connections idle for too long, called with the mutex locked
+  void expire(Clock::time_point now, std::vector<QueryPtr>& expired)
+  {
+    while (!idle.empty() && connections > options.min_connections &&
+           now - idle.front().since > options.idle_timeout)
+    {
+      expired.push_back(std::move(idle.front().query));
+      idle.pop_front();
+      --connections;
+      ++closed;
+    }
+  }
+
+  void release(QueryPtr query)
+  {
+    // The connections are closed only after unlocking
+    std::vector<QueryPtr> expired;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cancelled)
+    {
+      expired.push_back(std::move(query));
+      --connections;
+      ++closed;
+    }
+    else
+    {
+      const auto now = Clock::now();
+      idle.push_back(Idle{std::move(query), now});
+      expire(now, expired);
+    }
+    released.notify_one();
+  }
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Destructor fails the callers still waiting for a connection
+ */
+// ----------------------------------------------------------------------
+
+QueryPool::~QueryPool()
+{
+  try
+  {
+    cancel();
+  }
+  catch (...)
+  {
+    // Destructors must not throw
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open the minimum number of connections unless the pool is lazy
+ */
+// ----------------------------------------------------------------------
+
+QueryPool::QueryPool(std::string theName, Factory theFactory, const Options& theOptions)
+    : itsName(std::move(theName)), itsOptions(theOptions), itsState(std::make_shared<State>())
+{
+  try
+  {
+    if (itsOptions.max_connections == 0)
+      throw Fmi::Exception(BCP, "Database connection pool must allow at least one connection")
+          .addParameter("Pool", itsName);
+
+    itsOptions.min_connections = std::min(itsOptions.min_connections, itsOptions.max_connections);
+
+    itsState->factory = std::move(theFactory);
+    itsState->options = itsOptions;
+
+    if (itsOptions.lazy)
+      return;
+
+    const auto now = Clock::now();
+    for (std::size_t i = 0; i < itsOptions.min_connections; i++)
+    {
+      itsState->idle.push_back(State::Idle{itsState->factory(), now});
+      ++itsState->connections;
+      ++itsState->opened;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Constructor failed!").addParameter("Pool", itsName);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Reserve a connection, opening a new one if all are busy
+ *
+ * Waits at most for the wait timeout and not beyond the deadline.
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<Locus::Query> QueryPool::reserve(Clock::time_point theDeadline)
+{
+  try
+  {
+    auto& state = *itsState;
+
+    auto until = theDeadline;
+    if (itsOptions.wait_timeout.count() > 0)
+      until = std::min(until, Clock::now() + itsOptions.wait_timeout);
+
+    QueryPtr query;
+    bool open = false;
+    std::vector<QueryPtr> expired;
+    {
+      std::unique_lock<std::mutex> lock(state.mutex);
+      state.expire(Clock::now(), expired);
+      while (true)
+      {
+        if (state.cancelled)
+          throw Fmi::Exception(BCP, "Database connection pool has been shut down");
+
+        if (!state.idle.empty())
+        {
+          query = std::move(state.idle.back().query);
+          state.idle.pop_back();
+          break;
+        }
+
+        // Reserve the slot now and open the connection after unlocking
+        if (state.connections < itsOptions.max_connections)
+        {
+          ++state.connections;
+          open = true;
+          break;
+        }
+
+        if (until != Clock::time_point::max() && Clock::now() >= until)
+        {
+          ++state.timeouts;
+          throw Fmi::Exception(BCP, "Timed out waiting for a database connection")
+              .addParameter("Connections", Fmi::to_string(state.connections))
+              .addParameter("Waiting", Fmi::to_string(state.waiting));
+        }
+
+        ++state.waiting;
+        if (until == Clock::time_point::max())
+          state.released.wait(lock);
+        else
+          state.released.wait_until(lock, until);
+        --state.waiting;
+      }
+      ++state.reserved;
+    }
+
+    if (open)
+    {
+      try
+      {
+        query = state.factory();
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        --state.connections;
+        ++state.failures;
+        state.released.notify_one();
+        throw Fmi::Exception::Trace(BCP, "Failed to open a database connection");
+      }
+      std::lock_guard<std::mutex> lock(state.mutex);
+      ++state.opened;
+    }
+
+    // The deleter returns the connection to the pool
+    auto* ptr = query.get();
+    return {ptr,
+            [state = itsState, query = std::move(query)](Locus::Query* /* ptr */) mutable
+            {
+              try
+              {
+                state->release(std::move(query));
+              }
+              catch (...)
+              {
+                // Deleters must not throw
+              }
+            }};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Pool", itsName);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Reserve a connection, or one from the fallback pool on failure
+ *
+ * Failing to open a connection, timing out while all connections are
+ * busy and a cancelled pool all fall back to the other pool, which
+ * waits at most until the same deadline.
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<Locus::Query> QueryPool::reserve(QueryPool& theFallback,
+                                                 Clock::time_point theDeadline)
+{
+  try
+  {
+    return reserve(theDeadline);
+  }
+  catch (...)
+  {
+    // Timeouts and failed connections are counted in the status of this pool
+  }
+
+  try
+  {
+    return theFallback.reserve(theDeadline);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Pool", itsName);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Close the idle connections and fail all reservations
+ *
+ * Reserved connections are closed when they are released.
+ */
+// ----------------------------------------------------------------------
+
+void QueryPool::cancel()
+{
+  try
+  {
+    std::deque<State::Idle> idle;
+    {
+      std::lock_guard<std::mutex> lock(itsState->mutex);
+      itsState->cancelled = true;
+      std::swap(idle, itsState->idle);
+      itsState->connections -= idle.size();
+      itsState->closed += idle.size();
+      itsState->released.notify_all();
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Pool", itsName);
+  }
+}
+
+QueryPool::Status QueryPool::status() const
+{
+  std::lock_guard<std::mutex> lock(itsState->mutex);
+  Status ret;
+  ret.connections = itsState->connections;
+  ret.idle = itsState->idle.size();
+  ret.waiting = itsState->waiting;
+  ret.reserved = itsState->reserved;
+  ret.opened = itsState->opened;
+  ret.closed = itsState->closed;
+  ret.timeouts = itsState->timeouts;
+  ret.failures = itsState->failures;
+  return ret;
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
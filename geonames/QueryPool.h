@@ -0,0 +1,95 @@
+// ======================================================================
+/*!
+ * \brief Pool of database connections for the Locus searches
+ *
+ * The pool opens the minimum number of connections at once, or on demand
+ * if the pool is lazy, and more on demand up to the maximum. Connections beyond the minimum are closed once
+ * they have been idle for the idle timeout. When all connections are busy
+ * the callers wait for one to be released, but at most for the wait
+ * timeout or until their deadline, after which the reservation fails
+ * instead of tying up the calling thread. A reserved connection is
+ * returned to the pool when the last copy of the returned pointer is
+ * destroyed, even if the pool itself has been destroyed first.
+ *
+ * A pool used only as an alternative to another one, such as a read
+ * replica, can reserve from the other pool whenever its own reservation
+ * fails.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <locus/Query.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class QueryPool
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Factory = std::function<std::shared_ptr<Locus::Query>()>;
+
+  struct Options
+  {
+    std::size_t min_connections = 30;
+    std::size_t max_connections = 100;
+    std::chrono::milliseconds wait_timeout{5000};  // 0 = wait until the deadline
+    std::chrono::seconds idle_timeout{300};
+    bool lazy = false;  // do not open the minimum number of connections at once
+  };
+
+  struct Status
+  {
+    std::size_t connections = 0;  // open connections including those being opened
+    std::size_t idle = 0;
+    std::size_t waiting = 0;  // callers waiting for a connection
+    std::uint64_t reserved = 0;
+    std::uint64_t opened = 0;
+    std::uint64_t closed = 0;
+    std::uint64_t timeouts = 0;
+    std::uint64_t failures = 0;  // connections which could not be opened
+  };
+
+  ~QueryPool();
+  QueryPool(std::string theName, Factory theFactory, const Options& theOptions);
+
+  QueryPool() = delete;
+  QueryPool(const QueryPool& other) = delete;
+  QueryPool& operator=(const QueryPool& other) = delete;
+  QueryPool(QueryPool&& other) = delete;
+  QueryPool& operator=(QueryPool&& other) = delete;
+
+  std::shared_ptr<Locus::Query> reserve(Clock::time_point theDeadline = Clock::time_point::max());
+
+  // Reserve from the fallback pool if no connection could be reserved from this one
+  std::shared_ptr<Locus::Query> reserve(QueryPool& theFallback,
+                                        Clock::time_point theDeadline = Clock::time_point::max());
+
+  // Fail all current and future reservations
+  void cancel();
+
+  const std::string& name() const { return itsName; }
+  const Options& options() const { return itsOptions; }
+  Status status() const;
+
+ private:
+  struct State;
+
+  std::string itsName;
+  Options itsOptions;
+  std::shared_ptr<State> itsState;  // shared with the reserved connections
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,91 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class SingleFlight
+ */
+// ======================================================================
+
+#include "SingleFlight.h"
+#include <macgyver/Exception.h>
+#include <exception>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run the search unless an identical one is already running
+ */
+// ----------------------------------------------------------------------
+
+Spine::LocationList SingleFlight::run(const std::string& theKey,
+                                      const Search& theSearch,
+                                      Clock::time_point theDeadline)
+{
+  std::promise<Spine::LocationList> promise;
+
+  {
+    std::unique_lock<std::mutex> lock(itsMutex);
+    auto pos = itsFlights.find(theKey);
+    if (pos != itsFlights.end())
+    {
+      ++itsCoalesced;
+      auto flight = pos->second;
+      lock.unlock();
+      if (theDeadline != Clock::time_point::max() &&
+          flight.wait_until(theDeadline) == std::future_status::timeout)
+        throw Fmi::Exception(BCP, "Timed out waiting for an identical search");
+      return flight.get();
+    }
+    itsFlights.emplace(theKey, promise.get_future().share());
+    ++itsStarted;
+  }
+
+  Spine::LocationList result;
+  std::exception_ptr error;
+  try
+  {
+    result = theSearch();
+    promise.set_value(result);
+  }
+  catch (...)
+  {
+    error = std::current_exception();
+    promise.set_exception(error);
+  }
+
+  // Later callers will find the result from the cache instead
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsFlights.erase(theKey);
+  }
+
+  if (error)
+    std::rethrow_exception(error);
+
+  return result;
+}
+
+std::size_t SingleFlight::started() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsStarted;
+}
+
+std::size_t SingleFlight::coalesced() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsCoalesced;
+}
+
+std::size_t SingleFlight::inflight() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsFlights.size();
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,55 @@
+// ======================================================================
+/*!
+ * \brief Coalescing of concurrent identical searches
+ *
+ * The first caller for a key runs the search while any callers arriving
+ * with the same key before it finishes wait for and share its result,
+ * including a possible failure. Keys are the same keys the search results
+ * are cached with. A waiting caller gives up at its deadline, the search
+ * itself continues and its result is cached as usual.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <spine/Location.h>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class SingleFlight
+{
+ public:
+  using Search = std::function<Spine::LocationList()>;
+  using Clock = std::chrono::steady_clock;
+
+  Spine::LocationList run(const std::string& theKey,
+                          const Search& theSearch,
+                          Clock::time_point theDeadline = Clock::time_point::max());
+
+  std::size_t started() const;    // searches run
+  std::size_t coalesced() const;  // callers which waited for another search
+  std::size_t inflight() const;   // searches currently running
+
+ private:
+  using Flight = std::shared_future<Spine::LocationList>;
+
+  mutable std::mutex itsMutex;
+  std::unordered_map<std::string, Flight> itsFlights;
+  std::size_t itsStarted = 0;
+  std::size_t itsCoalesced = 0;
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,231 @@
+// ======================================================================
+/*!
+ * \brief Implementation of snapshot files
+ */
+// ======================================================================
+
+#include "Snapshot.h"
+#include <macgyver/Exception.h>
+#include <cstdio>
+#include <unistd.h>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+namespace
+{
+const char* snapshot_magic = "FMIGEOSNAPSHOT";
+
+// Increment whenever the contents of the snapshot change
+const std::uint64_t snapshot_version = 1;
+
+// Sanity limit for string lengths to detect corrupt files early
+const std::uint64_t max_string_length = 100000000;
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open a temporary file for the snapshot and write the header
+ */
+// ----------------------------------------------------------------------
+
+SnapshotWriter::SnapshotWriter(std::string theFilename,
+                               std::uint64_t theHash,
+                               const std::string& theFingerprint)
+    : itsFilename(std::move(theFilename)),
+      itsTmpFilename(itsFilename + ".tmp." + std::to_string(getpid()))
+{
+  try
+  {
+    itsOutput.open(itsTmpFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!itsOutput)
+      throw Fmi::Exception(BCP, "Failed to open snapshot file for writing")
+          .addParameter("File", itsTmpFilename);
+
+    write(std::string(snapshot_magic));
+    write(snapshot_version);
+    write(theHash);
+    write(theFingerprint);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove the temporary file unless the snapshot was committed
+ */
+// ----------------------------------------------------------------------
+
+SnapshotWriter::~SnapshotWriter()
+{
+  if (itsCommitted)
+    return;
+
+  itsOutput.close();
+  std::remove(itsTmpFilename.c_str());
+}
+
+void SnapshotWriter::write(std::uint8_t value)
+{
+  itsOutput.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void SnapshotWriter::write(std::int32_t value)
+{
+  itsOutput.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void SnapshotWriter::write(std::uint64_t value)
+{
+  itsOutput.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void SnapshotWriter::write(float value)
+{
+  itsOutput.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void SnapshotWriter::write(double value)
+{
+  itsOutput.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void SnapshotWriter::write(const std::string& value)
+{
+  write(static_cast<std::uint64_t>(value.size()));
+  itsOutput.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Finish the snapshot and rename it over the final file
+ */
+// ----------------------------------------------------------------------
+
+void SnapshotWriter::commit()
+{
+  try
+  {
+    itsOutput.close();
+    if (!itsOutput)
+      throw Fmi::Exception(BCP, "Failed to write snapshot file")
+          .addParameter("File", itsTmpFilename);
+
+    if (std::rename(itsTmpFilename.c_str(), itsFilename.c_str()) != 0)
+      throw Fmi::Exception(BCP, "Failed to rename snapshot file")
+          .addParameter("From", itsTmpFilename)
+          .addParameter("To", itsFilename);
+
+    itsCommitted = true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open a snapshot and validate the header
+ */
+// ----------------------------------------------------------------------
+
+SnapshotReader::SnapshotReader(const std::string& theFilename,
+                               std::uint64_t theHash,
+                               const std::string& theFingerprint)
+    : itsFilename(theFilename)
+{
+  try
+  {
+    itsInput.open(itsFilename, std::ios::in | std::ios::binary);
+    if (!itsInput)
+      throw Fmi::Exception(BCP, "Failed to open snapshot file").addParameter("File", itsFilename);
+
+    if (read_string() != snapshot_magic)
+      throw Fmi::Exception(BCP, "Not a geonames snapshot file").addParameter("File", itsFilename);
+
+    if (read_uint64() != snapshot_version)
+      throw Fmi::Exception(BCP, "Snapshot version mismatch").addParameter("File", itsFilename);
+
+    if (read_uint64() != theHash)
+      throw Fmi::Exception(BCP, "Snapshot is out of date").addParameter("File", itsFilename);
+
+    if (read_string() != theFingerprint)
+      throw Fmi::Exception(BCP, "Snapshot was created with different settings")
+          .addParameter("File", itsFilename);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+template <typename T>
+T SnapshotReader::read_value()
+{
+  T value;
+  itsInput.read(reinterpret_cast<char*>(&value), sizeof(value));
+  if (!itsInput)
+    throw Fmi::Exception(BCP, "Snapshot file is truncated").addParameter("File", itsFilename);
+  return value;
+}
+
+std::uint8_t SnapshotReader::read_uint8()
+{
+  return read_value<std::uint8_t>();
+}
+
+std::int32_t SnapshotReader::read_int32()
+{
+  return read_value<std::int32_t>();
+}
+
+std::uint64_t SnapshotReader::read_uint64()
+{
+  return read_value<std::uint64_t>();
+}
+
+float SnapshotReader::read_float()
+{
+  return read_value<float>();
+}
+
+double SnapshotReader::read_double()
+{
+  return read_value<double>();
+}
+
+std::string SnapshotReader::read_string()
+{
+  const auto length = read_uint64();
+  if (length > max_string_length)
+    throw Fmi::Exception(BCP, "Snapshot file is corrupt").addParameter("File", itsFilename);
+
+  std::string value(length, '\0');
+  itsInput.read(value.data(), static_cast<std::streamsize>(length));
+  if (!itsInput)
+    throw Fmi::Exception(BCP, "Snapshot file is truncated").addParameter("File", itsFilename);
+  return value;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Verify the whole snapshot has been read
+ */
+// ----------------------------------------------------------------------
+
+void SnapshotReader::finish()
+{
+  if (itsInput.peek() != std::char_traits<char>::eof())
+    throw Fmi::Exception(BCP, "Snapshot file has trailing data").addParameter("File", itsFilename);
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,94 @@
+// ======================================================================
+/*!
+ * \brief Binary snapshot files of the loaded geonames data
+ *
+ * A snapshot starts with a magic string, a format version, the database
+ * hash value and a fingerprint of the settings which affect the loaded
+ * data. A snapshot is valid only if all of these match. The data is
+ * stored in native byte order, snapshots are not meant to be moved
+ * between different architectures.
+ *
+ * The writer writes into a temporary file which is renamed over the
+ * final file only when commit() is called, hence readers never see
+ * partially written snapshots.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class SnapshotWriter
+{
+ public:
+  ~SnapshotWriter();
+  SnapshotWriter(std::string theFilename,
+                 std::uint64_t theHash,
+                 const std::string& theFingerprint);
+
+  SnapshotWriter() = delete;
+  SnapshotWriter(const SnapshotWriter& other) = delete;
+  SnapshotWriter& operator=(const SnapshotWriter& other) = delete;
+  SnapshotWriter(SnapshotWriter&& other) = delete;
+  SnapshotWriter& operator=(SnapshotWriter&& other) = delete;
+
+  void write(std::uint8_t value);
+  void write(std::int32_t value);
+  void write(std::uint64_t value);
+  void write(float value);
+  void write(double value);
+  void write(const std::string& value);
+
+  // Finish writing and replace the final file
+  void commit();
+
+ private:
+  std::string itsFilename;
+  std::string itsTmpFilename;
+  std::ofstream itsOutput;
+  bool itsCommitted = false;
+};
+
+class SnapshotReader
+{
+ public:
+  // Throws if the file cannot be opened or if the header does not match
+  SnapshotReader(const std::string& theFilename,
+                 std::uint64_t theHash,
+                 const std::string& theFingerprint);
+
+  SnapshotReader() = delete;
+  SnapshotReader(const SnapshotReader& other) = delete;
+  SnapshotReader& operator=(const SnapshotReader& other) = delete;
+  SnapshotReader(SnapshotReader&& other) = delete;
+  SnapshotReader& operator=(SnapshotReader&& other) = delete;
+
+  std::uint8_t read_uint8();
+  std::int32_t read_int32();
+  std::uint64_t read_uint64();
+  float read_float();
+  double read_double();
+  std::string read_string();
+
+  // Throws if there is unread data left
+  void finish();
+
+ private:
+  template <typename T>
+  T read_value();
+
+  std::string itsFilename;
+  std::ifstream itsInput;
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
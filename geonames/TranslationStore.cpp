@@ -0,0 +1,183 @@
+// ======================================================================
+/*!
+ * \brief Implementation of class TranslationStore
+ */
+// ======================================================================
+
+#include "TranslationStore.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <limits>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a new translation
+ */
+// ----------------------------------------------------------------------
+
+void TranslationStore::add(int id, const std::string& language, const std::string& name)
+{
+  try
+  {
+    auto pos = itsLanguageIds.find(language);
+    if (pos == itsLanguageIds.end())
+    {
+      if (itsLanguages.size() > std::numeric_limits<std::uint16_t>::max())
+        throw Fmi::Exception(BCP, "Too many translation languages")
+            .addParameter("Language", language);
+
+      auto lang = static_cast<std::uint16_t>(itsLanguages.size());
+      itsLanguages.push_back(language);
+      pos = itsLanguageIds.insert(std::make_pair(language, lang)).first;
+    }
+
+    if (itsArena.size() + name.size() > std::numeric_limits<std::uint32_t>::max())
+      throw Fmi::Exception(BCP, "Too many translations");
+
+    Entry entry{static_cast<std::uint32_t>(itsArena.size()),
+                static_cast<std::uint32_t>(name.size()),
+                pos->second};
+    itsArena.append(name);
+    itsStaged.push_back(Staged{id, entry});
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the CSR index from the added translations
+ */
+// ----------------------------------------------------------------------
+
+void TranslationStore::finalize()
+{
+  try
+  {
+    // Stable sort so that the first added translation for each language wins
+
+    std::stable_sort(itsStaged.begin(),
+                     itsStaged.end(),
+                     [](const Staged& a, const Staged& b)
+                     {
+                       if (a.id != b.id)
+                         return (a.id < b.id);
+                       return (a.entry.language < b.entry.language);
+                     });
+
+    auto last = std::unique(itsStaged.begin(),
+                            itsStaged.end(),
+                            [](const Staged& a, const Staged& b)
+                            { return (a.id == b.id && a.entry.language == b.entry.language); });
+    itsStaged.erase(last, itsStaged.end());
+
+    // Merge with possible previously finalized data is not supported, start from scratch
+
+    itsIds.clear();
+    itsOffsets.clear();
+    itsEntries.clear();
+    itsEntries.reserve(itsStaged.size());
+
+    for (const auto& staged : itsStaged)
+    {
+      if (itsIds.empty() || itsIds.back() != staged.id)
+      {
+        itsIds.push_back(staged.id);
+        itsOffsets.push_back(static_cast<std::uint32_t>(itsEntries.size()));
+      }
+      itsEntries.push_back(staged.entry);
+    }
+    itsOffsets.push_back(static_cast<std::uint32_t>(itsEntries.size()));
+
+    std::vector<Staged>().swap(itsStaged);
+    itsArena.shrink_to_fit();
+    itsIds.shrink_to_fit();
+    itsOffsets.shrink_to_fit();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the translations for the given row
+ */
+// ----------------------------------------------------------------------
+
+TranslationStore::Range TranslationStore::translations(std::size_t row) const
+{
+  const Entry* base = itsEntries.data();
+  return {base + itsOffsets[row], base + itsOffsets[row + 1]};
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the translations for the given id
+ */
+// ----------------------------------------------------------------------
+
+TranslationStore::Range TranslationStore::find(int id) const
+{
+  auto pos = std::lower_bound(itsIds.begin(), itsIds.end(), id);
+  if (pos == itsIds.end() || *pos != id)
+    return {nullptr, nullptr};
+  return translations(pos - itsIds.begin());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the translation for the given id and language
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::string_view> TranslationStore::find(int id, const std::string& language) const
+{
+  auto range = find(id);
+  if (range.first == range.second)
+    return {};
+
+  auto lang = language_id(language);
+  if (!lang)
+    return {};
+
+  auto pos = std::lower_bound(range.first,
+                              range.second,
+                              *lang,
+                              [](const Entry& entry, std::uint16_t value)
+                              { return entry.language < value; });
+
+  if (pos == range.second || pos->language != *lang)
+    return {};
+
+  return name(*pos);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the interned language number
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::uint16_t> TranslationStore::language_id(const std::string& language) const
+{
+  auto pos = itsLanguageIds.find(language);
+  if (pos == itsLanguageIds.end())
+    return {};
+  return pos->second;
+}
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
+
+// ======================================================================
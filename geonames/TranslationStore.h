@@ -0,0 +1,98 @@
+// ======================================================================
+/*!
+ * \brief Compact storage for translations of locations or municipalities
+ *
+ * Translations are stored in CSR form: the ids with translations are kept
+ * in a sorted array, and each id owns a contiguous range of entries
+ * sorted by language. Languages are interned into small integers and all
+ * the names are stored in a single character arena.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class TranslationStore
+{
+ public:
+  struct Entry
+  {
+    std::uint32_t offset;    // position of the name in the arena
+    std::uint32_t length;    // length of the name
+    std::uint16_t language;  // interned language
+  };
+
+  using Range = std::pair<const Entry*, const Entry*>;
+
+  // Add a translation. The first translation added for an id and language is kept.
+  // Lookups are not possible until finalize() is called.
+  void add(int id, const std::string& language, const std::string& name);
+
+  // Build the index
+  void finalize();
+
+  // Find a translation
+  std::optional<std::string_view> find(int id, const std::string& language) const;
+
+  // Number of ids with translations
+  std::size_t size() const { return itsIds.size(); }
+  bool empty() const { return itsIds.empty(); }
+
+  // Approximate size in bytes
+  std::size_t memory() const
+  {
+    return itsIds.capacity() * sizeof(int) + itsOffsets.capacity() * sizeof(std::uint32_t) +
+           itsEntries.capacity() * sizeof(Entry) + itsArena.capacity();
+  }
+
+  // Access by row number in 0...size()-1
+  int id(std::size_t row) const { return itsIds[row]; }
+  Range translations(std::size_t row) const;
+
+  // Access by id, returns an empty range if there are no translations
+  Range find(int id) const;
+
+  const std::string& language(const Entry& entry) const { return itsLanguages[entry.language]; }
+  std::string_view name(const Entry& entry) const
+  {
+    return std::string_view(itsArena.data() + entry.offset, entry.length);
+  }
+
+ private:
+  std::optional<std::uint16_t> language_id(const std::string& language) const;
+
+  struct Staged
+  {
+    int id;
+    Entry entry;
+  };
+
+  std::vector<Staged> itsStaged;  // cleared by finalize()
+
+  std::vector<int> itsIds;                // sorted ids
+  std::vector<std::uint32_t> itsOffsets;  // itsIds.size()+1 offsets into itsEntries
+  std::vector<Entry> itsEntries;          // entries sorted by id and language
+  std::string itsArena;                   // all names back to back
+
+  std::vector<std::string> itsLanguages;                             // language id to name
+  std::map<std::string, std::uint16_t, std::less<>> itsLanguageIds;  // name to language id
+};
+
+}  // namespace Geonames
+}  // namespace Engine
+}  // namespace SmartMet
+
+// ======================================================================
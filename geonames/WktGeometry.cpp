@@ -148,8 +148,59 @@ bool is_multi_geometry(const OGRGeometry& geom)
   return ret;
 }
 
+// Center of the bounding box, used for finding the nearest place
+std::pair<double, double> get_center(const OGRGeometry* geom)
+{
+  OGREnvelope envelope;
+  geom->getEnvelope(&envelope);
+  return {(envelope.MaxX + envelope.MinX) / 2.0, (envelope.MaxY + envelope.MinY) / 2.0};
+}
+
 }  // namespace
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the WKT and create the SVG paths
+ */
+// ----------------------------------------------------------------------
+
+WktShape::WktShape(const std::string& wkt, double radius)
+{
+  try
+  {
+    itsGeom = get_ogr_geometry(wkt, radius).release();
+    if (itsGeom == nullptr)
+      throw Fmi::Exception(BCP, "Invalid WKT: " + wkt);
+
+    itsSvgPath = get_svg_path(*itsGeom);
+
+    if (is_multi_geometry(*itsGeom))
+    {
+      itsParts = get_geometry_list(itsGeom);
+      for (const auto* g : itsParts)
+        itsSvgPaths.push_back(get_svg_path(*g));
+    }
+  }
+  catch (...)
+  {
+    if (itsGeom)
+      OGRGeometryFactory::destroyGeometry(itsGeom);
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Destroy OGRGeometry object
+ */
+// ----------------------------------------------------------------------
+
+WktShape::~WktShape()
+{
+  if (itsGeom)
+    OGRGeometryFactory::destroyGeometry(itsGeom);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Initialize the WktGeometry object
@@ -162,11 +213,8 @@ void WktGeometry::init(const Spine::LocationPtr& loc,
 {
   try
   {
-    // Create OGRGeometry
-    geometryFromWkt(loc->name, loc->radius);
-
-    // Get SVG-path
-    svgPathsFromGeometry();
+    // Create OGRGeometry and the SVG-paths, or get them from the cache
+    geometryFromWkt(loc->name, loc->radius, geoengine);
 
     // Get locations from OGRGeometry; OGRMulti* geometries may contain many locations
     locationsFromGeometry(loc, language, geoengine);
@@ -183,7 +231,9 @@ void WktGeometry::init(const Spine::LocationPtr& loc,
  */
 // ----------------------------------------------------------------------
 
-void WktGeometry::geometryFromWkt(const std::string& wktString, double radius)
+void WktGeometry::geometryFromWkt(const std::string& wktString,
+                                  double radius,
+                                  const SmartMet::Engine::Geonames::Engine& geoengine)
 {
   if (wktString.find(" as") != std::string::npos)
     itsName = wktString.substr(wktString.find(" as") + 3);
@@ -197,30 +247,15 @@ void WktGeometry::geometryFromWkt(const std::string& wktString, double radius)
     }
   }
 
-  itsGeom = get_ogr_geometry(wktString, radius).release();
-}
-
-// ----------------------------------------------------------------------
-/*!
- * \brief Create NFmiSvgPath object(s) from OGRGeometry
- */
-// ----------------------------------------------------------------------
-
-void WktGeometry::svgPathsFromGeometry()
-{
-  itsSvgPath = get_svg_path(*itsGeom);
-
-  if (is_multi_geometry(*itsGeom))
-  {
-    std::list<const OGRGeometry*> glist = get_geometry_list(itsGeom);
-    for (const auto* g : glist)
-      itsSvgPaths.push_back(get_svg_path(*g));
-  }
+  itsShape = geoengine.wktShape(wktString, radius);
 }
 
 // ----------------------------------------------------------------------
 /*!
  * \brief Create Spine::LocationPtr objects from OGRGeometry
+ *
+ * The nearest places of the geometry and its parts are searched with a
+ * single batch.
  */
 // ----------------------------------------------------------------------
 
@@ -228,14 +263,22 @@ void WktGeometry::locationsFromGeometry(const Spine::LocationPtr& loc,
                                         const std::string& language,
                                         const SmartMet::Engine::Geonames::Engine& geoengine)
 {
-  itsLocation = locationFromGeometry(itsGeom, loc, language, geoengine);
+  const auto& parts = itsShape->getParts();
 
-  if (is_multi_geometry(*itsGeom))
-  {
-    std::list<const OGRGeometry*> glist = get_geometry_list(itsGeom);
-    for (const auto* g : glist)
-      itsLocations.push_back(locationFromGeometry(g, loc, language, geoengine));
-  }
+  std::vector<std::pair<double, double>> centers;
+  centers.reserve(1 + parts.size());
+  centers.push_back(get_center(itsShape->getGeometry()));
+  for (const auto* g : parts)
+    centers.push_back(get_center(g));
+
+  std::string features;  // use defaults
+  auto geolocs = geoengine.featureSearch(centers, language, features);
+
+  itsLocation = locationFromGeometry(itsShape->getGeometry(), geolocs[0], loc);
+
+  std::size_t i = 1;
+  for (const auto* g : parts)
+    itsLocations.push_back(locationFromGeometry(g, geolocs[i++], loc));
 }
 
 // ----------------------------------------------------------------------
@@ -244,22 +287,10 @@ void WktGeometry::locationsFromGeometry(const Spine::LocationPtr& loc,
  */
 // ----------------------------------------------------------------------
 
-Spine::LocationPtr WktGeometry::locationFromGeometry(
-    const OGRGeometry* geom,
-    const Spine::LocationPtr& loc,
-    const std::string& language,
-    const SmartMet::Engine::Geonames::Engine& geoengine)
+Spine::LocationPtr WktGeometry::locationFromGeometry(const OGRGeometry* geom,
+                                                     const Spine::LocationPtr& geoloc,
+                                                     const Spine::LocationPtr& loc) const
 {
-  OGREnvelope envelope;
-  geom->getEnvelope(&envelope);
-  double top = envelope.MaxY;
-  double bottom = envelope.MinY;
-  double left = envelope.MinX;
-  double right = envelope.MaxX;
-
-  double lon = (right + left) / 2.0;
-  double lat = (top + bottom) / 2.0;
-  Spine::LocationPtr geoloc = geoengine.lonlatSearch(lon, lat, language);
   std::unique_ptr<Spine::Location> tmp(new Spine::Location(geoloc->geoid,
                                                            "",  // tloc.tag,
                                                            geoloc->iso2,
@@ -321,20 +352,7 @@ WktGeometry::WktGeometry(const Spine::LocationPtr& loc,
   init(loc, language, geoengine);
 }
 
-// ----------------------------------------------------------------------
-/*!
- * \brief Destroy OGRGeometry object
- */
-// ----------------------------------------------------------------------
-
-WktGeometry::~WktGeometry()
-{
-  if (itsGeom)
-  {
-    OGRGeometryFactory::destroyGeometry(itsGeom);
-    itsGeom = nullptr;
-  }
-}
+WktGeometry::~WktGeometry() = default;
 
 // ----------------------------------------------------------------------
 /*!
@@ -371,7 +389,7 @@ Spine::LocationList WktGeometry::getLocations() const
 
 NFmiSvgPath WktGeometry::getSvgPath() const
 {
-  return itsSvgPath;
+  return itsShape->getSvgPath();
 }
 
 // ----------------------------------------------------------------------
@@ -387,7 +405,7 @@ NFmiSvgPath WktGeometry::getSvgPath() const
 
 std::list<NFmiSvgPath> WktGeometry::getSvgPaths() const
 {
-  return itsSvgPaths;
+  return itsShape->getSvgPaths();
 }
 
 // ----------------------------------------------------------------------
@@ -398,7 +416,7 @@ std::list<NFmiSvgPath> WktGeometry::getSvgPaths() const
 
 const OGRGeometry* WktGeometry::getGeometry() const
 {
-  return itsGeom;
+  return itsShape->getGeometry();
 }
 
 // ----------------------------------------------------------------------
@@ -14,6 +14,9 @@
  * as a name, but if wkt-string is longer than 60 characters the name is
  * truncated into 30 characters in order to be more usable in output document.
  *
+ * The parsed geometries and their SVG paths are shared WktShape objects,
+ * which the engine caches since the same geometries are requested often.
+ *
  */
 // ======================================================================
 
@@ -31,6 +34,35 @@ namespace Geonames
 {
 class Engine;
 
+class WktShape
+{
+ public:
+  ~WktShape();
+  // Throws if the WKT cannot be parsed
+  WktShape(const std::string& wkt, double radius);
+
+  WktShape() = delete;
+  WktShape(const WktShape& other) = delete;
+  WktShape& operator=(const WktShape& other) = delete;
+  WktShape(WktShape&& other) = delete;
+  WktShape& operator=(WktShape&& other) = delete;
+
+  const OGRGeometry* getGeometry() const { return itsGeom; }
+  const NFmiSvgPath& getSvgPath() const { return itsSvgPath; }
+  const std::list<NFmiSvgPath>& getSvgPaths() const { return itsSvgPaths; }
+
+  // Geometry primitives inside a multipart geometry, empty for primitives
+  const std::list<const OGRGeometry*>& getParts() const { return itsParts; }
+
+ private:
+  OGRGeometry* itsGeom = nullptr;      // Geometry created from wkt
+  NFmiSvgPath itsSvgPath;              // NFmiSvgPath for original geometry
+  std::list<NFmiSvgPath> itsSvgPaths;  // NFmiSvgPaths for geometries inside multipart geometry
+  std::list<const OGRGeometry*> itsParts;
+};
+
+using WktShapePtr = std::shared_ptr<const WktShape>;
+
 class WktGeometry
 {
  public:
@@ -54,22 +86,20 @@ class WktGeometry
   void init(const Spine::LocationPtr& loc,
             const std::string& language,
             const SmartMet::Engine::Geonames::Engine& geoengine);
-  void geometryFromWkt(const std::string& wktString, double radius);
-  void svgPathsFromGeometry();
+  void geometryFromWkt(const std::string& wktString,
+                       double radius,
+                       const SmartMet::Engine::Geonames::Engine& geoengine);
   void locationsFromGeometry(const Spine::LocationPtr& loc,
                              const std::string& language,
                              const SmartMet::Engine::Geonames::Engine& geoengine);
   Spine::LocationPtr locationFromGeometry(const OGRGeometry* geom,
-                                          const Spine::LocationPtr& loc,
-                                          const std::string& language,
-                                          const SmartMet::Engine::Geonames::Engine& geoengine);
+                                          const Spine::LocationPtr& geoloc,
+                                          const Spine::LocationPtr& loc) const;
 
-  std::string itsName;                 // Name of geometry
-  OGRGeometry* itsGeom = nullptr;      // Geometry created from wkt
-  NFmiSvgPath itsSvgPath;              // NFmiSvgPath for original geometry
-  std::list<NFmiSvgPath> itsSvgPaths;  // NFmiSvgPaths for geometries inside multipart geometry
-  Spine::LocationPtr itsLocation;      // Location for original geometry
-  Spine::LocationList itsLocations;    // Locations for geometries inside multipart geometry
+  std::string itsName;               // Name of geometry
+  WktShapePtr itsShape;              // Geometry created from wkt and its SVG paths
+  Spine::LocationPtr itsLocation;    // Location for original geometry
+  Spine::LocationList itsLocations;  // Locations for geometries inside multipart geometry
 };
 
 using WktGeometryPtr = std::shared_ptr<const WktGeometry>;
@@ -0,0 +1,534 @@
+// ======================================================================
+/*!
+ * \brief Benchmarks of the most frequently used engine operations
+ *
+ * Usage: EngineBenchmark [options]
+ *
+ *   --threads 1,2,4   thread counts to run each benchmark with (default 1)
+ *   --seconds 2       duration of each benchmark per thread count
+ *   --filter suggest  run only the benchmarks whose name contains the string
+ *   --replay file     replay the requests of the file instead
+ *   --reloads 1       number of timed full reloads, 0 disables them
+ *
+ * The results are printed to standard output as one JSON object per
+ * line, latencies are in microseconds. Replay files contain one tab
+ * separated request per line, empty lines and lines starting with #
+ * are ignored:
+ *
+ *   suggest  pattern  [lang]  [keyword]
+ *   name     name     [lang]
+ *   id       geoid    [lang]
+ *   lonlat   lon      lat     [lang]
+ *   keyword  lon      lat     [radius]  [lang]
+ */
+// ======================================================================
+
+#include "Engine.h"
+#include <locus/Query.h>
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <spine/HTTP.h>
+#include <spine/Location.h>
+#include <spine/Options.h>
+#include <spine/Reactor.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+SmartMet::Spine::Reactor *reactor;
+SmartMet::Engine::Geonames::Engine *names;
+
+auto accept_all = [](const SmartMet::Spine::LocationPtr &loc) { return false; };
+
+namespace Benchmarks
+{
+using Clock = std::chrono::steady_clock;
+
+struct Settings
+{
+  std::vector<unsigned int> threads{1};
+  double seconds = 2;
+  std::string filter;
+  std::string replay;
+  unsigned int reloads = 1;
+};
+
+// Called repeatedly with the thread number and the number of the call
+using Function = std::function<void(unsigned int thread, std::size_t call)>;
+
+struct Benchmark
+{
+  std::string name;
+  Function function;
+};
+
+struct Result
+{
+  std::string name;
+  unsigned int threads = 0;
+  std::size_t failures = 0;
+  double seconds = 0;
+  std::vector<double> latencies;  // microseconds
+};
+
+// ----------------------------------------------------------------------
+
+Settings parse_arguments(int argc, char **argv)
+{
+  Settings settings;
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string option = argv[i];
+    if (i + 1 >= argc)
+      throw std::runtime_error("Missing value for option " + option);
+    const std::string value = argv[++i];
+
+    if (option == "--threads")
+    {
+      settings.threads.clear();
+      std::istringstream input(value);
+      std::string count;
+      while (std::getline(input, count, ','))
+        settings.threads.push_back(std::max(1, Fmi::stoi(count)));
+    }
+    else if (option == "--seconds")
+      settings.seconds = Fmi::stod(value);
+    else if (option == "--filter")
+      settings.filter = value;
+    else if (option == "--replay")
+      settings.replay = value;
+    else if (option == "--reloads")
+      settings.reloads = Fmi::stoi(value);
+    else
+      throw std::runtime_error("Unknown option " + option);
+  }
+  return settings;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run a function in the given number of threads
+ *
+ * Every thread calls the function at least once. If the number of calls
+ * is given, each thread stops after that many calls, otherwise when the
+ * time is up.
+ */
+// ----------------------------------------------------------------------
+
+Result run(const std::string &name,
+           const Function &function,
+           unsigned int threads,
+           double seconds,
+           std::size_t calls = 0)
+{
+  std::vector<std::vector<double>> latencies(threads);
+  std::atomic<std::size_t> counter{0};
+  std::atomic<std::size_t> failures{0};
+
+  const auto start = Clock::now();
+  const auto deadline =
+      start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+  std::vector<std::thread> workers;
+  for (unsigned int thread = 0; thread < threads; thread++)
+  {
+    workers.emplace_back(
+        [&, thread]()
+        {
+          auto &samples = latencies[thread];
+          do
+          {
+            const auto call = counter++;
+            const auto t0 = Clock::now();
+            try
+            {
+              function(thread, call);
+            }
+            catch (...)
+            {
+              ++failures;
+            }
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+          } while (calls > 0 ? samples.size() < calls : Clock::now() < deadline);
+        });
+  }
+
+  for (auto &worker : workers)
+    worker.join();
+
+  Result result;
+  result.name = name;
+  result.threads = threads;
+  result.failures = failures;
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  for (const auto &samples : latencies)
+    result.latencies.insert(result.latencies.end(), samples.begin(), samples.end());
+  return result;
+}
+
+// ----------------------------------------------------------------------
+
+std::string json_string(const std::string &value)
+{
+  std::string ret = "\"";
+  for (char ch : value)
+  {
+    if (ch == '"' || ch == '\\')
+      ret += '\\';
+    ret += ch;
+  }
+  return ret + "\"";
+}
+
+void print(Result result)
+{
+  auto &samples = result.latencies;
+  std::sort(samples.begin(), samples.end());
+
+  const auto percentile = [&samples](double q)
+  { return samples[std::min(samples.size() - 1, static_cast<std::size_t>(q * samples.size()))]; };
+
+  double sum = 0;
+  for (auto value : samples)
+    sum += value;
+
+  cout << "{\"benchmark\":" << json_string(result.name) << ",\"threads\":" << result.threads
+       << ",\"calls\":" << samples.size() << ",\"failures\":" << result.failures
+       << ",\"seconds\":" << Fmi::to_string("%.3f", result.seconds)
+       << ",\"throughput\":" << Fmi::to_string("%.1f", samples.size() / result.seconds)
+       << ",\"mean_us\":" << Fmi::to_string("%.1f", sum / samples.size())
+       << ",\"p50_us\":" << Fmi::to_string("%.1f", percentile(0.5))
+       << ",\"p90_us\":" << Fmi::to_string("%.1f", percentile(0.9))
+       << ",\"p99_us\":" << Fmi::to_string("%.1f", percentile(0.99))
+       << ",\"max_us\":" << Fmi::to_string("%.1f", samples.back()) << "}" << endl;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The benchmarks of the hot paths
+ *
+ * The places are searched around Helsinki so that the results do not
+ * depend on the exact contents of the test database.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Benchmark> benchmarks()
+{
+  using SmartMet::Spine::LocationList;
+
+  std::vector<Benchmark> ret;
+
+  const LocationList nearby = names->keywordRadiusSearch(24.94, 60.17, 300, "fi", "all", 1000);
+  if (nearby.empty())
+    throw std::runtime_error("Found no places near Helsinki to benchmark with");
+
+  std::vector<long> geoids;
+  std::vector<std::string> placenames;
+  std::string lonlats;
+  std::string geoidlist;
+  for (const auto &loc : nearby)
+  {
+    geoids.push_back(loc->geoid);
+    placenames.push_back(loc->name);
+    if (!lonlats.empty())
+    {
+      lonlats += ',';
+      geoidlist += ',';
+    }
+    lonlats += Fmi::to_string(loc->longitude) + ',' + Fmi::to_string(loc->latitude);
+    geoidlist += Fmi::to_string(loc->geoid);
+  }
+
+  // Suggest for prefixes of 1-5 characters
+
+  const std::vector<std::string> words{"helsinki", "tampere", "jyvaskyla", "oulu", "stockholm"};
+  const std::vector<std::string> languages{"fi", "sv", "en"};
+
+  for (const auto &lang : languages)
+  {
+    for (std::size_t length = 1; length <= 5; length++)
+    {
+      std::vector<std::string> patterns;
+      for (const auto &word : words)
+        patterns.push_back(word.substr(0, length));
+
+      ret.push_back({"suggest/" + lang + "/" + Fmi::to_string(length),
+                     [patterns, lang](unsigned int, std::size_t call)
+                     { names->suggest(patterns[call % patterns.size()], accept_all, lang); }});
+    }
+  }
+
+  ret.push_back({"suggest/keywords",
+                 [words](unsigned int, std::size_t call)
+                 {
+                   const auto &word = words[call % words.size()];
+                   names->suggest(word.substr(0, 3), accept_all, "fi", "all,ajax_fi_all");
+                 }});
+
+  ret.push_back({"suggest/languages",
+                 [words, languages](unsigned int, std::size_t call)
+                 {
+                   const auto &word = words[call % words.size()];
+                   names->suggest(word.substr(0, 3), accept_all, languages);
+                 }});
+
+  // Sorting and translating, sorting includes copying the list
+
+  ret.push_back({"sort/" + Fmi::to_string(nearby.size()),
+                 [nearby](unsigned int, std::size_t)
+                 {
+                   auto locs = nearby;
+                   names->sort(locs);
+                 }});
+
+  ret.push_back({"translate",
+                 [geoids, languages](unsigned int, std::size_t call)
+                 {
+                   names->idSearch(geoids[call % geoids.size()],
+                                   languages[(call / geoids.size()) % languages.size()]);
+                 }});
+
+  // Nearest places from the loaded data at pseudo random coordinates in Finland
+
+  const auto coordinate = [](std::size_t call)
+  {
+    const std::size_t hash = (call + 1) * 2654435761U;
+    return std::make_pair(20.0 + (hash % 1000) * 0.011, 60.0 + ((hash / 1000) % 1000) * 0.01);
+  };
+
+  ret.push_back({"keywordSearch/nearest",
+                 [coordinate](unsigned int, std::size_t call)
+                 {
+                   const auto lonlat = coordinate(call);
+                   names->keywordSearch(lonlat.first, lonlat.second);
+                 }});
+
+  ret.push_back({"keywordSearch/radius",
+                 [coordinate](unsigned int, std::size_t call)
+                 {
+                   const auto lonlat = coordinate(call);
+                   names->keywordRadiusSearch(lonlat.first, lonlat.second, 20);
+                 }});
+
+  // Cached searches repeat the same queries, uncached ones change a search
+  // option which is part of the cache key but does not change the result
+
+  static std::atomic<unsigned int> unique{0};
+
+  ret.push_back({"nameSearch/cached",
+                 [placenames](unsigned int, std::size_t call)
+                 {
+                   Locus::QueryOptions opts;
+                   opts.SetLanguage("fi");
+                   opts.SetResultLimit(1);
+                   const auto n = std::min<std::size_t>(10, placenames.size());
+                   names->nameSearch(opts, placenames[call % n]);
+                 }});
+
+  ret.push_back({"nameSearch/uncached",
+                 [placenames](unsigned int, std::size_t call)
+                 {
+                   Locus::QueryOptions opts;
+                   opts.SetLanguage("fi");
+                   opts.SetResultLimit(1000 + unique++);
+                   names->nameSearch(opts, placenames[call % placenames.size()]);
+                 }});
+
+  ret.push_back({"idSearch/cached",
+                 [geoids](unsigned int, std::size_t call)
+                 {
+                   Locus::QueryOptions opts;
+                   opts.SetLanguage("fi");
+                   names->idSearch(opts, geoids[call % std::min<std::size_t>(10, geoids.size())]);
+                 }});
+
+  ret.push_back({"idSearch/uncached",
+                 [geoids](unsigned int, std::size_t call)
+                 {
+                   Locus::QueryOptions opts;
+                   opts.SetLanguage("fi");
+                   opts.SetResultLimit(1000 + unique++);
+                   names->idSearch(opts, geoids[call % geoids.size()]);
+                 }});
+
+  // Location options with long lists
+
+  SmartMet::Spine::HTTP::Request lonlatRequest;
+  lonlatRequest.setParameter("lonlats", lonlats);
+  ret.push_back({"parseLocations/lonlats/" + Fmi::to_string(nearby.size()),
+                 [lonlatRequest](unsigned int, std::size_t)
+                 { names->parseLocations(lonlatRequest); }});
+
+  SmartMet::Spine::HTTP::Request geoidRequest;
+  geoidRequest.setParameter("geoids", geoidlist);
+  ret.push_back({"parseLocations/geoids/" + Fmi::to_string(nearby.size()),
+                 [geoidRequest](unsigned int, std::size_t)
+                 { names->parseLocations(geoidRequest); }});
+
+  SmartMet::Spine::HTTP::Request wktRequest;
+  wktRequest.setParameter("wkt", "POLYGON((24.8 60.1,25.1 60.1,25.1 60.3,24.8 60.3,24.8 60.1))");
+  auto wktOptions = std::make_shared<SmartMet::Engine::Geonames::LocationOptions>(
+      names->parseLocations(wktRequest));
+  ret.push_back({"getWktGeometries",
+                 [wktOptions](unsigned int, std::size_t)
+                 { names->getWktGeometries(*wktOptions, "fi"); }});
+
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Benchmarks replaying the requests of a file
+ *
+ * All the requests are replayed in the order of the file, and the
+ * requests of each type separately.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<Benchmark> replay(const std::string &filename)
+{
+  std::ifstream input(filename);
+  if (!input)
+    throw std::runtime_error("Failed to open " + filename);
+
+  std::map<std::string, std::vector<Function>> requests;
+  std::vector<Function> all;
+
+  std::string line;
+  while (std::getline(input, line))
+  {
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::vector<std::string> fields;
+    std::istringstream tokens(line);
+    std::string field;
+    while (std::getline(tokens, field, '\t'))
+      fields.push_back(field);
+
+    const auto arg = [&fields](std::size_t i, const std::string &def = "")
+    { return (i < fields.size() && !fields[i].empty() ? fields[i] : def); };
+
+    const std::string type = arg(0);
+    Function request;
+    if (type == "suggest")
+      request = [pattern = arg(1), lang = arg(2, "fi"), keyword = arg(3, "all")](unsigned int,
+                                                                                 std::size_t)
+      { names->suggest(pattern, accept_all, lang, keyword); };
+    else if (type == "name")
+      request = [name = arg(1), lang = arg(2, "fi")](unsigned int, std::size_t)
+      { names->nameSearch(name, lang); };
+    else if (type == "id")
+      request = [id = Fmi::stol(arg(1)), lang = arg(2, "fi")](unsigned int, std::size_t)
+      { names->idSearch(id, lang); };
+    else if (type == "lonlat")
+      request = [lon = Fmi::stod(arg(1)), lat = Fmi::stod(arg(2)), lang = arg(3, "fi")](
+                    unsigned int, std::size_t) { names->lonlatSearch(lon, lat, lang); };
+    else if (type == "keyword")
+      request = [lon = Fmi::stod(arg(1)),
+                 lat = Fmi::stod(arg(2)),
+                 radius = Fmi::stod(arg(3, "-1")),
+                 lang = arg(4, "fi")](unsigned int, std::size_t)
+      { names->keywordSearch(lon, lat, radius, lang); };
+    else
+      throw std::runtime_error("Unknown request type '" + type + "' in " + filename);
+
+    requests[type].push_back(request);
+    all.push_back(request);
+  }
+
+  if (all.empty())
+    throw std::runtime_error("No requests to replay in " + filename);
+
+  const auto cycle = [](std::vector<Function> functions)
+  {
+    return [functions = std::move(functions)](unsigned int thread, std::size_t call)
+    { functions[call % functions.size()](thread, call); };
+  };
+
+  std::vector<Benchmark> ret{{"replay", cycle(all)}};
+  for (auto &type_requests : requests)
+    ret.push_back({"replay/" + type_requests.first, cycle(std::move(type_requests.second))});
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+
+void run(const Settings &settings)
+{
+  // Wait for autocomplete data to be loaded
+  names->suggestReady().get();
+
+  const auto selected = [&settings](const std::string &name)
+  { return settings.filter.empty() || name.find(settings.filter) != std::string::npos; };
+
+  auto tests = (settings.replay.empty() ? benchmarks() : replay(settings.replay));
+
+  for (const auto &test : tests)
+  {
+    if (!selected(test.name))
+      continue;
+
+    // Warm up the caches before measuring
+    run(test.name, test.function, 1, 0, 1);
+
+    for (auto threads : settings.threads)
+      print(run(test.name, test.function, threads, settings.seconds));
+  }
+
+  // Full reloads measure building all the data
+
+  if (settings.replay.empty() && settings.reloads > 0 && selected("reload"))
+  {
+    print(run(
+        "reload",
+        [](unsigned int, std::size_t)
+        {
+          auto result = names->reload();
+          if (!result.first)
+            throw std::runtime_error(result.second);
+        },
+        1,
+        0,
+        settings.reloads));
+  }
+}
+
+}  // namespace Benchmarks
+
+int main(int argc, char **argv)
+{
+  try
+  {
+    const auto settings = Benchmarks::parse_arguments(argc, argv);
+
+    SmartMet::Spine::Options opts;
+    opts.configfile = "cnf/reactor.conf";
+    opts.parseConfig();
+
+    reactor = new SmartMet::Spine::Reactor(opts);
+    reactor->init();
+    names = reinterpret_cast<SmartMet::Engine::Geonames::Engine *>(
+        reactor->getSingleton("Geonames", NULL));
+
+    Benchmarks::run(settings);
+
+    delete reactor;
+    return 0;
+  }
+  catch (...)
+  {
+    cerr << Fmi::Exception::Trace(BCP, "Benchmark failed!").getStackTrace() << endl;
+    return 1;
+  }
+}
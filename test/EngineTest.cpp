@@ -1,11 +1,14 @@
 #include "Engine.h"
 #include <locus/Query.h>
+#include <macgyver/Geometry.h>
 #include <macgyver/StringConversion.h>
 #include <regression/tframe.h>
 #include <spine/Location.h>
 #include <spine/Options.h>
 #include <spine/Reactor.h>
+#include <cmath>
 #include <iterator>
+#include <limits>
 #include <libconfig.h++>
 #include <unistd.h>
 
@@ -83,6 +86,34 @@ void nearest()
 
 // ----------------------------------------------------------------------
 
+void nearestwithin()
+{
+  auto ptrs = names->keywordRadiusSearch(28.76, 61.17, 20);
+  if (ptrs.empty())
+    TEST_FAILED("Found no places within 20 km from coord 28.76,61.17");
+  if (ptrs.front()->name != "Imatrankoski")
+    TEST_FAILED("Nearest place should be Imatrankoski, not " + ptrs.front()->name);
+
+  double previous = 0;
+  for (const auto &ptr : ptrs)
+  {
+    double dist = Fmi::Geometry::GeoDistance(28.76, 61.17, ptr->longitude, ptr->latitude) / 1000;
+    if (dist > 20)
+      TEST_FAILED(ptr->name + " is not within 20 km");
+    if (dist < previous)
+      TEST_FAILED("Places are not sorted by distance at " + ptr->name);
+    previous = dist;
+  }
+
+  auto limited = names->keywordRadiusSearch(28.76, 61.17, 20, "fi", "all", 3);
+  if (limited.size() != std::min<std::size_t>(3, ptrs.size()))
+    TEST_FAILED("Expecting at most 3 places, got " + Fmi::to_string(limited.size()));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
 void nearestplaces()
 {
   SmartMet::Spine::LocationList ptrs;
@@ -923,6 +954,122 @@ void lonlatSearch()
 
 // ----------------------------------------------------------------------
 
+void batchSearch()
+{
+  Locus::QueryOptions opts;
+  opts.SetCountries("all");
+  opts.SetSearchVariants(true);
+  opts.SetLanguage("fi");
+
+  // Helsinki, Rome and Helsinki again
+
+  auto results = names->idSearch(opts, std::vector<int>{658225, 3169070, 658225});
+
+  if (results.size() != 3)
+    TEST_FAILED("Should get 3 results for 3 ids, not " + Fmi::to_string(results.size()));
+  if (results[0].empty() || results[0].front()->name != "Helsinki")
+    TEST_FAILED("First id search result should be Helsinki");
+  if (results[1].empty() || results[1].front()->name != "Rooma")
+    TEST_FAILED("Second id search result should be Rooma");
+  if (results[2].empty() || results[2].front()->name != "Helsinki")
+    TEST_FAILED("Third id search result should be Helsinki");
+
+  auto locs = names->nameSearch(std::vector<std::string>{"Rooma", "Helsinki"}, "fi");
+
+  if (locs.size() != 2)
+    TEST_FAILED("Should get 2 results for 2 names, not " + Fmi::to_string(locs.size()));
+  if (locs[0]->name != "Rooma" || locs[1]->name != "Helsinki")
+    TEST_FAILED("Name search results should be Rooma and Helsinki, not " + locs[0]->name +
+                " and " + locs[1]->name);
+
+  TEST_PASSED();
+}
+
+void asyncSearch()
+{
+  Locus::QueryOptions opts;
+  opts.SetCountries("all");
+  opts.SetSearchVariants(true);
+  opts.SetLanguage("fi");
+
+  auto helsinki = names->idSearchAsync(opts, 658225);
+  auto rome = names->nameSearchAsync(opts, "Rooma");
+
+  auto locs = helsinki.get();
+  if (locs.empty() || locs.front()->name != "Helsinki")
+    TEST_FAILED("Asynchronous id search should find Helsinki");
+
+  locs = rome.get();
+  if (locs.empty() || locs.front()->name != "Rooma")
+    TEST_FAILED("Asynchronous name search should find Rooma");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void rasterSampling()
+{
+  // Kumpula twice, points on both sides of one degree tile edges, and the
+  // sea off Helsinki
+
+  const std::vector<std::pair<double, double>> coordinates{{24.9642, 60.2089},
+                                                           {25.0, 60.0},
+                                                           {24.9642, 60.2089},
+                                                           {24.999999, 59.999999},
+                                                           {25.000001, 60.000001},
+                                                           {25.0, 61.0},
+                                                           {24.0, 60.5},
+                                                           {25.0, 60.0},
+                                                           {24.95, 60.1}};
+
+  const auto heights = names->demHeights(coordinates);
+  const auto covers = names->coverTypes(coordinates);
+
+  if (heights.size() != coordinates.size() || covers.size() != coordinates.size())
+    TEST_FAILED("Should get one height and cover type for each coordinate");
+
+  for (std::size_t i = 0; i < coordinates.size(); i++)
+  {
+    const auto lon = coordinates[i].first;
+    const auto lat = coordinates[i].second;
+    const std::string where = Fmi::to_string(lon) + "," + Fmi::to_string(lat);
+
+    const auto height = names->demHeight(lon, lat);
+    if (!(height == heights[i] || (std::isnan(height) && std::isnan(heights[i]))))
+      TEST_FAILED("DEM height at " + where + " should be " + Fmi::to_string(height) + ", not " +
+                  Fmi::to_string(heights[i]));
+
+    if (names->coverType(lon, lat) != covers[i])
+      TEST_FAILED("Cover type at " + where + " differs from a single point query");
+  }
+
+  // Coordinates which are not finite cannot be sampled
+
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const std::vector<std::pair<double, double>> invalid{
+      {nan, 60.0}, {24.9642, 60.2089}, {25.0, nan}, {nan, nan}};
+
+  const auto invalid_heights = names->demHeights(invalid);
+  const auto invalid_covers = names->coverTypes(invalid);
+  for (std::size_t i : {0, 2, 3})
+  {
+    if (!std::isnan(invalid_heights[i]))
+      TEST_FAILED("DEM height at a non-finite coordinate should be NaN");
+    if (invalid_covers[i] != Fmi::LandCover::NoData)
+      TEST_FAILED("Cover type at a non-finite coordinate should be NoData");
+  }
+  if (!(invalid_heights[1] == heights[0] ||
+        (std::isnan(invalid_heights[1]) && std::isnan(heights[0]))))
+    TEST_FAILED("DEM height at Kumpula should not depend on other coordinates");
+  if (invalid_covers[1] != covers[0])
+    TEST_FAILED("Cover type at Kumpula should not depend on other coordinates");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
 void keywordSearch()
 {
   SmartMet::Spine::LocationList ptrs;
@@ -1042,10 +1189,14 @@ class tests : public tframe::tests
     TEST(nameIdSearch);
     TEST(idSearch);
     TEST(lonlatSearch);
+    TEST(batchSearch);
+    TEST(asyncSearch);
     TEST(nearest);
+    TEST(nearestwithin);
     TEST(nearestplaces);
     TEST(countryName);
     TEST(featureSearch);
+    TEST(rasterSampling);
 
     // Test the next last since they require autocomplete to be initialized
     TEST(keywordSearch);
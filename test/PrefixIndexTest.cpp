@@ -0,0 +1,174 @@
+#include "PrefixIndex.h"
+#include <regression/tframe.h>
+#include <spine/Location.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+using SmartMet::Engine::Geonames::PrefixIndex;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Location with the given name
+ */
+// ----------------------------------------------------------------------
+
+SmartMet::Spine::LocationPtr location(const std::string &theName)
+{
+  return std::make_shared<SmartMet::Spine::Location>(theName, 0.0);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Index the names of the given locations
+ *
+ * The last key in signed character order is "helsinki", non-ASCII keys
+ * come first.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<SmartMet::Spine::LocationPtr> locations{location("helsinki"),
+                                                    location("espoo"),
+                                                    location("hel"),
+                                                    location("äänekoski"),
+                                                    location("helsingfors"),
+                                                    location("åbo")};
+
+std::shared_ptr<const PrefixIndex> make_index()
+{
+  PrefixIndex::Builder builder;
+  for (const auto &loc : locations)
+    builder.insert(loc->name, loc);
+
+  // The first value of a duplicate key is kept
+  builder.insert("espoo", location("esbo"));
+
+  return builder.build();
+}
+
+const auto prefixes = make_index();
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Names of the matches separated by commas
+ */
+// ----------------------------------------------------------------------
+
+std::string names(const PrefixIndex::Matches &theMatches)
+{
+  std::string ret;
+  for (const auto &loc : theMatches)
+  {
+    if (!ret.empty())
+      ret += ',';
+    ret += loc->name;
+  }
+  return ret;
+}
+
+void check(const std::string &theSearch,
+           const PrefixIndex::Matches &theMatches,
+           const std::string &theExpected)
+{
+  const auto result = names(theMatches);
+  if (result != theExpected)
+    TEST_FAILED(theSearch + ": expected '" + theExpected + "', got '" + result + "'");
+}
+
+namespace Tests
+{
+void emptyPrefix()
+{
+  const PrefixIndex::Subset all{0, 1, 2, 3, 4, 5};
+
+  check("findprefix('')", prefixes->findprefix(""), "");
+  check("findprefix('', subset)", prefixes->findprefix("", all), "");
+  for (const auto &matches : prefixes->findprefix("", {&all, nullptr}))
+    check("findprefix('', subsets)", matches, "");
+
+  if (prefixes->size() != locations.size())
+    TEST_FAILED("Expected " + std::to_string(locations.size()) + " keys, got " +
+                std::to_string(prefixes->size()));
+
+  TEST_PASSED();
+}
+
+void noMatch()
+{
+  check("findprefix('x')", prefixes->findprefix("x"), "");
+  check("findprefix('a')", prefixes->findprefix("a"), "");
+  check("findprefix('helsinkix')", prefixes->findprefix("helsinkix"), "");
+  check("findprefix('espoox')", prefixes->findprefix("espoox"), "");
+
+  // A match outside the subset
+  const SmartMet::Spine::LocationList espoo{locations[1]};
+  const auto subsets = prefixes->subsets({&espoo});
+  check("findprefix('hel', espoo)", prefixes->findprefix("hel", *subsets.front()), "");
+
+  TEST_PASSED();
+}
+
+void lastKey()
+{
+  check("findprefix('helsinki')", prefixes->findprefix("helsinki"), "helsinki");
+  check("findprefix('helsink')", prefixes->findprefix("helsink"), "helsinki");
+  check("findprefix('hel')", prefixes->findprefix("hel"), "hel,helsingfors,helsinki");
+  check("findprefix('e')", prefixes->findprefix("e"), "espoo");
+
+  const SmartMet::Spine::LocationList helsinki{locations[0]};
+  const auto subsets = prefixes->subsets({&helsinki});
+  check("findprefix('helsinki', helsinki)",
+        prefixes->findprefix("helsinki", *subsets.front()),
+        "helsinki");
+
+  TEST_PASSED();
+}
+
+void nonAscii()
+{
+  // UTF-8 lead bytes are negative as signed characters
+  check("findprefix('\\xc3')", prefixes->findprefix("\xc3"), "äänekoski,åbo");
+  check("findprefix('ä')", prefixes->findprefix("ä"), "äänekoski");
+  check("findprefix('åbo')", prefixes->findprefix("åbo"), "åbo");
+  check("findprefix('ö')", prefixes->findprefix("ö"), "");
+
+  // Each subset is searched separately, a null subset matches all keys
+  const SmartMet::Spine::LocationList first{locations[5], locations[0]};
+  const SmartMet::Spine::LocationList second{locations[0], locations[3]};
+  const auto subsets = prefixes->subsets({&first, &second});
+  const auto matches = prefixes->findprefix("\xc3", {subsets[0].get(), subsets[1].get(), nullptr});
+  check("findprefix('\\xc3', first)", matches[0], "åbo");
+  check("findprefix('\\xc3', second)", matches[1], "äänekoski");
+  check("findprefix('\\xc3', all)", matches[2], "äänekoski,åbo");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+// The actual test driver
+class tests : public tframe::tests
+{
+  //! Overridden message separator
+  virtual const char *error_message_prefix() const { return "\n\t"; }
+  //! Main test suite
+  void test()
+  {
+    TEST(emptyPrefix);
+    TEST(noMatch);
+    TEST(lastKey);
+    TEST(nonAscii);
+  }
+
+};  // class tests
+
+}  // namespace Tests
+
+int main(void)
+{
+  cout << endl << "PrefixIndex tester" << endl << "==================" << endl;
+  Tests::tests t;
+  return t.run();
+}
@@ -0,0 +1,138 @@
+#include "QueryLog.h"
+#include <regression/tframe.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+using SmartMet::Engine::Geonames::QueryLog;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Queries of all kinds with various options
+ */
+// ----------------------------------------------------------------------
+
+std::vector<QueryLog::Query> make_queries()
+{
+  std::vector<QueryLog::Query> ret;
+
+  Locus::QueryOptions defaults;
+
+  Locus::QueryOptions finnish;
+  finnish.SetCountries("fi");
+  finnish.SetLanguage("fi");
+  finnish.SetSearchVariants(true);
+
+  Locus::QueryOptions restricted;
+  restricted.SetCountries("fi,se,no");
+  restricted.SetFeatures("PPLC,PPLA,PPLA2");
+  restricted.SetLanguage("sv");
+  restricted.SetNameType("fmisid");
+  restricted.SetCharset("latin1");
+  restricted.SetResultLimit(5);
+  restricted.SetFullCountrySearch(true);
+
+  for (const auto &options : {defaults, finnish, restricted})
+  {
+    ret.push_back({QueryLog::Kind::Name, options, "Helsinki"});
+    ret.push_back({QueryLog::Kind::Name, options, "Åbo,Åbo"});
+    ret.push_back({QueryLog::Kind::LonLat, options, "", 24.9642F, 60.2089F, 15});
+    ret.push_back({QueryLog::Kind::LonLat, options, "", -0.1F, 51.5F, 0});
+    ret.push_back({QueryLog::Kind::Id, options, "", 0, 0, 0, 658225});
+    ret.push_back({QueryLog::Kind::Id, options, "", 0, 0, 0, -100539});
+    ret.push_back({QueryLog::Kind::Keyword, options, "mareografit"});
+  }
+
+  return ret;
+}
+
+namespace Tests
+{
+void roundTrip()
+{
+  const std::string filename = "tmp-geonames.querylog";
+
+  const auto queries = make_queries();
+
+  std::vector<QueryLog::Entry> entries;
+  for (const auto &query : queries)
+    entries.emplace_back(QueryLog::key(query), query);
+
+  QueryLog::write(filename, entries);
+  const auto result = QueryLog::read(filename);
+  std::remove(filename.c_str());
+
+  if (result.size() != entries.size())
+    TEST_FAILED("Read " + std::to_string(result.size()) + " queries instead of " +
+                std::to_string(entries.size()));
+
+  for (std::size_t i = 0; i < entries.size(); i++)
+  {
+    const auto key = QueryLog::key(result[i]);
+    if (key != entries[i].first)
+      TEST_FAILED("Key of query " + std::to_string(i) + " changed from '" + entries[i].first +
+                  "' to '" + key + "'");
+    if (result[i].kind != entries[i].second.kind)
+      TEST_FAILED("Kind of query " + std::to_string(i) + " changed");
+  }
+
+  TEST_PASSED();
+}
+
+void uniqueKeys()
+{
+  const auto queries = make_queries();
+
+  // Every query differs from the others by its kind, options or arguments
+  for (std::size_t i = 0; i < queries.size(); i++)
+    for (std::size_t j = i + 1; j < queries.size(); j++)
+      if (QueryLog::key(queries[i]) == QueryLog::key(queries[j]))
+        TEST_FAILED("Queries " + std::to_string(i) + " and " + std::to_string(j) +
+                    " have the same key " + QueryLog::key(queries[i]));
+
+  // Each saved option changes the key
+  const Locus::QueryOptions base;
+  std::vector<Locus::QueryOptions> variants(8, base);
+  variants[0].SetCountries("se");
+  variants[1].SetFeatures("PPLX");
+  variants[2].SetLanguage("et");
+  variants[3].SetNameType("wmo");
+  variants[4].SetCharset("latin1");
+  variants[5].SetResultLimit(base.GetResultLimit() + 1);
+  variants[6].SetSearchVariants(!base.GetSearchVariants());
+  variants[7].SetFullCountrySearch(!base.GetFullCountrySearch());
+
+  const auto base_key = QueryLog::name_key(base, "Helsinki");
+  for (std::size_t i = 0; i < variants.size(); i++)
+    if (QueryLog::name_key(variants[i], "Helsinki") == base_key)
+      TEST_FAILED("Changing option " + std::to_string(i) + " should change the key");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+// The actual test driver
+class tests : public tframe::tests
+{
+  //! Overridden message separator
+  virtual const char *error_message_prefix() const { return "\n\t"; }
+  //! Main test suite
+  void test()
+  {
+    TEST(roundTrip);
+    TEST(uniqueKeys);
+  }
+
+};  // class tests
+
+}  // namespace Tests
+
+int main(void)
+{
+  cout << endl << "QueryLog tester" << endl << "===============" << endl;
+  Tests::tests t;
+  return t.run();
+}
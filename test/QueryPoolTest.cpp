@@ -0,0 +1,306 @@
+#include "QueryPool.h"
+#include <regression/tframe.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+using SmartMet::Engine::Geonames::QueryPool;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Factory counting the connections it has opened
+ *
+ * The pool never dereferences the connections, hence null connections
+ * suffice and no database is needed.
+ */
+// ----------------------------------------------------------------------
+
+struct Factory
+{
+  std::shared_ptr<std::atomic<int>> count = std::make_shared<std::atomic<int>>(0);
+  std::shared_ptr<std::atomic<bool>> fail = std::make_shared<std::atomic<bool>>(false);
+
+  std::shared_ptr<Locus::Query> operator()() const
+  {
+    if (*fail)
+      throw std::runtime_error("Connection refused");
+    ++*count;
+    return {};
+  }
+};
+
+QueryPool::Options options(std::size_t theMin, std::size_t theMax)
+{
+  QueryPool::Options ret;
+  ret.min_connections = theMin;
+  ret.max_connections = theMax;
+  ret.wait_timeout = std::chrono::milliseconds(50);
+  return ret;
+}
+
+bool throws(const std::function<void()> &theCall)
+{
+  try
+  {
+    theCall();
+    return false;
+  }
+  catch (...)
+  {
+    return true;
+  }
+}
+
+void check(const std::string &theName, std::uint64_t theValue, std::uint64_t theExpected)
+{
+  if (theValue != theExpected)
+    TEST_FAILED(theName + ": expected " + std::to_string(theExpected) + ", got " +
+                std::to_string(theValue));
+}
+
+namespace Tests
+{
+void eagerOpening()
+{
+  Factory factory;
+  QueryPool pool("test", factory, options(2, 4));
+
+  check("opened", pool.status().opened, 2);
+  check("idle", pool.status().idle, 2);
+
+  // Idle connections are reused before opening new ones
+  auto q1 = pool.reserve();
+  auto q2 = pool.reserve();
+  check("opened after reusing", pool.status().opened, 2);
+  auto q3 = pool.reserve();
+  check("opened when all busy", pool.status().opened, 3);
+  check("factory calls", *factory.count, 3);
+
+  TEST_PASSED();
+}
+
+void lazyOpening()
+{
+  Factory factory;
+  auto opts = options(2, 4);
+  opts.lazy = true;
+  QueryPool pool("test", factory, opts);
+
+  check("opened", pool.status().opened, 0);
+  check("connections", pool.status().connections, 0);
+
+  {
+    auto q1 = pool.reserve();
+    check("opened on first use", pool.status().opened, 1);
+  }
+
+  // The released connection is kept since it is within the minimum
+  auto q2 = pool.reserve();
+  check("opened on reuse", pool.status().opened, 1);
+  check("connections", pool.status().connections, 1);
+
+  TEST_PASSED();
+}
+
+void waitTimeout()
+{
+  Factory factory;
+  QueryPool pool("test", factory, options(1, 1));
+
+  auto q1 = pool.reserve();
+
+  const auto start = QueryPool::Clock::now();
+  if (!throws([&] { pool.reserve(); }))
+    TEST_FAILED("Reserving from an exhausted pool should time out");
+  if (QueryPool::Clock::now() - start < std::chrono::milliseconds(50))
+    TEST_FAILED("Reservation timed out before the wait timeout");
+  check("timeouts", pool.status().timeouts, 1);
+  check("waiting", pool.status().waiting, 0);
+
+  // A connection released during the wait is handed to the waiter
+  auto opts = options(1, 1);
+  opts.wait_timeout = std::chrono::milliseconds(5000);
+  QueryPool pool2("test", factory, opts);
+  auto q2 = pool2.reserve();
+  std::thread releaser(
+      [&q2]
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        q2.reset();
+      });
+  const bool failed = throws([&] { pool2.reserve(); });
+  releaser.join();
+  if (failed)
+    TEST_FAILED("Waiter should get the released connection");
+  check("timeouts after release", pool2.status().timeouts, 0);
+
+  TEST_PASSED();
+}
+
+void deadline()
+{
+  Factory factory;
+  auto opts = options(1, 1);
+  opts.wait_timeout = std::chrono::milliseconds(0);
+  QueryPool pool("test", factory, opts);
+
+  auto q1 = pool.reserve();
+
+  // Without a wait timeout only the deadline ends the wait
+  const auto start = QueryPool::Clock::now();
+  if (!throws([&] { pool.reserve(start + std::chrono::milliseconds(30)); }))
+    TEST_FAILED("Reservation should fail at the deadline");
+  if (QueryPool::Clock::now() - start < std::chrono::milliseconds(30))
+    TEST_FAILED("Reservation failed before the deadline");
+
+  // A deadline earlier than the wait timeout wins
+  QueryPool pool2("test", factory, options(1, 1));
+  auto q2 = pool2.reserve();
+  if (!throws([&] { pool2.reserve(QueryPool::Clock::now()); }))
+    TEST_FAILED("Reservation past the deadline should fail");
+
+  check("timeouts", pool.status().timeouts + pool2.status().timeouts, 2);
+
+  TEST_PASSED();
+}
+
+void idleTimeout()
+{
+  Factory factory;
+  auto opts = options(0, 2);
+  opts.idle_timeout = std::chrono::seconds(0);
+  QueryPool pool("test", factory, opts);
+
+  auto q1 = pool.reserve();
+  auto q2 = pool.reserve();
+  q1.reset();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+  // Releasing expires the connection idle for longer than the timeout
+  q2.reset();
+  check("closed", pool.status().closed, 1);
+  check("idle", pool.status().idle, 1);
+  check("connections", pool.status().connections, 1);
+
+  // Connections within the minimum are never expired
+  auto opts2 = options(2, 2);
+  opts2.idle_timeout = std::chrono::seconds(0);
+  QueryPool pool2("test", factory, opts2);
+  {
+    auto q3 = pool2.reserve();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  auto q4 = pool2.reserve();
+  check("closed within minimum", pool2.status().closed, 0);
+  check("connections within minimum", pool2.status().connections, 2);
+
+  TEST_PASSED();
+}
+
+void failures()
+{
+  Factory factory;
+  auto opts = options(0, 1);
+  QueryPool pool("test", factory, opts);
+
+  *factory.fail = true;
+  if (!throws([&] { pool.reserve(); }))
+    TEST_FAILED("Reservation should fail when the connection cannot be opened");
+  check("failures", pool.status().failures, 1);
+  check("connections", pool.status().connections, 0);
+
+  // The failed slot is available again
+  *factory.fail = false;
+  if (throws([&] { pool.reserve(); }))
+    TEST_FAILED("Reservation should succeed once the database is reachable");
+
+  // A lazy pool can be created while the database is unreachable
+  *factory.fail = true;
+  opts.min_connections = 1;
+  opts.lazy = true;
+  if (throws([&] { QueryPool("lazy", factory, opts); }))
+    TEST_FAILED("Creating a lazy pool should not open connections");
+
+  TEST_PASSED();
+}
+
+void replicaFallback()
+{
+  Factory primary_factory;
+  Factory replica_factory;
+  auto opts = options(0, 1);
+  opts.lazy = true;
+  QueryPool primary("primary", primary_factory, opts);
+  QueryPool replica("replica", replica_factory, opts);
+
+  // A healthy replica is used
+  {
+    auto q = replica.reserve(primary);
+    check("replica reserved", replica.status().reserved, 1);
+    check("primary reserved", primary.status().reserved, 0);
+
+    // A busy replica falls back to the primary after the wait timeout
+    auto q2 = replica.reserve(primary);
+    check("replica timeouts", replica.status().timeouts, 1);
+    check("primary reserved when busy", primary.status().reserved, 1);
+  }
+
+  // A replica which has been shut down falls back to the primary
+  replica.cancel();
+  {
+    auto q = replica.reserve(primary);
+    check("primary reserved after cancel", primary.status().reserved, 2);
+  }
+
+  // An unreachable replica falls back to the primary
+  *replica_factory.fail = true;
+  QueryPool unreachable("replica", replica_factory, opts);
+  {
+    auto q = unreachable.reserve(primary);
+    check("unreachable failures", unreachable.status().failures, 1);
+    check("primary reserved when unreachable", primary.status().reserved, 3);
+  }
+
+  // Failures of the fallback are reported
+  primary.cancel();
+  if (!throws([&] { unreachable.reserve(primary); }))
+    TEST_FAILED("Reservation should fail when both pools fail");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+// The actual test driver
+class tests : public tframe::tests
+{
+  //! Overridden message separator
+  virtual const char *error_message_prefix() const { return "\n\t"; }
+  //! Main test suite
+  void test()
+  {
+    TEST(eagerOpening);
+    TEST(lazyOpening);
+    TEST(waitTimeout);
+    TEST(deadline);
+    TEST(idleTimeout);
+    TEST(failures);
+    TEST(replicaFallback);
+  }
+
+};  // class tests
+
+}  // namespace Tests
+
+int main(void)
+{
+  cout << endl << "QueryPool tester" << endl << "================" << endl;
+  Tests::tests t;
+  return t.run();
+}
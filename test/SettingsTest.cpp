@@ -0,0 +1,1944 @@
+#include "CollationTable.h"
+#include "Engine.h"
+#include "LocationPriorities.h"
+#include <locus/Query.h>
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <regression/tframe.h>
+#include <spine/Location.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <locale>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/locale.hpp>
+#include <boost/thread.hpp>
+#include <libconfig.h++>
+#include <pqxx/pqxx>
+
+using namespace std;
+
+// Tests of engines with non-default settings. Each engine is constructed
+// directly from a modified copy of the test configuration, hence the
+// tests in EngineTest.cpp keep running with the default settings.
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief An engine initialized and shut down without a reactor
+ */
+// ----------------------------------------------------------------------
+
+class TestEngine : public SmartMet::Engine::Geonames::Engine
+{
+ public:
+  explicit TestEngine(const std::string &theConfigFile) : Engine(theConfigFile) { init(); }
+  ~TestEngine() override { shutdown(); }
+
+  TestEngine() = delete;
+  TestEngine(const TestEngine &other) = delete;
+  TestEngine &operator=(const TestEngine &other) = delete;
+  TestEngine(TestEngine &&other) = delete;
+  TestEngine &operator=(TestEngine &&other) = delete;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find or add a group to a configuration
+ */
+// ----------------------------------------------------------------------
+
+libconfig::Setting &group(libconfig::Setting &theParent, const char *theName)
+{
+  if (theParent.exists(theName))
+    return theParent[theName];
+  return theParent.add(theName, libconfig::Setting::TypeGroup);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Replace or add a setting of the given type
+ */
+// ----------------------------------------------------------------------
+
+libconfig::Setting &replace(libconfig::Setting &theParent,
+                            const char *theName,
+                            libconfig::Setting::Type theType)
+{
+  if (theParent.exists(theName))
+    theParent.remove(theName);
+  return theParent.add(theName, theType);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a copy of the test configuration with modified settings
+ *
+ * Returns the name of the new configuration file.
+ */
+// ----------------------------------------------------------------------
+
+std::string make_config(const std::string &theName,
+                        const std::function<void(libconfig::Setting &)> &theChanges)
+{
+  libconfig::Config config;
+  config.readFile("cnf/geonames.conf");
+  theChanges(config.getRoot());
+
+  const std::string filename = "cnf/tmp-" + theName + ".conf";
+  config.writeFile(filename.c_str());
+  return filename;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Connect directly to the test database
+ */
+// ----------------------------------------------------------------------
+
+std::unique_ptr<Locus::Query> database_query()
+{
+  libconfig::Config config;
+  config.readFile("cnf/geonames.conf");
+
+  std::string host, user, pass, database;
+  int port = 5432;
+  config.lookupValue("database.host", host);
+  config.lookupValue("database.user", user);
+  config.lookupValue("database.pass", pass);
+  config.lookupValue("database.database", database);
+  config.lookupValue("database.port", port);
+
+  auto lq = std::make_unique<Locus::Query>(host, user, pass, database, Fmi::to_string(port));
+  lq->load_iso639_table();
+  return lq;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Connect directly to the test database for modifying it
+ */
+// ----------------------------------------------------------------------
+
+std::unique_ptr<pqxx::connection> database_connection()
+{
+  libconfig::Config config;
+  config.readFile("cnf/geonames.conf");
+
+  std::string host, user, pass, database;
+  int port = 5432;
+  config.lookupValue("database.host", host);
+  config.lookupValue("database.user", user);
+  config.lookupValue("database.pass", pass);
+  config.lookupValue("database.database", database);
+  config.lookupValue("database.port", port);
+
+  return std::make_unique<pqxx::connection>("host=" + host + " port=" + Fmi::to_string(port) +
+                                            " user=" + user + " password=" + pass +
+                                            " dbname=" + database);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compare in-memory search results with database search results
+ *
+ * The area, municipality and priority of the in-memory results are
+ * intentionally different, see the README. Returns an error message or
+ * an empty string.
+ */
+// ----------------------------------------------------------------------
+
+std::string compare_locations(const SmartMet::Spine::LocationList &ptrs,
+                              const Locus::Query::return_type &locs)
+{
+  if (ptrs.size() != locs.size())
+    return "Got " + Fmi::to_string(ptrs.size()) + " locations instead of " +
+           Fmi::to_string(locs.size()) + " from the database";
+
+  auto ptr = ptrs.begin();
+  for (const auto &loc : locs)
+  {
+    const auto &mine = **ptr++;
+    const std::string where = " of geoid " + Fmi::to_string(loc.id);
+    if (mine.geoid != loc.id)
+      return "Geoid " + Fmi::to_string(mine.geoid) + " should be " + Fmi::to_string(loc.id);
+    if (mine.name != loc.name)
+      return "Name" + where + " should be " + loc.name + ", not " + mine.name;
+    if (mine.iso2 != loc.iso2)
+      return "ISO2" + where + " should be " + loc.iso2 + ", not " + mine.iso2;
+    if (mine.feature != loc.feature)
+      return "Feature" + where + " should be " + loc.feature + ", not " + mine.feature;
+    if (mine.timezone != loc.timezone)
+      return "Timezone" + where + " should be " + loc.timezone + ", not " + mine.timezone;
+    if (std::abs(mine.longitude - loc.lon) > 1e-6 || std::abs(mine.latitude - loc.lat) > 1e-6)
+      return "Coordinates" + where + " differ from the database";
+    if (mine.population != static_cast<int>(loc.population))
+      return "Population" + where + " differs from the database";
+    if (mine.fmisid != loc.fmisid)
+      return "FMISID" + where + " differs from the database";
+  }
+  return {};
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Capture the output written into a stream
+ */
+// ----------------------------------------------------------------------
+
+class Capture
+{
+ public:
+  explicit Capture(std::ostream &theStream)
+      : itsStream(theStream), itsBuffer(theStream.rdbuf(itsOutput.rdbuf()))
+  {
+  }
+  ~Capture() { itsStream.rdbuf(itsBuffer); }
+
+  Capture() = delete;
+  Capture(const Capture &other) = delete;
+  Capture &operator=(const Capture &other) = delete;
+  Capture(Capture &&other) = delete;
+  Capture &operator=(Capture &&other) = delete;
+
+  std::string str() const { return itsOutput.str(); }
+  bool contains(const std::string &theText) const
+  {
+    return (itsOutput.str().find(theText) != std::string::npos);
+  }
+
+ private:
+  std::ostream &itsStream;
+  std::ostringstream itsOutput;
+  std::streambuf *itsBuffer;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Describe locations for comparing the results of two engines
+ */
+// ----------------------------------------------------------------------
+
+std::string describe(const SmartMet::Spine::LocationList &ptrs)
+{
+  std::string ret;
+  for (const auto &ptr : ptrs)
+    ret += "\n\t\t" + Fmi::to_string(ptr->geoid) + " " + ptr->name + " / " + ptr->area + " / " +
+           ptr->iso2 + " " + ptr->feature;
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compare the results of the same searches from two engines
+ *
+ * Returns an error message or an empty string.
+ */
+// ----------------------------------------------------------------------
+
+using Results = std::vector<std::pair<std::string, SmartMet::Spine::LocationList>>;
+
+std::string compare_results(const Results &expected, const Results &results)
+{
+  if (expected.size() != results.size())
+    return "Got " + Fmi::to_string(results.size()) + " results instead of " +
+           Fmi::to_string(expected.size());
+
+  for (std::size_t i = 0; i < expected.size(); i++)
+  {
+    const auto want = describe(expected[i].second);
+    const auto got = describe(results[i].second);
+    if (want != got)
+      return expected[i].first + " should find" + want + "\n\tnot" + got;
+  }
+  return {};
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Name, id, keyword and suggest searches whose results must not
+ *        depend on how the data was loaded
+ */
+// ----------------------------------------------------------------------
+
+auto accept_all = [](const SmartMet::Spine::LocationPtr &loc) { return false; };
+
+Results sample_searches(const SmartMet::Engine::Geonames::Engine &names)
+{
+  Results ret;
+
+  for (const auto *lang : {"fi", "sv"})
+  {
+    Locus::QueryOptions opts;
+    opts.SetCountries("all");
+    opts.SetSearchVariants(true);
+    opts.SetLanguage(lang);
+
+    for (const auto *name : {"Helsinki", "Kallio", "Sepänkylä", "Åbo,Åbo"})
+      ret.emplace_back(std::string("nameSearch ") + name + " " + lang,
+                       names.nameSearch(opts, name));
+
+    for (int id : {658225, 3169070})
+      ret.emplace_back("idSearch " + Fmi::to_string(id) + " " + lang, names.idSearch(opts, id));
+
+    ret.emplace_back(std::string("keywordSearch mareografit ") + lang,
+                     names.keywordSearch(opts, "mareografit"));
+  }
+
+  const std::vector<std::pair<std::string, std::string>> suggestions{{"he", "fi"},
+                                                                      {"Ääne", "fi"},
+                                                                      {"sepä", "fi"},
+                                                                      {"Åb", "sv"},
+                                                                      {"helsi", "sv"},
+                                                                      {"stockholm", "en"},
+                                                                      {"Kumpula,Helsinki", "fi"},
+                                                                      {"100539", "fmisid"}};
+  for (const auto &pattern_lang : suggestions)
+    ret.emplace_back("suggest " + pattern_lang.first + " " + pattern_lang.second,
+                     names.suggest(pattern_lang.first, accept_all, pattern_lang.second));
+
+  ret.emplace_back("suggest h ajax_fi_all", names.suggest("h", accept_all, "fi", "ajax_fi_all"));
+
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Statistics of a cache of an engine
+ */
+// ----------------------------------------------------------------------
+
+Fmi::Cache::CacheStats cache_stats(const SmartMet::Spine::SmartMetEngine &theEngine,
+                                   const std::string &theCache)
+{
+  auto stats = theEngine.getCacheStats();
+  auto pos = stats.find("Geonames::" + theCache);
+  if (pos == stats.end())
+    throw std::runtime_error("Cache " + theCache + " has no statistics");
+  return pos->second;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Engine with the default settings for comparisons, loaded on first use
+ */
+// ----------------------------------------------------------------------
+
+std::unique_ptr<TestEngine> reference_engine;
+
+const TestEngine &reference()
+{
+  if (!reference_engine)
+  {
+    reference_engine = std::make_unique<TestEngine>("cnf/geonames.conf");
+    reference_engine->ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+  }
+  return *reference_engine;
+}
+
+namespace Tests
+{
+// ----------------------------------------------------------------------
+
+void memoryIdSearch()
+{
+  const auto config = make_config(
+      "memory_id_search",
+      [](libconfig::Setting &root)
+      { replace(root, "memory_id_search", libconfig::Setting::TypeBoolean) = true; });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Locations).wait();
+
+  auto lq = database_query();
+
+  for (const auto *lang : {"fi", "sv", "en"})
+  {
+    Locus::QueryOptions opts;
+    opts.SetCountries("all");
+    opts.SetSearchVariants(true);
+    opts.SetLanguage(lang);
+
+    // Helsinki, Rome and the Kemi Ajos and Raahe Lapaluoto mareographs
+
+    for (int id : {658225, 3169070, -100539, -100540})
+    {
+      auto error = compare_locations(names.idSearch(opts, id), lq->FetchById(opts, id));
+      if (!error.empty())
+        TEST_FAILED("Id search " + Fmi::to_string(id) + " in language " + lang + ": " + error);
+    }
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void memoryStationSearch()
+{
+  const auto config = make_config(
+      "memory_station_search",
+      [](libconfig::Setting &root)
+      { replace(root, "memory_station_search", libconfig::Setting::TypeBoolean) = true; });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Locations).wait();
+
+  auto lq = database_query();
+
+  // Kumpula and the Kemi Ajos mareograph
+
+  const std::vector<std::pair<std::string, std::string>> stations{
+      {"fmisid", "101004"}, {"wmo", "2998"}, {"lpnn", "339"}, {"fmisid", "100539"}};
+
+  for (const auto *lang : {"fi", "sv"})
+  {
+    for (const auto &type_id : stations)
+    {
+      Locus::QueryOptions opts;
+      opts.SetCountries("all");
+      opts.SetSearchVariants(true);
+      opts.SetResultLimit(1);
+      opts.SetNameType(type_id.first);
+      opts.SetLanguage(lang);
+
+      auto error = compare_locations(names.nameSearch(opts, type_id.second),
+                                     lq->FetchByName(opts, type_id.second));
+      if (!error.empty())
+        TEST_FAILED("Station search " + type_id.first + " " + type_id.second + " in language " +
+                    lang + ": " + error);
+    }
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start an engine which must not use the snapshot
+ *
+ * Returns an error message or an empty string.
+ */
+// ----------------------------------------------------------------------
+
+std::string rejected_snapshot(const std::string &theConfig, const Results &theExpected)
+{
+  Capture out(std::cout);
+  Capture err(std::cerr);
+
+  TestEngine names(theConfig);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  if (!err.contains("Ignoring geonames snapshot"))
+    return "No warning about ignoring the snapshot";
+  if (out.contains("read_snapshot: "))
+    return "The snapshot should not have been loaded";
+  if (!out.contains("read_geonames: "))
+    return "The data should have been read from the database";
+
+  return compare_results(theExpected, sample_searches(names));
+}
+
+void snapshot()
+{
+  const std::string snapshotfile = "tmp-geonames.snapshot";
+  std::remove(snapshotfile.c_str());
+
+  // Verbose output tells whether the snapshot or the database was read
+
+  const auto settings = [&snapshotfile](libconfig::Setting &root)
+  {
+    replace(root, "verbose", libconfig::Setting::TypeBoolean) = true;
+    replace(group(root, "snapshot"), "file", libconfig::Setting::TypeString) = snapshotfile;
+  };
+  const auto config = make_config("snapshot", settings);
+
+  // The first engine reads the database and writes the snapshot
+
+  Results expected;
+  {
+    Capture out(std::cout);
+    TestEngine names(config);
+    names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+    if (!out.contains("read_geonames: "))
+      TEST_FAILED("The data should have been read from the database");
+    expected = sample_searches(names);
+  }
+
+  if (!std::filesystem::exists(snapshotfile))
+    TEST_FAILED("Snapshot " + snapshotfile + " was not written");
+
+  // A restarted engine reads the snapshot instead of the database
+
+  {
+    Capture out(std::cout);
+    TestEngine names(config);
+    names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+    if (!out.contains("read_snapshot: "))
+      TEST_FAILED("The data should have been read from the snapshot");
+    if (out.contains("read_geonames: "))
+      TEST_FAILED("The database should not have been read when the snapshot is valid");
+
+    auto error = compare_results(expected, sample_searches(names));
+    if (!error.empty())
+      TEST_FAILED("After restarting from the snapshot: " + error);
+  }
+
+  // A snapshot of another version is ignored. The version follows the
+  // magic string, which is stored as a 64-bit length and 14 characters.
+
+  {
+    std::fstream file(snapshotfile, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(8 + 14);
+    const std::uint64_t version = 0;
+    file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    if (!file)
+      TEST_FAILED("Failed to modify the snapshot version");
+  }
+
+  auto error = rejected_snapshot(config, expected);
+  if (!error.empty())
+    TEST_FAILED("Snapshot with a different version: " + error);
+
+  // The previous engine wrote a valid snapshot, which must not be used with
+  // settings affecting the data
+
+  const auto other = make_config("snapshot_settings",
+                                 [&settings](libconfig::Setting &root)
+                                 {
+                                   settings(root);
+                                   replace(root, "maxdemresolution", libconfig::Setting::TypeInt) =
+                                       50;
+                                 });
+
+  error = rejected_snapshot(other, expected);
+  if (!error.empty())
+    TEST_FAILED("Snapshot with different settings: " + error);
+
+  std::remove(snapshotfile.c_str());
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Results of an engine which reads all the data from the database
+ */
+// ----------------------------------------------------------------------
+
+Results full_load(const std::string &theConfig)
+{
+  Capture out(std::cout);
+  TestEngine names(theConfig);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+  return sample_searches(names);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Configuration for incremental reloads with modified priorities
+ *
+ * The file is rewritten with the same name, hence reloads read the new
+ * priorities.
+ */
+// ----------------------------------------------------------------------
+
+std::string incremental_config(int theEspooPriority, int theCountryBonus)
+{
+  return make_config("incremental_reload",
+                     [=](libconfig::Setting &root)
+                     {
+                       replace(root, "verbose", libconfig::Setting::TypeBoolean) = true;
+                       replace(root, "incremental_reload", libconfig::Setting::TypeBoolean) = true;
+                       root["priorities"]["areas"]["Espoo"] = theEspooPriority;
+                       auto &countries = root["priorities"]["countries"];
+                       for (int i = 0; i < countries.getLength(); i++)
+                         countries[i] = static_cast<int>(countries[i]) + theCountryBonus;
+                     });
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Reload incrementally and compare the results with a full load
+ *
+ * Returns an error message or an empty string.
+ */
+// ----------------------------------------------------------------------
+
+std::string incremental_reload(TestEngine &theEngine,
+                               const std::string &theConfig,
+                               const std::string &theExpectedOutput = "")
+{
+  std::string output;
+  {
+    Capture out(std::cout);
+    auto result = theEngine.reload();
+    if (!result.first)
+      return "Reload failed: " + result.second;
+    output = out.str();
+  }
+
+  if (output.find("read_geonames_incremental: ") == std::string::npos)
+    return "The reload was not incremental";
+  if (output.find(theExpectedOutput) == std::string::npos)
+    return "The reload did not report '" + theExpectedOutput + "'";
+
+  return compare_results(full_load(theConfig), sample_searches(theEngine));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove translations from the database until destroyed
+ */
+// ----------------------------------------------------------------------
+
+class RemovedTranslations
+{
+ public:
+  RemovedTranslations(pqxx::connection &theConnection, const std::string &theCondition)
+      : itsConnection(theConnection)
+  {
+    pqxx::work work(itsConnection);
+    work.exec(
+        "CREATE TEMPORARY TABLE removed_translations AS SELECT * FROM alternate_geonames WHERE " +
+        theCondition);
+    work.exec("DELETE FROM alternate_geonames WHERE id IN (SELECT id FROM removed_translations)");
+    work.commit();
+  }
+
+  ~RemovedTranslations()
+  {
+    try
+    {
+      restore();
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "Failed to restore the removed translations: " << e.what() << std::endl;
+    }
+  }
+
+  RemovedTranslations() = delete;
+  RemovedTranslations(const RemovedTranslations &other) = delete;
+  RemovedTranslations &operator=(const RemovedTranslations &other) = delete;
+  RemovedTranslations(RemovedTranslations &&other) = delete;
+  RemovedTranslations &operator=(RemovedTranslations &&other) = delete;
+
+  void restore()
+  {
+    if (itsRestored)
+      return;
+    pqxx::work work(itsConnection);
+    work.exec("INSERT INTO alternate_geonames SELECT * FROM removed_translations");
+    work.exec("DROP TABLE removed_translations");
+    work.commit();
+    itsRestored = true;
+  }
+
+ private:
+  pqxx::connection &itsConnection;
+  bool itsRestored = false;
+};
+
+void incrementalReload()
+{
+  auto config = incremental_config(1, 0);
+
+  Capture out(std::cout);
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  // Unchanged locations and keyword trees are shared with the previous data
+
+  auto error = incremental_reload(names, config);
+  if (!error.empty())
+    TEST_FAILED("Reload without changes: " + error);
+
+  // Locations in Espoo are copied with a new priority, the rest are shared
+
+  config = incremental_config(5, 0);
+  error = incremental_reload(names, config);
+  if (!error.empty())
+    TEST_FAILED("Reload with a new priority for Espoo: " + error);
+
+  // The priorities of all locations change, hence all translations are read
+
+  config = incremental_config(5, 1);
+  error = incremental_reload(names, config, "most locations changed, reading all translations");
+  if (!error.empty())
+    TEST_FAILED("Reload with new priorities for all countries: " + error);
+
+  // Removing rows from the database is done only in the private CI database
+
+  if (std::getenv("CI") == nullptr)
+  {
+    std::cerr << "\n\tNot removing translations from a shared database, CI is not set";
+    TEST_PASSED();
+  }
+
+  auto conn = database_connection();
+
+  {
+    // Helsingfors, the Swedish name of Helsinki
+    RemovedTranslations removed(*conn, "geonames_id=658225 AND language='sv'");
+
+    error = incremental_reload(names, config, "translations have been removed");
+    if (!error.empty())
+      TEST_FAILED("Reload after removing translations: " + error);
+
+    // The restored rows are not modified, but the row count has changed
+
+    removed.restore();
+    error = incremental_reload(names, config, "reading all translations");
+    if (!error.empty())
+      TEST_FAILED("Reload after restoring the removed translations: " + error);
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void suggestPrefixReuse()
+{
+  const auto config = make_config(
+      "suggest_prefix_reuse",
+      [](libconfig::Setting &root)
+      {
+        auto &cache = group(root, "cache");
+        replace(cache, "suggest_prefix_reuse", libconfig::Setting::TypeBoolean) = true;
+      });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  // Each pattern extends the previous one, hence the candidates of all but
+  // the first pattern are filtered from the cached candidates of a prefix.
+  // The reference engine searches the trees for every pattern.
+
+  struct Chain
+  {
+    std::string lang;
+    std::string keyword;
+    std::vector<std::string> patterns;
+  };
+
+  const std::vector<Chain> chains{
+      {"fi", "all", {"h", "he", "hel", "hels", "helsi", "helsinki"}},
+      {"sv", "all", {"h", "hel", "hels", "helsingf"}},
+      {"fi", "all", {"ä", "ää", "ääne"}},
+      {"fi", "all", {"kumpula", "kumpula,", "kumpula,helsinki"}},
+      {"fi", "ajax_fi_all", {"h", "ha", "ham"}},
+      {"fmisid", "all", {"1", "10", "1005", "100539"}}};
+
+  for (const auto &chain : chains)
+  {
+    for (const auto &pattern : chain.patterns)
+    {
+      const std::string what =
+          "suggest " + pattern + " " + chain.lang + " " + chain.keyword + " should find";
+      const auto want =
+          describe(reference().suggest(pattern, accept_all, chain.lang, chain.keyword));
+      const auto got = describe(names.suggest(pattern, accept_all, chain.lang, chain.keyword));
+      if (got != want)
+        TEST_FAILED(what + want + "\n\tnot" + got);
+    }
+  }
+
+  if (cache_stats(names, "suggest_prefix_reuse").hits == 0)
+    TEST_FAILED("Cached prefixes were not reused");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Sum of a statistic of the name search caches
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+T search_cache_total(const SmartMet::Spine::SmartMetEngine &theEngine,
+                     T Fmi::Cache::CacheStats::*theStatistic)
+{
+  T ret = 0;
+  for (const auto *cache :
+       {"name_search_cache", "lonlat_search_cache", "id_search_cache", "keyword_search_cache"})
+    ret += cache_stats(theEngine, cache).*theStatistic;
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Searches using the name search caches
+ */
+// ----------------------------------------------------------------------
+
+Results cached_searches(const SmartMet::Engine::Geonames::Engine &names)
+{
+  // Options with and without country and feature restrictions
+
+  Locus::QueryOptions restricted;
+  restricted.SetCountries("fi");
+  restricted.SetFeatures("PPL,PPLX");
+  restricted.SetLanguage("fi");
+
+  Locus::QueryOptions unrestricted;
+  unrestricted.SetLanguage("sv");
+
+  Results ret;
+  for (const auto &opts : {restricted, unrestricted})
+  {
+    const std::string lang = opts.GetLanguage();
+    ret.emplace_back("nameSearch Kumpula " + lang, names.nameSearch(opts, "Kumpula"));
+    ret.emplace_back("idSearch 658225 " + lang, names.idSearch(opts, 658225));
+    ret.emplace_back("lonlatSearch 24.9642,60.2089 " + lang,
+                     names.lonlatSearch(opts, 24.9642, 60.2089));
+    ret.emplace_back("keywordSearch mareografit " + lang,
+                     names.keywordSearch(opts, "mareografit"));
+  }
+  return ret;
+}
+
+void warmupFile()
+{
+  const std::string warmupfile = "tmp-geonames.queries";
+  std::remove(warmupfile.c_str());
+
+  const auto config = make_config(
+      "warmup_file",
+      [&warmupfile](libconfig::Setting &root)
+      { replace(group(root, "cache"), "warmup_file", libconfig::Setting::TypeString) = warmupfile; });
+
+  // The queries are saved on shutdown
+
+  Results expected;
+  {
+    TestEngine names(config);
+    names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+    expected = cached_searches(names);
+  }
+
+  if (!std::filesystem::exists(warmupfile))
+    TEST_FAILED("Warmup file " + warmupfile + " was not written");
+
+  // A restarted engine runs the saved queries once autocomplete is ready
+
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  for (int i = 0; i < 600; i++)
+  {
+    if (search_cache_total(names, &Fmi::Cache::CacheStats::inserts) >= expected.size())
+      break;
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+  }
+
+  if (search_cache_total(names, &Fmi::Cache::CacheStats::inserts) < expected.size())
+    TEST_FAILED("The caches were not warmed up with " + Fmi::to_string(expected.size()) +
+                " queries from " + warmupfile);
+
+  // The same queries must now be cache hits with the same results
+
+  const auto hits = search_cache_total(names, &Fmi::Cache::CacheStats::hits);
+  const auto misses = search_cache_total(names, &Fmi::Cache::CacheStats::misses);
+
+  auto error = compare_results(expected, cached_searches(names));
+  if (!error.empty())
+    TEST_FAILED("After warming up: " + error);
+
+  if (search_cache_total(names, &Fmi::Cache::CacheStats::misses) != misses)
+    TEST_FAILED("Warmed up queries should not miss the cache");
+  if (search_cache_total(names, &Fmi::Cache::CacheStats::hits) < hits + expected.size())
+    TEST_FAILED("Warmed up queries should hit the cache");
+
+  std::remove(warmupfile.c_str());
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compare suggestions to those of the reference engine
+ *
+ * Returns an error message or an empty string.
+ */
+// ----------------------------------------------------------------------
+
+struct Suggestion
+{
+  std::string pattern;
+  std::string lang;
+  std::string keyword;  // empty for the default keyword
+};
+
+std::string compare_suggestions(const SmartMet::Engine::Geonames::Engine &names,
+                                const std::vector<Suggestion> &theSuggestions)
+{
+  for (const auto &s : theSuggestions)
+  {
+    std::string what = "suggest " + s.pattern + " " + s.lang;
+    std::string want;
+    std::string got;
+    if (s.keyword.empty())
+    {
+      want = describe(reference().suggest(s.pattern, accept_all, s.lang));
+      got = describe(names.suggest(s.pattern, accept_all, s.lang));
+    }
+    else
+    {
+      what += " " + s.keyword;
+      want = describe(reference().suggest(s.pattern, accept_all, s.lang, s.keyword));
+      got = describe(names.suggest(s.pattern, accept_all, s.lang, s.keyword));
+    }
+    if (got != want)
+      return what + " should find" + want + "\n\tnot" + got;
+  }
+  return "";
+}
+
+void compactSuggestIndex()
+{
+  const auto config = make_config(
+      "compact_suggest_index",
+      [](libconfig::Setting &root)
+      { replace(root, "compact_suggest_index", libconfig::Setting::TypeBoolean) = true; });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  // The reference engine uses the ternary trees
+
+  const std::vector<Suggestion> suggestions{{"he", "fi", ""},
+                                            {"Ääne", "fi", ""},
+                                            {"sepä", "fi", ""},
+                                            {"Åb", "sv", ""},
+                                            {"helsi", "sv", ""},
+                                            {"stockholm", "en", ""},
+                                            {"Kumpula,Helsinki", "fi", ""},
+                                            {"100539", "fmisid", ""},
+                                            {"he", "fi", "all"},
+                                            {"helsi", "sv", "all"},
+                                            {"h", "fi", "ajax_fi_all"},
+                                            {"h", "sv", "ajax_fi_all"},
+                                            {"k", "fi", "mareografit"},
+                                            {"k", "sv", "mareografit"},
+                                            {"100539", "fmisid", "mareografit"},
+                                            {"xyzzy", "fi", "ajax_fi_all"}};
+
+  auto error = compare_suggestions(names, suggestions);
+  if (!error.empty())
+    TEST_FAILED(error);
+
+  // Several keywords are searched at once from the compact index, the matches
+  // of a location belonging to several keywords must rank the same anyway
+
+  const std::vector<Suggestion> keywords{{"k", "fi", "ajax_fi_all,mareografit"},
+                                         {"k", "sv", "mareografit,ajax_fi_all"},
+                                         {"ke", "fi", "all,mareografit"},
+                                         {"h", "fi", "mareografit,all,ajax_fi_all"},
+                                         {"100539", "fmisid", "all,mareografit"}};
+
+  error = compare_suggestions(names, keywords);
+  if (!error.empty())
+    TEST_FAILED(error);
+
+  for (const auto &s : keywords)
+  {
+    for (unsigned int page : {0, 1})
+    {
+      const auto want = describe(
+          reference().suggestDuplicates(s.pattern, accept_all, s.lang, s.keyword, page, 5));
+      const auto got =
+          describe(names.suggestDuplicates(s.pattern, accept_all, s.lang, s.keyword, page, 5));
+      if (got != want)
+        TEST_FAILED("suggestDuplicates " + s.pattern + " " + s.lang + " " + s.keyword + " page " +
+                    Fmi::to_string(page) + " should find" + want + "\n\tnot" + got);
+    }
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Wait until the suggestions match those of the reference engine
+ *
+ * Returns the last error message or an empty string.
+ */
+// ----------------------------------------------------------------------
+
+std::string wait_for_suggestions(const SmartMet::Engine::Geonames::Engine &names,
+                                 const std::vector<Suggestion> &theSuggestions)
+{
+  std::string error;
+  for (int i = 0; i < 600; i++)
+  {
+    error = compare_suggestions(names, theSuggestions);
+    if (error.empty())
+      break;
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+  }
+  return error;
+}
+
+void lazyLanguages()
+{
+  const auto config = make_config("lazy_languages",
+                                  [](libconfig::Setting &root)
+                                  {
+                                    replace(root, "verbose", libconfig::Setting::TypeBoolean) =
+                                        true;
+                                    auto &eager = replace(
+                                        root, "eager_languages", libconfig::Setting::TypeArray);
+                                    eager.add(libconfig::Setting::TypeString) = "fi";
+                                    replace(root,
+                                            "lazy_language_expiration",
+                                            libconfig::Setting::TypeInt) = 1;
+                                  });
+
+  // Verbose output tells when the trees are built and released
+  Capture out(std::cout);
+
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  if (out.contains("building the trees of language 'sv'"))
+    TEST_FAILED("The trees of language sv should not be built before use");
+
+  // The first search starts the build and is answered from the base trees,
+  // the partial results must not be cached
+
+  names.suggest("helsingf", accept_all, "sv");
+  if (!out.contains("building the trees of language 'sv'"))
+    TEST_FAILED("The first search of language sv should start building its trees");
+
+  const std::vector<Suggestion> built{
+      {"helsingf", "sv", ""}, {"Åb", "sv", ""}, {"h", "sv", "ajax_fi_all"}};
+  auto error = wait_for_suggestions(names, built);
+  if (!error.empty())
+    TEST_FAILED("After building the trees of language sv: " + error);
+
+  // The trees are released once unused longer than the expiration time,
+  // and built again by the next search
+
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(2500));
+
+  names.suggest("stockh", accept_all, "sv");
+  if (!out.contains("released the trees of language 'sv'"))
+    TEST_FAILED("The unused trees of language sv should have been released");
+
+  const std::vector<Suggestion> rebuilt{{"stockh", "sv", ""}, {"vas", "sv", ""}};
+  error = wait_for_suggestions(names, rebuilt);
+  if (!error.empty())
+    TEST_FAILED("After rebuilding the trees of language sv: " + error);
+
+  // The eager languages are always available
+
+  error = compare_suggestions(names, {{"he", "fi", ""}, {"Ääne", "fi", ""}});
+  if (!error.empty())
+    TEST_FAILED(error);
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Names of the loaded locations and their translations
+ */
+// ----------------------------------------------------------------------
+
+std::vector<std::string> loaded_names()
+{
+  auto conn = database_connection();
+  pqxx::nontransaction work(*conn);
+  auto res = work.exec(
+      "SELECT g.name FROM geonames g INNER JOIN keywords_has_geonames k ON "
+      "g.id=k.geonames_id UNION SELECT a.name FROM alternate_geonames a INNER JOIN "
+      "keywords_has_geonames k ON a.geonames_id=k.geonames_id");
+
+  std::vector<std::string> ret;
+  ret.reserve(res.size());
+  for (const auto &row : res)
+    ret.push_back(row[0].as<std::string>());
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Normal form of a name as in Engine::Impl::to_treeword
+ *
+ * The collation table is used when given and when it knows all the
+ * characters of the name, otherwise the collator.
+ */
+// ----------------------------------------------------------------------
+
+std::string treeword(const std::string &theName,
+                     const SmartMet::Engine::Geonames::CollationTable::Transform &theCollate,
+                     const SmartMet::Engine::Geonames::CollationTable *theTable)
+{
+  std::string tmp;
+  std::remove_copy_if(theName.begin(),
+                      theName.end(),
+                      std::back_inserter(tmp),
+                      [](char c) { return std::isspace(c); });
+  if (tmp.empty())
+    return {};
+
+  std::string key;
+  if (theTable != nullptr && theTable->transform(tmp, key))
+    return key;
+  return theCollate(tmp);
+}
+
+void fastCollation()
+{
+  // The collator of the configured locale
+
+  libconfig::Config settings;
+  settings.readFile("cnf/geonames.conf");
+  std::string locale_name;
+  settings.lookupValue("locale", locale_name);
+
+  boost::locale::generator generator;
+  const std::locale loc = generator(locale_name);
+  const auto &collator = std::use_facet<boost::locale::collator<char>>(loc);
+
+  const auto collate = [&collator](const std::string &name)
+  {
+    auto tmp = collator.transform(boost::locale::collator_base::primary, name);
+    if (!tmp.empty() && tmp.back() == '\0')
+      tmp.pop_back();
+    return tmp;
+  };
+
+  // The keys of all the loaded names must not depend on the table, or the
+  // contents of the search trees would change
+
+  const SmartMet::Engine::Geonames::CollationTable table(collate);
+
+  std::size_t fast = 0;
+  std::string dummy;
+  for (const auto &name : loaded_names())
+  {
+    const auto want = treeword(name, collate, nullptr);
+    const auto got = treeword(name, collate, &table);
+    if (got != want)
+      TEST_FAILED("The table driven key of '" + name + "' differs from the collator key");
+    if (table.transform(name, dummy))
+      ++fast;
+  }
+
+  if (fast == 0)
+    TEST_FAILED("No names were transformed with the collation table");
+
+  // Suggestions with and without the table
+
+  const auto config = make_config(
+      "fast_collation",
+      [](libconfig::Setting &root)
+      { replace(root, "fast_collation", libconfig::Setting::TypeBoolean) = true; });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  const std::vector<Suggestion> suggestions{{"ä", "fi", ""},
+                                            {"Ä", "fi", ""},
+                                            {"Ääne", "fi", ""},
+                                            {"ö", "fi", ""},
+                                            {"Öst", "sv", ""},
+                                            {"å", "sv", ""},
+                                            {"Åb", "sv", ""},
+                                            {"jyväs", "fi", ""},
+                                            {"ylä-", "fi", ""},
+                                            {"Etelä-Pohj", "fi", ""},
+                                            {"kemi a", "fi", "mareografit"},
+                                            {"Kemi Ajos", "fi", "mareografit"},
+                                            {"Kumpula,Helsinki", "fi", ""},
+                                            {"Åbo,Åbo", "sv", ""}};
+
+  auto error = compare_suggestions(names, suggestions);
+  if (!error.empty())
+    TEST_FAILED(error);
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Geoids of the loaded locations
+ *
+ * Only the locations attached to some keyword are loaded, hence only
+ * they can be found by in-memory searches.
+ */
+// ----------------------------------------------------------------------
+
+std::set<int> loaded_geoids()
+{
+  auto conn = database_connection();
+  pqxx::nontransaction work(*conn);
+  auto res = work.exec("SELECT DISTINCT geonames_id FROM keywords_has_geonames");
+
+  std::set<int> ret;
+  for (const auto &row : res)
+    ret.insert(row[0].as<int>());
+  return ret;
+}
+
+void memoryLonLatSearch()
+{
+  const std::string default_features = "PPL,PPLA,PPLA2,PPLA3,PPLC,PPLG,PPLX";
+
+  const auto config = make_config(
+      "memory_lonlat_search",
+      [](libconfig::Setting &root)
+      {
+        replace(root, "memory_lonlat_search", libconfig::Setting::TypeBoolean) = true;
+        auto &features =
+            replace(root, "memory_lonlat_features", libconfig::Setting::TypeArray);
+        for (const auto *feature : {"PPL", "PPLA", "PPLA2", "PPLA3", "PPLC", "PPLG", "PPLX"})
+          features.add(libconfig::Setting::TypeString) = feature;
+      });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  auto lq = database_query();
+  const auto loaded = loaded_geoids();
+
+  // Kumpula, Turku, the Kemi Ajos mareograph and Stockholm
+
+  const std::vector<std::pair<float, float>> coordinates{
+      {24.9642, 60.2089}, {22.2666, 60.4518}, {24.5159, 65.6737}, {18.0686, 59.3293}};
+
+  struct Variant
+  {
+    std::string countries;
+    std::string features;  // empty for the configured default features
+    float radius;          // zero for the default radius
+    unsigned int limit;
+  };
+
+  const std::vector<Variant> variants{{"all", "", 0, 1},
+                                      {"all", "", 50, 5},
+                                      {"fi", "", 20, 5},
+                                      {"all", "PPLX", 10, 5},
+                                      {"fi,se", "PPLC,PPLA,PPLA2", 0, 3},
+                                      {"se", "PPL", 5, 1},
+                                      {"all", "PPL,PPLX", 2, 10}};
+
+  for (const auto *lang : {"fi", "sv"})
+  {
+    for (const auto &variant : variants)
+    {
+      Locus::QueryOptions opts;
+      opts.SetCountries(variant.countries);
+      if (!variant.features.empty())
+        opts.SetFeatures(variant.features);
+      opts.SetResultLimit(variant.limit);
+      opts.SetLanguage(lang);
+
+      // The database is searched with the default features made explicit and
+      // with a larger limit, the locations not loaded are then skipped
+
+      auto dbopts = opts;
+      dbopts.SetFeatures(variant.features.empty() ? default_features : variant.features);
+      dbopts.SetResultLimit(1000);
+
+      const float radius = (variant.radius > 0 ? variant.radius : Locus::Query::default_radius);
+
+      for (const auto &lonlat : coordinates)
+      {
+        Locus::Query::return_type expected;
+        for (const auto &loc : lq->FetchByLonLat(dbopts, lonlat.first, lonlat.second, radius))
+        {
+          if (loaded.count(loc.id) == 0)
+            continue;
+          expected.push_back(loc);
+          if (expected.size() >= variant.limit)
+            break;
+        }
+
+        auto result = (variant.radius > 0
+                           ? names.lonlatSearch(opts, lonlat.first, lonlat.second, variant.radius)
+                           : names.lonlatSearch(opts, lonlat.first, lonlat.second));
+
+        auto error = compare_locations(result, expected);
+        if (!error.empty())
+          TEST_FAILED("Lonlat search " + Fmi::to_string(lonlat.first) + "," +
+                      Fmi::to_string(lonlat.second) + " countries=" + variant.countries +
+                      " features=" + variant.features + " radius=" +
+                      Fmi::to_string(variant.radius) + " in language " + lang + ": " + error);
+      }
+    }
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void locationPriorities()
+{
+  libconfig::Config config;
+  config.readFile("cnf/geonames.conf");
+
+  SmartMet::Engine::Geonames::LocationPriorities priorities;
+  priorities.init(config);
+
+  struct Case
+  {
+    std::string iso2;
+    std::string feature;
+    std::string area;
+    int population;
+    int expected;  // population + area + country + feature priorities from cnf/geonames.conf
+  };
+
+  const std::vector<Case> cases{
+      // FI population divisor 2000, area Helsinki 2, country FI 15, FI_features PPLC 35
+      {"FI", "PPLC", "Helsinki", 600000, 300000 + 2000 + 15000 + 35000},
+      // Rounded population score, area Espoo 1, FI_features ADM3 2
+      {"FI", "ADM3", "Espoo", 3001, 1501 + 1000 + 15000 + 2000},
+      // SE population divisor 20000, default area, country SE 12, default_features PPLA2 25
+      {"SE", "PPLA2", "Göteborg", 50000, 2500 + 0 + 12000 + 25000},
+      // US population divisor 100000, default country, default_features PPL 20
+      {"US", "PPL", "", 1000000, 10000 + 0 + 0 + 20000},
+      // Unknown country uses all the defaults
+      {"XX", "FOO", "", 250, 3 + 0 + 0 + 0},
+      // AX has a population divisor and a country score but no feature map
+      {"AX", "ADM1", "Mariehamn", 0, 0 + 0 + 15000 + 0},
+      // Feature codes too long for the tables get the default feature score
+      {"FI", "SYNOPXYZW", "Vantaa", 0, 0 + 1000 + 15000 + 0},
+      // Codes are case sensitive, lower case iso2 codes use the defaults
+      {"fi", "PPLX", "Turku", 100000, 1000 + 1000 + 0 + 19000},
+      // Empty feature, EE population divisor 10000 and country EE 9
+      {"EE", "", "", 10000, 1000 + 0 + 9000 + 0},
+      // MX population divisor 108000, default_features ISL 12
+      {"MX", "ISL", "Oaxaca", 108000, 1000 + 0 + 0 + 12000}};
+
+  for (const auto &c : cases)
+  {
+    SmartMet::Spine::Location loc("test", 0.0);
+    loc.iso2 = c.iso2;
+    loc.feature = c.feature;
+    loc.area = c.area;
+    loc.population = c.population;
+
+    const int priority = priorities.getPriority(loc);
+    if (priority != c.expected)
+      TEST_FAILED("Priority of " + c.feature + " in " + c.area + "/" + c.iso2 + " population " +
+                  Fmi::to_string(c.population) + " should be " + Fmi::to_string(c.expected) +
+                  ", not " + Fmi::to_string(priority));
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Describe the translated fields of locations
+ */
+// ----------------------------------------------------------------------
+
+std::string describe_translations(const SmartMet::Spine::LocationList &ptrs)
+{
+  std::string ret;
+  for (const auto &ptr : ptrs)
+    ret += "\n\t\t" + Fmi::to_string(ptr->geoid) + " " + ptr->name + " / " + ptr->area + " / " +
+           ptr->country;
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Searches returning translated locations in the given language
+ */
+// ----------------------------------------------------------------------
+
+Results translated_searches(const SmartMet::Engine::Geonames::Engine &names,
+                            const std::string &theLang)
+{
+  Locus::QueryOptions opts;
+  opts.SetCountries("all");
+  opts.SetSearchVariants(true);
+  opts.SetLanguage(theLang);
+
+  Results ret;
+  for (const auto *name : {"Helsinki", "Åbo,Åbo", "Kumpula"})
+    ret.emplace_back(std::string("nameSearch ") + name + " " + theLang,
+                     names.nameSearch(opts, name));
+  ret.emplace_back("idSearch 658225 " + theLang, names.idSearch(opts, 658225));
+  ret.emplace_back("keywordSearch mareografit " + theLang,
+                   names.keywordSearch(opts, "mareografit"));
+  for (const auto *pattern : {"hel", "Åb", "tur", "stockh"})
+    ret.emplace_back(std::string("suggest ") + pattern + " " + theLang,
+                     names.suggest(pattern, accept_all, theLang));
+  ret.emplace_back("suggest k mareografit " + theLang,
+                   names.suggest("k", accept_all, theLang, "mareografit"));
+  return ret;
+}
+
+std::string compare_translations(const Results &expected, const Results &results)
+{
+  for (std::size_t i = 0; i < expected.size() && i < results.size(); i++)
+  {
+    const auto want = describe_translations(expected[i].second);
+    const auto got = describe_translations(results[i].second);
+    if (want != got)
+      return expected[i].first + " should find" + want + "\n\tnot" + got;
+  }
+  if (expected.size() != results.size())
+    return "Got " + Fmi::to_string(results.size()) + " results instead of " +
+           Fmi::to_string(expected.size());
+  return {};
+}
+
+void pretranslatedLanguages()
+{
+  const auto config = make_config("pretranslated_languages",
+                                  [](libconfig::Setting &root)
+                                  {
+                                    auto &languages = replace(root,
+                                                              "pretranslated_languages",
+                                                              libconfig::Setting::TypeArray);
+                                    for (const auto *lang : {"fi", "sv", "en"})
+                                      languages.add(libconfig::Setting::TypeString) = lang;
+                                  });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  // Pretranslated and other languages must translate like the reference engine
+
+  std::vector<std::pair<std::string, Results>> first;
+  for (const auto *lang : {"fi", "sv", "en", "de"})
+  {
+    auto results = translated_searches(names, lang);
+    auto error = compare_translations(translated_searches(reference(), lang), results);
+    if (!error.empty())
+      TEST_FAILED(error);
+    first.emplace_back(lang, std::move(results));
+  }
+
+  // The returned locations are shared, hence searches in other languages
+  // must not modify them
+
+  std::vector<std::pair<std::string, Results>> copies;
+  for (const auto &lang_results : first)
+  {
+    Results copy;
+    for (const auto &search : lang_results.second)
+    {
+      SmartMet::Spine::LocationList locs;
+      for (const auto &loc : search.second)
+        locs.push_back(std::make_shared<SmartMet::Spine::Location>(*loc));
+      copy.emplace_back(search.first, std::move(locs));
+    }
+    copies.emplace_back(lang_results.first, std::move(copy));
+  }
+
+  for (const auto *lang : {"de", "en", "sv", "fi"})
+    translated_searches(names, lang);
+
+  for (std::size_t i = 0; i < first.size(); i++)
+  {
+    auto error = compare_translations(copies[i].second, first[i].second);
+    if (!error.empty())
+      TEST_FAILED("Returned locations were modified by later searches: " + error);
+
+    error = compare_translations(copies[i].second, translated_searches(names, first[i].first));
+    if (!error.empty())
+      TEST_FAILED("Repeated searches should translate the same way: " + error);
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void suggestWithoutCache()
+{
+  const auto config = make_config(
+      "suggest_without_cache",
+      [](libconfig::Setting &root)
+      { replace(group(root, "cache"), "suggest_max_size", libconfig::Setting::TypeInt) = 0; });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+  // The reference engine selects the pages from cached candidates
+
+  const auto reject_finland = [](const SmartMet::Spine::LocationPtr &loc)
+  { return loc->iso2 == "FI"; };
+  const auto reject_ppl = [](const SmartMet::Spine::LocationPtr &loc)
+  { return loc->feature == "PPL"; };
+
+  const std::vector<std::pair<std::string, std::function<bool(const SmartMet::Spine::LocationPtr &)>>>
+      predicates{{"all", accept_all}, {"not FI", reject_finland}, {"not PPL", reject_ppl}};
+
+  const std::vector<Suggestion> suggestions{{"h", "fi", ""},
+                                            {"he", "sv", ""},
+                                            {"Ääne", "fi", ""},
+                                            {"Åb", "sv", ""},
+                                            {"sto", "en", ""},
+                                            {"Kumpula,Helsinki", "fi", ""},
+                                            {"100539", "fmisid", ""},
+                                            {"k", "fi", "mareografit"},
+                                            {"h", "fi", "ajax_fi_all,mareografit"}};
+
+  for (const auto &s : suggestions)
+  {
+    const std::string keyword = (s.keyword.empty() ? FMINAMES_DEFAULT_KEYWORD : s.keyword);
+    for (const auto &predicate : predicates)
+    {
+      for (unsigned int maxresults : {0, 1, 15})
+      {
+        for (unsigned int page : {0, 1, 2})
+        {
+          const std::string what = "suggest " + s.pattern + " " + s.lang + " " + keyword + " " +
+                                   predicate.first + " page " + Fmi::to_string(page) + " of " +
+                                   Fmi::to_string(maxresults);
+
+          auto want = describe(reference().suggest(
+              s.pattern, predicate.second, s.lang, keyword, page, maxresults));
+          auto got =
+              describe(names.suggest(s.pattern, predicate.second, s.lang, keyword, page, maxresults));
+          if (got != want)
+            TEST_FAILED(what + " should find" + want + "\n\tnot" + got);
+
+          want = describe(reference().suggestDuplicates(
+              s.pattern, predicate.second, s.lang, keyword, page, maxresults));
+          got = describe(names.suggestDuplicates(
+              s.pattern, predicate.second, s.lang, keyword, page, maxresults));
+          if (got != want)
+            TEST_FAILED("Duplicate " + what + " should find" + want + "\n\tnot" + got);
+        }
+      }
+    }
+  }
+
+  // Several languages at once
+
+  const std::vector<std::string> languages{"fi", "sv", "en"};
+  const auto want = reference().suggest("hel", accept_all, languages);
+  const auto got = names.suggest("hel", accept_all, languages);
+  if (want.size() != got.size())
+    TEST_FAILED("Suggest in several languages should return " + Fmi::to_string(want.size()) +
+                " lists, not " + Fmi::to_string(got.size()));
+  for (std::size_t i = 0; i < want.size(); i++)
+    if (describe(got[i]) != describe(want[i]))
+      TEST_FAILED("Suggest hel in language " + languages[i] + " should find" + describe(want[i]) +
+                  "\n\tnot" + describe(got[i]));
+
+  if (cache_stats(names, "suggest_cache").inserts != 0)
+    TEST_FAILED("Suggestions should not be cached when the cache is disabled");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run a search which needs the given readiness phase
+ *
+ * The loading continues in the background, hence a later phase may become
+ * ready at any time. A search may fail only if its phase was not ready
+ * when it started, and may succeed only if the phase is ready once it has
+ * finished. Returns an error message or an empty string.
+ */
+// ----------------------------------------------------------------------
+
+std::string answerable(const SmartMet::Engine::Geonames::Engine &names,
+                       SmartMet::Engine::Geonames::Engine::ReadyPhase thePhase,
+                       const std::string &theSearch,
+                       const std::function<void()> &theCall)
+{
+  const bool ready = names.isReady(thePhase);
+  try
+  {
+    theCall();
+  }
+  catch (...)
+  {
+    if (ready)
+      return theSearch + " failed although its phase was ready";
+    return {};
+  }
+  if (!names.isReady(thePhase))
+    return theSearch + " succeeded before its phase was ready";
+  return {};
+}
+
+void readinessPhases()
+{
+  using ReadyPhase = SmartMet::Engine::Geonames::Engine::ReadyPhase;
+
+  const auto &expected = reference();
+
+  Locus::QueryOptions opts;
+  opts.SetCountries("all");
+  opts.SetSearchVariants(true);
+  opts.SetLanguage("fi");
+
+  // The searches in the order of the phases they need
+  const auto keyword_searches = [&opts](const SmartMet::Engine::Geonames::Engine &names)
+  {
+    Results ret;
+    ret.emplace_back("keywordSearch mareografit", names.keywordSearch(opts, "mareografit"));
+    ret.emplace_back("keywordRadiusSearch 24.9642,60.2089",
+                     names.keywordRadiusSearch(24.9642, 60.2089, 50, "fi", "mareografit"));
+    ret.emplace_back(
+        "keywordSearch 24.9642,60.2089",
+        SmartMet::Spine::LocationList{
+            names.keywordSearch(24.9642, 60.2089, -1, "fi", "mareografit")});
+    return ret;
+  };
+  const auto base_suggest = [](const SmartMet::Engine::Geonames::Engine &names)
+  { return names.suggest("he", accept_all, "fi"); };
+  const auto keyword_suggest = [](const SmartMet::Engine::Geonames::Engine &names)
+  { return names.suggest("h", accept_all, "fi", "ajax_fi_all"); };
+
+  TestEngine names("cnf/geonames.conf");
+
+  const std::vector<std::pair<ReadyPhase, std::string>> phases{
+      {ReadyPhase::Locations, "Locations"},
+      {ReadyPhase::Suggest, "Suggest"},
+      {ReadyPhase::Complete, "Complete"}};
+
+  for (std::size_t i = 0; i < phases.size(); i++)
+  {
+    const auto &phase = phases[i];
+    names.ready(phase.first).wait();
+
+    for (std::size_t j = 0; j <= i; j++)
+      if (!names.isReady(phases[j].first))
+        TEST_FAILED(phases[j].second + " is not ready although " + phase.second + " is");
+
+    // Searches of this and the earlier phases must be answered
+
+    auto error = compare_results(keyword_searches(expected), keyword_searches(names));
+    if (!error.empty())
+      TEST_FAILED("At phase " + phase.second + ": " + error);
+
+    if (phase.first != ReadyPhase::Locations && base_suggest(names).empty())
+      TEST_FAILED("At phase " + phase.second + " suggest found nothing");
+
+    if (phase.first == ReadyPhase::Complete)
+    {
+      error = compare_results({{"suggest he fi", base_suggest(expected)},
+                               {"suggest h ajax_fi_all", keyword_suggest(expected)}},
+                              {{"suggest he fi", base_suggest(names)},
+                               {"suggest h ajax_fi_all", keyword_suggest(names)}});
+      if (!error.empty())
+        TEST_FAILED("At phase " + phase.second + ": " + error);
+
+      error = compare_results(sample_searches(expected), sample_searches(names));
+      if (!error.empty())
+        TEST_FAILED("At phase " + phase.second + ": " + error);
+      break;
+    }
+
+    // Searches of the later phases may be answered only once their phase is ready
+
+    error = answerable(names,
+                       ReadyPhase::Suggest,
+                       "suggest he fi",
+                       [&names, &base_suggest]() { base_suggest(names); });
+    if (error.empty())
+      error = answerable(names,
+                         ReadyPhase::Complete,
+                         "suggest h ajax_fi_all",
+                         [&names, &keyword_suggest]() { keyword_suggest(names); });
+    if (!error.empty())
+      TEST_FAILED("At phase " + phase.second + ": " + error);
+
+    // Partial suggest results are not cached
+    const auto inserts = cache_stats(names, "suggest_cache").inserts;
+    try
+    {
+      base_suggest(names);
+    }
+    catch (...)
+    {
+      // Suggest itself may not be ready yet
+    }
+    if (cache_stats(names, "suggest_cache").inserts != inserts &&
+        !names.isReady(ReadyPhase::Complete))
+      TEST_FAILED("At phase " + phase.second + " partial suggest results were cached");
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void lonlatGridCache()
+{
+  const auto config = make_config(
+      "lonlat_grid",
+      [](libconfig::Setting &root)
+      {
+        auto &cache = group(root, "cache");
+        replace(cache, "lonlat_resolution", libconfig::Setting::TypeFloat) = 0.1;
+      });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Locations).wait();
+
+  const auto &exact = reference();
+  auto lq = database_query();
+
+  // Two points in Helsinki in the same grid cell (24.9,60.2), and the cell itself
+  const std::pair<float, float> first{24.93F, 60.17F};
+  const std::pair<float, float> second{24.87F, 60.21F};
+  const std::pair<float, float> cell{24.9F, 60.2F};
+  const float radius = 10;
+
+  Locus::QueryOptions opts;
+  opts.SetCountries("all");
+  opts.SetResultLimit(3);
+  opts.SetLanguage("fi");
+
+  const auto where = [](const std::pair<float, float> &lonlat)
+  { return Fmi::to_string(lonlat.first) + "," + Fmi::to_string(lonlat.second); };
+
+  // Both points are searched at the grid point, hence the second one is a cache hit
+  // and both get the locations of the grid point search with their own coordinates
+
+  const auto expected = lq->FetchByLonLat(opts, cell.first, cell.second, radius);
+  if (expected.empty())
+    TEST_FAILED("The database should find locations near " + where(cell));
+
+  const auto hits = cache_stats(names, "lonlat_search_cache").hits;
+  for (const auto &lonlat : {first, second})
+  {
+    auto error = compare_locations(names.lonlatSearch(opts, lonlat.first, lonlat.second, radius),
+                                   expected);
+    if (!error.empty())
+      TEST_FAILED("Lonlat search " + where(lonlat) + " with a grid: " + error);
+  }
+  if (cache_stats(names, "lonlat_search_cache").hits != hits + 1)
+    TEST_FAILED("The second point in the same grid cell should be a cache hit");
+
+  // Exact coordinates do not share the cache entry
+
+  const auto exact_hits = cache_stats(exact, "lonlat_search_cache").hits;
+  for (const auto &lonlat : {first, second})
+  {
+    auto error = compare_locations(exact.lonlatSearch(opts, lonlat.first, lonlat.second, radius),
+                                   lq->FetchByLonLat(opts, lonlat.first, lonlat.second, radius));
+    if (!error.empty())
+      TEST_FAILED("Lonlat search " + where(lonlat) + " without a grid: " + error);
+  }
+  if (cache_stats(exact, "lonlat_search_cache").hits != exact_hits)
+    TEST_FAILED("Exact coordinates should not share a cache entry");
+
+  // Nearest place searches find the same place with the coordinates they were made with
+
+  std::string place;
+  for (const auto &lonlat : {first, second})
+  {
+    auto loc = names.lonlatSearch(lonlat.first, lonlat.second, "fi", radius);
+    if (!loc)
+      TEST_FAILED("Nearest place search " + where(lonlat) + " found nothing");
+    if (place.empty())
+      place = loc->name;
+    else if (loc->name != place)
+      TEST_FAILED("Nearest place search " + where(lonlat) + " should find " + place + ", not " +
+                  loc->name);
+    if (std::abs(loc->longitude - lonlat.first) > 1e-5 ||
+        std::abs(loc->latitude - lonlat.second) > 1e-5)
+      TEST_FAILED("Nearest place search " + where(lonlat) + " returned coordinates " +
+                  Fmi::to_string(loc->longitude) + "," + Fmi::to_string(loc->latitude));
+    const auto dem = names.demHeight(lonlat.first, lonlat.second);
+    if (loc->dem != dem && !(std::isnan(loc->dem) && std::isnan(dem)))
+      TEST_FAILED("Nearest place search " + where(lonlat) + " returned the height of another point");
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The locations of every keyword in the database
+ */
+// ----------------------------------------------------------------------
+
+Results keyword_locations(const SmartMet::Engine::Geonames::Engine &names)
+{
+  auto conn = database_connection();
+  pqxx::nontransaction work(*conn);
+  auto res = work.exec("SELECT DISTINCT keyword FROM keywords_has_geonames ORDER BY keyword");
+
+  Locus::QueryOptions opts;
+  opts.SetCountries("all");
+  opts.SetLanguage("fi");
+
+  Results ret;
+  for (const auto &row : res)
+  {
+    const auto keyword = row[0].as<std::string>();
+    auto locs = names.keywordSearch(opts, keyword);
+    const auto count = Fmi::to_string(locs.size());
+    ret.emplace_back("keywordSearch " + keyword + " (" + count + " locations)", std::move(locs));
+  }
+  return ret;
+}
+
+void parallelLoad()
+{
+  const auto &expected = reference();
+  const auto expected_keywords = keyword_locations(expected);
+  const auto expected_searches = sample_searches(expected);
+
+  // The reference engine reads each table with a single query and connection
+
+  for (bool parallel : {true, false})
+  {
+    for (int fetch_size : {0, 1000})
+    {
+      if (!parallel && fetch_size == 0)
+        continue;
+
+      const std::string name = "parallel_load_" + std::string(parallel ? "on" : "off") + "_" +
+                               Fmi::to_string(fetch_size);
+      const auto config = make_config(
+          name,
+          [parallel, fetch_size](libconfig::Setting &root)
+          {
+            auto &database = group(root, "database");
+            replace(database, "parallel_load", libconfig::Setting::TypeBoolean) = parallel;
+            replace(database, "fetch_size", libconfig::Setting::TypeInt) = fetch_size;
+          });
+      TestEngine names(config);
+      names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Complete).wait();
+
+      auto error = compare_results(expected_keywords, keyword_locations(names));
+      if (error.empty())
+        error = compare_results(expected_searches, sample_searches(names));
+      if (!error.empty())
+        TEST_FAILED("With parallel_load=" + std::string(parallel ? "true" : "false") +
+                    " and fetch_size=" + Fmi::to_string(fetch_size) + ": " + error);
+    }
+  }
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+void batchSearchFailures()
+{
+  const auto config = make_config(
+      "batch_search_failures",
+      [](libconfig::Setting &root)
+      {
+        replace(root, "batch_threads", libconfig::Setting::TypeInt) = 4;
+        auto &security = group(root, "security");
+        replace(security, "disable", libconfig::Setting::TypeBoolean) = false;
+        auto &deny = replace(group(security, "names"), "deny", libconfig::Setting::TypeArray);
+        deny.add(libconfig::Setting::TypeString) = "forbidden.*";
+      });
+  TestEngine names(config);
+  names.ready(SmartMet::Engine::Geonames::Engine::ReadyPhase::Locations).wait();
+
+  Locus::QueryOptions opts;
+  opts.SetCountries("all");
+  opts.SetSearchVariants(true);
+  opts.SetLanguage("fi");
+
+  // The batches are searched concurrently, the first failed name must be reported
+  // no matter which search fails first
+
+  const std::vector<std::vector<std::string>> batches{
+      {"Helsinki", "forbidden_b", "Rooma", "forbidden_a", "Kallio"},
+      {"forbidden_a", "Helsinki", "forbidden_b"},
+      {"Rooma", "Kallio", "Helsinki", "forbidden_b", "forbidden_a", "forbidden_c"}};
+
+  for (int round = 0; round < 10; round++)
+  {
+    for (const auto &batch : batches)
+    {
+      const std::string first = *std::find_if(batch.begin(),
+                                              batch.end(),
+                                              [](const std::string &name)
+                                              { return name.rfind("forbidden", 0) == 0; });
+
+      std::string trace;
+      try
+      {
+        names.nameSearch(opts, batch);
+      }
+      catch (const Fmi::Exception &e)
+      {
+        trace = e.getStackTrace();
+      }
+
+      if (trace.empty())
+        TEST_FAILED("Batch with forbidden names should fail");
+
+      for (const auto &name : batch)
+      {
+        if (name.rfind("forbidden", 0) != 0)
+          continue;
+        const bool reported = (trace.find(name) != std::string::npos);
+        if (reported != (name == first))
+          TEST_FAILED("Batch should fail for " + first + ", not:\n" + trace);
+      }
+    }
+  }
+
+  // A failed batch does not prevent searching the same names later
+  auto results = names.nameSearch(opts, std::vector<std::string>{"Helsinki", "Rooma"});
+  if (results.size() != 2 || results[0].empty() || results[1].empty())
+    TEST_FAILED("Names of a failed batch should still be found");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+// The actual test driver
+class tests : public tframe::tests
+{
+  //! Overridden message separator
+  virtual const char *error_message_prefix() const { return "\n\t"; }
+  //! Main test suite
+  void test()
+  {
+    TEST(memoryIdSearch);
+    TEST(memoryStationSearch);
+    TEST(snapshot);
+    TEST(incrementalReload);
+    TEST(suggestPrefixReuse);
+    TEST(warmupFile);
+    TEST(compactSuggestIndex);
+    TEST(lazyLanguages);
+    TEST(fastCollation);
+    TEST(memoryLonLatSearch);
+    TEST(locationPriorities);
+    TEST(pretranslatedLanguages);
+    TEST(suggestWithoutCache);
+    TEST(readinessPhases);
+    TEST(lonlatGridCache);
+    TEST(parallelLoad);
+    TEST(batchSearchFailures);
+  }
+
+};  // class tests
+
+}  // namespace Tests
+
+int main(void)
+{
+  // Set output unbuffered - otherwise, output is lost in crash (like segfault)
+  cout.setf(ios::unitbuf);
+  cerr.setf(ios::unitbuf);
+
+  cout << endl << "Geonames settings tester" << endl << "========================" << endl;
+  Tests::tests t;
+  int result = t.run();
+  reference_engine.reset();
+  return result;
+}
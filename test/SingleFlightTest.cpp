@@ -0,0 +1,235 @@
+#include "SingleFlight.h"
+#include <regression/tframe.h>
+#include <spine/Location.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+using SmartMet::Engine::Geonames::SingleFlight;
+
+const std::size_t callers = 8;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Wait until the given number of callers wait for the search
+ *
+ * Keeps the search running until the other callers have joined it.
+ */
+// ----------------------------------------------------------------------
+
+void wait_for_callers(const SingleFlight &theFlights, std::size_t theCount)
+{
+  const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (theFlights.coalesced() < theCount)
+  {
+    if (std::chrono::steady_clock::now() > until)
+      throw std::runtime_error("The callers did not join the search");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run the search concurrently from all the callers
+ *
+ * Returns the results and the number of callers which failed.
+ */
+// ----------------------------------------------------------------------
+
+std::pair<std::vector<SmartMet::Spine::LocationList>, std::size_t> run_all(
+    SingleFlight &theFlights, const std::string &theKey, const SingleFlight::Search &theSearch)
+{
+  std::vector<SmartMet::Spine::LocationList> results(callers);
+  std::atomic<std::size_t> failures{0};
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < callers; i++)
+    threads.emplace_back(
+        [&, i]()
+        {
+          try
+          {
+            results[i] = theFlights.run(theKey, theSearch);
+          }
+          catch (const std::runtime_error &e)
+          {
+            if (std::string(e.what()) == "Search failed")
+              ++failures;
+          }
+        });
+  for (auto &thread : threads)
+    thread.join();
+  return {results, failures};
+}
+
+namespace Tests
+{
+void oneExecution()
+{
+  SingleFlight flights;
+  std::atomic<int> executions{0};
+  const auto location = std::make_shared<SmartMet::Spine::Location>("Helsinki", 0.0);
+
+  const auto result = run_all(flights,
+                              "helsinki",
+                              [&]()
+                              {
+                                ++executions;
+                                wait_for_callers(flights, callers - 1);
+                                return SmartMet::Spine::LocationList{location};
+                              });
+
+  if (executions != 1)
+    TEST_FAILED("Expected one execution, got " + std::to_string(executions.load()));
+  if (result.second != 0)
+    TEST_FAILED(std::to_string(result.second) + " callers failed");
+  for (const auto &locs : result.first)
+    if (locs.size() != 1 || locs.front() != location)
+      TEST_FAILED("All callers should get the result of the search");
+  if (flights.started() != 1 || flights.coalesced() != callers - 1)
+    TEST_FAILED("Expected 1 search and " + std::to_string(callers - 1) +
+                " coalesced callers, got " + std::to_string(flights.started()) + " and " +
+                std::to_string(flights.coalesced()));
+  if (flights.inflight() != 0)
+    TEST_FAILED("The finished search is still in flight");
+
+  // Finished searches are not shared with later callers
+  flights.run("helsinki",
+              [&]()
+              {
+                ++executions;
+                return SmartMet::Spine::LocationList{};
+              });
+  if (executions != 2)
+    TEST_FAILED("A later search should run again");
+
+  TEST_PASSED();
+}
+
+void failurePropagates()
+{
+  SingleFlight flights;
+  std::atomic<int> executions{0};
+
+  const auto result = run_all(flights,
+                              "helsinki",
+                              [&]() -> SmartMet::Spine::LocationList
+                              {
+                                ++executions;
+                                wait_for_callers(flights, callers - 1);
+                                throw std::runtime_error("Search failed");
+                              });
+
+  if (executions != 1)
+    TEST_FAILED("Expected one execution, got " + std::to_string(executions.load()));
+  if (result.second != callers)
+    TEST_FAILED("All " + std::to_string(callers) + " callers should fail, not " +
+                std::to_string(result.second));
+  if (flights.inflight() != 0)
+    TEST_FAILED("The failed search is still in flight");
+
+  TEST_PASSED();
+}
+
+void differentKeys()
+{
+  SingleFlight flights;
+  std::atomic<int> executions{0};
+
+  // Both searches must be running at the same time to finish
+  const auto search = [&]()
+  {
+    ++executions;
+    const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (executions < 2 && std::chrono::steady_clock::now() < until)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return SmartMet::Spine::LocationList{};
+  };
+
+  std::thread other([&]() { flights.run("espoo", search); });
+  flights.run("helsinki", search);
+  other.join();
+
+  if (flights.started() != 2 || flights.coalesced() != 0)
+    TEST_FAILED("Searches with different keys should not be coalesced");
+
+  TEST_PASSED();
+}
+
+void deadline()
+{
+  SingleFlight flights;
+  std::atomic<bool> finish{false};
+
+  std::thread searcher(
+      [&]()
+      {
+        flights.run("helsinki",
+                    [&]()
+                    {
+                      while (!finish)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                      return SmartMet::Spine::LocationList{};
+                    });
+      });
+
+  while (flights.inflight() == 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  // The waiting caller gives up, the search continues
+  bool timedout = false;
+  try
+  {
+    flights.run("helsinki",
+                []() { return SmartMet::Spine::LocationList{}; },
+                SingleFlight::Clock::now() + std::chrono::milliseconds(20));
+  }
+  catch (...)
+  {
+    timedout = true;
+  }
+
+  const auto inflight = flights.inflight();
+  finish = true;
+  searcher.join();
+
+  if (!timedout)
+    TEST_FAILED("The waiting caller should time out");
+  if (inflight != 1)
+    TEST_FAILED("The search should continue after the waiting caller timed out");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+
+// The actual test driver
+class tests : public tframe::tests
+{
+  //! Overridden message separator
+  virtual const char *error_message_prefix() const { return "\n\t"; }
+  //! Main test suite
+  void test()
+  {
+    TEST(oneExecution);
+    TEST(failurePropagates);
+    TEST(differentKeys);
+    TEST(deadline);
+  }
+
+};  // class tests
+
+}  // namespace Tests
+
+int main(void)
+{
+  cout << endl << "SingleFlight tester" << endl << "===================" << endl;
+  Tests::tests t;
+  return t.run();
+}